@@ -0,0 +1,210 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ZIPTREE_H_
+#define ZIPTREE_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reusable zip tree implementation. The style is inspired by the BSD
+ * sys/queue.h linked list definitions.
+ *
+ * Zip trees were developed in: Tarjan, R. E., Levy, C. C., and Timmel, S. "Zip
+ * Trees." arXiv preprint arXiv:1806.06726 (2018).
+ *
+ * A zip tree is a randomized binary search tree with expected O(log n) depth.
+ * It is intrusive: The ZIP_ENTRY definition is contained in the tree elements
+ * themselves and inserting or removing an element never allocates memory.
+ * Every element gets a rank that is drawn from a geometric distribution. The
+ * rank is computed from a hash of the element address, so no random number
+ * generator is required.
+ *
+ * Use ZIP_HEAD to define the tree root structure and ZIP_IMPL (in a .c
+ * compilation unit) to generate the methods. The keys of all elements in a
+ * tree must be unique. */
+
+enum ZIP_CMP {
+    ZIP_CMP_LESS = -1,
+    ZIP_CMP_EQ = 0,
+    ZIP_CMP_MORE = 1
+};
+
+#if defined(_MSC_VER)
+# define ZIP_INLINE __inline
+#else
+# define ZIP_INLINE inline
+#endif
+
+#define ZIP_HEAD(name, type)                    \
+struct name {                                   \
+    struct type *zip_root;                      \
+}
+
+#define ZIP_ENTRY(type)                         \
+struct {                                        \
+    struct type *zip_left;                      \
+    struct type *zip_right;                     \
+    unsigned char zip_rank;                     \
+}
+
+#define ZIP_INIT(head) do { (head)->zip_root = NULL; } while(0)
+#define ZIP_ROOT(head) (head)->zip_root
+#define ZIP_EMPTY(head) (ZIP_ROOT(head) == NULL)
+#define ZIP_LEFT(elm, field) (elm)->field.zip_left
+#define ZIP_RIGHT(elm, field) (elm)->field.zip_right
+#define ZIP_RANK(elm, field) (elm)->field.zip_rank
+
+/* Geometrically distributed rank (P(k) = 1/2^(k+1)) from the leading zeros of
+ * the Fibonacci hash of the element address */
+static ZIP_INLINE unsigned char
+zip_rank_from_address(const void *elm) {
+    unsigned long long h =
+        (unsigned long long)(size_t)elm * 0x9E3779B97F4A7C15ULL;
+    unsigned char rank = 0;
+    while(rank < 63 && !(h & 0x8000000000000000ULL)) {
+        h <<= 1;
+        rank++;
+    }
+    return rank;
+}
+
+/* Generates the following static methods for the tree "name":
+ *
+ * void name##_ZIP_INSERT(struct name *head, struct type *elm);
+ * void name##_ZIP_REMOVE(struct name *head, struct type *elm);
+ * struct type *name##_ZIP_FIND(struct name *head, const keytype *key);
+ * struct type *name##_ZIP_MIN(struct name *head);
+ * void name##_ZIP_ITER(struct name *head,
+ *                      void (*cb)(struct type *elm, void *data), void *data);
+ *
+ * The callback of ZIP_ITER may free the element. But the tree must not be
+ * used afterwards and needs to be reset with ZIP_INIT.
+ *
+ * The comparison function has the signature
+ * enum ZIP_CMP cmp(const keytype *a, const keytype *b). */
+#define ZIP_IMPL(name, type, field, keytype, keyfield, cmp)             \
+static ZIP_INLINE struct type *                                         \
+name##_ZIP_INSERT_INTERNAL(struct type *root, struct type *elm) {       \
+    if(!root) {                                                         \
+        ZIP_LEFT(elm, field) = NULL;                                    \
+        ZIP_RIGHT(elm, field) = NULL;                                   \
+        return elm;                                                     \
+    }                                                                   \
+    if(cmp(&(elm)->keyfield, &(root)->keyfield) == ZIP_CMP_LESS) {      \
+        if(name##_ZIP_INSERT_INTERNAL(ZIP_LEFT(root, field), elm) == elm) { \
+            if(ZIP_RANK(elm, field) < ZIP_RANK(root, field)) {          \
+                ZIP_LEFT(root, field) = elm;                            \
+            } else {                                                    \
+                ZIP_LEFT(root, field) = ZIP_RIGHT(elm, field);          \
+                ZIP_RIGHT(elm, field) = root;                           \
+                return elm;                                             \
+            }                                                           \
+        }                                                               \
+    } else {                                                            \
+        if(name##_ZIP_INSERT_INTERNAL(ZIP_RIGHT(root, field), elm) == elm) { \
+            if(ZIP_RANK(elm, field) <= ZIP_RANK(root, field)) {         \
+                ZIP_RIGHT(root, field) = elm;                           \
+            } else {                                                    \
+                ZIP_RIGHT(root, field) = ZIP_LEFT(elm, field);          \
+                ZIP_LEFT(elm, field) = root;                            \
+                return elm;                                             \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    return root;                                                        \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE void                                                  \
+name##_ZIP_INSERT(struct name *head, struct type *elm) {                \
+    ZIP_RANK(elm, field) = zip_rank_from_address(elm);                  \
+    ZIP_ROOT(head) = name##_ZIP_INSERT_INTERNAL(ZIP_ROOT(head), elm);   \
+}                                                                       \
+                                                                        \
+/* Merge two subtrees. All keys in x are smaller than the keys in y. */ \
+static ZIP_INLINE struct type *                                         \
+name##_ZIP_ZIP(struct type *x, struct type *y) {                        \
+    if(!x)                                                              \
+        return y;                                                       \
+    if(!y)                                                              \
+        return x;                                                       \
+    if(ZIP_RANK(x, field) < ZIP_RANK(y, field)) {                       \
+        ZIP_LEFT(y, field) = name##_ZIP_ZIP(x, ZIP_LEFT(y, field));     \
+        return y;                                                       \
+    }                                                                   \
+    ZIP_RIGHT(x, field) = name##_ZIP_ZIP(ZIP_RIGHT(x, field), y);       \
+    return x;                                                           \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE struct type *                                         \
+name##_ZIP_REMOVE_INTERNAL(struct type *root, struct type *elm) {       \
+    if(!root)                                                           \
+        return NULL;                                                    \
+    if(root == elm)                                                     \
+        return name##_ZIP_ZIP(ZIP_LEFT(root, field), ZIP_RIGHT(root, field)); \
+    if(cmp(&(elm)->keyfield, &(root)->keyfield) == ZIP_CMP_LESS)        \
+        ZIP_LEFT(root, field) =                                         \
+            name##_ZIP_REMOVE_INTERNAL(ZIP_LEFT(root, field), elm);     \
+    else                                                                \
+        ZIP_RIGHT(root, field) =                                        \
+            name##_ZIP_REMOVE_INTERNAL(ZIP_RIGHT(root, field), elm);    \
+    return root;                                                        \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE void                                                  \
+name##_ZIP_REMOVE(struct name *head, struct type *elm) {                \
+    ZIP_ROOT(head) = name##_ZIP_REMOVE_INTERNAL(ZIP_ROOT(head), elm);   \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE struct type *                                         \
+name##_ZIP_FIND(struct name *head, const keytype *key) {                \
+    struct type *cur = ZIP_ROOT(head);                                  \
+    while(cur) {                                                        \
+        enum ZIP_CMP c = cmp(key, &(cur)->keyfield);                    \
+        if(c == ZIP_CMP_EQ)                                             \
+            return cur;                                                 \
+        if(c == ZIP_CMP_LESS)                                           \
+            cur = ZIP_LEFT(cur, field);                                 \
+        else                                                            \
+            cur = ZIP_RIGHT(cur, field);                                \
+    }                                                                   \
+    return NULL;                                                        \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE struct type *                                         \
+name##_ZIP_MIN(struct name *head) {                                     \
+    struct type *cur = ZIP_ROOT(head);                                  \
+    if(!cur)                                                            \
+        return NULL;                                                    \
+    while(ZIP_LEFT(cur, field))                                         \
+        cur = ZIP_LEFT(cur, field);                                     \
+    return cur;                                                         \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE void                                                  \
+name##_ZIP_ITER_INTERNAL(struct type *elm,                              \
+                         void (*cb)(struct type *, void *), void *data) { \
+    if(!elm)                                                            \
+        return;                                                         \
+    struct type *left = ZIP_LEFT(elm, field);                           \
+    struct type *right = ZIP_RIGHT(elm, field);                         \
+    name##_ZIP_ITER_INTERNAL(left, cb, data);                           \
+    cb(elm, data);                                                      \
+    name##_ZIP_ITER_INTERNAL(right, cb, data);                          \
+}                                                                       \
+                                                                        \
+static ZIP_INLINE void                                                  \
+name##_ZIP_ITER(struct name *head,                                      \
+                void (*cb)(struct type *, void *), void *data) {        \
+    name##_ZIP_ITER_INTERNAL(ZIP_ROOT(head), cb, data);                 \
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* ZIPTREE_H_ */
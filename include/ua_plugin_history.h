@@ -0,0 +1,61 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef UA_PLUGIN_HISTORY_H_
+#define UA_PLUGIN_HISTORY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_types.h"
+#include "ua_types_generated.h"
+
+#ifdef UA_ENABLE_HISTORIZING
+
+/**
+ * .. _history-database:
+ *
+ * Historical Access Plugin API
+ * ============================
+ * The history database stores the values of VariableNodes with the
+ * ``historizing`` attribute set. The server hands every value written to such a
+ * node (and every value read from its DataSource) to the database. The
+ * HistoryRead service forwards the requests for raw and modified values. */
+
+struct UA_HistoryDatabase;
+typedef struct UA_HistoryDatabase UA_HistoryDatabase;
+
+struct UA_HistoryDatabase {
+    void *context;
+    void (*deleteMembers)(UA_HistoryDatabase *hdb);
+
+    /* Store a new value of a historizing VariableNode. The value always has a
+     * source timestamp. */
+    void (*setValue)(UA_Server *server, void *hdbContext,
+                     const UA_NodeId *sessionId, void *sessionContext,
+                     const UA_NodeId *nodeId, const UA_DataValue *value);
+
+    /* Read the history of a node for ReadRawModifiedDetails. The historyData
+     * of the result is set to a decoded HistoryData (or HistoryModifiedData).
+     * The continuation point in nodeToRead is set when the client continues a
+     * previous request. At most maxValues values are returned, if it is not
+     * zero. A new continuation point is returned if more values remain. */
+    void (*readRaw)(UA_Server *server, void *hdbContext,
+                    const UA_NodeId *sessionId, void *sessionContext,
+                    const UA_ReadRawModifiedDetails *details,
+                    UA_TimestampsToReturn timestampsToReturn,
+                    UA_Boolean releaseContinuationPoints,
+                    UA_UInt32 maxValues,
+                    const UA_HistoryReadValueId *nodeToRead,
+                    UA_HistoryReadResult *result);
+};
+
+#endif /* UA_ENABLE_HISTORIZING */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UA_PLUGIN_HISTORY_H_ */
@@ -48,6 +48,9 @@ typedef struct {
     UA_UInt32 recvBufferSize;
     UA_UInt32 maxMessageSize;
     UA_UInt32 maxChunkCount;
+    UA_UInt32 sendQueueHighWatermark; /* Local only. Above this number of
+                                       * queued bytes the connection is
+                                       * congested. 0 -> unlimited */
 } UA_ConnectionConfig;
 
 typedef enum {
@@ -74,6 +77,15 @@ struct UA_Connection {
     UA_ByteString incompleteMessage; /* A half-received message (TCP is a
                                       * streaming protocol) is stored here */
     UA_UInt64 connectCallbackID;     /* Callback Id, for the connect-loop */
+    size_t sendQueueSize;            /* Bytes accepted by send that are not yet
+                                      * written to the network. Maintained by
+                                      * network layers with an outbound
+                                      * queue. */
+    void *strand;                    /* Used by the server to process the
+                                      * messages of the connection in order.
+                                      * Initialized to NULL by the network
+                                      * layer. */
+
     /* Get a buffer for sending */
     UA_StatusCode (*getSendBuffer)(UA_Connection *connection, size_t length,
                                    UA_ByteString *buf);
@@ -82,7 +94,11 @@ struct UA_Connection {
     void (*releaseSendBuffer)(UA_Connection *connection, UA_ByteString *buf);
 
     /* Sends a message over the connection. The message buffer is always freed,
-     * even if sending fails.
+     * even if sending fails. The network layer may queue the message if the
+     * socket is not writable and send it out later. The queued bytes are
+     * counted in sendQueueSize. When the localConf.sendQueueHighWatermark is
+     * surpassed, the server no longer reads from the connection and defers
+     * publish responses until the queue has been drained.
      *
      * @param connection The connection
      * @param buf The message buffer
@@ -119,6 +135,58 @@ struct UA_Connection {
 void UA_EXPORT
 UA_Connection_deleteMembers(UA_Connection *connection);
 
+/* More bytes than the high watermark are queued for sending */
+static UA_INLINE UA_Boolean
+UA_Connection_isCongested(const UA_Connection *connection) {
+    return connection->localConf.sendQueueHighWatermark > 0 &&
+        connection->sendQueueSize > connection->localConf.sendQueueHighWatermark;
+}
+
+/**
+ * Buffer Pool
+ * -----------
+ * Network layers need a buffer for every received packet and for every sent
+ * chunk. The buffer pool recycles buffers of a fixed size instead of allocating
+ * and freeing them each time. Requests for larger buffers are served from the
+ * heap without recycling. Buffers from the pool must be returned to the pool
+ * and not freed directly. With multithreading enabled, the pool can be used
+ * concurrently. */
+
+typedef struct {
+    size_t allocated; /* Buffers allocated on the heap */
+    size_t reused;    /* Buffers taken from the pool */
+    size_t freed;     /* Buffers returned to the heap */
+    size_t pooled;    /* Unused buffers currently held in the pool */
+} UA_BufferPoolStatistics;
+
+struct UA_BufferPool;
+typedef struct UA_BufferPool UA_BufferPool;
+
+/* Create a new buffer pool.
+ *
+ * @param bufferSize The size of the recycled buffers
+ * @param maxPooled The maximum number of unused buffers kept in the pool
+ * @return The new pool or NULL if out of memory */
+UA_BufferPool UA_EXPORT *
+UA_BufferPool_new(size_t bufferSize, size_t maxPooled);
+
+/* Frees the pool and the unused buffers. All buffers must have been returned
+ * to the pool beforehand. */
+void UA_EXPORT
+UA_BufferPool_delete(UA_BufferPool *pool);
+
+/* Get a buffer of the given length */
+UA_StatusCode UA_EXPORT
+UA_BufferPool_get(UA_BufferPool *pool, size_t length, UA_ByteString *buf);
+
+/* Return a buffer to the pool. The length may have been reduced in the
+ * meantime. The ByteString is set to null afterwards. */
+void UA_EXPORT
+UA_BufferPool_release(UA_BufferPool *pool, UA_ByteString *buf);
+
+void UA_EXPORT
+UA_BufferPool_getStatistics(UA_BufferPool *pool, UA_BufferPoolStatistics *stats);
+
 /**
  * Server Network Layer
  * --------------------
@@ -74,6 +74,13 @@ typedef struct {
     UA_Boolean isInverse;
     size_t targetIdsSize;
     UA_ExpandedNodeId *targetIds;
+
+    /* Members specific to open62541. Large target sets are indexed with a
+     * hash-map from the target NodeId to the position in targetIds. The index
+     * is maintained by UA_Node_addReference and UA_Node_deleteReference. */
+    size_t targetIdsCapacity; /* Allocated length of targetIds */
+    size_t targetIndexSize; /* Zero or a power of two */
+    size_t *targetIndex; /* Position + 1. Zero for an empty slot. */
 } UA_NodeReferenceKind;
 
 #define UA_NODE_BASEATTRIBUTES                  \
@@ -189,6 +196,10 @@ typedef struct {
     UA_Byte accessLevel;
     UA_Double minimumSamplingInterval;
     UA_Boolean historizing; /* currently unsupported */
+
+    /* Members specific to open62541 */
+    UA_UInt32 valueVersion; /* Changes whenever the node is edited. Zero if the
+                             * node was not edited since it was added. */
 } UA_VariableNode;
 
 /**
@@ -1207,7 +1207,14 @@ UA_Server_deleteReference(UA_Server *server, const UA_NodeId sourceNodeId,
  * generated automatically and is returned through ``outEventId``.``NULL`` can be passed if the `EventId` is not
  * needed. ``deleteEventNode`` specifies whether the node representation of the event should be deleted after invoking
  * the method. This can be useful if events with the similar attributes are triggered frequently. ``UA_TRUE`` would
- * cause the node to be deleted. */
+ * cause the node to be deleted.
+ *
+ * The method ``UA_Server_emitEvent`` emits an event without a node
+ * representation. The fields of the event are passed as an array and the
+ * EventFilters of the monitored items are evaluated against the array. This
+ * avoids adding and removing nodes for every event and is suited for high event
+ * rates. The server caches the ancestors of the origin node that receive the
+ * event. */
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
 
 /* The EventQueueOverflowEventType is defined as abstract, therefore we can not
@@ -1239,6 +1246,30 @@ UA_StatusCode UA_EXPORT
 UA_Server_triggerEvent(UA_Server *server, const UA_NodeId eventNodeId, const UA_NodeId originId,
                        UA_ByteString *outEventId, const UA_Boolean deleteEventNode);
 
+/* A field of an event without a node representation. The field is identified
+ * by its browse path from the event type, e.g. the single name "Severity". */
+typedef struct {
+    size_t browsePathSize;
+    UA_QualifiedName *browsePath;
+    UA_Variant value;
+} UA_EventField;
+
+/* Emits an event without a node representation. The fields EventId,
+ * EventType, SourceNode and ReceiveTime are set by the server. The field Time
+ * is set to the current time if it is not contained in the fields.
+ *
+ * @param server The server object
+ * @param eventType The type of the event. Must be a subtype of BaseEventType
+ * @param originId The node that emits the event
+ * @param fieldsSize The number of event fields
+ * @param fields The event fields. They are copied where a filter selects them
+ * @param outEventId The EventId of the new event. Can be NULL
+ * @return The StatusCode of the UA_Server_emitEvent method */
+UA_StatusCode UA_EXPORT
+UA_Server_emitEvent(UA_Server *server, const UA_NodeId eventType, const UA_NodeId originId,
+                    size_t fieldsSize, const UA_EventField *fields,
+                    UA_ByteString *outEventId);
+
 #endif /* UA_ENABLE_SUBSCRIPTIONS_EVENTS */
 
 /**
@@ -27,6 +27,10 @@ extern "C" {
 #include "ua_plugin_pubsub.h"
 #endif
 
+#ifdef UA_ENABLE_HISTORIZING
+#include "ua_plugin_history.h"
+#endif
+
 /**
  * .. _server-configuration:
  *
@@ -153,6 +157,12 @@ struct UA_ServerConfig {
     UA_DurationRange samplingIntervalLimits;
     UA_UInt32Range queueSizeLimits; /* Negotiated with the client */
 
+    /* Values stored in VariableNodes are sampled when the node is written
+     * instead of on every sampling interval. The sampling interval limits the
+     * rate of the samples. Values from a DataSource or with an onRead callback
+     * are always sampled in the interval. Not used with multithreading. */
+    UA_Boolean sampleOnWrite;
+
     /* Limits for PublishRequests */
     UA_UInt32 maxPublishReqPerSession;
 
@@ -169,6 +179,8 @@ struct UA_ServerConfig {
 
     /* Historical Access */
 #ifdef UA_ENABLE_HISTORIZING
+    UA_HistoryDatabase historyDatabase;
+
     UA_Boolean accessHistoryDataCapability;
     UA_UInt32  maxReturnDataValues; /* 0 -> unlimited size */
     
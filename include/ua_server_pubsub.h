@@ -302,6 +302,21 @@ UA_Server_updateWriterGroupConfig(UA_Server *server, UA_NodeId writerGroupIdenti
 UA_StatusCode
 UA_Server_removeWriterGroup(UA_Server *server, const UA_NodeId writerGroup);
 
+/* Freezing the configuration of a WriterGroup encodes its NetworkMessages
+ * once. Every publish cycle then only encodes the sequence numbers, timestamps
+ * and field values in place before the messages are sent. This requires that
+ * the encoded size of the field values stays the same, e.g. scalars of a
+ * numerical type. A NetworkMessage whose field value changes in size is not
+ * sent. The frozen WriterGroup publishes only key frames.
+ *
+ * While frozen, the DataSetWriters of the WriterGroup and the fields of the
+ * connected PublishedDataSets cannot be added or removed. */
+UA_StatusCode
+UA_Server_freezeWriterGroupConfiguration(UA_Server *server, const UA_NodeId writerGroup);
+
+UA_StatusCode
+UA_Server_unfreezeWriterGroupConfiguration(UA_Server *server, const UA_NodeId writerGroup);
+
 /**
  * .. _dsw:
  *
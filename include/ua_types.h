@@ -867,6 +867,16 @@ UA_init(void *p, const UA_DataType *type) {
 UA_StatusCode UA_EXPORT
 UA_copy(const void *src, void *dst, const UA_DataType *type);
 
+/* Compares two variables of the same type. The values are equal if they have
+ * the same binary encoding.
+ *
+ * @param p1 The memory location of the first variable
+ * @param p2 The memory location of the second variable
+ * @param type The datatype description
+ * @return Returns true if the values are equal */
+UA_Boolean UA_EXPORT
+UA_equal(const void *p1, const void *p2, const UA_DataType *type);
+
 /* Deletes the dynamically allocated content of a variable (e.g. resets all
  * arrays to undefined arrays). Afterwards, the variable can be safely deleted
  * without causing memory leaks. But the variable is not initialized and may
@@ -20,6 +20,10 @@
 #include "ua_nodestore_default.h"
 #include "ua_securitypolicy_none.h"
 
+#ifdef UA_ENABLE_HISTORIZING
+#include "ua_history_default.h"
+#endif
+
 #ifdef UA_ENABLE_ENCRYPTION
 #include "ua_securitypolicy_basic128rsa15.h"
 #include "ua_securitypolicy_basic256sha256.h"
@@ -50,7 +54,8 @@ const UA_ConnectionConfig UA_ConnectionConfig_default = {
     65535, /* .sendBufferSize, 64k per chunk */
     65535, /* .recvBufferSize, 64k per chunk */
     0, /* .maxMessageSize, 0 -> unlimited */
-    0 /* .maxChunkCount, 0 -> unlimited */
+    0, /* .maxChunkCount, 0 -> unlimited */
+    1 << 20 /* .sendQueueHighWatermark, 1MB */
 };
 
 /***************************/
@@ -276,13 +281,16 @@ createDefaultConfig(void) {
     /* Limits for MonitoredItems */
     conf->samplingIntervalLimits = UA_DURATIONRANGE(50.0, 24.0 * 3600.0 * 1000.0);
     conf->queueSizeLimits = UA_UINT32RANGE(1, 100);
+    conf->sampleOnWrite = false;
 
 #ifdef UA_ENABLE_DISCOVERY
     conf->discoveryCleanupTimeout = 60 * 60;
 #endif
 
 #ifdef UA_ENABLE_HISTORIZING
-    /* conf->accessHistoryDataCapability = UA_FALSE; */
+    /* Keep the last 10000 values of every historizing node in memory */
+    conf->historyDatabase = UA_HistoryDatabase_default(10000);
+    conf->accessHistoryDataCapability = (conf->historyDatabase.readRaw != NULL);
     /* conf->maxReturnDataValues = 0; */
 
     /* conf->accessHistoryEventsCapability = UA_FALSE; */
@@ -614,6 +622,12 @@ UA_ServerConfig_delete(UA_ServerConfig *config) {
     if(config->nodestore.deleteNodestore)
         config->nodestore.deleteNodestore(config->nodestore.context);
 
+#ifdef UA_ENABLE_HISTORIZING
+    /* History Database */
+    if(config->historyDatabase.deleteMembers)
+        config->historyDatabase.deleteMembers(&config->historyDatabase);
+#endif
+
     /* Custom DataTypes */
     for(size_t i = 0; i < config->customDataTypesSize; ++i)
         UA_free(config->customDataTypes[i].members);
@@ -666,7 +680,8 @@ const UA_ClientConfig UA_ClientConfig_default = {
         65535, /* .sendBufferSize, 64k per chunk */
         65535, /* .recvBufferSize, 64k per chunk */
         0, /* .maxMessageSize, 0 -> unlimited */
-        0 /* .maxChunkCount, 0 -> unlimited */
+        0, /* .maxChunkCount, 0 -> unlimited */
+        0 /* .sendQueueHighWatermark, the client sends blocking */
     },
     UA_ClientConnectionTCP, /* .connectionFunc (for sync connection) */
     UA_ClientConnectionTCP_init, /* .initConnectionFunc (for async client) */
@@ -0,0 +1,461 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#include "ua_history_default.h"
+
+#include "../src/ua_util.h" /* TOOO: Move the ziptree to the arch definitions */
+
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#define BEGIN_HISTORY_CRITSECT(DB) pthread_mutex_lock(&(DB)->mutex)
+#define END_HISTORY_CRITSECT(DB) pthread_mutex_unlock(&(DB)->mutex)
+#else
+#define BEGIN_HISTORY_CRITSECT(DB)
+#define END_HISTORY_CRITSECT(DB)
+#endif
+
+/* The values of every node are kept in a ring buffer that is sorted by the
+ * source timestamp. The buffer grows up to the maximum size. Then the oldest
+ * value is overwritten. Range queries use a binary search on the timestamps.
+ *
+ * A continuation point contains the timestamp of the next value and the offset
+ * among the values with the same timestamp. So it stays valid when old values
+ * are dropped from the buffer. */
+
+typedef struct UA_HistoryNode {
+    ZIP_ENTRY(UA_HistoryNode) zipfields;
+    UA_NodeId nodeId;
+    size_t start; /* Position of the oldest value */
+    size_t size;
+    size_t capacity;
+    UA_DataValue *values;
+} UA_HistoryNode;
+
+ZIP_HEAD(UA_HistoryNodeTree, UA_HistoryNode);
+
+typedef struct {
+    struct UA_HistoryNodeTree nodes;
+    size_t maxValuesPerNode;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t mutex;
+#endif
+} UA_HistoryRingBuffer;
+
+/* The continuation point is the timestamp of the next value and the offset
+ * among the values with the same timestamp. The fields are copied one by one,
+ * so that no struct padding is sent to the client. */
+typedef struct {
+    UA_DateTime timestamp;
+    UA_UInt32 offset;
+} UA_HistoryContinuationPoint;
+
+#define UA_HISTORYCONTINUATIONPOINT_SIZE (sizeof(UA_DateTime) + sizeof(UA_UInt32))
+
+static UA_StatusCode
+encodeContinuationPoint(const UA_HistoryContinuationPoint *cp, UA_ByteString *dst) {
+    UA_StatusCode retval = UA_ByteString_allocBuffer(dst, UA_HISTORYCONTINUATIONPOINT_SIZE);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(dst->data, &cp->timestamp, sizeof(UA_DateTime));
+    memcpy(&dst->data[sizeof(UA_DateTime)], &cp->offset, sizeof(UA_UInt32));
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+decodeContinuationPoint(const UA_ByteString *src, UA_HistoryContinuationPoint *cp) {
+    if(src->length != UA_HISTORYCONTINUATIONPOINT_SIZE)
+        return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    memcpy(&cp->timestamp, src->data, sizeof(UA_DateTime));
+    memcpy(&cp->offset, &src->data[sizeof(UA_DateTime)], sizeof(UA_UInt32));
+    return UA_STATUSCODE_GOOD;
+}
+
+static enum ZIP_CMP
+cmpHistoryNodeId(const UA_NodeId *a, const UA_NodeId *b) {
+    if(a->namespaceIndex != b->namespaceIndex)
+        return (a->namespaceIndex < b->namespaceIndex) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->identifierType != b->identifierType)
+        return (a->identifierType < b->identifierType) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    int c = 0;
+    switch(a->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if(a->identifier.numeric != b->identifier.numeric)
+            return (a->identifier.numeric < b->identifier.numeric) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+        return ZIP_CMP_EQ;
+    case UA_NODEIDTYPE_GUID:
+        c = memcmp(&a->identifier.guid, &b->identifier.guid, sizeof(UA_Guid));
+        break;
+    case UA_NODEIDTYPE_STRING:
+    case UA_NODEIDTYPE_BYTESTRING:
+        if(a->identifier.string.length != b->identifier.string.length)
+            return (a->identifier.string.length < b->identifier.string.length) ?
+                ZIP_CMP_LESS : ZIP_CMP_MORE;
+        if(a->identifier.string.length > 0)
+            c = memcmp(a->identifier.string.data, b->identifier.string.data,
+                       a->identifier.string.length);
+        break;
+    }
+    if(c == 0)
+        return ZIP_CMP_EQ;
+    return (c < 0) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_IMPL(UA_HistoryNodeTree, UA_HistoryNode, zipfields, UA_NodeId, nodeId, cmpHistoryNodeId)
+
+/**********************/
+/* Ring Buffer Access */
+/**********************/
+
+static UA_DataValue *
+getValue(const UA_HistoryNode *hn, size_t i) {
+    return &hn->values[(hn->start + i) % hn->capacity];
+}
+
+static UA_DateTime
+getTimestamp(const UA_HistoryNode *hn, size_t i) {
+    return getValue(hn, i)->sourceTimestamp;
+}
+
+/* Index of the first value with a timestamp >= t */
+static size_t
+lowerBound(const UA_HistoryNode *hn, UA_DateTime t) {
+    size_t lo = 0, hi = hn->size;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(getTimestamp(hn, mid) < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Index of the first value with a timestamp > t */
+static size_t
+upperBound(const UA_HistoryNode *hn, UA_DateTime t) {
+    size_t lo = 0, hi = hn->size;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(getTimestamp(hn, mid) <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Make room for one more value. Grows the buffer up to the maximum size. Then
+ * drops the oldest value. Returns false if the value cannot be stored. */
+static UA_Boolean
+reserveValue(UA_HistoryNode *hn, size_t maxValues, UA_DateTime t) {
+    if(hn->size < hn->capacity)
+        return true;
+
+    if(hn->capacity < maxValues) {
+        /* Values are only dropped when the buffer has the maximum size. So the
+         * values start at the beginning of the buffer. */
+        UA_assert(hn->start == 0);
+        size_t capacity = (hn->capacity < 8) ? 8 : hn->capacity * 2;
+        if(capacity > maxValues)
+            capacity = maxValues;
+        UA_DataValue *values = (UA_DataValue*)
+            UA_realloc(hn->values, sizeof(UA_DataValue) * capacity);
+        if(!values)
+            return false;
+        hn->values = values;
+        hn->capacity = capacity;
+        return true;
+    }
+
+    /* Older than all values in a full buffer */
+    if(t < getTimestamp(hn, 0))
+        return false;
+
+    UA_DataValue_deleteMembers(getValue(hn, 0));
+    hn->start = (hn->start + 1) % hn->capacity;
+    hn->size--;
+    return true;
+}
+
+static void
+insertValue(UA_HistoryNode *hn, size_t maxValues, const UA_DataValue *value) {
+    /* Values with the same timestamp are stored in the order of arrival */
+    UA_DateTime t = value->sourceTimestamp;
+    if(!reserveValue(hn, maxValues, t))
+        return;
+
+    /* Values mostly arrive in order. Otherwise move the newer values. */
+    size_t pos = upperBound(hn, t);
+    for(size_t i = hn->size; i > pos; --i)
+        *getValue(hn, i) = *getValue(hn, i - 1);
+
+    UA_DataValue *target = getValue(hn, pos);
+    if(UA_DataValue_copy(value, target) != UA_STATUSCODE_GOOD) {
+        /* Close the gap again */
+        for(size_t i = pos; i < hn->size; ++i)
+            *getValue(hn, i) = *getValue(hn, i + 1);
+        return;
+    }
+    hn->size++;
+}
+
+/*************/
+/* Interface */
+/*************/
+
+static void
+setValue_ringBuffer(UA_Server *server, void *hdbContext,
+                    const UA_NodeId *sessionId, void *sessionContext,
+                    const UA_NodeId *nodeId, const UA_DataValue *value) {
+    UA_HistoryRingBuffer *rb = (UA_HistoryRingBuffer*)hdbContext;
+    BEGIN_HISTORY_CRITSECT(rb);
+    UA_HistoryNode *hn = UA_HistoryNodeTree_ZIP_FIND(&rb->nodes, nodeId);
+    if(!hn) {
+        hn = (UA_HistoryNode*)UA_calloc(1, sizeof(UA_HistoryNode));
+        if(!hn || UA_NodeId_copy(nodeId, &hn->nodeId) != UA_STATUSCODE_GOOD) {
+            UA_free(hn);
+            END_HISTORY_CRITSECT(rb);
+            return;
+        }
+        UA_HistoryNodeTree_ZIP_INSERT(&rb->nodes, hn);
+    }
+    insertValue(hn, rb->maxValuesPerNode, value);
+    END_HISTORY_CRITSECT(rb);
+}
+
+static UA_StatusCode
+copyHistoryValue(const UA_DataValue *src, UA_DataValue *dst,
+                 UA_TimestampsToReturn timestampsToReturn,
+                 const UA_NumericRange *range) {
+    UA_StatusCode retval;
+    if(range) {
+        *dst = *src;
+        UA_Variant_init(&dst->value);
+        retval = UA_Variant_copyRange(&src->value, &dst->value, *range);
+    } else {
+        retval = UA_DataValue_copy(src, dst);
+    }
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(timestampsToReturn == UA_TIMESTAMPSTORETURN_SOURCE) {
+        dst->hasServerTimestamp = false;
+        dst->hasServerPicoseconds = false;
+    } else if(timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER) {
+        dst->hasSourceTimestamp = false;
+        dst->hasSourcePicoseconds = false;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Compute the range [lo, hi) of values in the requested time interval.
+ * Returns whether the values are returned in reverse order. */
+static UA_StatusCode
+getRange(const UA_HistoryNode *hn, const UA_ReadRawModifiedDetails *details,
+         size_t *lo, size_t *hi, UA_Boolean *reverse) {
+    UA_DateTime start = details->startTime;
+    UA_DateTime end = details->endTime;
+    if(start == 0 && end == 0)
+        return UA_STATUSCODE_BADINVALIDTIMESTAMPARGUMENT;
+    /* With only one timestamp the number of values limits the interval */
+    if((start == 0 || end == 0) && details->numValuesPerNode == 0)
+        return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+
+    *reverse = (start == 0 || (end != 0 && start > end));
+    if(!*reverse) {
+        /* Values in [start, end). Values at start if both are the same. */
+        *lo = lowerBound(hn, start);
+        if(end == 0)
+            *hi = hn->size;
+        else if(end == start)
+            *hi = upperBound(hn, end);
+        else
+            *hi = lowerBound(hn, end);
+    } else if(start == 0) {
+        /* Values up to and including end */
+        *lo = 0;
+        *hi = upperBound(hn, end);
+    } else {
+        /* Values in (end, start] */
+        *lo = (end == 0) ? 0 : upperBound(hn, end);
+        *hi = upperBound(hn, start);
+    }
+
+    /* Add the bounding values before and after the interval */
+    if(details->returnBounds) {
+        if(*lo > 0)
+            (*lo)--;
+        if(*hi < hn->size)
+            (*hi)++;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+readRawValues(const UA_HistoryNode *hn, const UA_ReadRawModifiedDetails *details,
+              UA_TimestampsToReturn timestampsToReturn, UA_UInt32 maxValues,
+              const UA_HistoryReadValueId *nodeToRead, UA_HistoryData *data,
+              UA_ByteString *continuationPoint) {
+    size_t lo, hi;
+    UA_Boolean reverse;
+    UA_StatusCode retval = getRange(hn, details, &lo, &hi, &reverse);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* The position of the next value. Counting down in reverse order. */
+    size_t next = reverse ? hi : lo;
+    if(nodeToRead->continuationPoint.length > 0) {
+        UA_HistoryContinuationPoint cp;
+        retval = decodeContinuationPoint(&nodeToRead->continuationPoint, &cp);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        next = lowerBound(hn, cp.timestamp) + cp.offset;
+        if(reverse)
+            next++;
+        if(next < lo)
+            next = lo;
+        if(next > hi)
+            next = hi;
+    }
+    size_t available = reverse ? next - lo : hi - next;
+
+    /* Limit the number of values */
+    size_t limit = details->numValuesPerNode;
+    if(maxValues > 0 && (limit == 0 || maxValues < limit))
+        limit = maxValues;
+    size_t count = available;
+    if(limit > 0 && count > limit)
+        count = limit;
+    if(count == 0)
+        return UA_STATUSCODE_GOODNODATA;
+
+    /* Parse the index range */
+    UA_NumericRange range;
+    UA_NumericRange *rangeptr = NULL;
+    if(nodeToRead->indexRange.length > 0) {
+        retval = UA_NumericRange_parseFromString(&range, &nodeToRead->indexRange);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        rangeptr = &range;
+    }
+
+    /* Copy the values */
+    data->dataValues = (UA_DataValue*)
+        UA_Array_new(count, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    if(!data->dataValues) {
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto cleanup;
+    }
+    data->dataValuesSize = count;
+    for(size_t i = 0; i < count; ++i) {
+        size_t pos = reverse ? next - 1 - i : next + i;
+        retval = copyHistoryValue(getValue(hn, pos), &data->dataValues[i],
+                                  timestampsToReturn, rangeptr);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+    }
+
+    /* Continue after the last returned value */
+    if(count < available) {
+        size_t pos = reverse ? next - count - 1 : next + count;
+        UA_HistoryContinuationPoint cp;
+        cp.timestamp = getTimestamp(hn, pos);
+        cp.offset = (UA_UInt32)(pos - lowerBound(hn, cp.timestamp));
+        retval = encodeContinuationPoint(&cp, continuationPoint);
+    }
+
+ cleanup:
+    if(rangeptr)
+        UA_free(range.dimensions);
+    return retval;
+}
+
+static void
+readRaw_ringBuffer(UA_Server *server, void *hdbContext,
+                   const UA_NodeId *sessionId, void *sessionContext,
+                   const UA_ReadRawModifiedDetails *details,
+                   UA_TimestampsToReturn timestampsToReturn,
+                   UA_Boolean releaseContinuationPoints,
+                   UA_UInt32 maxValues,
+                   const UA_HistoryReadValueId *nodeToRead,
+                   UA_HistoryReadResult *result) {
+    /* The continuation points hold no resources */
+    if(releaseContinuationPoints)
+        return;
+
+    /* Values are never modified. Return an empty HistoryModifiedData. */
+    if(details->isReadModified) {
+        UA_HistoryModifiedData *modified = UA_HistoryModifiedData_new();
+        if(!modified) {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        result->historyData.encoding = UA_EXTENSIONOBJECT_DECODED;
+        result->historyData.content.decoded.type = &UA_TYPES[UA_TYPES_HISTORYMODIFIEDDATA];
+        result->historyData.content.decoded.data = modified;
+        result->statusCode = UA_STATUSCODE_GOODNODATA;
+        return;
+    }
+
+    UA_HistoryData *data = UA_HistoryData_new();
+    if(!data) {
+        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    result->historyData.encoding = UA_EXTENSIONOBJECT_DECODED;
+    result->historyData.content.decoded.type = &UA_TYPES[UA_TYPES_HISTORYDATA];
+    result->historyData.content.decoded.data = data;
+
+    UA_HistoryRingBuffer *rb = (UA_HistoryRingBuffer*)hdbContext;
+    BEGIN_HISTORY_CRITSECT(rb);
+    UA_HistoryNode *hn = UA_HistoryNodeTree_ZIP_FIND(&rb->nodes, &nodeToRead->nodeId);
+    if(hn)
+        result->statusCode = readRawValues(hn, details, timestampsToReturn, maxValues,
+                                           nodeToRead, data, &result->continuationPoint);
+    else
+        result->statusCode = UA_STATUSCODE_GOODNODATA;
+    END_HISTORY_CRITSECT(rb);
+}
+
+static void
+deleteHistoryNode(UA_HistoryNode *hn, void *data) {
+    for(size_t i = 0; i < hn->size; ++i)
+        UA_DataValue_deleteMembers(getValue(hn, i));
+    UA_free(hn->values);
+    UA_NodeId_deleteMembers(&hn->nodeId);
+    UA_free(hn);
+}
+
+static void
+deleteMembers_ringBuffer(UA_HistoryDatabase *hdb) {
+    UA_HistoryRingBuffer *rb = (UA_HistoryRingBuffer*)hdb->context;
+    if(!rb)
+        return;
+    UA_HistoryNodeTree_ZIP_ITER(&rb->nodes, deleteHistoryNode, NULL);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&rb->mutex);
+#endif
+    UA_free(rb);
+    hdb->context = NULL;
+}
+
+UA_HistoryDatabase
+UA_HistoryDatabase_default(size_t maxValuesPerNode) {
+    UA_HistoryDatabase hdb;
+    memset(&hdb, 0, sizeof(UA_HistoryDatabase));
+    if(maxValuesPerNode == 0)
+        return hdb;
+    UA_HistoryRingBuffer *rb = (UA_HistoryRingBuffer*)
+        UA_calloc(1, sizeof(UA_HistoryRingBuffer));
+    if(!rb)
+        return hdb;
+    ZIP_INIT(&rb->nodes);
+    rb->maxValuesPerNode = maxValuesPerNode;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&rb->mutex, NULL);
+#endif
+    hdb.context = rb;
+    hdb.deleteMembers = deleteMembers_ringBuffer;
+    hdb.setValue = setValue_ringBuffer;
+    hdb.readRaw = readRaw_ringBuffer;
+    return hdb;
+}
@@ -0,0 +1,24 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_HISTORY_DEFAULT_H_
+#define UA_HISTORY_DEFAULT_H_
+
+#include "ua_server.h"
+#include "ua_plugin_history.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default history database. Keeps the values of every historizing node in an
+ * in-memory ring buffer sorted by the source timestamp. When the buffer of a
+ * node is full, the oldest value is dropped for every new value. */
+UA_EXPORT UA_HistoryDatabase
+UA_HistoryDatabase_default(size_t maxValuesPerNode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UA_HISTORY_DEFAULT_H_ */
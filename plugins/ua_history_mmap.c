@@ -0,0 +1,962 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* Enable POSIX features */
+#ifndef _XOPEN_SOURCE
+# define _XOPEN_SOURCE 600
+#endif
+#ifndef _DEFAULT_SOURCE
+# define _DEFAULT_SOURCE
+#endif
+
+#include "ua_history_mmap.h"
+#include "ua_log_stdout.h"
+
+#include "../src/ua_util.h" /* TOOO: Move the ziptree to the arch definitions */
+#include "../src/ua_types_encoding_binary.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#define BEGIN_HISTORY_CRITSECT(DB) pthread_mutex_lock(&(DB)->mutex)
+#define END_HISTORY_CRITSECT(DB) pthread_mutex_unlock(&(DB)->mutex)
+#else
+#define BEGIN_HISTORY_CRITSECT(DB)
+#define END_HISTORY_CRITSECT(DB)
+#endif
+
+/* The values of a node are appended to a sequence of segment files. A segment
+ * stores the values in columns (source timestamp, server timestamp, status code
+ * and the end of the encoded value) followed by the region of binary encoded
+ * variants. The segment file has the following layout:
+ *
+ *   | header | encoded nodeId | source timestamps | server timestamps |
+ *   | status codes | value ends | encoded values |
+ *
+ * The number of rows in a new segment is chosen from the average size of the
+ * values in the previous segment. When either the columns or the value region
+ * are full, the segment is sealed: The unused end of the value region is cut
+ * from the file and the pages are flushed asynchronously. Then a new segment
+ * is created. Only the active segment of a node stays mapped.
+ *
+ * The values are appended in the order of their source timestamp. So the
+ * timestamp column of a segment is the time index for a binary search. The
+ * time range of every segment is kept in memory to find the segments of a
+ * query. The row count in the header is updated after the row was written. So
+ * a segment stays consistent when the server stops unexpectedly. Unsealed
+ * segments are sealed when the directory is loaded.
+ *
+ * Segment files use the byte order of the host. */
+
+#define UA_HISTORYSEGMENT_MAGIC 0x53484155 /* "UAHS" */
+#define UA_HISTORYSEGMENT_VERSION 1
+#define UA_HISTORYSEGMENT_SUFFIX ".uahs"
+
+/* Bytes of a row in the columns */
+#define UA_HISTORYSEGMENT_ROWSIZE (2 * sizeof(UA_DateTime) + \
+                                   sizeof(UA_StatusCode) + sizeof(UA_UInt32))
+
+/* Expected size of an encoded value before the first segment was sealed */
+#define UA_HISTORYSEGMENT_VALUESIZE 16
+
+typedef struct {
+    UA_UInt32 magic;
+    UA_UInt32 version;
+    UA_UInt32 capacity;    /* Rows in the columns */
+    UA_UInt32 count;       /* Written rows */
+    UA_UInt32 sealed;
+    UA_UInt32 nodeIdSize;  /* Encoded NodeId after the header */
+    UA_UInt32 valuesStart; /* Offset of the value region in the file */
+    UA_UInt32 valuesSize;  /* Size of the value region */
+} UA_HistorySegmentHeader;
+
+typedef struct {
+    UA_Byte *base;
+    size_t length;
+    UA_HistorySegmentHeader *header;
+    UA_DateTime *sourceTimestamps;
+    UA_DateTime *serverTimestamps;
+    UA_StatusCode *statusCodes;
+    UA_UInt32 *valueEnds; /* Relative to the value region */
+    UA_Byte *values;
+} UA_HistorySegmentMap;
+
+/* Kept in memory for every segment */
+typedef struct {
+    UA_UInt64 id;
+    UA_DateTime minTime;
+    UA_DateTime maxTime;
+    size_t count;
+    size_t first; /* Index of the first row among all values of the node */
+} UA_HistorySegmentInfo;
+
+typedef struct UA_HistoryMmapNode {
+    ZIP_ENTRY(UA_HistoryMmapNode) zipfields;
+    UA_NodeId nodeId;
+    size_t size; /* Values in all segments */
+    size_t segmentsSize;
+    UA_HistorySegmentInfo *segments; /* Ordered by time */
+    UA_HistorySegmentMap active; /* The last segment if it is mapped */
+    size_t avgValueSize;
+} UA_HistoryMmapNode;
+
+ZIP_HEAD(UA_HistoryMmapNodeTree, UA_HistoryMmapNode);
+
+typedef struct {
+    struct UA_HistoryMmapNodeTree nodes;
+    char *directory;
+    size_t segmentSize;
+    size_t maxSegmentsPerNode;
+    UA_UInt64 nextSegmentId;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t mutex;
+#endif
+} UA_HistoryMmapStore;
+
+/* Continuation points contain the timestamp of the next value. The timestamps
+ * of a node are unique. */
+typedef struct {
+    UA_DateTime timestamp;
+} UA_HistoryMmapContinuationPoint;
+
+static enum ZIP_CMP
+cmpHistoryMmapNodeId(const UA_NodeId *a, const UA_NodeId *b) {
+    if(a->namespaceIndex != b->namespaceIndex)
+        return (a->namespaceIndex < b->namespaceIndex) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->identifierType != b->identifierType)
+        return (a->identifierType < b->identifierType) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    int c = 0;
+    switch(a->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if(a->identifier.numeric != b->identifier.numeric)
+            return (a->identifier.numeric < b->identifier.numeric) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+        return ZIP_CMP_EQ;
+    case UA_NODEIDTYPE_GUID:
+        c = memcmp(&a->identifier.guid, &b->identifier.guid, sizeof(UA_Guid));
+        break;
+    case UA_NODEIDTYPE_STRING:
+    case UA_NODEIDTYPE_BYTESTRING:
+        if(a->identifier.string.length != b->identifier.string.length)
+            return (a->identifier.string.length < b->identifier.string.length) ?
+                ZIP_CMP_LESS : ZIP_CMP_MORE;
+        if(a->identifier.string.length > 0)
+            c = memcmp(a->identifier.string.data, b->identifier.string.data,
+                       a->identifier.string.length);
+        break;
+    }
+    if(c == 0)
+        return ZIP_CMP_EQ;
+    return (c < 0) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_IMPL(UA_HistoryMmapNodeTree, UA_HistoryMmapNode, zipfields,
+         UA_NodeId, nodeId, cmpHistoryMmapNodeId)
+
+/*****************/
+/* Segment Files */
+/*****************/
+
+static size_t
+columnsStart(size_t nodeIdSize) {
+    size_t start = sizeof(UA_HistorySegmentHeader) + nodeIdSize;
+    return (start + 7) & ~(size_t)7;
+}
+
+static void
+segmentPath(const UA_HistoryMmapStore *store, UA_UInt64 id, char *path) {
+    snprintf(path, PATH_MAX, "%s/%016llx" UA_HISTORYSEGMENT_SUFFIX,
+             store->directory, (unsigned long long)id);
+}
+
+/* Set up the pointers into the columns. Checks that the layout in the header
+ * fits into the file. */
+static UA_StatusCode
+initSegmentMap(UA_HistorySegmentMap *map) {
+    if(map->length < sizeof(UA_HistorySegmentHeader))
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_HistorySegmentHeader *h = (UA_HistorySegmentHeader*)map->base;
+    if(h->magic != UA_HISTORYSEGMENT_MAGIC || h->version != UA_HISTORYSEGMENT_VERSION ||
+       h->count > h->capacity)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    size_t start = columnsStart(h->nodeIdSize);
+    if(h->valuesStart != start + h->capacity * UA_HISTORYSEGMENT_ROWSIZE ||
+       (size_t)h->valuesStart + h->valuesSize > map->length)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    map->header = h;
+    map->sourceTimestamps = (UA_DateTime*)(map->base + start);
+    map->serverTimestamps = &map->sourceTimestamps[h->capacity];
+    map->statusCodes = (UA_StatusCode*)&map->serverTimestamps[h->capacity];
+    map->valueEnds = (UA_UInt32*)&map->statusCodes[h->capacity];
+    map->values = map->base + h->valuesStart;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+mapSegment(const UA_HistoryMmapStore *store, UA_UInt64 id,
+           UA_Boolean writable, UA_HistorySegmentMap *map) {
+    char path[PATH_MAX];
+    segmentPath(store, id, path);
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if(fd < 0)
+        return UA_STATUSCODE_BADDATAUNAVAILABLE;
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return UA_STATUSCODE_BADDATAUNAVAILABLE;
+    }
+    if((size_t)st.st_size < sizeof(UA_HistorySegmentHeader)) {
+        close(fd);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *base = mmap(NULL, (size_t)st.st_size, prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+
+    memset(map, 0, sizeof(UA_HistorySegmentMap));
+    map->base = (UA_Byte*)base;
+    map->length = (size_t)st.st_size;
+    UA_StatusCode retval = initSegmentMap(map);
+    if(retval != UA_STATUSCODE_GOOD) {
+        munmap(base, map->length);
+        map->base = NULL;
+    }
+    return retval;
+}
+
+/* Cut the unused end of the value region and flush the pages. The map is
+ * released. */
+static void
+sealSegment(const UA_HistoryMmapStore *store, UA_UInt64 id,
+            UA_HistorySegmentMap *map) {
+    UA_HistorySegmentHeader *h = map->header;
+    h->valuesSize = (h->count > 0) ? map->valueEnds[h->count - 1] : 0;
+    h->sealed = true;
+    size_t fileSize = (size_t)h->valuesStart + h->valuesSize;
+    msync(map->base, map->length, MS_ASYNC);
+    munmap(map->base, map->length);
+    map->base = NULL;
+
+    char path[PATH_MAX];
+    segmentPath(store, id, path);
+    int res = truncate(path, (off_t)fileSize);
+    (void)res; /* The unused end only wastes space */
+}
+
+/* Create and map a new segment for the node. The segment has room for at
+ * least one value of the given size. */
+static UA_StatusCode
+createSegment(UA_HistoryMmapStore *store, UA_HistoryMmapNode *node,
+              size_t valueSize, UA_DateTime timestamp) {
+    size_t nodeIdSize = UA_calcSizeBinary(&node->nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+    size_t start = columnsStart(nodeIdSize);
+    size_t fileSize = store->segmentSize;
+    if(fileSize < start + UA_HISTORYSEGMENT_ROWSIZE + valueSize)
+        fileSize = start + UA_HISTORYSEGMENT_ROWSIZE + valueSize;
+    if(fileSize > UA_UINT32_MAX)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+
+    /* Balance the columns and the value region. The space for the new value
+     * is always reserved. */
+    size_t capacity = (fileSize - start - valueSize) /
+        (UA_HISTORYSEGMENT_ROWSIZE + node->avgValueSize);
+    if(capacity == 0)
+        capacity = 1;
+    size_t valuesStart = start + capacity * UA_HISTORYSEGMENT_ROWSIZE;
+
+    UA_HistorySegmentInfo *segments = (UA_HistorySegmentInfo*)
+        UA_realloc(node->segments, sizeof(UA_HistorySegmentInfo) * (node->segmentsSize + 1));
+    if(!segments)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->segments = segments;
+
+    UA_UInt64 id = store->nextSegmentId;
+    char path[PATH_MAX];
+    segmentPath(store, id, path);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    if(ftruncate(fd, (off_t)fileSize) != 0) {
+        close(fd);
+        unlink(path);
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    }
+    void *base = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) {
+        unlink(path);
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    }
+    store->nextSegmentId++;
+
+    /* The file is zeroed. Write the header and the NodeId. */
+    UA_HistorySegmentHeader *h = (UA_HistorySegmentHeader*)base;
+    h->magic = UA_HISTORYSEGMENT_MAGIC;
+    h->version = UA_HISTORYSEGMENT_VERSION;
+    h->capacity = (UA_UInt32)capacity;
+    h->nodeIdSize = (UA_UInt32)nodeIdSize;
+    h->valuesStart = (UA_UInt32)valuesStart;
+    h->valuesSize = (UA_UInt32)(fileSize - valuesStart);
+    UA_Byte *pos = (UA_Byte*)base + sizeof(UA_HistorySegmentHeader);
+    const UA_Byte *end = pos + nodeIdSize;
+    UA_StatusCode retval = UA_encodeBinary(&node->nodeId, &UA_TYPES[UA_TYPES_NODEID],
+                                           &pos, &end, NULL, NULL);
+    if(retval == UA_STATUSCODE_GOOD) {
+        node->active.base = (UA_Byte*)base;
+        node->active.length = fileSize;
+        retval = initSegmentMap(&node->active);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        munmap(base, fileSize);
+        node->active.base = NULL;
+        unlink(path);
+        return retval;
+    }
+
+    UA_HistorySegmentInfo *info = &node->segments[node->segmentsSize];
+    info->id = id;
+    info->minTime = timestamp;
+    info->maxTime = timestamp;
+    info->count = 0;
+    info->first = node->size;
+    node->segmentsSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+sealActiveSegment(UA_HistoryMmapStore *store, UA_HistoryMmapNode *node) {
+    if(!node->active.base)
+        return;
+    UA_HistorySegmentHeader *h = node->active.header;
+    if(h->count > 0) {
+        size_t avg = node->active.valueEnds[h->count - 1] / h->count;
+        node->avgValueSize = (avg > 0) ? avg : 1;
+    }
+    sealSegment(store, node->segments[node->segmentsSize - 1].id, &node->active);
+}
+
+static void
+dropOldestSegment(UA_HistoryMmapStore *store, UA_HistoryMmapNode *node) {
+    char path[PATH_MAX];
+    segmentPath(store, node->segments[0].id, path);
+    unlink(path);
+    size_t count = node->segments[0].count;
+    node->segmentsSize--;
+    memmove(node->segments, &node->segments[1],
+            sizeof(UA_HistorySegmentInfo) * node->segmentsSize);
+    for(size_t i = 0; i < node->segmentsSize; ++i)
+        node->segments[i].first -= count;
+    node->size -= count;
+}
+
+static void
+appendValue(UA_HistoryMmapStore *store, UA_HistoryMmapNode *node,
+            const UA_DataValue *value) {
+    /* Append only. Repeated reads of a DataSource return the same value. */
+    UA_DateTime t = value->sourceTimestamp;
+    if(node->size > 0 && t <= node->segments[node->segmentsSize - 1].maxTime)
+        return;
+
+    UA_Variant empty;
+    UA_Variant_init(&empty);
+    const UA_Variant *v = value->hasValue ? &value->value : &empty;
+    size_t valueSize = UA_calcSizeBinary(v, &UA_TYPES[UA_TYPES_VARIANT]);
+    if(valueSize == 0)
+        return;
+
+    /* Seal the active segment when it is full */
+    UA_HistorySegmentMap *map = &node->active;
+    if(map->base) {
+        UA_HistorySegmentHeader *h = map->header;
+        size_t used = (h->count > 0) ? map->valueEnds[h->count - 1] : 0;
+        if(h->count == h->capacity || used + valueSize > h->valuesSize)
+            sealActiveSegment(store, node);
+    }
+    if(!map->base) {
+        if(createSegment(store, node, valueSize, t) != UA_STATUSCODE_GOOD)
+            return;
+        while(store->maxSegmentsPerNode > 0 &&
+              node->segmentsSize > store->maxSegmentsPerNode)
+            dropOldestSegment(store, node);
+    }
+
+    /* Write the row */
+    UA_HistorySegmentHeader *h = map->header;
+    UA_UInt32 row = h->count;
+    UA_UInt32 used = (row > 0) ? map->valueEnds[row - 1] : 0;
+    if(row == h->capacity || used + valueSize > h->valuesSize)
+        return;
+    UA_Byte *pos = &map->values[used];
+    const UA_Byte *end = &map->values[h->valuesSize];
+    if(UA_encodeBinary(v, &UA_TYPES[UA_TYPES_VARIANT], &pos, &end,
+                       NULL, NULL) != UA_STATUSCODE_GOOD)
+        return;
+    map->sourceTimestamps[row] = t;
+    map->serverTimestamps[row] = value->hasServerTimestamp ? value->serverTimestamp : 0;
+    map->statusCodes[row] = value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+    map->valueEnds[row] = used + (UA_UInt32)valueSize;
+    h->count = row + 1;
+
+    UA_HistorySegmentInfo *info = &node->segments[node->segmentsSize - 1];
+    if(info->count == 0)
+        info->minTime = t;
+    info->maxTime = t;
+    info->count++;
+    node->size++;
+}
+
+/***********/
+/* Reading */
+/***********/
+
+/* Maps one segment at a time while the values of a node are read */
+typedef struct {
+    const UA_HistoryMmapStore *store;
+    const UA_HistoryMmapNode *node;
+    size_t segment;
+    UA_HistorySegmentMap map;
+    UA_Boolean owned; /* Unmap when done. Not set for the active segment. */
+} UA_HistorySegmentReader;
+
+static void
+releaseSegment(UA_HistorySegmentReader *r) {
+    if(r->owned && r->map.base)
+        munmap(r->map.base, r->map.length);
+    r->map.base = NULL;
+    r->owned = false;
+}
+
+static UA_StatusCode
+selectSegment(UA_HistorySegmentReader *r, size_t segment) {
+    if(r->map.base && r->segment == segment)
+        return UA_STATUSCODE_GOOD;
+    releaseSegment(r);
+    const UA_HistoryMmapNode *node = r->node;
+    r->segment = segment;
+    if(segment == node->segmentsSize - 1 && node->active.base) {
+        r->map = node->active;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_StatusCode retval = mapSegment(r->store, node->segments[segment].id, false, &r->map);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    r->owned = true;
+    /* The count in the header can be outdated after a crash */
+    if(r->map.header->count < node->segments[segment].count) {
+        releaseSegment(r);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Index of the first value with a timestamp >= t. Or > t if after is set. */
+static UA_StatusCode
+findBound(UA_HistorySegmentReader *r, UA_DateTime t, UA_Boolean after, size_t *index) {
+    const UA_HistoryMmapNode *node = r->node;
+
+    /* Find the first segment that ends after the bound */
+    size_t lo = 0, hi = node->segmentsSize;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        UA_DateTime max = node->segments[mid].maxTime;
+        if(max < t || (after && max == t))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == node->segmentsSize) {
+        *index = node->size;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* The bound is at the start of the segment */
+    const UA_HistorySegmentInfo *info = &node->segments[lo];
+    if(info->minTime > t || (!after && info->minTime == t)) {
+        *index = info->first;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Search in the timestamp column */
+    UA_StatusCode retval = selectSegment(r, lo);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    const UA_DateTime *timestamps = r->map.sourceTimestamps;
+    size_t rlo = 0, rhi = info->count;
+    while(rlo < rhi) {
+        size_t mid = rlo + (rhi - rlo) / 2;
+        if(timestamps[mid] < t || (after && timestamps[mid] == t))
+            rlo = mid + 1;
+        else
+            rhi = mid;
+    }
+    *index = info->first + rlo;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Map the segment of the value with the index. Returns the row. */
+static UA_StatusCode
+seekValue(UA_HistorySegmentReader *r, size_t index, size_t *row) {
+    const UA_HistoryMmapNode *node = r->node;
+    size_t segment = r->segment;
+    if(!r->map.base || index < node->segments[segment].first ||
+       index >= node->segments[segment].first + node->segments[segment].count) {
+        /* The last segment that starts before the index */
+        size_t lo = 0, hi = node->segmentsSize;
+        while(hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if(node->segments[mid].first <= index)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        segment = lo;
+    }
+    UA_StatusCode retval = selectSegment(r, segment);
+    *row = index - node->segments[segment].first;
+    return retval;
+}
+
+/* Decode the value directly from the mapped pages */
+static UA_StatusCode
+readValue(const UA_HistorySegmentMap *map, size_t row, UA_DataValue *dst,
+          UA_TimestampsToReturn timestampsToReturn, const UA_NumericRange *range) {
+    UA_UInt32 start = (row > 0) ? map->valueEnds[row - 1] : 0;
+    UA_UInt32 end = map->valueEnds[row];
+    if(start > end || end > map->header->valuesSize)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    UA_ByteString encoded = {end - start, &map->values[start]};
+    size_t offset = 0;
+    UA_Variant value;
+    UA_StatusCode retval = UA_decodeBinary(&encoded, &offset, &value,
+                                           &UA_TYPES[UA_TYPES_VARIANT], 0, NULL);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(range) {
+        retval = UA_Variant_copyRange(&value, &dst->value, *range);
+        UA_Variant_deleteMembers(&value);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    } else {
+        dst->value = value;
+    }
+    dst->hasValue = (dst->value.type != NULL);
+
+    if(map->statusCodes[row] != UA_STATUSCODE_GOOD) {
+        dst->status = map->statusCodes[row];
+        dst->hasStatus = true;
+    }
+    if(timestampsToReturn != UA_TIMESTAMPSTORETURN_SERVER) {
+        dst->sourceTimestamp = map->sourceTimestamps[row];
+        dst->hasSourceTimestamp = true;
+    }
+    if(timestampsToReturn != UA_TIMESTAMPSTORETURN_SOURCE &&
+       map->serverTimestamps[row] != 0) {
+        dst->serverTimestamp = map->serverTimestamps[row];
+        dst->hasServerTimestamp = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Compute the range [lo, hi) of values in the requested time interval.
+ * Returns whether the values are returned in reverse order. */
+static UA_StatusCode
+getSegmentRange(UA_HistorySegmentReader *r, const UA_ReadRawModifiedDetails *details,
+                size_t *lo, size_t *hi, UA_Boolean *reverse) {
+    UA_DateTime start = details->startTime;
+    UA_DateTime end = details->endTime;
+    if(start == 0 && end == 0)
+        return UA_STATUSCODE_BADINVALIDTIMESTAMPARGUMENT;
+    /* With only one timestamp the number of values limits the interval */
+    if((start == 0 || end == 0) && details->numValuesPerNode == 0)
+        return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    *reverse = (start == 0 || (end != 0 && start > end));
+    if(!*reverse) {
+        /* Values in [start, end). Values at start if both are the same. */
+        retval = findBound(r, start, false, lo);
+        if(end == 0)
+            *hi = r->node->size;
+        else
+            retval |= findBound(r, end, end == start, hi);
+    } else if(start == 0) {
+        /* Values up to and including end */
+        *lo = 0;
+        retval = findBound(r, end, true, hi);
+    } else {
+        /* Values in (end, start] */
+        *lo = 0;
+        if(end != 0)
+            retval = findBound(r, end, true, lo);
+        retval |= findBound(r, start, true, hi);
+    }
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Add the bounding values before and after the interval */
+    if(details->returnBounds) {
+        if(*lo > 0)
+            (*lo)--;
+        if(*hi < r->node->size)
+            (*hi)++;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+readSegmentValues(UA_HistorySegmentReader *r, const UA_ReadRawModifiedDetails *details,
+                  UA_TimestampsToReturn timestampsToReturn, UA_UInt32 maxValues,
+                  const UA_HistoryReadValueId *nodeToRead, UA_HistoryData *data,
+                  UA_ByteString *continuationPoint) {
+    size_t lo, hi;
+    UA_Boolean reverse;
+    UA_StatusCode retval = getSegmentRange(r, details, &lo, &hi, &reverse);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* The position of the next value. Counting down in reverse order. */
+    size_t next = reverse ? hi : lo;
+    if(nodeToRead->continuationPoint.length > 0) {
+        if(nodeToRead->continuationPoint.length != sizeof(UA_HistoryMmapContinuationPoint))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        UA_HistoryMmapContinuationPoint cp;
+        memcpy(&cp, nodeToRead->continuationPoint.data,
+               sizeof(UA_HistoryMmapContinuationPoint));
+        retval = findBound(r, cp.timestamp, reverse, &next);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        if(next < lo)
+            next = lo;
+        if(next > hi)
+            next = hi;
+    }
+    size_t available = reverse ? next - lo : hi - next;
+
+    /* Limit the number of values */
+    size_t limit = details->numValuesPerNode;
+    if(maxValues > 0 && (limit == 0 || maxValues < limit))
+        limit = maxValues;
+    size_t count = available;
+    if(limit > 0 && count > limit)
+        count = limit;
+    if(count == 0)
+        return UA_STATUSCODE_GOODNODATA;
+
+    /* Parse the index range */
+    UA_NumericRange range;
+    UA_NumericRange *rangeptr = NULL;
+    if(nodeToRead->indexRange.length > 0) {
+        retval = UA_NumericRange_parseFromString(&range, &nodeToRead->indexRange);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        rangeptr = &range;
+    }
+
+    /* Decode the values */
+    data->dataValues = (UA_DataValue*)
+        UA_Array_new(count, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    if(!data->dataValues) {
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto cleanup;
+    }
+    data->dataValuesSize = count;
+    for(size_t i = 0; i < count; ++i) {
+        size_t row;
+        retval = seekValue(r, reverse ? next - 1 - i : next + i, &row);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+        retval = readValue(&r->map, row, &data->dataValues[i],
+                           timestampsToReturn, rangeptr);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+    }
+
+    /* Continue at the timestamp of the next value */
+    if(count < available) {
+        size_t row;
+        retval = seekValue(r, reverse ? next - count - 1 : next + count, &row);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+        UA_HistoryMmapContinuationPoint cp;
+        cp.timestamp = r->map.sourceTimestamps[row];
+        retval = UA_ByteString_allocBuffer(continuationPoint,
+                                           sizeof(UA_HistoryMmapContinuationPoint));
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+        memcpy(continuationPoint->data, &cp, sizeof(UA_HistoryMmapContinuationPoint));
+    }
+
+ cleanup:
+    if(rangeptr)
+        UA_free(range.dimensions);
+    return retval;
+}
+
+/*************/
+/* Interface */
+/*************/
+
+static UA_HistoryMmapNode *
+getHistoryMmapNode(UA_HistoryMmapStore *store, const UA_NodeId *nodeId) {
+    UA_HistoryMmapNode *node = UA_HistoryMmapNodeTree_ZIP_FIND(&store->nodes, nodeId);
+    if(node)
+        return node;
+    node = (UA_HistoryMmapNode*)UA_calloc(1, sizeof(UA_HistoryMmapNode));
+    if(!node || UA_NodeId_copy(nodeId, &node->nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(node);
+        return NULL;
+    }
+    node->avgValueSize = UA_HISTORYSEGMENT_VALUESIZE;
+    UA_HistoryMmapNodeTree_ZIP_INSERT(&store->nodes, node);
+    return node;
+}
+
+static void
+setValue_mmap(UA_Server *server, void *hdbContext,
+              const UA_NodeId *sessionId, void *sessionContext,
+              const UA_NodeId *nodeId, const UA_DataValue *value) {
+    UA_HistoryMmapStore *store = (UA_HistoryMmapStore*)hdbContext;
+    BEGIN_HISTORY_CRITSECT(store);
+    UA_HistoryMmapNode *node = getHistoryMmapNode(store, nodeId);
+    if(node)
+        appendValue(store, node, value);
+    END_HISTORY_CRITSECT(store);
+}
+
+static void
+readRaw_mmap(UA_Server *server, void *hdbContext,
+             const UA_NodeId *sessionId, void *sessionContext,
+             const UA_ReadRawModifiedDetails *details,
+             UA_TimestampsToReturn timestampsToReturn,
+             UA_Boolean releaseContinuationPoints,
+             UA_UInt32 maxValues,
+             const UA_HistoryReadValueId *nodeToRead,
+             UA_HistoryReadResult *result) {
+    /* The continuation points hold no resources */
+    if(releaseContinuationPoints)
+        return;
+
+    /* Values are never modified. Return an empty HistoryModifiedData. */
+    if(details->isReadModified) {
+        UA_HistoryModifiedData *modified = UA_HistoryModifiedData_new();
+        if(!modified) {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        result->historyData.encoding = UA_EXTENSIONOBJECT_DECODED;
+        result->historyData.content.decoded.type = &UA_TYPES[UA_TYPES_HISTORYMODIFIEDDATA];
+        result->historyData.content.decoded.data = modified;
+        result->statusCode = UA_STATUSCODE_GOODNODATA;
+        return;
+    }
+
+    UA_HistoryData *data = UA_HistoryData_new();
+    if(!data) {
+        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    result->historyData.encoding = UA_EXTENSIONOBJECT_DECODED;
+    result->historyData.content.decoded.type = &UA_TYPES[UA_TYPES_HISTORYDATA];
+    result->historyData.content.decoded.data = data;
+
+    UA_HistoryMmapStore *store = (UA_HistoryMmapStore*)hdbContext;
+    BEGIN_HISTORY_CRITSECT(store);
+    UA_HistoryMmapNode *node = UA_HistoryMmapNodeTree_ZIP_FIND(&store->nodes, &nodeToRead->nodeId);
+    if(node) {
+        UA_HistorySegmentReader r;
+        memset(&r, 0, sizeof(UA_HistorySegmentReader));
+        r.store = store;
+        r.node = node;
+        result->statusCode = readSegmentValues(&r, details, timestampsToReturn, maxValues,
+                                               nodeToRead, data, &result->continuationPoint);
+        releaseSegment(&r);
+    } else {
+        result->statusCode = UA_STATUSCODE_GOODNODATA;
+    }
+    END_HISTORY_CRITSECT(store);
+}
+
+/***********/
+/* Loading */
+/***********/
+
+static int
+cmpSegmentInfo(const void *a, const void *b) {
+    const UA_HistorySegmentInfo *sa = (const UA_HistorySegmentInfo*)a;
+    const UA_HistorySegmentInfo *sb = (const UA_HistorySegmentInfo*)b;
+    if(sa->minTime != sb->minTime)
+        return (sa->minTime < sb->minTime) ? -1 : 1;
+    return 0;
+}
+
+/* Add an existing segment file to the in-memory index. Unsealed segments are
+ * sealed. Empty segments and segments with a broken format are removed. Files
+ * that cannot be loaded for other reasons are kept. */
+static void
+loadSegment(UA_HistoryMmapStore *store, UA_UInt64 id) {
+    char path[PATH_MAX];
+    segmentPath(store, id, path);
+    UA_HistorySegmentMap map;
+    UA_StatusCode retval = mapSegment(store, id, true, &map);
+    if(retval == UA_STATUSCODE_BADDECODINGERROR) {
+        unlink(path);
+        return;
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "Could not load the history segment %s with %s",
+                       path, UA_StatusCode_name(retval));
+        return;
+    }
+    UA_HistorySegmentHeader *h = map.header;
+    UA_ByteString encoded = {h->nodeIdSize, map.base + sizeof(UA_HistorySegmentHeader)};
+    size_t offset = 0;
+    UA_NodeId nodeId;
+    UA_HistoryMmapNode *node = NULL;
+    UA_HistorySegmentInfo *segments = NULL;
+    if(h->count == 0 || sizeof(UA_HistorySegmentHeader) + h->nodeIdSize > map.length ||
+       UA_decodeBinary(&encoded, &offset, &nodeId, &UA_TYPES[UA_TYPES_NODEID],
+                       0, NULL) != UA_STATUSCODE_GOOD)
+        goto drop;
+    node = getHistoryMmapNode(store, &nodeId);
+    UA_NodeId_deleteMembers(&nodeId);
+    if(node)
+        segments = (UA_HistorySegmentInfo*)
+            UA_realloc(node->segments, sizeof(UA_HistorySegmentInfo) * (node->segmentsSize + 1));
+    if(!segments) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "Could not load the history segment %s with %s", path,
+                       UA_StatusCode_name(UA_STATUSCODE_BADOUTOFMEMORY));
+        munmap(map.base, map.length);
+        return;
+    }
+    node->segments = segments;
+
+    UA_HistorySegmentInfo *info = &node->segments[node->segmentsSize];
+    info->id = id;
+    info->count = h->count;
+    info->minTime = map.sourceTimestamps[0];
+    info->maxTime = map.sourceTimestamps[h->count - 1];
+    node->segmentsSize++;
+    if(!h->sealed) {
+        sealSegment(store, id, &map);
+        return;
+    }
+    munmap(map.base, map.length);
+    return;
+
+ drop:
+    munmap(map.base, map.length);
+    unlink(path);
+}
+
+static void
+indexHistoryMmapNode(UA_HistoryMmapNode *node, void *data) {
+    qsort(node->segments, node->segmentsSize, sizeof(UA_HistorySegmentInfo),
+          cmpSegmentInfo);
+    node->size = 0;
+    for(size_t i = 0; i < node->segmentsSize; ++i) {
+        node->segments[i].first = node->size;
+        node->size += node->segments[i].count;
+    }
+}
+
+static UA_StatusCode
+loadSegments(UA_HistoryMmapStore *store) {
+    DIR *dir = opendir(store->directory);
+    if(!dir && errno == ENOENT) {
+        if(mkdir(store->directory, 0755) != 0)
+            return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+        dir = opendir(store->directory);
+    }
+    if(!dir)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+
+    struct dirent *entry;
+    size_t suffixLen = strlen(UA_HISTORYSEGMENT_SUFFIX);
+    while((entry = readdir(dir))) {
+        size_t len = strlen(entry->d_name);
+        if(len != 16 + suffixLen ||
+           strcmp(&entry->d_name[16], UA_HISTORYSEGMENT_SUFFIX) != 0)
+            continue;
+        char *end = NULL;
+        UA_UInt64 id = strtoull(entry->d_name, &end, 16);
+        if(end != &entry->d_name[16])
+            continue;
+        if(id >= store->nextSegmentId)
+            store->nextSegmentId = id + 1;
+        loadSegment(store, id);
+    }
+    closedir(dir);
+    UA_HistoryMmapNodeTree_ZIP_ITER(&store->nodes, indexHistoryMmapNode, NULL);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+deleteHistoryMmapNode(UA_HistoryMmapNode *node, void *data) {
+    sealActiveSegment((UA_HistoryMmapStore*)data, node);
+    UA_free(node->segments);
+    UA_NodeId_deleteMembers(&node->nodeId);
+    UA_free(node);
+}
+
+static void
+deleteMembers_mmap(UA_HistoryDatabase *hdb) {
+    UA_HistoryMmapStore *store = (UA_HistoryMmapStore*)hdb->context;
+    if(!store)
+        return;
+    UA_HistoryMmapNodeTree_ZIP_ITER(&store->nodes, deleteHistoryMmapNode, store);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&store->mutex);
+#endif
+    UA_free(store->directory);
+    UA_free(store);
+    hdb->context = NULL;
+}
+
+UA_HistoryDatabase
+UA_HistoryDatabase_mmap(const char *directory, size_t segmentSize,
+                        size_t maxSegmentsPerNode) {
+    UA_HistoryDatabase hdb;
+    memset(&hdb, 0, sizeof(UA_HistoryDatabase));
+    size_t dirLen = strlen(directory);
+    if(dirLen == 0 || dirLen + 32 > PATH_MAX || segmentSize > UA_UINT32_MAX)
+        return hdb;
+    UA_HistoryMmapStore *store = (UA_HistoryMmapStore*)
+        UA_calloc(1, sizeof(UA_HistoryMmapStore));
+    if(!store)
+        return hdb;
+    store->directory = (char*)UA_malloc(dirLen + 1);
+    if(!store->directory) {
+        UA_free(store);
+        return hdb;
+    }
+    memcpy(store->directory, directory, dirLen + 1);
+    ZIP_INIT(&store->nodes);
+    store->segmentSize = segmentSize;
+    store->maxSegmentsPerNode = maxSegmentsPerNode;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&store->mutex, NULL);
+#endif
+    hdb.context = store;
+    hdb.deleteMembers = deleteMembers_mmap;
+    if(loadSegments(store) != UA_STATUSCODE_GOOD) {
+        deleteMembers_mmap(&hdb);
+        return hdb;
+    }
+    hdb.setValue = setValue_mmap;
+    hdb.readRaw = readRaw_mmap;
+    return hdb;
+}
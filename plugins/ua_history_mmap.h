@@ -0,0 +1,38 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_HISTORY_MMAP_H_
+#define UA_HISTORY_MMAP_H_
+
+#include "ua_server.h"
+#include "ua_plugin_history.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* History database that appends the values of every historizing node to
+ * memory-mapped segment files in a directory. Only the time range of the
+ * segments is kept in memory. Full segments are sealed and mapped only while a
+ * HistoryRead accesses them. So the history can grow far beyond the available
+ * memory. The segments of a directory are loaded again on startup.
+ *
+ * Values older than the last stored value of a node are dropped. The
+ * picoseconds of the timestamps are not stored.
+ *
+ * @param directory The directory for the segment files. Created if it does not
+ *        exist.
+ * @param segmentSize The size of a new segment file in bytes.
+ * @param maxSegmentsPerNode The oldest segment of a node is deleted when the
+ *        node has more segments. Zero for no limit.
+ * @return A history database without callbacks if the directory cannot be
+ *         opened. */
+UA_EXPORT UA_HistoryDatabase
+UA_HistoryDatabase_mmap(const char *directory, size_t segmentSize,
+                        size_t maxSegmentsPerNode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UA_HISTORY_MMAP_H_ */
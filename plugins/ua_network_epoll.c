@@ -0,0 +1,783 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/* Enable POSIX features */
+#ifndef _XOPEN_SOURCE
+# define _XOPEN_SOURCE 600
+#endif
+#ifndef _DEFAULT_SOURCE
+# define _DEFAULT_SOURCE
+#endif
+
+#include "ua_network_epoll.h"
+#include "ua_log_stdout.h"
+#include "../deps/queue.h"
+
+#include <stdio.h> // snprintf
+#include <string.h> // memset
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h> // close
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+#include "ua_log_socket_error.h"
+
+#define EPOLL_MAXBACKLOG       1024
+#define EPOLL_MAXSERVERSOCKETS 16
+#define EPOLL_MAXEVENTS        256
+#define EPOLL_NOHELLOTIMEOUT   120000 /* timeout in ms before close the connection
+                                       * if server does not receive Hello Message */
+#define EPOLL_MAXPOOLEDBUFFERS 256    /* unused send/recv buffers kept for reuse */
+
+/* Design
+ * ------
+ * All sockets are registered with an epoll instance in edge-triggered mode.
+ * Edge-triggered means that epoll reports a socket only once when new data
+ * arrives. It is not reported again until more data arrives. So the layer
+ * keeps its own per-connection readiness state: A connection that was reported
+ * by epoll is appended to the ready list. In every iteration, each connection
+ * in the ready list receives one buffer. A connection leaves the ready list once
+ * a receive did not fill the entire buffer, i.e. the socket was drained.
+ * Connections with a lot of traffic therefore cannot starve the others.
+ *
+ * Connections that have not sent a HEL message yet are kept in a second list
+ * ordered by the opening date. Only the head of that list needs to be checked
+ * for the timeout. An iteration never touches idle connections.
+ *
+ * Sending never blocks. What cannot be written right away is appended to the
+ * send queue of the connection and sent out when epoll reports the socket as
+ * writable. Congested connections (see UA_Connection_isCongested) are taken
+ * out of the ready list and are not read from until the send queue has been
+ * drained. This stops a client that does not read its responses from making
+ * the server queue ever more data.
+ *
+ * The receive and send buffers of all connections are taken from a buffer
+ * pool of the network layer. So the common request/response exchange does not
+ * allocate memory for the buffers. */
+
+typedef struct EpollSendQueueEntry {
+    SIMPLEQ_ENTRY(EpollSendQueueEntry) next;
+    UA_ByteString buf;
+    size_t offset;
+} EpollSendQueueEntry;
+
+typedef struct EpollConnectionEntry {
+    UA_Connection connection;
+    LIST_ENTRY(EpollConnectionEntry) pointers;
+    TAILQ_ENTRY(EpollConnectionEntry) readyPointers;
+    TAILQ_ENTRY(EpollConnectionEntry) helloPointers;
+    UA_Boolean ready;
+    UA_Boolean throttled; /* Readable, but congested */
+    UA_Boolean waitingForHello;
+    SIMPLEQ_HEAD(, EpollSendQueueEntry) sendQueue;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t sendQueueMutex; /* send is called from the workers */
+#endif
+} EpollConnectionEntry;
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define EPOLL_SENDQUEUE_LOCK(e) pthread_mutex_lock(&(e)->sendQueueMutex)
+# define EPOLL_SENDQUEUE_UNLOCK(e) pthread_mutex_unlock(&(e)->sendQueueMutex)
+#else
+# define EPOLL_SENDQUEUE_LOCK(e)
+# define EPOLL_SENDQUEUE_UNLOCK(e)
+#endif
+
+typedef struct {
+    UA_Logger logger;
+    UA_ConnectionConfig conf;
+    UA_UInt16 port;
+    int epollfd;
+    int serverSockets[EPOLL_MAXSERVERSOCKETS];
+    UA_UInt16 serverSocketsSize;
+    LIST_HEAD(, EpollConnectionEntry) connections;
+    TAILQ_HEAD(, EpollConnectionEntry) ready;
+    TAILQ_HEAD(, EpollConnectionEntry) hello;
+    UA_BufferPool *bufferPool;
+} ServerNetworkLayerEpoll;
+
+/**********************/
+/* Connection Methods */
+/**********************/
+
+static UA_StatusCode
+EpollConnection_getSendBuffer(UA_Connection *connection,
+                              size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll*)connection->handle;
+    return UA_BufferPool_get(layer->bufferPool, length, buf);
+}
+
+/* Used for both send and recv buffers */
+static void
+EpollConnection_releaseBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll*)connection->handle;
+    UA_BufferPool_release(layer->bufferPool, buf);
+}
+
+/* Send as much as possible without blocking. Returns the number of written
+ * bytes or -1 if the connection failed. */
+static ssize_t
+EpollConnection_sendNonBlocking(int sockfd, const UA_Byte *data, size_t length) {
+    size_t nWritten = 0;
+    while(nWritten < length) {
+        /* Prevent OS signals when sending to a closed socket */
+        ssize_t n = send(sockfd, (const char*)data + nWritten,
+                         length - nWritten, MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        nWritten += (size_t)n;
+    }
+    return (ssize_t)nWritten;
+}
+
+static UA_StatusCode
+EpollConnection_send(UA_Connection *connection, UA_ByteString *buf) {
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        EpollConnection_releaseBuffer(connection, buf);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    EpollConnectionEntry *e = (EpollConnectionEntry*)connection;
+    EPOLL_SENDQUEUE_LOCK(e);
+
+    /* Try to send right away if nothing is queued. Otherwise the order of the
+     * messages would get mixed up. */
+    size_t nWritten = 0;
+    if(SIMPLEQ_EMPTY(&e->sendQueue)) {
+        ssize_t n = EpollConnection_sendNonBlocking(connection->sockfd,
+                                                    buf->data, buf->length);
+        if(n < 0) {
+            EPOLL_SENDQUEUE_UNLOCK(e);
+            connection->close(connection);
+            EpollConnection_releaseBuffer(connection, buf);
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        }
+        nWritten = (size_t)n;
+        if(nWritten == buf->length) {
+            EPOLL_SENDQUEUE_UNLOCK(e);
+            EpollConnection_releaseBuffer(connection, buf);
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+
+    /* Queue the remainder. The queue takes ownership of the buffer. If this
+     * fails, the message was partially sent and the stream is corrupted. */
+    EpollSendQueueEntry *q = (EpollSendQueueEntry*)
+        UA_malloc(sizeof(EpollSendQueueEntry));
+    if(!q) {
+        EPOLL_SENDQUEUE_UNLOCK(e);
+        connection->close(connection);
+        EpollConnection_releaseBuffer(connection, buf);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    q->buf = *buf;
+    q->offset = nWritten;
+    SIMPLEQ_INSERT_TAIL(&e->sendQueue, q, next);
+    connection->sendQueueSize += buf->length - nWritten;
+    *buf = UA_BYTESTRING_NULL;
+    EPOLL_SENDQUEUE_UNLOCK(e);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Called when epoll reports the socket as writable */
+static void
+EpollConnection_flushSendQueue(EpollConnectionEntry *e) {
+    UA_Boolean failed = false;
+    EPOLL_SENDQUEUE_LOCK(e);
+    EpollSendQueueEntry *q;
+    while((q = SIMPLEQ_FIRST(&e->sendQueue))) {
+        ssize_t n = EpollConnection_sendNonBlocking(e->connection.sockfd,
+                                                    &q->buf.data[q->offset],
+                                                    q->buf.length - q->offset);
+        if(n < 0) {
+            failed = true;
+            break;
+        }
+        q->offset += (size_t)n;
+        e->connection.sendQueueSize -= (size_t)n;
+        if(q->offset < q->buf.length)
+            break;
+        SIMPLEQ_REMOVE_HEAD(&e->sendQueue, next);
+        EpollConnection_releaseBuffer(&e->connection, &q->buf);
+        UA_free(q);
+    }
+    EPOLL_SENDQUEUE_UNLOCK(e);
+    if(failed)
+        e->connection.close(&e->connection);
+}
+
+static void
+EpollConnection_clearSendQueue(EpollConnectionEntry *e) {
+    EpollSendQueueEntry *q;
+    while((q = SIMPLEQ_FIRST(&e->sendQueue))) {
+        SIMPLEQ_REMOVE_HEAD(&e->sendQueue, next);
+        EpollConnection_releaseBuffer(&e->connection, &q->buf);
+        UA_free(q);
+    }
+    e->connection.sendQueueSize = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&e->sendQueueMutex);
+#endif
+}
+
+/* Receive without blocking. Returns an empty buffer if no data is available. */
+static UA_StatusCode
+EpollConnection_recv(UA_Connection *connection, UA_ByteString *response) {
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll*)connection->handle;
+    UA_StatusCode retval = UA_BufferPool_get(layer->bufferPool,
+                                             connection->localConf.recvBufferSize,
+                                             response);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval; /* not enough memory retry */
+
+    ssize_t ret;
+    do {
+        ret = recv(connection->sockfd, (char*)response->data,
+                   connection->localConf.recvBufferSize, 0);
+    } while(ret < 0 && errno == EINTR);
+
+    /* The remote side closed the connection */
+    if(ret == 0) {
+        EpollConnection_releaseBuffer(connection, response);
+        connection->close(connection);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    /* Error case */
+    if(ret < 0) {
+        EpollConnection_releaseBuffer(connection, response);
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+            return UA_STATUSCODE_GOOD; /* statuscode_good but no data */
+        connection->close(connection);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    /* Set the length of the received buffer */
+    response->length = (size_t)ret;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+epoll_socket_set_nonblocking(int sockfd) {
+    int opts = fcntl(sockfd, F_GETFL);
+    if(opts < 0 || fcntl(sockfd, F_SETFL, opts|O_NONBLOCK) < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerEpoll_freeConnection(UA_Connection *connection) {
+    EpollConnection_clearSendQueue((EpollConnectionEntry*)connection);
+    UA_Connection_deleteMembers(connection);
+    UA_free(connection);
+}
+
+/* This performs only 'shutdown'. The socket is reported by epoll afterwards
+ * and 'close' is called from the listen method. */
+static void
+ServerNetworkLayerEpoll_close(UA_Connection *connection) {
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return;
+    shutdown(connection->sockfd, SHUT_RDWR);
+    connection->state = UA_CONNECTION_CLOSED;
+}
+
+/*****************/
+/* Network Layer */
+/*****************/
+
+static void
+ServerNetworkLayerEpoll_addConnection(ServerNetworkLayerEpoll *layer, int newsockfd,
+                                      struct sockaddr_storage *remote) {
+    /* Set nonblocking */
+    if(epoll_socket_set_nonblocking(newsockfd) != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i | Could not set the socket to nonblocking",
+                       newsockfd);
+        close(newsockfd);
+        return;
+    }
+
+    /* Do not merge packets on the socket (disable Nagle's algorithm) */
+    int dummy = 1;
+    if(setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY,
+                  (const char *)&dummy, sizeof(dummy)) < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK,
+                         "Cannot set socket option TCP_NODELAY. Error: %s",
+                         errno_str));
+        close(newsockfd);
+        return;
+    }
+
+    /* Get the peer name for logging */
+    char remote_name[100];
+    int res = getnameinfo((struct sockaddr*)remote,
+                          sizeof(struct sockaddr_storage),
+                          remote_name, sizeof(remote_name),
+                          NULL, 0, NI_NUMERICHOST);
+    if(res == 0) {
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "Connection %i | New connection over TCP from %s",
+                    newsockfd, remote_name);
+    } else {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Connection %i | New connection over TCP, "
+                           "getnameinfo failed with error: %s",
+                           newsockfd, errno_str));
+    }
+
+    /* Allocate and initialize the connection */
+    EpollConnectionEntry *e = (EpollConnectionEntry*)
+        UA_calloc(1, sizeof(EpollConnectionEntry));
+    if(!e) {
+        close(newsockfd);
+        return;
+    }
+
+    SIMPLEQ_INIT(&e->sendQueue);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&e->sendQueueMutex, NULL);
+#endif
+    UA_Connection *c = &e->connection;
+    c->sockfd = newsockfd;
+    c->handle = layer;
+    c->localConf = layer->conf;
+    c->remoteConf = layer->conf;
+    c->send = EpollConnection_send;
+    c->close = ServerNetworkLayerEpoll_close;
+    c->free = ServerNetworkLayerEpoll_freeConnection;
+    c->getSendBuffer = EpollConnection_getSendBuffer;
+    c->releaseSendBuffer = EpollConnection_releaseBuffer;
+    c->releaseRecvBuffer = EpollConnection_releaseBuffer;
+    c->state = UA_CONNECTION_OPENING;
+    c->openingDate = UA_DateTime_nowMonotonic();
+
+    /* Register for edge-triggered notifications. Data that arrived before the
+     * registration is reported right away. */
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = e;
+    if(epoll_ctl(layer->epollfd, EPOLL_CTL_ADD, newsockfd, &event) < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Connection %i | Could not add the socket to epoll: %s",
+                           newsockfd, errno_str));
+        close(newsockfd);
+        EpollConnection_clearSendQueue(e);
+        UA_free(e);
+        return;
+    }
+
+    LIST_INSERT_HEAD(&layer->connections, e, pointers);
+
+    /* The opening dates are monotonic. So the list remains sorted. */
+    e->waitingForHello = true;
+    TAILQ_INSERT_TAIL(&layer->hello, e, helloPointers);
+}
+
+static void
+ServerNetworkLayerEpoll_removeConnection(ServerNetworkLayerEpoll *layer,
+                                         UA_Server *server, EpollConnectionEntry *e) {
+    LIST_REMOVE(e, pointers);
+    if(e->ready)
+        TAILQ_REMOVE(&layer->ready, e, readyPointers);
+    if(e->waitingForHello)
+        TAILQ_REMOVE(&layer->hello, e, helloPointers);
+    /* Closing the socket also removes it from the epoll set */
+    close(e->connection.sockfd);
+    UA_Server_removeConnection(server, &e->connection);
+}
+
+/* Accept until the backlog of the server sockets is empty. Required for the
+ * edge-triggered mode. */
+static void
+ServerNetworkLayerEpoll_accept(ServerNetworkLayerEpoll *layer) {
+    for(UA_UInt16 i = 0; i < layer->serverSocketsSize; i++) {
+        while(true) {
+            struct sockaddr_storage remote;
+            socklen_t remote_size = sizeof(remote);
+            int newsockfd = accept(layer->serverSockets[i],
+                                   (struct sockaddr*)&remote, &remote_size);
+            if(newsockfd < 0) {
+                if(errno == EINTR)
+                    continue;
+                if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                    UA_LOG_SOCKET_ERRNO_WRAP(
+                        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                                       "Accepting a connection failed with %s",
+                                       errno_str));
+                }
+                break;
+            }
+
+            UA_LOG_TRACE(layer->logger, UA_LOGCATEGORY_NETWORK,
+                         "Connection %i | New TCP connection on server socket %i",
+                         newsockfd, layer->serverSockets[i]);
+            ServerNetworkLayerEpoll_addConnection(layer, newsockfd, &remote);
+        }
+    }
+}
+
+/* Close connections that did not send a HEL message in time */
+static void
+ServerNetworkLayerEpoll_closeHelloTimeouts(ServerNetworkLayerEpoll *layer,
+                                           UA_Server *server) {
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    EpollConnectionEntry *e;
+    while((e = TAILQ_FIRST(&layer->hello))) {
+        if(e->connection.state == UA_CONNECTION_OPENING &&
+           now <= e->connection.openingDate + (EPOLL_NOHELLOTIMEOUT * UA_DATETIME_MSEC))
+            break;
+        TAILQ_REMOVE(&layer->hello, e, helloPointers);
+        e->waitingForHello = false;
+        if(e->connection.state != UA_CONNECTION_OPENING)
+            continue;
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "Connection %i | Closed by the server (no Hello Message)",
+                    e->connection.sockfd);
+        ServerNetworkLayerEpoll_removeConnection(layer, server, e);
+    }
+}
+
+static void
+ServerNetworkLayerEpoll_addServerSocket(ServerNetworkLayerEpoll *layer,
+                                        struct addrinfo *ai) {
+    /* Create the server socket */
+    int newsock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if(newsock < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Error opening the server socket");
+        return;
+    }
+
+    /* Some Linux distributions have net.ipv6.bindv6only not activated. So
+     * sockets can double-bind to IPv4 and IPv6. This leads to problems. Use
+     * AF_INET6 sockets only for IPv6. */
+    int optval = 1;
+    if(ai->ai_family == AF_INET6 &&
+       setsockopt(newsock, IPPROTO_IPV6, IPV6_V6ONLY,
+                  (const char*)&optval, sizeof(optval)) == -1) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Could not set an IPv6 socket to IPv6 only");
+        close(newsock);
+        return;
+    }
+    if(setsockopt(newsock, SOL_SOCKET, SO_REUSEADDR,
+                  (const char *)&optval, sizeof(optval)) == -1) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Could not make the socket reusable");
+        close(newsock);
+        return;
+    }
+
+    if(epoll_socket_set_nonblocking(newsock) != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Could not set the server socket to nonblocking");
+        close(newsock);
+        return;
+    }
+
+    /* Bind socket to address */
+    if(bind(newsock, ai->ai_addr, ai->ai_addrlen) < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Error binding a server socket: %s", errno_str));
+        close(newsock);
+        return;
+    }
+
+    /* Start listening */
+    if(listen(newsock, EPOLL_MAXBACKLOG) < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Error listening on server socket: %s", errno_str));
+        close(newsock);
+        return;
+    }
+
+    /* Server sockets are registered without a connection entry */
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;
+    if(epoll_ctl(layer->epollfd, EPOLL_CTL_ADD, newsock, &event) < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Could not add the server socket to epoll: %s",
+                           errno_str));
+        close(newsock);
+        return;
+    }
+
+    layer->serverSockets[layer->serverSocketsSize] = newsock;
+    layer->serverSocketsSize++;
+}
+
+static UA_StatusCode
+ServerNetworkLayerEpoll_start(UA_ServerNetworkLayer *nl,
+                              const UA_String *customHostname) {
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll *)nl->handle;
+
+    /* Get the discovery url from the hostname */
+    UA_String du = UA_STRING_NULL;
+    char discoveryUrl[256];
+    if(customHostname->length) {
+        du.length = (size_t)snprintf(discoveryUrl, 255, "opc.tcp://%.*s:%d/",
+                                     (int)customHostname->length,
+                                     customHostname->data, layer->port);
+        du.data = (UA_Byte*)discoveryUrl;
+    } else {
+        char hostname[256];
+        if(gethostname(hostname, 255) == 0) {
+            du.length = (size_t)snprintf(discoveryUrl, 255, "opc.tcp://%s:%d/",
+                                         hostname, layer->port);
+            du.data = (UA_Byte*)discoveryUrl;
+        }
+    }
+    UA_String_copy(&du, &nl->discoveryUrl);
+
+    /* Create the epoll instance */
+    layer->epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if(layer->epollfd < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK,
+                         "Could not create the epoll instance: %s", errno_str));
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    /* Get addrinfo of the server and create server sockets */
+    char portno[6];
+    snprintf(portno, 6, "%d", layer->port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if(getaddrinfo(NULL, portno, &hints, &res) != 0) {
+        close(layer->epollfd);
+        layer->epollfd = -1;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    /* There might be serveral addrinfos (for different network cards,
+     * IPv4/IPv6). Add a server socket for all of them. */
+    struct addrinfo *ai = res;
+    for(layer->serverSocketsSize = 0;
+        layer->serverSocketsSize < EPOLL_MAXSERVERSOCKETS && ai != NULL;
+        ai = ai->ai_next)
+        ServerNetworkLayerEpoll_addServerSocket(layer, ai);
+    freeaddrinfo(res);
+
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "epoll network layer listening on %.*s",
+                (int)nl->discoveryUrl.length, nl->discoveryUrl.data);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+ServerNetworkLayerEpoll_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
+                               UA_UInt16 timeout) {
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll *)nl->handle;
+    if(layer->serverSocketsSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    ServerNetworkLayerEpoll_closeHelloTimeouts(layer, server);
+
+    /* Do not wait if there are connections with pending data */
+    int wait = TAILQ_EMPTY(&layer->ready) ? (int)timeout : 0;
+    struct epoll_event events[EPOLL_MAXEVENTS];
+    int n = epoll_wait(layer->epollfd, events, EPOLL_MAXEVENTS, wait);
+    if(n < 0) {
+        if(errno != EINTR) {
+            UA_LOG_SOCKET_ERRNO_WRAP(
+                UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                               "epoll_wait failed with %s", errno_str));
+        }
+        /* we will retry, so do not return bad */
+        n = 0;
+    }
+
+    /* Accept new connections, send out queued data and mark the reported
+     * connections as ready. Connections are only removed after all events have
+     * been handled. So the pointers in the events are valid. */
+    for(int i = 0; i < n; i++) {
+        EpollConnectionEntry *e = (EpollConnectionEntry*)events[i].data.ptr;
+        if(!e) {
+            ServerNetworkLayerEpoll_accept(layer);
+            continue;
+        }
+
+        /* Always flush. A worker might be queueing data right now. */
+        if(events[i].events & EPOLLOUT)
+            EpollConnection_flushSendQueue(e);
+
+        /* Only writable. Resume reading if the congestion has resolved. */
+        if(!(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) &&
+           (!e->throttled || UA_Connection_isCongested(&e->connection)))
+            continue;
+
+        e->throttled = false;
+        if(e->ready)
+            continue;
+        e->ready = true;
+        TAILQ_INSERT_TAIL(&layer->ready, e, readyPointers);
+    }
+
+    /* Receive one buffer from every ready connection */
+    EpollConnectionEntry *e, *e_tmp;
+    TAILQ_FOREACH_SAFE(e, &layer->ready, readyPointers, e_tmp) {
+        /* Backpressure. Stop reading until the send queue has been drained. */
+        if(e->connection.state != UA_CONNECTION_CLOSED &&
+           UA_Connection_isCongested(&e->connection)) {
+            TAILQ_REMOVE(&layer->ready, e, readyPointers);
+            e->ready = false;
+            e->throttled = true;
+            continue;
+        }
+
+        UA_LOG_TRACE(layer->logger, UA_LOGCATEGORY_NETWORK,
+                     "Connection %i | Activity on the socket",
+                     e->connection.sockfd);
+
+        UA_ByteString buf = UA_BYTESTRING_NULL;
+        UA_StatusCode retval = EpollConnection_recv(&e->connection, &buf);
+        if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED) {
+            /* The socket is shutdown but not closed */
+            UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                        "Connection %i | Closed", e->connection.sockfd);
+            ServerNetworkLayerEpoll_removeConnection(layer, server, e);
+            continue;
+        }
+
+        /* Out of memory. Retry in the next iteration. */
+        if(retval != UA_STATUSCODE_GOOD)
+            continue;
+
+        /* The socket is drained if the buffer was not filled up */
+        if(buf.length < e->connection.localConf.recvBufferSize) {
+            TAILQ_REMOVE(&layer->ready, e, readyPointers);
+            e->ready = false;
+        }
+
+        /* Process packets */
+        if(buf.length > 0)
+            UA_Server_processBinaryMessage(server, &e->connection, &buf);
+        EpollConnection_releaseBuffer(&e->connection, &buf);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerEpoll_stop(UA_ServerNetworkLayer *nl, UA_Server *server) {
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll *)nl->handle;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the epoll network layer");
+
+    /* Close the server sockets */
+    for(UA_UInt16 i = 0; i < layer->serverSocketsSize; i++) {
+        shutdown(layer->serverSockets[i], SHUT_RDWR);
+        close(layer->serverSockets[i]);
+    }
+    layer->serverSocketsSize = 0;
+
+    /* Close and remove the open connections. There is no need to wait for
+     * epoll to report the shutdown. */
+    EpollConnectionEntry *e, *e_tmp;
+    LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
+        ServerNetworkLayerEpoll_close(&e->connection);
+        ServerNetworkLayerEpoll_removeConnection(layer, server, e);
+    }
+
+    if(layer->epollfd >= 0) {
+        close(layer->epollfd);
+        layer->epollfd = -1;
+    }
+}
+
+/* run only when the server is stopped */
+static void
+ServerNetworkLayerEpoll_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll *)nl->handle;
+    UA_String_deleteMembers(&nl->discoveryUrl);
+
+    /* Hard-close and remove remaining connections. The server is no longer
+     * running. So this is safe. */
+    EpollConnectionEntry *e, *e_tmp;
+    LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
+        LIST_REMOVE(e, pointers);
+        close(e->connection.sockfd);
+        EpollConnection_clearSendQueue(e);
+        UA_free(e);
+    }
+
+    if(layer->epollfd >= 0)
+        close(layer->epollfd);
+
+    /* Free the layer */
+    UA_BufferPool_delete(layer->bufferPool);
+    UA_free(layer);
+}
+
+void
+UA_ServerNetworkLayerEpoll_getBufferPoolStatistics(const UA_ServerNetworkLayer *nl,
+                                                   UA_BufferPoolStatistics *stats) {
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll *)nl->handle;
+    UA_BufferPool_getStatistics(layer->bufferPool, stats);
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerEpoll(UA_ConnectionConfig conf, UA_UInt16 port,
+                           UA_Logger logger) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    ServerNetworkLayerEpoll *layer = (ServerNetworkLayerEpoll*)
+        UA_calloc(1, sizeof(ServerNetworkLayerEpoll));
+    if(!layer)
+        return nl;
+
+    size_t bufferSize = conf.sendBufferSize > conf.recvBufferSize ?
+        conf.sendBufferSize : conf.recvBufferSize;
+    layer->bufferPool = UA_BufferPool_new(bufferSize, EPOLL_MAXPOOLEDBUFFERS);
+    if(!layer->bufferPool) {
+        UA_free(layer);
+        return nl;
+    }
+
+    layer->logger = (logger != NULL ? logger : UA_Log_Stdout);
+    layer->conf = conf;
+    layer->port = port;
+    layer->epollfd = -1;
+    LIST_INIT(&layer->connections);
+    TAILQ_INIT(&layer->ready);
+    TAILQ_INIT(&layer->hello);
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerEpoll_start;
+    nl.listen = ServerNetworkLayerEpoll_listen;
+    nl.stop = ServerNetworkLayerEpoll_stop;
+    nl.deleteMembers = ServerNetworkLayerEpoll_deleteMembers;
+    return nl;
+}
@@ -0,0 +1,34 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#ifndef UA_NETWORK_EPOLL_H_
+#define UA_NETWORK_EPOLL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_server.h"
+#include "ua_plugin_network.h"
+#include "ua_plugin_log.h"
+
+/* Server network layer for Linux based on edge-triggered epoll. Unlike
+ * UA_ServerNetworkLayerTCP, the cost of an iteration depends only on the
+ * number of sockets with activity and not on the total number of open
+ * connections. There is also no limit from FD_SETSIZE. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerEpoll(UA_ConnectionConfig conf, UA_UInt16 port,
+                           UA_Logger logger);
+
+/* The send and receive buffers of all connections are recycled in a buffer
+ * pool of the network layer. */
+void UA_EXPORT
+UA_ServerNetworkLayerEpoll_getBufferPoolStatistics(const UA_ServerNetworkLayer *nl,
+                                                   UA_BufferPoolStatistics *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_NETWORK_EPOLL_H_ */
@@ -43,6 +43,10 @@
 #include <stdio.h> // snprintf
 #include <string.h> // memset
 
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
 #if !defined(UA_FREERTOS)
 # include <errno.h>
 #else
@@ -234,6 +238,36 @@ connection_write(UA_Connection *connection, UA_ByteString *buf) {
     return UA_STATUSCODE_GOOD;
 }
 
+/* Receive into the buffer. Afterwards, the length of the buffer is set to the
+ * number of received bytes. Zero received bytes with UA_STATUSCODE_GOOD
+ * means that the receiving should be retried. */
+static UA_StatusCode
+socket_recv(UA_Connection *connection, UA_ByteString *buf, UA_Boolean hadTimeout) {
+    ssize_t ret = recv((SOCKET)connection->sockfd, (char*)buf->data,
+                       WIN32_INT buf->length, 0);
+
+    /* The remote side closed the connection */
+    if(ret == 0) {
+        buf->length = 0;
+        connection->close(connection);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    /* Error case */
+    if(ret < 0) {
+        buf->length = 0;
+        if(errno__ == INTERRUPTED || hadTimeout ?
+           false : (errno__ == EAGAIN || errno__ == WOULDBLOCK))
+            return UA_STATUSCODE_GOOD; /* statuscode_good but no data -> retry */
+        connection->close(connection);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    /* Set the length of the received buffer */
+    buf->length = (size_t)ret;
+    return UA_STATUSCODE_GOOD;
+}
+
 static UA_StatusCode
 connection_recv(UA_Connection *connection, UA_ByteString *response,
                 UA_UInt32 timeout) {
@@ -273,31 +307,13 @@ connection_recv(UA_Connection *connection, UA_ByteString *response,
         response->length = 0;
         return UA_STATUSCODE_BADOUTOFMEMORY; /* not enough memory retry */
     }
+    response->length = connection->localConf.recvBufferSize;
 
     /* Get the received packet(s) */
-    ssize_t ret = recv(connection->sockfd, (char*)response->data,
-                       connection->localConf.recvBufferSize, 0);
-
-    /* The remote side closed the connection */
-    if(ret == 0) {
-        UA_ByteString_deleteMembers(response);
-        connection->close(connection);
-        return UA_STATUSCODE_BADCONNECTIONCLOSED;
-    }
-
-    /* Error case */
-    if(ret < 0) {
+    UA_StatusCode retval = socket_recv(connection, response, timeout > 0);
+    if(retval != UA_STATUSCODE_GOOD || response->length == 0)
         UA_ByteString_deleteMembers(response);
-        if(errno__ == INTERRUPTED || (timeout > 0) ?
-           false : (errno__ == EAGAIN || errno__ == WOULDBLOCK))
-            return UA_STATUSCODE_GOOD; /* statuscode_good but no data -> retry */
-        connection->close(connection);
-        return UA_STATUSCODE_BADCONNECTIONCLOSED;
-    }
-
-    /* Set the length of the received buffer */
-    response->length = (size_t)ret;
-    return UA_STATUSCODE_GOOD;
+    return retval;
 }
 
 static UA_StatusCode
@@ -343,12 +359,33 @@ socket_set_blocking(SOCKET sockfd) {
 #define MAXBACKLOG     100
 #define NOHELLOTIMEOUT 120000 /* timeout in ms before close the connection
                                * if server does not receive Hello Message */
+#define MAXPOOLEDBUFFERS 64   /* unused send/recv buffers kept for reuse */
+
+/* A buffer that could not be sent right away. It is sent out when the socket
+ * becomes writable. */
+typedef struct SendQueueEntry {
+    SIMPLEQ_ENTRY(SendQueueEntry) next;
+    UA_ByteString buf;
+    size_t offset;
+} SendQueueEntry;
 
 typedef struct ConnectionEntry {
     UA_Connection connection;
     LIST_ENTRY(ConnectionEntry) pointers;
+    SIMPLEQ_HEAD(, SendQueueEntry) sendQueue;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t sendQueueMutex; /* send is called from the workers */
+#endif
 } ConnectionEntry;
 
+#ifdef UA_ENABLE_MULTITHREADING
+# define SENDQUEUE_LOCK(e) pthread_mutex_lock(&(e)->sendQueueMutex)
+# define SENDQUEUE_UNLOCK(e) pthread_mutex_unlock(&(e)->sendQueueMutex)
+#else
+# define SENDQUEUE_LOCK(e)
+# define SENDQUEUE_UNLOCK(e)
+#endif
+
 typedef struct {
     UA_Logger logger;
     UA_ConnectionConfig conf;
@@ -356,14 +393,150 @@ typedef struct {
     UA_Int32 serverSockets[FD_SETSIZE];
     UA_UInt16 serverSocketsSize;
     LIST_HEAD(, ConnectionEntry) connections;
+    UA_BufferPool *bufferPool; /* Recycles the send and recv buffers */
 } ServerNetworkLayerTCP;
 
+/* The buffers of server connections come from the pool of the network layer */
+static UA_StatusCode
+ServerNetworkLayerTCP_getSendBuffer(UA_Connection *connection,
+                                    size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP*)connection->handle;
+    return UA_BufferPool_get(layer->bufferPool, length, buf);
+}
+
+static void
+ServerNetworkLayerTCP_releaseBuffer(UA_Connection *connection,
+                                    UA_ByteString *buf) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP*)connection->handle;
+    UA_BufferPool_release(layer->bufferPool, buf);
+}
+
+static void
+ConnectionEntry_clearSendQueue(ConnectionEntry *e) {
+    SendQueueEntry *q;
+    while((q = SIMPLEQ_FIRST(&e->sendQueue))) {
+        SIMPLEQ_REMOVE_HEAD(&e->sendQueue, next);
+        ServerNetworkLayerTCP_releaseBuffer(&e->connection, &q->buf);
+        UA_free(q);
+    }
+    e->connection.sendQueueSize = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&e->sendQueueMutex);
+#endif
+}
+
 static void
 ServerNetworkLayerTCP_freeConnection(UA_Connection *connection) {
+    ConnectionEntry_clearSendQueue((ConnectionEntry*)connection);
     UA_Connection_deleteMembers(connection);
     UA_free(connection);
 }
 
+/* Send as much as possible without blocking. Returns the number of written
+ * bytes or -1 if the connection failed. */
+static ssize_t
+socket_send_nonblocking(SOCKET sockfd, const UA_Byte *data, size_t length) {
+    /* Prevent OS signals when sending to a closed socket */
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+
+    size_t nWritten = 0;
+    while(nWritten < length) {
+        ssize_t n = send(sockfd, (const char*)data + nWritten,
+                         WIN32_INT (length - nWritten), flags);
+        if(n < 0) {
+            if(errno__ == INTERRUPTED)
+                continue;
+            if(errno__ == AGAIN || errno__ == WOULDBLOCK)
+                break;
+            return -1;
+        }
+        nWritten += (size_t)n;
+    }
+    return (ssize_t)nWritten;
+}
+
+/* Sending never blocks. What cannot be written to the socket right away is
+ * appended to the send queue of the connection. */
+static UA_StatusCode
+ServerNetworkLayerTCP_send(UA_Connection *connection, UA_ByteString *buf) {
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        ServerNetworkLayerTCP_releaseBuffer(connection, buf);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    ConnectionEntry *e = (ConnectionEntry*)connection;
+    SENDQUEUE_LOCK(e);
+
+    /* Try to send right away if nothing is queued. Otherwise the order of the
+     * messages would get mixed up. */
+    size_t nWritten = 0;
+    if(SIMPLEQ_EMPTY(&e->sendQueue)) {
+        ssize_t n = socket_send_nonblocking((SOCKET)connection->sockfd,
+                                            buf->data, buf->length);
+        if(n < 0) {
+            SENDQUEUE_UNLOCK(e);
+            connection->close(connection);
+            ServerNetworkLayerTCP_releaseBuffer(connection, buf);
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        }
+        nWritten = (size_t)n;
+        if(nWritten == buf->length) {
+            SENDQUEUE_UNLOCK(e);
+            ServerNetworkLayerTCP_releaseBuffer(connection, buf);
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+
+    /* Queue the remainder. The queue takes ownership of the buffer. If this
+     * fails, the message was partially sent and the stream is corrupted. */
+    SendQueueEntry *q = (SendQueueEntry*)UA_malloc(sizeof(SendQueueEntry));
+    if(!q) {
+        SENDQUEUE_UNLOCK(e);
+        connection->close(connection);
+        ServerNetworkLayerTCP_releaseBuffer(connection, buf);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    q->buf = *buf;
+    q->offset = nWritten;
+    SIMPLEQ_INSERT_TAIL(&e->sendQueue, q, next);
+    connection->sendQueueSize += buf->length - nWritten;
+    *buf = UA_BYTESTRING_NULL;
+    SENDQUEUE_UNLOCK(e);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Called when the socket is writable */
+static void
+flushSendQueue(ConnectionEntry *e) {
+    UA_Boolean failed = false;
+    SENDQUEUE_LOCK(e);
+    SendQueueEntry *q;
+    while((q = SIMPLEQ_FIRST(&e->sendQueue))) {
+        ssize_t n = socket_send_nonblocking((SOCKET)e->connection.sockfd,
+                                            &q->buf.data[q->offset],
+                                            q->buf.length - q->offset);
+        if(n < 0) {
+            failed = true;
+            break;
+        }
+        q->offset += (size_t)n;
+        e->connection.sendQueueSize -= (size_t)n;
+        if(q->offset < q->buf.length)
+            break;
+        SIMPLEQ_REMOVE_HEAD(&e->sendQueue, next);
+        ServerNetworkLayerTCP_releaseBuffer(&e->connection, &q->buf);
+        UA_free(q);
+    }
+    SENDQUEUE_UNLOCK(e);
+    if(failed)
+        e->connection.close(&e->connection);
+}
+
 /* This performs only 'shutdown'. 'close' is called when the shutdown
  * socket is returned from select. */
 static void
@@ -418,16 +591,20 @@ ServerNetworkLayerTCP_add(ServerNetworkLayerTCP *layer, UA_Int32 newsockfd,
 
     UA_Connection *c = &e->connection;
     memset(c, 0, sizeof(UA_Connection));
+    SIMPLEQ_INIT(&e->sendQueue);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&e->sendQueueMutex, NULL);
+#endif
     c->sockfd = newsockfd;
     c->handle = layer;
     c->localConf = layer->conf;
     c->remoteConf = layer->conf;
-    c->send = connection_write;
+    c->send = ServerNetworkLayerTCP_send;
     c->close = ServerNetworkLayerTCP_close;
     c->free = ServerNetworkLayerTCP_freeConnection;
-    c->getSendBuffer = connection_getsendbuffer;
-    c->releaseSendBuffer = connection_releasesendbuffer;
-    c->releaseRecvBuffer = connection_releaserecvbuffer;
+    c->getSendBuffer = ServerNetworkLayerTCP_getSendBuffer;
+    c->releaseSendBuffer = ServerNetworkLayerTCP_releaseBuffer;
+    c->releaseRecvBuffer = ServerNetworkLayerTCP_releaseBuffer;
     c->state = UA_CONNECTION_OPENING;
     c->openingDate = UA_DateTime_nowMonotonic();
 
@@ -584,10 +761,14 @@ ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, const UA_String *customHo
     return UA_STATUSCODE_GOOD;
 }
 
-/* After every select, reset the sockets to listen on */
+/* After every select, reset the sockets to listen on. Congested connections
+ * are not read from until the send queue has been drained (backpressure).
+ * Connections with queued data wait for the socket to become writable. */
 static UA_Int32
-setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset) {
+setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset, fd_set *writeset) {
     FD_ZERO(fdset);
+    if(writeset)
+        FD_ZERO(writeset);
     UA_Int32 highestfd = 0;
     for(UA_UInt16 i = 0; i < layer->serverSocketsSize; i++) {
         UA_fd_set(layer->serverSockets[i], fdset);
@@ -597,7 +778,11 @@ setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset) {
 
     ConnectionEntry *e;
     LIST_FOREACH(e, &layer->connections, pointers) {
-        UA_fd_set(e->connection.sockfd, fdset);
+        if(e->connection.state == UA_CONNECTION_CLOSED ||
+           !UA_Connection_isCongested(&e->connection))
+            UA_fd_set(e->connection.sockfd, fdset);
+        if(writeset && e->connection.sendQueueSize > 0)
+            UA_fd_set(e->connection.sockfd, writeset);
         if(e->connection.sockfd > highestfd)
             highestfd = e->connection.sockfd;
     }
@@ -615,11 +800,11 @@ ServerNetworkLayerTCP_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
         return UA_STATUSCODE_GOOD;
 
     /* Listen on open sockets (including the server) */
-    fd_set fdset, errset;
-    UA_Int32 highestfd = setFDSet(layer, &fdset);
-    setFDSet(layer, &errset);
+    fd_set fdset, writeset, errset;
+    UA_Int32 highestfd = setFDSet(layer, &fdset, &writeset);
+    setFDSet(layer, &errset, NULL);
     struct timeval tmptv = {0, timeout * 1000};
-    if (select(highestfd+1, &fdset, NULL, &errset, &tmptv) < 0) {
+    if (select(highestfd+1, &fdset, &writeset, &errset, &tmptv) < 0) {
         UA_LOG_SOCKET_ERRNO_WRAP(
             UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
                                   "Socket select failed with %s", errno_str));
@@ -665,22 +850,35 @@ ServerNetworkLayerTCP_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
             continue;
         }
 
+        /* Send out queued data */
+        if(UA_fd_isset(e->connection.sockfd, &writeset))
+            flushSendQueue(e);
+
         if(!UA_fd_isset(e->connection.sockfd, &errset) &&
-           !UA_fd_isset(e->connection.sockfd, &fdset))
+           !UA_fd_isset(e->connection.sockfd, &fdset) &&
+           e->connection.state != UA_CONNECTION_CLOSED)
           continue;
 
         UA_LOG_TRACE(layer->logger, UA_LOGCATEGORY_NETWORK,
                     "Connection %i | Activity on the socket",
                     e->connection.sockfd);
 
-        UA_ByteString buf = UA_BYTESTRING_NULL;
-        UA_StatusCode retval = connection_recv(&e->connection, &buf, 0);
+        UA_StatusCode retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+        if(e->connection.state != UA_CONNECTION_CLOSED) {
+            UA_ByteString buf = UA_BYTESTRING_NULL;
+            retval = UA_BufferPool_get(layer->bufferPool,
+                                       layer->conf.recvBufferSize, &buf);
+            if(retval != UA_STATUSCODE_GOOD)
+                continue; /* Retry in the next iteration */
+            retval = socket_recv(&e->connection, &buf, false);
+            if(retval == UA_STATUSCODE_GOOD && buf.length > 0) {
+                /* Process packets */
+                UA_Server_processBinaryMessage(server, &e->connection, &buf);
+            }
+            ServerNetworkLayerTCP_releaseBuffer(&e->connection, &buf);
+        }
 
-        if(retval == UA_STATUSCODE_GOOD) {
-            /* Process packets */
-            UA_Server_processBinaryMessage(server, &e->connection, &buf);
-            connection_releaserecvbuffer(&e->connection, &buf);
-        } else if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED) {
+        if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED) {
             /* The socket is shutdown but not closed */
             UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
                         "Connection %i | Closed",
@@ -732,13 +930,22 @@ ServerNetworkLayerTCP_deleteMembers(UA_ServerNetworkLayer *nl) {
     LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
         LIST_REMOVE(e, pointers);
         CLOSESOCKET(e->connection.sockfd);
+        ConnectionEntry_clearSendQueue(e);
         UA_free(e);
     }
 
     /* Free the layer */
+    UA_BufferPool_delete(layer->bufferPool);
     UA_free(layer);
 }
 
+void
+UA_ServerNetworkLayerTCP_getBufferPoolStatistics(const UA_ServerNetworkLayer *nl,
+                                                 UA_BufferPoolStatistics *stats) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP *)nl->handle;
+    UA_BufferPool_getStatistics(layer->bufferPool, stats);
+}
+
 UA_ServerNetworkLayer
 UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port, UA_Logger logger) {
     UA_ServerNetworkLayer nl;
@@ -748,6 +955,14 @@ UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port, UA_Logger log
     if(!layer)
         return nl;
 
+    size_t bufferSize = conf.sendBufferSize > conf.recvBufferSize ?
+        conf.sendBufferSize : conf.recvBufferSize;
+    layer->bufferPool = UA_BufferPool_new(bufferSize, MAXPOOLEDBUFFERS);
+    if(!layer->bufferPool) {
+        UA_free(layer);
+        return nl;
+    }
+
     layer->logger = (logger != NULL ? logger : UA_Log_Stdout);
     layer->conf = conf;
     layer->port = port;
@@ -18,6 +18,12 @@ extern "C" {
 UA_ServerNetworkLayer UA_EXPORT
 UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port, UA_Logger logger);
 
+/* The server network layer recycles the send and receive buffers of all
+ * connections in a buffer pool. */
+void UA_EXPORT
+UA_ServerNetworkLayerTCP_getBufferPoolStatistics(const UA_ServerNetworkLayer *nl,
+                                                 UA_BufferPoolStatistics *stats);
+
 UA_Connection UA_EXPORT
 UA_ClientConnectionTCP(UA_ConnectionConfig conf, const char *endpointUrl, const UA_UInt32 timeout,
                        UA_Logger logger);
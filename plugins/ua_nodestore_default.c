@@ -1,5 +1,5 @@
 /* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
- * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. 
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
  *
  *    Copyright 2014-2017 (c) Fraunhofer IOSB (Author: Julius Pfrommer)
  *    Copyright 2017 (c) Julian Grothoff
@@ -16,11 +16,11 @@
 
 #ifdef UA_ENABLE_MULTITHREADING
 #include <pthread.h>
-#define BEGIN_CRITSECT(NODEMAP) pthread_mutex_lock(&(NODEMAP)->mutex)
-#define END_CRITSECT(NODEMAP) pthread_mutex_unlock(&(NODEMAP)->mutex)
+#define BEGIN_CRITSECT(SHARD) pthread_mutex_lock(&(SHARD)->mutex)
+#define END_CRITSECT(SHARD) pthread_mutex_unlock(&(SHARD)->mutex)
 #else
-#define BEGIN_CRITSECT(NODEMAP)
-#define END_CRITSECT(NODEMAP)
+#define BEGIN_CRITSECT(SHARD)
+#define END_CRITSECT(SHARD)
 #endif
 
 /* The default Nodestore is simply a hash-map from NodeIds to Nodes. To find an
@@ -30,34 +30,95 @@
  * - Matching NodeId: Return the entry
  * - NULL: Abort the search
  *
+ * The slots store the hash of the NodeId next to the pointer to the entry.
+ * Non-matching entries are skipped without accessing the node.
+ *
+ * The hash-map is resized incrementally. The new table points to the previous
+ * table. Every write operation copies a few slots from the previous table into
+ * the new table until the previous table can be dropped. Lookups search the
+ * new table first and then the previous table. Until the copying is done, the
+ * removal and replacement of nodes is done in both tables.
+ *
+ * The nodes can be distributed to several independent hash-maps (shards)
+ * according to their namespace index. Every shard is resized and locked
+ * separately.
+ *
  * The nodestore uses atomic operations to set entries of the hash-map. If
  * UA_ENABLE_IMMUTABLE_NODES is configured, the nodestore allows read-access
- * from an interrupt without seeing corrupted nodes. For true multi-threaded
- * access, a mutex is used.
+ * from an interrupt without seeing corrupted nodes.
+ *
+ * With multithreading, writers are serialized with a mutex. Readers don't take
+ * the mutex (RCU-style). Replaced and removed entries, as well as the tables
+ * dropped after a resize, are retired. Retired memory is freed only after a
+ * grace period where all lookups that could have seen it have finished. The
+ * grace period uses the same epoch scheme as the delayed callbacks of the
+ * server:
  *
- * Multi-threading without a mutex could be realized with the Linux RCU mechanism.
- * But this is not done for this implementation of the nodestore. */
+ * 1. Every lookup is counted in the current epoch (parity) until it finishes.
+ * 2. The epoch is advanced when all lookups from the previous epoch (with the
+ *    same parity as the next epoch) have finished.
+ * 3. Retired memory is freed once the epoch has advanced twice. Retired entries
+ *    additionally wait until the last reader has released the node. */
 
 typedef struct UA_NodeMapEntry {
     struct UA_NodeMapEntry *orig; /* the version this is a copy from (or NULL) */
-    UA_UInt16 refCount; /* How many consumers have a reference to the node? */
+    UA_UInt32 refCount; /* How many consumers have a reference to the node? */
     UA_Boolean deleted; /* Node was marked as deleted and can be deleted when refCount == 0 */
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_UInt32 retiredEpoch;
+    struct UA_NodeMapEntry *retiredNext;
+#endif
     UA_Node node;
 } UA_NodeMapEntry;
 
 #define UA_NODEMAP_MINSIZE 64
 #define UA_NODEMAP_TOMBSTONE ((UA_NodeMapEntry*)0x01)
 
+/* Slots of the previous table that are copied with every write */
+#define UA_NODEMAP_MIGRATESTEP 64
+
 typedef struct {
-    UA_NodeMapEntry **entries;
+    UA_NodeMapEntry *entry;
+    UA_UInt32 hash; /* Hash of the NodeId. Set before the entry is published. */
+} UA_NodeMapSlot;
+
+typedef struct UA_NodeMapTable {
+    UA_NodeMapSlot *slots;
     UA_UInt32 size;
-    UA_UInt32 count;
     UA_UInt32 sizePrimeIndex;
+
+    /* The table before the last resize. NULL when all slots are copied. */
+    struct UA_NodeMapTable * volatile prev;
+    UA_UInt32 copied; /* Slots of prev that are copied */
+
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_UInt32 retiredEpoch;
+    struct UA_NodeMapTable *retiredNext;
+#endif
+} UA_NodeMapTable;
+
+typedef struct {
+    UA_NodeMapTable * volatile table;
+    UA_UInt32 count;
 #ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_t mutex; /* Protect access */
+    pthread_mutex_t mutex; /* Serialize the writers */
+    volatile UA_UInt32 epoch;
+    volatile size_t epochReaders[2]; /* Unfinished lookups per epoch parity */
+    UA_NodeMapEntry *retiredEntries;
+    UA_NodeMapTable *retiredTables;
 #endif
+} UA_NodeMapShard;
+
+typedef struct {
+    size_t shardsSize;
+    UA_NodeMapShard *shards;
 } UA_NodeMap;
 
+static UA_NodeMapShard *
+getShard(UA_NodeMap *ns, const UA_NodeId *nodeid) {
+    return &ns->shards[nodeid->namespaceIndex % ns->shardsSize];
+}
+
 /*********************/
 /* HashMap Utilities */
 /*********************/
@@ -89,67 +150,281 @@ higher_prime_index(UA_UInt32 n) {
     return low;
 }
 
-/* returns an empty slot or null if the nodeid exists or if no empty slot is found. */
-static UA_NodeMapEntry **
-findFreeSlot(const UA_NodeMap *ns, const UA_NodeId *nodeid) {
-    UA_NodeMapEntry **retval = NULL;
-    UA_UInt32 h = UA_NodeId_hash(nodeid);
-    UA_UInt32 size = ns->size;
+/* Load the entry only once. Concurrent writers may change it. */
+static UA_NodeMapEntry *
+loadEntry(const UA_NodeMapSlot *slot) {
+    return *(UA_NodeMapEntry * const volatile *)&slot->entry;
+}
+
+/* Load the previous table with acquire semantics. The slots copied before the
+ * previous table was unlinked are visible afterwards. */
+static UA_NodeMapTable *
+loadPrev(const UA_NodeMapTable *t) {
+    UA_NodeMapTable *prev = *(UA_NodeMapTable * const volatile *)&t->prev;
+    UA_atomic_sync();
+    return prev;
+}
+
+/* returns the slot with the nodeid or null if the nodeid is not found */
+static UA_NodeMapSlot *
+findOccupiedSlot(const UA_NodeMapTable *t, const UA_NodeId *nodeid, UA_UInt32 h) {
+    UA_UInt32 size = t->size;
+    UA_UInt64 idx = mod(h, size); // use 64 bit container to avoid overflow
+    UA_UInt32 hash2 = mod2(h, size);
+    UA_UInt32 startIdx = (UA_UInt32)idx;
+    UA_NodeMapEntry *entry = NULL;
+
+    do {
+        UA_NodeMapSlot *slot = &t->slots[(UA_UInt32)idx];
+        entry = slot->entry;
+        if(entry > UA_NODEMAP_TOMBSTONE && slot->hash == h &&
+           UA_NodeId_equal(&entry->node.nodeId, nodeid))
+            return slot;
+        idx += hash2;
+        if(idx >= size)
+            idx -= size;
+    } while((UA_UInt32)idx != startIdx && entry);
+
+    /* NULL is returned if there is no free slot (idx == startIdx)
+     * and the node id is not found or if the end of the used slots (!entry)
+     * is reached. */
+    return NULL;
+}
+
+/* returns the first empty or tombstone slot or null if no free slot is found.
+ * Does not check whether the nodeid exists. */
+static UA_NodeMapSlot *
+findFreeSlot(const UA_NodeMapTable *t, UA_UInt32 h) {
+    UA_UInt32 size = t->size;
     UA_UInt64 idx = mod(h, size); // use 64 bit container to avoid overflow
+    UA_UInt32 hash2 = mod2(h, size);
     UA_UInt32 startIdx = (UA_UInt32)idx;
+
+    do {
+        UA_NodeMapSlot *slot = &t->slots[(UA_UInt32)idx];
+        if(slot->entry <= UA_NODEMAP_TOMBSTONE)
+            return slot;
+        idx += hash2;
+        if(idx >= size)
+            idx -= size;
+    } while((UA_UInt32)idx != startIdx);
+    return NULL;
+}
+
+/* Same as findOccupiedSlot, but without the mutex. Returns the entry, as the
+ * slot might be changed concurrently. The NodeId of the entry is always
+ * compared, as the hash and the entry are not loaded atomically. */
+static UA_NodeMapEntry *
+findEntry(const UA_NodeMapTable *t, const UA_NodeId *nodeid, UA_UInt32 h) {
+    UA_UInt32 size = t->size;
+    UA_UInt64 idx = mod(h, size); // use 64 bit container to avoid overflow
     UA_UInt32 hash2 = mod2(h, size);
+    UA_UInt32 startIdx = (UA_UInt32)idx;
     UA_NodeMapEntry *entry = NULL;
 
     do {
-        entry = ns->entries[(UA_UInt32)idx];
-        if(entry > UA_NODEMAP_TOMBSTONE &&
+        const UA_NodeMapSlot *slot = &t->slots[(UA_UInt32)idx];
+        entry = loadEntry(slot);
+        if(entry > UA_NODEMAP_TOMBSTONE && slot->hash == h &&
            UA_NodeId_equal(&entry->node.nodeId, nodeid))
-            return NULL;
-        if(!retval && entry <= UA_NODEMAP_TOMBSTONE)
-            retval = &ns->entries[(UA_UInt32)idx];
+            return entry;
         idx += hash2;
         if(idx >= size)
             idx -= size;
     } while((UA_UInt32)idx != startIdx && entry);
+    return NULL;
+}
 
-    /* NULL is returned if there is no free slot (idx == startIdx).
-     * Otherwise the first free slot is returned after we are sure,
-     * that the node id cannot be found in the used hashmap (!entry). */
-    return retval;
+/* Set the hash before the entry becomes visible */
+static UA_Boolean
+publishSlot(UA_NodeMapSlot *slot, UA_NodeMapEntry *entry, UA_UInt32 h) {
+    UA_NodeMapEntry *oldEntry = slot->entry;
+    if(oldEntry > UA_NODEMAP_TOMBSTONE)
+        return false;
+    slot->hash = h;
+    return (UA_atomic_cmpxchg((void**)&slot->entry, oldEntry, entry) == oldEntry);
+}
+
+static UA_NodeMapTable *
+newTable(UA_UInt32 sizePrimeIndex) {
+    UA_NodeMapTable *t = (UA_NodeMapTable*)UA_calloc(1, sizeof(UA_NodeMapTable));
+    if(!t)
+        return NULL;
+    t->sizePrimeIndex = sizePrimeIndex;
+    t->size = primes[sizePrimeIndex];
+    t->slots = (UA_NodeMapSlot*)UA_calloc(t->size, sizeof(UA_NodeMapSlot));
+    if(!t->slots) {
+        UA_free(t);
+        return NULL;
+    }
+    return t;
+}
+
+static void
+deleteTable(UA_NodeMapTable *t) {
+    UA_free(t->slots);
+    UA_free(t);
+}
+
+static void
+deleteEntry(UA_NodeMapEntry *entry) {
+    UA_Node_deleteMembers(&entry->node);
+    UA_free(entry);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+/* Count the lookup in the current epoch. Retry if the epoch changed in
+ * between. Returns the parity of the epoch. */
+static UA_Byte
+beginRead(UA_NodeMapShard *shard) {
+    while(true) {
+        UA_UInt32 epoch = shard->epoch;
+        UA_Byte parity = (UA_Byte)(epoch & 0x01);
+        UA_atomic_addSize(&shard->epochReaders[parity], 1);
+        if(shard->epoch == epoch)
+            return parity;
+        UA_atomic_subSize(&shard->epochReaders[parity], 1);
+    }
+}
+
+static void
+endRead(UA_NodeMapShard *shard, UA_Byte parity) {
+    UA_atomic_subSize(&shard->epochReaders[parity], 1);
+}
+
+/* Advance the epoch and free the retired memory after the grace period. Called
+ * with the mutex held. */
+static void
+reclaim(UA_NodeMapShard *shard) {
+    UA_UInt32 epoch = shard->epoch;
+    for(size_t i = 0; i < 2; ++i) {
+        if(shard->epochReaders[(epoch + 1) & 0x01] != 0)
+            break;
+        epoch++;
+        UA_atomic_sync();
+        shard->epoch = epoch;
+    }
+
+    UA_NodeMapEntry **prevEntry = &shard->retiredEntries;
+    while(*prevEntry) {
+        UA_NodeMapEntry *entry = *prevEntry;
+        if((UA_UInt32)(epoch - entry->retiredEpoch) < 2 || entry->refCount > 0) {
+            prevEntry = &entry->retiredNext;
+            continue;
+        }
+        *prevEntry = entry->retiredNext;
+        deleteEntry(entry);
+    }
+
+    UA_NodeMapTable **prevTable = &shard->retiredTables;
+    while(*prevTable) {
+        UA_NodeMapTable *t = *prevTable;
+        if((UA_UInt32)(epoch - t->retiredEpoch) < 2) {
+            prevTable = &t->retiredNext;
+            continue;
+        }
+        *prevTable = t->retiredNext;
+        deleteTable(t);
+    }
+}
+
+#define BEGIN_READ(SHARD) UA_Byte readParity = beginRead(SHARD)
+#define END_READ(SHARD) endRead(SHARD, readParity)
+
+#else
+
+#define BEGIN_READ(SHARD)
+#define END_READ(SHARD)
+
+static void
+cleanupEntry(UA_NodeMapEntry *entry) {
+    if(entry->deleted && entry->refCount == 0)
+        deleteEntry(entry);
+}
+
+#endif
+
+/* The entry is no longer in the hash-map. Delete it when it cannot be accessed
+ * anymore. */
+static void
+retireEntry(UA_NodeMapShard *shard, UA_NodeMapEntry *entry) {
+    entry->deleted = true;
+#ifdef UA_ENABLE_MULTITHREADING
+    entry->retiredEpoch = shard->epoch;
+    entry->retiredNext = shard->retiredEntries;
+    shard->retiredEntries = entry;
+#else
+    cleanupEntry(entry);
+#endif
+}
+
+static void
+retireTable(UA_NodeMapShard *shard, UA_NodeMapTable *t) {
+#ifdef UA_ENABLE_MULTITHREADING
+    t->retiredEpoch = shard->epoch;
+    t->retiredNext = shard->retiredTables;
+    shard->retiredTables = t;
+#else
+    deleteTable(t);
+#endif
+}
+
+/* Copy up to maxSlots slots from the previous table. Drops the previous table
+ * when all slots are copied. The entries stay in the previous table, so that
+ * lookups don't miss them while they are copied. */
+static void
+copyPrevSlots(UA_NodeMapShard *shard, UA_UInt32 maxSlots) {
+    UA_NodeMapTable *t = shard->table;
+    UA_NodeMapTable *prev = t->prev;
+    if(!prev)
+        return;
+
+    UA_UInt32 end = prev->size;
+    if(end - t->copied > maxSlots)
+        end = t->copied + maxSlots;
+    for(UA_UInt32 i = t->copied; i < end; ++i) {
+        UA_NodeMapSlot *slot = &prev->slots[i];
+        if(slot->entry <= UA_NODEMAP_TOMBSTONE)
+            continue;
+        /* The stored hash is used. The nodes are not accessed. */
+        UA_NodeMapSlot *newSlot = findFreeSlot(t, slot->hash);
+        UA_assert(newSlot);
+        publishSlot(newSlot, slot->entry, slot->hash);
+    }
+    t->copied = end;
+
+    if(t->copied < prev->size)
+        return;
+    /* The copied slots are visible before prev is unlinked */
+    UA_atomic_xchg((void * volatile *)&t->prev, NULL);
+    retireTable(shard, prev);
 }
 
 /* The occupancy of the table after the call will be about 50% */
 static UA_StatusCode
-expand(UA_NodeMap *ns) {
-    UA_UInt32 osize = ns->size;
-    UA_UInt32 count = ns->count;
+expand(UA_NodeMapShard *shard) {
+    UA_NodeMapTable *ot = shard->table;
+    UA_UInt32 osize = ot->size;
+    UA_UInt32 count = shard->count;
     /* Resize only when table after removal of unused elements is either too
        full or too empty */
     if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODEMAP_MINSIZE))
         return UA_STATUSCODE_GOOD;
 
-    UA_NodeMapEntry **oentries = ns->entries;
-    UA_UInt32 nindex = higher_prime_index(count * 2);
-    UA_UInt32 nsize = primes[nindex];
-    UA_NodeMapEntry **nentries = (UA_NodeMapEntry **)UA_calloc(nsize, sizeof(UA_NodeMapEntry*));
-    if(!nentries)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-
-    ns->entries = nentries;
-    ns->size = nsize;
-    ns->sizePrimeIndex = nindex;
+    /* Finish the previous resize first. So that there are at most two tables
+     * at any time. */
+    copyPrevSlots(shard, UA_UINT32_MAX);
 
-    /* recompute the position of every entry and insert the pointer */
-    for(size_t i = 0, j = 0; i < osize && j < count; ++i) {
-        if(oentries[i] <= UA_NODEMAP_TOMBSTONE)
-            continue;
-        UA_NodeMapEntry **e = findFreeSlot(ns, &oentries[i]->node.nodeId);
-        UA_assert(e);
-        *e = oentries[i];
-        ++j;
-    }
+    UA_NodeMapTable *nt = newTable(higher_prime_index(count * 2));
+    if(!nt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    nt->prev = ot;
 
-    UA_free(oentries);
+    /* Publish the new table. The entries are copied incrementally with the
+     * following writes. */
+    UA_atomic_xchg((void * volatile *)&shard->table, nt);
+    copyPrevSlots(shard, UA_NODEMAP_MIGRATESTEP);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -191,55 +466,94 @@ newEntry(UA_NodeClass nodeClass) {
     return entry;
 }
 
-static void
-deleteEntry(UA_NodeMapEntry *entry) {
-    UA_Node_deleteMembers(&entry->node);
-    UA_free(entry);
+/* Find the slots of the node in the current and the previous table. Returns
+ * the current entry or NULL. */
+static UA_NodeMapEntry *
+findSlots(UA_NodeMapShard *shard, const UA_NodeId *nodeid, UA_UInt32 h,
+          UA_NodeMapSlot **slot, UA_NodeMapSlot **prevSlot) {
+    UA_NodeMapTable *t = shard->table;
+    *slot = findOccupiedSlot(t, nodeid, h);
+    *prevSlot = NULL;
+    if(t->prev)
+        *prevSlot = findOccupiedSlot(t->prev, nodeid, h);
+    if(*slot)
+        return (*slot)->entry;
+    if(*prevSlot)
+        return (*prevSlot)->entry;
+    return NULL;
 }
 
-static void
-cleanupEntry(UA_NodeMapEntry *entry) {
-    if(entry->deleted && entry->refCount == 0)
-        deleteEntry(entry);
+/* Set the slots with the entry to a new value */
+static UA_Boolean
+swapSlots(UA_NodeMapSlot *slot, UA_NodeMapSlot *prevSlot,
+          UA_NodeMapEntry *entry, UA_NodeMapEntry *newEntry) {
+    if(slot && UA_atomic_cmpxchg((void**)&slot->entry, entry, newEntry) != entry)
+        return false;
+    if(prevSlot && UA_atomic_cmpxchg((void**)&prevSlot->entry, entry, newEntry) != entry)
+        return false;
+    return true;
 }
 
 static UA_StatusCode
-clearSlot(UA_NodeMap *ns, UA_NodeMapEntry **slot) {
-    UA_NodeMapEntry *entry = *slot;
-    if(UA_atomic_cmpxchg((void**)slot, entry, UA_NODEMAP_TOMBSTONE) != entry)
+clearSlots(UA_NodeMapShard *shard, UA_NodeMapSlot *slot, UA_NodeMapSlot *prevSlot,
+           UA_NodeMapEntry *entry) {
+    if(!swapSlots(slot, prevSlot, entry, UA_NODEMAP_TOMBSTONE))
         return UA_STATUSCODE_BADINTERNALERROR;
-    entry->deleted = true;
-    cleanupEntry(entry);
-    --ns->count;
+    retireEntry(shard, entry);
+    --shard->count;
     /* Downsize the hashmap if it is very empty */
-    if(ns->count * 8 < ns->size && ns->size > 32)
-        expand(ns); /* Can fail. Just continue with the bigger hashmap. */
+    UA_NodeMapTable *t = shard->table;
+    if(shard->count * 8 < t->size && t->size > 32)
+        expand(shard); /* Can fail. Just continue with the bigger hashmap. */
     return UA_STATUSCODE_GOOD;
 }
 
-static UA_NodeMapEntry **
-findOccupiedSlot(const UA_NodeMap *ns, const UA_NodeId *nodeid) {
+/* Take a reference to the entry while it cannot be freed */
+static UA_NodeMapEntry *
+acquireEntry(UA_NodeMap *ns, const UA_NodeId *nodeid) {
+    UA_NodeMapShard *shard = getShard(ns, nodeid);
     UA_UInt32 h = UA_NodeId_hash(nodeid);
-    UA_UInt32 size = ns->size;
-    UA_UInt64 idx = mod(h, size); // use 64 bit container to avoid overflow
-    UA_UInt32 hash2 = mod2(h, size);
-    UA_UInt32 startIdx = (UA_UInt32)idx;
-    UA_NodeMapEntry *entry = NULL;
+    BEGIN_READ(shard);
+    UA_NodeMapTable *t = shard->table;
+    /* Load the previous table before searching the current table. Otherwise
+     * the entry can be copied and the previous table unlinked between both
+     * lookups. A retired previous table is not freed during the epoch. */
+    UA_NodeMapTable *prev = loadPrev(t);
+    UA_NodeMapEntry *entry = findEntry(t, nodeid, h);
+    if(!entry && prev)
+        entry = findEntry(prev, nodeid, h); /* Not yet copied */
+    if(entry)
+        UA_atomic_addUInt32(&entry->refCount, 1);
+    END_READ(shard);
+    return entry;
+}
 
-    do {
-        entry = ns->entries[(UA_UInt32)idx];
-        if(entry > UA_NODEMAP_TOMBSTONE &&
-           UA_NodeId_equal(&entry->node.nodeId, nodeid))
-            return &ns->entries[(UA_UInt32)idx];
-        idx += hash2;
-        if(idx >= size)
-            idx -= size;
-    } while((UA_UInt32)idx != startIdx && entry);
+static void
+releaseEntry(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    UA_assert(entry->refCount > 0);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Try to free the retired entry. But don't wait for the writers. The entry
+     * must not be accessed after the reference is given up. */
+    UA_NodeMapShard *shard = getShard(ns, &entry->node.nodeId);
+    UA_Boolean deleted = entry->deleted;
+    if(UA_atomic_subUInt32(&entry->refCount, 1) == 0 && deleted &&
+       pthread_mutex_trylock(&shard->mutex) == 0) {
+        reclaim(shard);
+        END_CRITSECT(shard);
+    }
+#else
+    --entry->refCount;
+    cleanupEntry(entry);
+#endif
+}
 
-    /* NULL is returned if there is no free slot (idx == startIdx)
-     * and the node id is not found or if the end of the used slots (!entry)
-     * is reached. */
-    return NULL;
+/* Called at the end of every write operation */
+static void
+finishWrite(UA_NodeMapShard *shard) {
+    copyPrevSlots(shard, UA_NODEMAP_MIGRATESTEP);
+#ifdef UA_ENABLE_MULTITHREADING
+    reclaim(shard);
+#endif
 }
 
 /***********************/
@@ -256,60 +570,39 @@ UA_NodeMap_newNode(void *context, UA_NodeClass nodeClass) {
 
 static void
 UA_NodeMap_deleteNode(void *context, UA_Node *node) {
-#ifdef UA_ENABLE_MULTITHREADING
-    UA_NodeMap *ns = (UA_NodeMap*)context;
-#endif
-    BEGIN_CRITSECT(ns);
+    /* The node was never added to the hash-map */
     UA_NodeMapEntry *entry = container_of(node, UA_NodeMapEntry, node);
     UA_assert(&entry->node == node);
     deleteEntry(entry);
-    END_CRITSECT(ns);
 }
 
 static const UA_Node *
 UA_NodeMap_getNode(void *context, const UA_NodeId *nodeid) {
-    UA_NodeMap *ns = (UA_NodeMap*)context;
-    BEGIN_CRITSECT(ns);
-    UA_NodeMapEntry **entry = findOccupiedSlot(ns, nodeid);
-    if(!entry) {
-        END_CRITSECT(ns);
+    UA_NodeMapEntry *entry = acquireEntry((UA_NodeMap*)context, nodeid);
+    if(!entry)
         return NULL;
-    }
-    ++(*entry)->refCount;
-    END_CRITSECT(ns);
-    return (const UA_Node*)&(*entry)->node;
+    return (const UA_Node*)&entry->node;
 }
 
 static void
 UA_NodeMap_releaseNode(void *context, const UA_Node *node) {
     if (!node)
         return;
-#ifdef UA_ENABLE_MULTITHREADING
-    UA_NodeMap *ns = (UA_NodeMap*)context;
-#endif
-    BEGIN_CRITSECT(ns);
     UA_NodeMapEntry *entry = container_of(node, UA_NodeMapEntry, node);
     UA_assert(&entry->node == node);
-    UA_assert(entry->refCount > 0);
-    --entry->refCount;
-    cleanupEntry(entry);
-    END_CRITSECT(ns);
+    releaseEntry((UA_NodeMap*)context, entry);
 }
 
 static UA_StatusCode
 UA_NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
                        UA_Node **outNode) {
     UA_NodeMap *ns = (UA_NodeMap*)context;
-    BEGIN_CRITSECT(ns);
-    UA_NodeMapEntry **slot = findOccupiedSlot(ns, nodeid);
-    if(!slot) {
-        END_CRITSECT(ns);
+    UA_NodeMapEntry *entry = acquireEntry(ns, nodeid);
+    if(!entry)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    }
-    UA_NodeMapEntry *entry = *slot;
     UA_NodeMapEntry *newItem = newEntry(entry->node.nodeClass);
     if(!newItem) {
-        END_CRITSECT(ns);
+        releaseEntry(ns, entry);
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
     UA_StatusCode retval = UA_Node_copy(&entry->node, &newItem->node);
@@ -319,37 +612,51 @@ UA_NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
     } else {
         deleteEntry(newItem);
     }
-    END_CRITSECT(ns);
+    releaseEntry(ns, entry);
     return retval;
 }
 
 static UA_StatusCode
 UA_NodeMap_removeNode(void *context, const UA_NodeId *nodeid) {
-    UA_NodeMap *ns = (UA_NodeMap*)context;
-    BEGIN_CRITSECT(ns);
-    UA_NodeMapEntry **slot = findOccupiedSlot(ns, nodeid);
+    UA_NodeMapShard *shard = getShard((UA_NodeMap*)context, nodeid);
+    BEGIN_CRITSECT(shard);
+    UA_NodeMapSlot *slot, *prevSlot;
+    UA_NodeMapEntry *entry =
+        findSlots(shard, nodeid, UA_NodeId_hash(nodeid), &slot, &prevSlot);
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    if(slot)
-        retval = clearSlot(ns, slot);
+    if(entry)
+        retval = clearSlots(shard, slot, prevSlot, entry);
     else
         retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
-    END_CRITSECT(ns);
+    finishWrite(shard);
+    END_CRITSECT(shard);
     return retval;
 }
 
+/* Returns a free slot in the current table if the nodeid is not yet used */
+static UA_NodeMapSlot *
+findInsertSlot(UA_NodeMapShard *shard, const UA_NodeId *nodeid, UA_UInt32 h) {
+    UA_NodeMapTable *t = shard->table;
+    if(findOccupiedSlot(t, nodeid, h))
+        return NULL;
+    if(t->prev && findOccupiedSlot(t->prev, nodeid, h))
+        return NULL;
+    return findFreeSlot(t, h);
+}
+
 static UA_StatusCode
 UA_NodeMap_insertNode(void *context, UA_Node *node,
                       UA_NodeId *addedNodeId) {
-    UA_NodeMap *ns = (UA_NodeMap*)context;
-    BEGIN_CRITSECT(ns);
-    if(ns->size * 3 <= ns->count * 4) {
-        if(expand(ns) != UA_STATUSCODE_GOOD) {
-            END_CRITSECT(ns);
+    UA_NodeMapShard *shard = getShard((UA_NodeMap*)context, &node->nodeId);
+    BEGIN_CRITSECT(shard);
+    if(shard->table->size * 3 <= shard->count * 4) {
+        if(expand(shard) != UA_STATUSCODE_GOOD) {
+            END_CRITSECT(shard);
             return UA_STATUSCODE_BADINTERNALERROR;
         }
     }
 
-    UA_NodeMapEntry **slot;
+    UA_NodeMapSlot *slot;
     if(node->nodeId.identifierType == UA_NODEIDTYPE_NUMERIC &&
             node->nodeId.identifier.numeric == 0) {
         /* create a random nodeid */
@@ -358,14 +665,14 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
         /* since the size is prime and we don't change the increase val, we will reach the starting id again */
         /* E.g. adding a nodeset will create children while there are still other nodes which need to be created */
         /* Thus the node ids may collide */
-        UA_UInt32 size = ns->size;
+        UA_UInt32 size = shard->table->size;
         UA_UInt64 identifier = mod(50000 + size+1, UA_UINT32_MAX); // start value, use 64 bit container to avoid overflow
-        UA_UInt32 increase = mod2(ns->count+1, size);
+        UA_UInt32 increase = mod2(shard->count+1, size);
         UA_UInt32 startId = (UA_UInt32)identifier; // mod ensures us that the id is a valid 32 bit
 
         do {
             node->nodeId.identifier.numeric = (UA_UInt32)identifier;
-            slot = findFreeSlot(ns, &node->nodeId);
+            slot = findInsertSlot(shard, &node->nodeId, UA_NodeId_hash(&node->nodeId));
             if(slot)
                 break;
             identifier += increase;
@@ -373,12 +680,12 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
                 identifier -= size;
         } while((UA_UInt32)identifier != startId);
     } else {
-        slot = findFreeSlot(ns, &node->nodeId);
+        slot = findInsertSlot(shard, &node->nodeId, UA_NodeId_hash(&node->nodeId));
     }
 
     if(!slot) {
         deleteEntry(container_of(node, UA_NodeMapEntry, node));
-        END_CRITSECT(ns);
+        END_CRITSECT(shard);
         return UA_STATUSCODE_BADNODEIDEXISTS;
     }
 
@@ -388,58 +695,56 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
         retval = UA_NodeId_copy(&node->nodeId, addedNodeId);
         if(retval != UA_STATUSCODE_GOOD) {
             deleteEntry(container_of(node, UA_NodeMapEntry, node));
-            END_CRITSECT(ns);
+            END_CRITSECT(shard);
             return retval;
         }
     }
 
     /* Insert the node */
-    UA_NodeMapEntry *oldEntry = *slot;
     UA_NodeMapEntry *newEntry = container_of(node, UA_NodeMapEntry, node);
-    if(oldEntry > UA_NODEMAP_TOMBSTONE ||
-       UA_atomic_cmpxchg((void**)slot, oldEntry,
-                         newEntry) != oldEntry) {
-        deleteEntry(container_of(node, UA_NodeMapEntry, node));
-        END_CRITSECT(ns);
+    if(!publishSlot(slot, newEntry, UA_NodeId_hash(&node->nodeId))) {
+        deleteEntry(newEntry);
+        END_CRITSECT(shard);
         return UA_STATUSCODE_BADNODEIDEXISTS;
     }
-    ++ns->count;
-    END_CRITSECT(ns);
+    ++shard->count;
+    finishWrite(shard);
+    END_CRITSECT(shard);
     return retval;
 }
 
 static UA_StatusCode
 UA_NodeMap_replaceNode(void *context, UA_Node *node) {
-    UA_NodeMap *ns = (UA_NodeMap*)context;
-    BEGIN_CRITSECT(ns);
+    UA_NodeMapShard *shard = getShard((UA_NodeMap*)context, &node->nodeId);
+    BEGIN_CRITSECT(shard);
 
     /* Find the node */
-    UA_NodeMapEntry **slot = findOccupiedSlot(ns, &node->nodeId);
-    if(!slot) {
-        END_CRITSECT(ns);
+    UA_NodeMapSlot *slot, *prevSlot;
+    UA_NodeMapEntry *oldEntryContainer =
+        findSlots(shard, &node->nodeId, UA_NodeId_hash(&node->nodeId), &slot, &prevSlot);
+    if(!oldEntryContainer) {
+        END_CRITSECT(shard);
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     }
     UA_NodeMapEntry *newEntryContainer = container_of(node, UA_NodeMapEntry, node);
-    UA_NodeMapEntry *oldEntryContainer = *slot;
 
     /* The node was already updated since the copy was made? */
     if(oldEntryContainer != newEntryContainer->orig) {
         deleteEntry(newEntryContainer);
-        END_CRITSECT(ns);
+        END_CRITSECT(shard);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
 
     /* Replace the entry with an atomic operation */
-    if(UA_atomic_cmpxchg((void**)slot, oldEntryContainer,
-                         newEntryContainer) != oldEntryContainer) {
+    if(!swapSlots(slot, prevSlot, oldEntryContainer, newEntryContainer)) {
         deleteEntry(newEntryContainer);
-        END_CRITSECT(ns);
+        END_CRITSECT(shard);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
 
-    oldEntryContainer->deleted = true;
-    cleanupEntry(oldEntryContainer);
-    END_CRITSECT(ns);
+    retireEntry(shard, oldEntryContainer);
+    finishWrite(shard);
+    END_CRITSECT(shard);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -447,59 +752,99 @@ static void
 UA_NodeMap_iterate(void *context, void *visitorContext,
                    UA_NodestoreVisitor visitor) {
     UA_NodeMap *ns = (UA_NodeMap*)context;
-    BEGIN_CRITSECT(ns);
-    for(UA_UInt32 i = 0; i < ns->size; ++i) {
-        if(ns->entries[i] > UA_NODEMAP_TOMBSTONE) {
-            END_CRITSECT(ns);
-            UA_NodeMapEntry *entry = ns->entries[i];
-            entry->refCount++;
+    for(size_t i = 0; i < ns->shardsSize; ++i) {
+        /* Visit every node only once. Finish the copying from the previous
+         * table. */
+        UA_NodeMapShard *shard = &ns->shards[i];
+        BEGIN_CRITSECT(shard);
+        copyPrevSlots(shard, UA_UINT32_MAX);
+        END_CRITSECT(shard);
+
+        /* The table is not freed during the iteration */
+        BEGIN_READ(shard);
+        UA_NodeMapTable *t = shard->table;
+        for(UA_UInt32 j = 0; j < t->size; ++j) {
+            UA_NodeMapEntry *entry = loadEntry(&t->slots[j]);
+            if(entry <= UA_NODEMAP_TOMBSTONE)
+                continue;
+            UA_atomic_addUInt32(&entry->refCount, 1);
             visitor(visitorContext, &entry->node);
-            entry->refCount--;
-            cleanupEntry(entry);
-            BEGIN_CRITSECT(ns);
+            releaseEntry(ns, entry);
         }
+        END_READ(shard);
     }
-    END_CRITSECT(ns);
 }
 
 static void
-UA_NodeMap_delete(void *context) {
-    UA_NodeMap *ns = (UA_NodeMap*)context;
+deleteShard(UA_NodeMapShard *shard) {
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&shard->mutex);
+    while(shard->retiredEntries) {
+        UA_NodeMapEntry *entry = shard->retiredEntries;
+        shard->retiredEntries = entry->retiredNext;
+        UA_assert(entry->refCount == 0);
+        deleteEntry(entry);
+    }
+#endif
+
+    /* The entries of the previous table are also in the current table */
+    copyPrevSlots(shard, UA_UINT32_MAX);
+
 #ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_destroy(&ns->mutex);
+    while(shard->retiredTables) {
+        UA_NodeMapTable *t = shard->retiredTables;
+        shard->retiredTables = t->retiredNext;
+        deleteTable(t);
+    }
 #endif
-    UA_UInt32 size = ns->size;
-    UA_NodeMapEntry **entries = ns->entries;
-    for(UA_UInt32 i = 0; i < size; ++i) {
-        if(entries[i] > UA_NODEMAP_TOMBSTONE) {
+
+    UA_NodeMapTable *t = shard->table;
+    for(UA_UInt32 i = 0; i < t->size; ++i) {
+        UA_NodeMapEntry *entry = t->slots[i].entry;
+        if(entry > UA_NODEMAP_TOMBSTONE) {
             /* On debugging builds, check that all nodes were release */
-            UA_assert(entries[i]->refCount == 0);
+            UA_assert(entry->refCount == 0);
             /* Delete the node */
-            deleteEntry(entries[i]);
+            deleteEntry(entry);
         }
     }
-    UA_free(ns->entries);
+    deleteTable(t);
+}
+
+static void
+UA_NodeMap_delete(void *context) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
+    for(size_t i = 0; i < ns->shardsSize; ++i)
+        deleteShard(&ns->shards[i]);
+    UA_free(ns->shards);
     UA_free(ns);
 }
 
 UA_StatusCode
-UA_Nodestore_default_new(UA_Nodestore *ns) {
+UA_Nodestore_default_newSharded(UA_Nodestore *ns, size_t shardsSize) {
+    if(shardsSize == 0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
     /* Allocate and initialize the nodemap */
-    UA_NodeMap *nodemap = (UA_NodeMap*)UA_malloc(sizeof(UA_NodeMap));
+    UA_NodeMap *nodemap = (UA_NodeMap*)UA_calloc(1, sizeof(UA_NodeMap));
     if(!nodemap)
         return UA_STATUSCODE_BADOUTOFMEMORY;
-    nodemap->sizePrimeIndex = higher_prime_index(UA_NODEMAP_MINSIZE);
-    nodemap->size = primes[nodemap->sizePrimeIndex];
-    nodemap->count = 0;
-    nodemap->entries = (UA_NodeMapEntry**)
-        UA_calloc(nodemap->size, sizeof(UA_NodeMapEntry*));
-    if(!nodemap->entries) {
+    nodemap->shards = (UA_NodeMapShard*)UA_calloc(shardsSize, sizeof(UA_NodeMapShard));
+    if(!nodemap->shards) {
         UA_free(nodemap);
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
+    for(; nodemap->shardsSize < shardsSize; ++nodemap->shardsSize) {
+        UA_NodeMapShard *shard = &nodemap->shards[nodemap->shardsSize];
+        shard->table = newTable(higher_prime_index(UA_NODEMAP_MINSIZE));
+        if(!shard->table) {
+            UA_NodeMap_delete(nodemap);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
 #ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_init(&nodemap->mutex, NULL);
+        pthread_mutex_init(&shard->mutex, NULL);
 #endif
+    }
 
     /* Populate the nodestore */
     ns->context = nodemap;
@@ -517,3 +862,8 @@ UA_Nodestore_default_new(UA_Nodestore *ns) {
 
     return UA_STATUSCODE_GOOD;
 }
+
+UA_StatusCode
+UA_Nodestore_default_new(UA_Nodestore *ns) {
+    return UA_Nodestore_default_newSharded(ns, 1);
+}
@@ -19,6 +19,12 @@ extern "C" {
 UA_StatusCode UA_EXPORT
 UA_Nodestore_default_new(UA_Nodestore *ns);
 
+/* Same as above. The nodes are distributed to shardsSize separate hash-maps
+ * according to the namespace index (modulo the number of shards). Every shard
+ * is resized and locked separately. */
+UA_StatusCode UA_EXPORT
+UA_Nodestore_default_newSharded(UA_Nodestore *ns, size_t shardsSize);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -63,7 +63,6 @@ typedef struct {
 
     mbedtls_ctr_drbg_context drbgContext;
     mbedtls_entropy_context entropyContext;
-    mbedtls_md_context_t sha256MdContext;
     mbedtls_pk_context localPrivateKey;
 } Basic256Sha256_PolicyContext;
 
@@ -78,6 +77,13 @@ typedef struct {
     UA_ByteString remoteSymEncryptingKey;
     UA_ByteString remoteSymIv;
 
+    /* Prepared when the keys are set. So the keys are not expanded for every
+     * chunk. The contexts are not shared between the channels. */
+    mbedtls_aes_context localSymAesContext;
+    mbedtls_aes_context remoteSymAesContext;
+    mbedtls_md_context_t localSymHmacContext;
+    mbedtls_md_context_t remoteSymHmacContext;
+
     mbedtls_x509_crt remoteCertificate;
 } Basic256Sha256_ChannelContext;
 
@@ -339,10 +345,12 @@ asymmetricModule_compareCertificateThumbprint_sp_basic256sha256(const UA_Securit
 /* SymmetricModule */
 /*******************/
 
+/* The key was set with mbedtls_md_hmac_starts before. Resetting the context
+ * reuses the key padding that is stored in the context. */
 static void
-md_hmac_Basic256Sha256(mbedtls_md_context_t *context, const UA_ByteString *key,
-                       const UA_ByteString *in, unsigned char out[32]) {
-    mbedtls_md_hmac_starts(context, key->data, key->length);
+md_hmac_Basic256Sha256(mbedtls_md_context_t *context, const UA_ByteString *in,
+                       unsigned char out[32]) {
+    mbedtls_md_hmac_reset(context);
     mbedtls_md_hmac_update(context, in->data, in->length);
     mbedtls_md_hmac_finish(context, out);
 }
@@ -362,11 +370,8 @@ sym_verify_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
         return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
     }
 
-    Basic256Sha256_PolicyContext *pc =
-        (Basic256Sha256_PolicyContext *)securityPolicy->policyContext;
-
     unsigned char mac[UA_SHA256_LENGTH];
-    md_hmac_Basic256Sha256(&pc->sha256MdContext, &cc->remoteSymSigningKey, message, mac);
+    md_hmac_Basic256Sha256(&cc->remoteSymHmacContext, message, mac);
 
     /* Compare with Signature */
     if(memcmp(signature->data, mac, UA_SHA256_LENGTH) != 0)
@@ -376,14 +381,13 @@ sym_verify_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
 
 static UA_StatusCode
 sym_sign_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
-                           const Basic256Sha256_ChannelContext *cc,
+                           Basic256Sha256_ChannelContext *cc,
                            const UA_ByteString *message,
                            UA_ByteString *signature) {
     if(signature->length != UA_SHA256_LENGTH)
         return UA_STATUSCODE_BADINTERNALERROR;
 
-    md_hmac_Basic256Sha256(&cc->policyContext->sha256MdContext, &cc->localSymSigningKey,
-                           message, signature->data);
+    md_hmac_Basic256Sha256(&cc->localSymHmacContext, message, signature->data);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -419,7 +423,7 @@ sym_getPlainTextBlockSize_sp_basic256sha256(const UA_SecurityPolicy *const secur
 
 static UA_StatusCode
 sym_encrypt_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
-                              const Basic256Sha256_ChannelContext *cc,
+                              Basic256Sha256_ChannelContext *cc,
                               UA_ByteString *data) {
     if(securityPolicy == NULL || cc == NULL || data == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -438,27 +442,19 @@ sym_encrypt_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
         return UA_STATUSCODE_BADINTERNALERROR;
     }
 
-    /* Keylength in bits */
-    unsigned int keylength = (unsigned int)(cc->localSymEncryptingKey.length * 8);
-    mbedtls_aes_context aesContext;
-    int mbedErr = mbedtls_aes_setkey_enc(&aesContext, cc->localSymEncryptingKey.data, keylength);
-    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+    /* The IV is updated during the encryption */
+    unsigned char iv[UA_SECURITYPOLICY_BASIC256SHA256_SYM_ENCRYPTION_BLOCK_SIZE];
+    memcpy(iv, cc->localSymIv.data, UA_SECURITYPOLICY_BASIC256SHA256_SYM_ENCRYPTION_BLOCK_SIZE);
 
-    UA_ByteString ivCopy;
-    UA_StatusCode retval = UA_ByteString_copy(&cc->localSymIv, &ivCopy);
-    if(retval != UA_STATUSCODE_GOOD)
-        return retval;
-
-    mbedErr = mbedtls_aes_crypt_cbc(&aesContext, MBEDTLS_AES_ENCRYPT, data->length,
-                                    ivCopy.data, data->data, data->data);
-    UA_MBEDTLS_ERRORHANDLING(UA_STATUSCODE_BADINTERNALERROR);
-    UA_ByteString_deleteMembers(&ivCopy);
-    return retval;
+    int mbedErr = mbedtls_aes_crypt_cbc(&cc->localSymAesContext, MBEDTLS_AES_ENCRYPT,
+                                        data->length, iv, data->data, data->data);
+    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+    return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
 sym_decrypt_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
-                              const Basic256Sha256_ChannelContext *cc,
+                              Basic256Sha256_ChannelContext *cc,
                               UA_ByteString *data) {
     if(securityPolicy == NULL || cc == NULL || data == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -475,21 +471,14 @@ sym_decrypt_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
         return UA_STATUSCODE_BADINTERNALERROR;
     }
 
-    unsigned int keylength = (unsigned int)(cc->remoteSymEncryptingKey.length * 8);
-    mbedtls_aes_context aesContext;
-    int mbedErr = mbedtls_aes_setkey_dec(&aesContext, cc->remoteSymEncryptingKey.data, keylength);
-    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+    /* The IV is updated during the decryption */
+    unsigned char iv[UA_SECURITYPOLICY_BASIC256SHA256_SYM_ENCRYPTION_BLOCK_SIZE];
+    memcpy(iv, cc->remoteSymIv.data, UA_SECURITYPOLICY_BASIC256SHA256_SYM_ENCRYPTION_BLOCK_SIZE);
 
-    UA_ByteString ivCopy;
-    UA_StatusCode retval = UA_ByteString_copy(&cc->remoteSymIv, &ivCopy);
-    if(retval != UA_STATUSCODE_GOOD)
-        return retval;
-
-    mbedErr = mbedtls_aes_crypt_cbc(&aesContext, MBEDTLS_AES_DECRYPT, data->length,
-                                    ivCopy.data, data->data, data->data);
-    UA_MBEDTLS_ERRORHANDLING(UA_STATUSCODE_BADINTERNALERROR);
-    UA_ByteString_deleteMembers(&ivCopy);
-    return retval;
+    int mbedErr = mbedtls_aes_crypt_cbc(&cc->remoteSymAesContext, MBEDTLS_AES_DECRYPT,
+                                        data->length, iv, data->data, data->data);
+    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+    return UA_STATUSCODE_GOOD;
 }
 
 static void
@@ -506,13 +495,22 @@ sym_generateKey_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
     if(securityPolicy == NULL || secret == NULL || seed == NULL || out == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
 
-    Basic256Sha256_PolicyContext *pc =
-        (Basic256Sha256_PolicyContext *)securityPolicy->policyContext;
-
     size_t hashLen = 0;
     const mbedtls_md_info_t *mdInfo = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
     hashLen = (size_t)mbedtls_md_get_size(mdInfo);
 
+    /* The key is derived only when a channel is opened or renewed. Use a local
+     * context so that the policy can be used from several threads. */
+    mbedtls_md_context_t mdContext;
+    mbedtls_md_init(&mdContext);
+    int mbedErr = mbedtls_md_setup(&mdContext, mdInfo, 1);
+    if(mbedErr) {
+        UA_LOG_MBEDERR
+        mbedtls_md_free(&mdContext);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    mbedtls_md_hmac_starts(&mdContext, secret->data, secret->length);
+
     UA_ByteString A_and_seed;
     UA_ByteString_allocBuffer(&A_and_seed, hashLen + seed->length);
     memcpy(A_and_seed.data + hashLen, seed->data, seed->length);
@@ -531,7 +529,7 @@ sym_generateKey_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
         ANext_and_seed.data
     };
 
-    md_hmac_Basic256Sha256(&pc->sha256MdContext, secret, seed, A.data);
+    md_hmac_Basic256Sha256(&mdContext, seed, A.data);
 
     UA_StatusCode retval = 0;
     for(size_t offset = 0; offset < out->length; offset += hashLen) {
@@ -548,21 +546,14 @@ sym_generateKey_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
             if(retval != UA_STATUSCODE_GOOD) {
                 UA_ByteString_deleteMembers(&A_and_seed);
                 UA_ByteString_deleteMembers(&ANext_and_seed);
+                mbedtls_md_free(&mdContext);
                 return retval;
             }
             bufferAllocated = UA_TRUE;
         }
 
-        md_hmac_Basic256Sha256(&pc->sha256MdContext, secret, &A_and_seed, outSegment.data);
-        md_hmac_Basic256Sha256(&pc->sha256MdContext, secret, &A, ANext.data);
-
-        if(retval != UA_STATUSCODE_GOOD) {
-            if(bufferAllocated)
-                UA_ByteString_deleteMembers(&outSegment);
-            UA_ByteString_deleteMembers(&A_and_seed);
-            UA_ByteString_deleteMembers(&ANext_and_seed);
-            return retval;
-        }
+        md_hmac_Basic256Sha256(&mdContext, &A_and_seed, outSegment.data);
+        md_hmac_Basic256Sha256(&mdContext, &A, ANext.data);
 
         if(bufferAllocated) {
             memcpy(out->data + offset, outSegment.data, out->length - offset);
@@ -575,6 +566,7 @@ sym_generateKey_sp_basic256sha256(const UA_SecurityPolicy *securityPolicy,
 
     UA_ByteString_deleteMembers(&A_and_seed);
     UA_ByteString_deleteMembers(&ANext_and_seed);
+    mbedtls_md_free(&mdContext);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -630,6 +622,11 @@ channelContext_deleteContext_sp_basic256sha256(Basic256Sha256_ChannelContext *cc
     UA_ByteString_deleteMembers(&cc->remoteSymEncryptingKey);
     UA_ByteString_deleteMembers(&cc->remoteSymIv);
 
+    mbedtls_aes_free(&cc->localSymAesContext);
+    mbedtls_aes_free(&cc->remoteSymAesContext);
+    mbedtls_md_free(&cc->localSymHmacContext);
+    mbedtls_md_free(&cc->remoteSymHmacContext);
+
     mbedtls_x509_crt_free(&cc->remoteCertificate);
 
     UA_free(cc);
@@ -660,10 +657,23 @@ channelContext_newContext_sp_basic256sha256(const UA_SecurityPolicy *securityPol
     UA_ByteString_init(&cc->remoteSymEncryptingKey);
     UA_ByteString_init(&cc->remoteSymIv);
 
+    mbedtls_aes_init(&cc->localSymAesContext);
+    mbedtls_aes_init(&cc->remoteSymAesContext);
+    mbedtls_md_init(&cc->localSymHmacContext);
+    mbedtls_md_init(&cc->remoteSymHmacContext);
+
     mbedtls_x509_crt_init(&cc->remoteCertificate);
 
+    /* Allocate the HMAC contexts */
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    const mbedtls_md_info_t *const mdInfo = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if(mbedtls_md_setup(&cc->localSymHmacContext, mdInfo, 1) != 0 ||
+       mbedtls_md_setup(&cc->remoteSymHmacContext, mdInfo, 1) != 0)
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+
     // TODO: this can be optimized so that we dont allocate memory before parsing the certificate
-    UA_StatusCode retval = parseRemoteCertificate_sp_basic256sha256(cc, remoteCertificate);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = parseRemoteCertificate_sp_basic256sha256(cc, remoteCertificate);
     if(retval != UA_STATUSCODE_GOOD) {
         channelContext_deleteContext_sp_basic256sha256(cc);
         *pp_contextData = NULL;
@@ -677,6 +687,11 @@ channelContext_setLocalSymEncryptingKey_sp_basic256sha256(Basic256Sha256_Channel
     if(key == NULL || cc == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
 
+    const UA_SecurityPolicy *securityPolicy = cc->policyContext->securityPolicy;
+    int mbedErr = mbedtls_aes_setkey_enc(&cc->localSymAesContext, key->data,
+                                         (unsigned int)(key->length * 8));
+    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+
     UA_ByteString_deleteMembers(&cc->localSymEncryptingKey);
     return UA_ByteString_copy(key, &cc->localSymEncryptingKey);
 }
@@ -687,6 +702,10 @@ channelContext_setLocalSymSigningKey_sp_basic256sha256(Basic256Sha256_ChannelCon
     if(key == NULL || cc == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
 
+    const UA_SecurityPolicy *securityPolicy = cc->policyContext->securityPolicy;
+    int mbedErr = mbedtls_md_hmac_starts(&cc->localSymHmacContext, key->data, key->length);
+    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+
     UA_ByteString_deleteMembers(&cc->localSymSigningKey);
     return UA_ByteString_copy(key, &cc->localSymSigningKey);
 }
@@ -708,6 +727,11 @@ channelContext_setRemoteSymEncryptingKey_sp_basic256sha256(Basic256Sha256_Channe
     if(key == NULL || cc == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
 
+    const UA_SecurityPolicy *securityPolicy = cc->policyContext->securityPolicy;
+    int mbedErr = mbedtls_aes_setkey_dec(&cc->remoteSymAesContext, key->data,
+                                         (unsigned int)(key->length * 8));
+    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+
     UA_ByteString_deleteMembers(&cc->remoteSymEncryptingKey);
     return UA_ByteString_copy(key, &cc->remoteSymEncryptingKey);
 }
@@ -718,6 +742,10 @@ channelContext_setRemoteSymSigningKey_sp_basic256sha256(Basic256Sha256_ChannelCo
     if(key == NULL || cc == NULL)
         return UA_STATUSCODE_BADINTERNALERROR;
 
+    const UA_SecurityPolicy *securityPolicy = cc->policyContext->securityPolicy;
+    int mbedErr = mbedtls_md_hmac_starts(&cc->remoteSymHmacContext, key->data, key->length);
+    UA_MBEDTLS_ERRORHANDLING_RETURN(UA_STATUSCODE_BADINTERNALERROR);
+
     UA_ByteString_deleteMembers(&cc->remoteSymSigningKey);
     return UA_ByteString_copy(key, &cc->remoteSymSigningKey);
 }
@@ -770,7 +798,6 @@ deleteMembers_sp_basic256sha256(UA_SecurityPolicy *securityPolicy) {
     mbedtls_ctr_drbg_free(&pc->drbgContext);
     mbedtls_entropy_free(&pc->entropyContext);
     mbedtls_pk_free(&pc->localPrivateKey);
-    mbedtls_md_free(&pc->sha256MdContext);
     UA_ByteString_deleteMembers(&pc->localCertThumbprint);
 
     UA_LOG_DEBUG(securityPolicy->logger, UA_LOGCATEGORY_SECURITYPOLICY,
@@ -800,20 +827,12 @@ policyContext_newContext_sp_basic256sha256(UA_SecurityPolicy *securityPolicy,
     mbedtls_ctr_drbg_init(&pc->drbgContext);
     mbedtls_entropy_init(&pc->entropyContext);
     mbedtls_pk_init(&pc->localPrivateKey);
-    mbedtls_md_init(&pc->sha256MdContext);
     pc->securityPolicy = securityPolicy;
 
-    /* Initialized the message digest */
-    const mbedtls_md_info_t *const mdInfo = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
-    int mbedErr = mbedtls_md_setup(&pc->sha256MdContext, mdInfo, MBEDTLS_MD_SHA256);
-    UA_MBEDTLS_ERRORHANDLING(UA_STATUSCODE_BADOUTOFMEMORY);
-    if(retval != UA_STATUSCODE_GOOD)
-        goto error;
-
     /* Add the system entropy source */
-    mbedErr = mbedtls_entropy_add_source(&pc->entropyContext,
-                                         mbedtls_platform_entropy_poll, NULL, 0,
-                                         MBEDTLS_ENTROPY_SOURCE_STRONG);
+    int mbedErr = mbedtls_entropy_add_source(&pc->entropyContext,
+                                             mbedtls_platform_entropy_poll, NULL, 0,
+                                             MBEDTLS_ENTROPY_SOURCE_STRONG);
     UA_MBEDTLS_ERRORHANDLING(UA_STATUSCODE_BADSECURITYCHECKSFAILED);
     if(retval != UA_STATUSCODE_GOOD)
         goto error;
@@ -41,6 +41,9 @@ UA_Client_init(UA_Client* client, UA_ClientConfig config) {
     client->channel.securityPolicy = &client->securityPolicy;
     client->channel.securityMode = UA_MESSAGESECURITYMODE_NONE;
     client->config = config;
+    UA_CustomTypesIndex_init(&client->customTypesIndex,
+                             client->config.customDataTypesSize,
+                             client->config.customDataTypes);
     if(client->config.stateCallback)
         client->config.stateCallback(client, client->state);
     /* Catch error during async connection */
@@ -114,6 +117,9 @@ UA_Client_secure_init(UA_Client* client, UA_ClientConfig config,
     client->channel.securityPolicy = &client->securityPolicy;
     client->channel.securityMode = UA_MESSAGESECURITYMODE_SIGNANDENCRYPT;
     client->config = config;
+    UA_CustomTypesIndex_init(&client->customTypesIndex,
+                             client->config.customDataTypesSize,
+                             client->config.customDataTypes);
     if(client->config.stateCallback)
         client->config.stateCallback(client, client->state);
 
@@ -227,6 +233,7 @@ UA_Client_deleteMembers(UA_Client* client) {
 
     /* Delete the async service calls */
     UA_Client_AsyncService_removeAll(client, UA_STATUSCODE_BADSHUTDOWN);
+    UA_Client_AsyncService_deleteMembers(client);
 
     /* Delete the subscriptions */
 #ifdef UA_ENABLE_SUBSCRIPTIONS
@@ -235,6 +242,8 @@ UA_Client_deleteMembers(UA_Client* client) {
 
     /* Delete the timed work */
     UA_Timer_deleteMembers(&client->timer);
+
+    UA_CustomTypesIndex_deleteMembers(&client->customTypesIndex);
 }
 
 void
@@ -321,16 +330,138 @@ sendSymmetricServiceRequest(UA_Client *client, const void *request,
 static const UA_NodeId
 serviceFaultId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_SERVICEFAULT_ENCODING_DEFAULTBINARY}};
 
-/* Look for the async callback in the linked list, execute and delete it */
+/**************************/
+/* Pending Async Services */
+/**************************/
+
+/* The pending calls are in a hash table by their requestId and in a tree
+ * ordered by their deadline. So matching a response and finding the timed out
+ * calls does not depend on the number of pending calls. */
+
+#define UA_ASYNCSERVICE_MINBUCKETS 16
+#define UA_ASYNCSERVICE_MAXPOOLED 256
+
+static enum ZIP_CMP
+cmpAsyncServiceDeadline(const UA_DateTime *a, const UA_DateTime *b) {
+    if(*a != *b)
+        return (*a < *b) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    /* Several calls can time out at the same time. The keys are unique by
+     * their address within the entry. The tree is never searched by key. */
+    if(a == b)
+        return ZIP_CMP_EQ;
+    return ((uintptr_t)a < (uintptr_t)b) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_IMPL(AsyncServiceCallTimeoutZip, AsyncServiceCall, timeoutZipfields,
+         UA_DateTime, deadline, cmpAsyncServiceDeadline)
+
+/* The requestIds are sequential. So they are evenly distributed without
+ * additional hashing. */
+static struct AsyncServiceCallBucket *
+getAsyncServiceBucket(UA_Client *client, UA_UInt32 requestId) {
+    return &client->asyncServiceBuckets[requestId & (client->asyncServiceBucketsSize - 1)];
+}
+
+/* At most one pending call per bucket on average. If the buckets cannot be
+ * grown, the existing buckets remain in use. */
 static UA_StatusCode
-processAsyncResponse(UA_Client *client, UA_UInt32 requestId, const UA_NodeId *responseTypeId,
-                     const UA_ByteString *responseMessage, size_t *offset) {
-    /* Find the callback */
+growAsyncServiceBuckets(UA_Client *client) {
+    size_t size = client->asyncServiceBucketsSize;
+    if(size > client->asyncServiceCallsSize)
+        return UA_STATUSCODE_GOOD;
+    size = (size == 0) ? UA_ASYNCSERVICE_MINBUCKETS : size << 1;
+    struct AsyncServiceCallBucket *buckets = (struct AsyncServiceCallBucket*)
+        UA_malloc(size * sizeof(struct AsyncServiceCallBucket));
+    if(!buckets)
+        return (client->asyncServiceBuckets) ?
+            UA_STATUSCODE_GOOD : UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < size; ++i)
+        LIST_INIT(&buckets[i]);
+
+    UA_free(client->asyncServiceBuckets);
+    client->asyncServiceBuckets = buckets;
+    client->asyncServiceBucketsSize = size;
+    AsyncServiceCall *ac;
+    LIST_FOREACH(ac, &client->asyncServiceCalls, pointers)
+        LIST_INSERT_HEAD(getAsyncServiceBucket(client, ac->requestId), ac, idPointers);
+    return UA_STATUSCODE_GOOD;
+}
+
+static AsyncServiceCall *
+findAsyncServiceCall(UA_Client *client, UA_UInt32 requestId) {
+    if(client->asyncServiceBucketsSize == 0)
+        return NULL;
     AsyncServiceCall *ac;
-    LIST_FOREACH(ac, &client->asyncServiceCalls, pointers) {
+    LIST_FOREACH(ac, getAsyncServiceBucket(client, requestId), idPointers) {
         if(ac->requestId == requestId)
-            break;
+            return ac;
+    }
+    return NULL;
+}
+
+/* The buckets are grown before the request is sent */
+static void
+addAsyncServiceCall(UA_Client *client, AsyncServiceCall *ac) {
+    LIST_INSERT_HEAD(&client->asyncServiceCalls, ac, pointers);
+    LIST_INSERT_HEAD(getAsyncServiceBucket(client, ac->requestId), ac, idPointers);
+    if(ac->timeout) {
+        ac->deadline = ac->start + (UA_DateTime)(ac->timeout * UA_DATETIME_MSEC);
+        AsyncServiceCallTimeoutZip_ZIP_INSERT(&client->asyncServiceTimeouts, ac);
+    }
+    client->asyncServiceCallsSize++;
+}
+
+static void
+removeAsyncServiceCall(UA_Client *client, AsyncServiceCall *ac) {
+    LIST_REMOVE(ac, pointers);
+    LIST_REMOVE(ac, idPointers);
+    if(ac->timeout)
+        AsyncServiceCallTimeoutZip_ZIP_REMOVE(&client->asyncServiceTimeouts, ac);
+    client->asyncServiceCallsSize--;
+}
+
+static AsyncServiceCall *
+allocAsyncServiceCall(UA_Client *client) {
+    AsyncServiceCall *ac = client->asyncServicePool;
+    if(!ac)
+        return (AsyncServiceCall*)UA_malloc(sizeof(AsyncServiceCall));
+    client->asyncServicePool = LIST_NEXT(ac, pointers);
+    client->asyncServicePoolSize--;
+    return ac;
+}
+
+static void
+releaseAsyncServiceCall(UA_Client *client, AsyncServiceCall *ac) {
+    if(client->asyncServicePoolSize >= UA_ASYNCSERVICE_MAXPOOLED) {
+        UA_free(ac);
+        return;
     }
+    ac->pointers.le_next = client->asyncServicePool;
+    client->asyncServicePool = ac;
+    client->asyncServicePoolSize++;
+}
+
+void
+UA_Client_AsyncService_deleteMembers(UA_Client *client) {
+    AsyncServiceCall *ac = client->asyncServicePool;
+    while(ac) {
+        AsyncServiceCall *next = LIST_NEXT(ac, pointers);
+        UA_free(ac);
+        ac = next;
+    }
+    client->asyncServicePool = NULL;
+    client->asyncServicePoolSize = 0;
+    UA_free(client->asyncServiceBuckets);
+    client->asyncServiceBuckets = NULL;
+    client->asyncServiceBucketsSize = 0;
+}
+
+/* Look for the async callback in the hash table, execute and delete it */
+static UA_StatusCode
+processAsyncResponse(UA_Client *client, UA_UInt32 requestId, const UA_NodeId *responseTypeId,
+                     const UA_ByteString *responseMessage, size_t *offset) {
+    /* Find the callback */
+    AsyncServiceCall *ac = findAsyncServiceCall(client, requestId);
     if(!ac)
         return UA_STATUSCODE_BADREQUESTHEADERINVALID;
 
@@ -370,13 +501,14 @@ processAsyncResponse(UA_Client *client, UA_UInt32 requestId, const UA_NodeId *re
         ((UA_ResponseHeader*)response)->serviceResult = retval;
     }
 
+    /* Remove the entry before calling the callback. The callback can close
+     * the client and remove all pending calls. */
+    removeAsyncServiceCall(client, ac);
+
     /* Call the callback */
     ac->callback(client, ac->userdata, requestId, response);
     UA_deleteMembers(response, ac->responseType);
-
-    /* Remove the callback */
-    LIST_REMOVE(ac, pointers);
-    UA_free(ac);
+    releaseAsyncServiceCall(client, ac);
     return retval;
 }
 
@@ -447,9 +579,8 @@ processServiceResponse(void *application, UA_SecureChannel *channel,
                  "Decode a message of type %u", responseId.identifier.numeric);
 
     /* Decode the response */
-    retval = UA_decodeBinary(message, &offset, rd->response, rd->responseType,
-                             rd->client->config.customDataTypesSize,
-                             rd->client->config.customDataTypes);
+    retval = UA_decodeBinaryIndexed(message, &offset, rd->response, rd->responseType,
+                                    &rd->client->customTypesIndex);
 
 finish:
     UA_NodeId_deleteMembers(&responseId);
@@ -600,11 +731,22 @@ UA_Client_AsyncService_cancel(UA_Client *client, AsyncServiceCall *ac,
 }
 
 void UA_Client_AsyncService_removeAll(UA_Client *client, UA_StatusCode statusCode) {
-    AsyncServiceCall *ac, *ac_tmp;
-    LIST_FOREACH_SAFE(ac, &client->asyncServiceCalls, pointers, ac_tmp) {
-        LIST_REMOVE(ac, pointers);
+    AsyncServiceCall *ac;
+    while((ac = LIST_FIRST(&client->asyncServiceCalls))) {
+        removeAsyncServiceCall(client, ac);
         UA_Client_AsyncService_cancel(client, ac, statusCode);
-        UA_free(ac);
+        releaseAsyncServiceCall(client, ac);
+    }
+}
+
+void
+UA_Client_AsyncService_removeTimedOut(UA_Client *client, UA_DateTime nowMonotonic) {
+    AsyncServiceCall *ac;
+    while((ac = AsyncServiceCallTimeoutZip_ZIP_MIN(&client->asyncServiceTimeouts)) &&
+          ac->deadline <= nowMonotonic) {
+        removeAsyncServiceCall(client, ac);
+        UA_Client_AsyncService_cancel(client, ac, UA_STATUSCODE_BADTIMEOUT);
+        releaseAsyncServiceCall(client, ac);
     }
 }
 
@@ -615,8 +757,14 @@ __UA_Client_AsyncServiceEx(UA_Client *client, const void *request,
                            const UA_DataType *responseType,
                            void *userdata, UA_UInt32 *requestId,
                            UA_UInt32 timeout) {
-    /* Prepare the entry for the linked list */
-    AsyncServiceCall *ac = (AsyncServiceCall*)UA_malloc(sizeof(AsyncServiceCall));
+    /* Make room in the hash table. The response can only be processed if the
+     * call can be stored after sending. */
+    UA_StatusCode retval = growAsyncServiceBuckets(client);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Prepare the entry */
+    AsyncServiceCall *ac = allocAsyncServiceCall(client);
     if(!ac)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     ac->callback = callback;
@@ -625,16 +773,16 @@ __UA_Client_AsyncServiceEx(UA_Client *client, const void *request,
     ac->timeout = timeout;
 
     /* Call the service and set the requestId */
-    UA_StatusCode retval = sendSymmetricServiceRequest(client, request, requestType, &ac->requestId);
+    retval = sendSymmetricServiceRequest(client, request, requestType, &ac->requestId);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_free(ac);
+        releaseAsyncServiceCall(client, ac);
         return retval;
     }
 
     ac->start = UA_DateTime_nowMonotonic();
 
     /* Store the entry for async processing */
-    LIST_INSERT_HEAD(&client->asyncServiceCalls, ac, pointers);
+    addAsyncServiceCall(client, ac);
     if(requestId)
         *requestId = ac->requestId;
     return UA_STATUSCODE_GOOD;
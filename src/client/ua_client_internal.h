@@ -18,6 +18,7 @@
 #include "ua_client_subscriptions.h"
 #include "../../deps/queue.h"
 #include "ua_timer.h"
+#include "ua_types_encoding_binary.h"
 
 /**************************/
 /* Subscriptions Handling */
@@ -95,6 +96,9 @@ signActivateSessionRequest(UA_SecureChannel *channel,
 
 typedef struct AsyncServiceCall {
     LIST_ENTRY(AsyncServiceCall) pointers;
+    LIST_ENTRY(AsyncServiceCall) idPointers;     /* Bucket by requestId */
+    ZIP_ENTRY(AsyncServiceCall) timeoutZipfields; /* Only with a timeout */
+    UA_DateTime deadline; /* Key in the timeout tree */
     UA_UInt32 requestId;
     UA_ClientAsyncServiceCallback callback;
     const UA_DataType *responseType;
@@ -104,11 +108,21 @@ typedef struct AsyncServiceCall {
     void *responsedata;
 } AsyncServiceCall;
 
+LIST_HEAD(AsyncServiceCallBucket, AsyncServiceCall);
+ZIP_HEAD(AsyncServiceCallTimeoutZip, AsyncServiceCall);
+
 void UA_Client_AsyncService_cancel(UA_Client *client, AsyncServiceCall *ac,
                                    UA_StatusCode statusCode);
 
 void UA_Client_AsyncService_removeAll(UA_Client *client, UA_StatusCode statusCode);
 
+/* Cancel the async service calls whose timeout has passed */
+void UA_Client_AsyncService_removeTimedOut(UA_Client *client, UA_DateTime nowMonotonic);
+
+/* Frees the lookup structures and the pooled entries. The calls need to be
+ * removed before. */
+void UA_Client_AsyncService_deleteMembers(UA_Client *client);
+
 typedef struct CustomCallback {
     LIST_ENTRY(CustomCallback)
     pointers;
@@ -136,6 +150,8 @@ struct UA_Client {
     UA_ClientState state;
 
     UA_ClientConfig config;
+    UA_CustomTypesIndex customTypesIndex; /* Lookup of the custom data types
+                                           * from the config during decoding */
     UA_Timer timer;
     UA_StatusCode connectStatus;
 
@@ -166,6 +182,20 @@ struct UA_Client {
     /* Async Service */
     AsyncServiceCall asyncConnectCall;
     LIST_HEAD(ListOfAsyncServiceCall, AsyncServiceCall) asyncServiceCalls;
+    size_t asyncServiceCallsSize;
+
+    /* Hashed lookup by the requestId. The number of buckets is a power of two
+     * and grows with the number of pending calls. */
+    size_t asyncServiceBucketsSize;
+    struct AsyncServiceCallBucket *asyncServiceBuckets;
+
+    /* Pending calls ordered by their deadline */
+    struct AsyncServiceCallTimeoutZip asyncServiceTimeouts;
+
+    /* Entries of finished calls are reused */
+    AsyncServiceCall *asyncServicePool;
+    size_t asyncServicePoolSize;
+
     /*When using highlevel functions these are the callbacks that can be accessed by the user*/
     LIST_HEAD(ListOfCustomCallback, CustomCallback) customCallbacks;
 
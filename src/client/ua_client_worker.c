@@ -83,24 +83,6 @@ void processDelayedClientCallbacks(UA_Client *client) {
     }
 }
 
-static void
-asyncServiceTimeoutCheck(UA_Client *client) {
-    UA_DateTime now = UA_DateTime_nowMonotonic();
-
-    /* Timeout occurs, remove the callback */
-    AsyncServiceCall *ac, *ac_tmp;
-    LIST_FOREACH_SAFE(ac, &client->asyncServiceCalls, pointers, ac_tmp) {
-        if(!ac->timeout)
-           continue;
-
-        if(ac->start + (UA_DateTime)(ac->timeout * UA_DATETIME_MSEC) <= now) {
-            LIST_REMOVE(ac, pointers);
-            UA_Client_AsyncService_cancel(client, ac, UA_STATUSCODE_BADTIMEOUT);
-            UA_free(ac);
-        }
-    }
-}
-
 static void
 backgroundConnectivityCallback(UA_Client *client, void *userdata,
                                UA_UInt32 requestId, const UA_ReadResponse *response) {
@@ -202,7 +184,7 @@ UA_StatusCode UA_Client_run_iterate(UA_Client *client, UA_UInt16 timeout) {
         /* The inactivity check must be done after receiveServiceResponse*/
         UA_Client_Subscriptions_backgroundPublishInactivityCheck(client);
 #endif
-        asyncServiceTimeoutCheck(client);
+        UA_Client_AsyncService_removeTimedOut(client, UA_DateTime_nowMonotonic());
 
 #ifndef UA_ENABLE_MULTITHREADING
 /* Process delayed callbacks when all callbacks and
@@ -6,6 +6,7 @@
  */
 
 #include "ua_types_encoding_binary.h"
+#include "ua_types_generated_encoding_binary.h"
 #include "server/ua_server_internal.h"
 
 #ifdef UA_ENABLE_PUBSUB /* conditional compilation */
@@ -19,6 +20,11 @@
 #include "ua_pubsub_ns0.h"
 #endif
 
+/* Initial and maximum size of the buffer for encoding the NetworkMessages of a
+ * WriterGroup. The maximum is the largest UDP datagram. */
+#define UA_PUBSUB_BUFFER_INITIALSIZE 512
+#define UA_PUBSUB_BUFFER_MAXSIZE 65535
+
 /**********************************************/
 /*               Connection                   */
 /**********************************************/
@@ -270,6 +276,9 @@ UA_Server_addDataSetField(UA_Server *server, const UA_NodeId publishedDataSet,
     if(currentDataSet->config.publishedDataSetType != UA_PUBSUB_DATASET_PUBLISHEDITEMS)
         return (UA_DataSetFieldResult) {UA_STATUSCODE_BADNOTIMPLEMENTED, {0, 0}};
 
+    if(currentDataSet->configurationFreezeCounter > 0)
+        return (UA_DataSetFieldResult) {UA_STATUSCODE_BADCONFIGURATIONERROR, {0, 0}};
+
     UA_DataSetField *newField = (UA_DataSetField *) UA_calloc(1, sizeof(UA_DataSetField));
     if(!newField)
         return (UA_DataSetFieldResult) {UA_STATUSCODE_BADINTERNALERROR, {0, 0}};
@@ -305,6 +314,9 @@ UA_Server_removeDataSetField(UA_Server *server, const UA_NodeId dsf) {
     if(!parentPublishedDataSet)
         return (UA_DataSetFieldResult) {UA_STATUSCODE_BADNOTFOUND, {0, 0}};
 
+    if(parentPublishedDataSet->configurationFreezeCounter > 0)
+        return (UA_DataSetFieldResult) {UA_STATUSCODE_BADCONFIGURATIONERROR, {0, 0}};
+
     parentPublishedDataSet->fieldSize--;
     if(currentField->config.field.variable.promotedField)
         parentPublishedDataSet->promotedFieldsCount--;
@@ -493,6 +505,7 @@ UA_WriterGroupConfig_deleteMembers(UA_WriterGroupConfig *writerGroupConfig){
 
 void
 UA_WriterGroup_deleteMembers(UA_Server *server, UA_WriterGroup *writerGroup) {
+    UA_WriterGroup_unfreezeConfiguration(server, writerGroup);
     UA_WriterGroupConfig_deleteMembers(&writerGroup->config);
     //delete WriterGroup
     //delete all writers. Therefore removeDataSetWriter is called from PublishedDataSet
@@ -503,6 +516,7 @@ UA_WriterGroup_deleteMembers(UA_Server *server, UA_WriterGroup *writerGroup) {
     LIST_REMOVE(writerGroup, listEntry);
     UA_NodeId_deleteMembers(&writerGroup->linkedConnection);
     UA_NodeId_deleteMembers(&writerGroup->identifier);
+    UA_ByteString_deleteMembers(&writerGroup->buffer);
 }
 
 UA_StatusCode
@@ -522,6 +536,9 @@ UA_Server_addDataSetWriter(UA_Server *server,
     if(!wg)
         return UA_STATUSCODE_BADNOTFOUND;
 
+    if(wg->configurationFrozen)
+        return UA_STATUSCODE_BADCONFIGURATIONERROR;
+
     UA_DataSetWriter *newDataSetWriter = (UA_DataSetWriter *) UA_calloc(1, sizeof(UA_DataSetWriter));
     if(!newDataSetWriter)
         return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -570,6 +587,9 @@ UA_Server_removeDataSetWriter(UA_Server *server, const UA_NodeId dsw){
     if(!linkedWriterGroup)
         return UA_STATUSCODE_BADNOTFOUND;
 
+    if(linkedWriterGroup->configurationFrozen)
+        return UA_STATUSCODE_BADCONFIGURATIONERROR;
+
     linkedWriterGroup->writersCount--;
 #ifdef UA_ENABLE_PUBSUB_INFORMATIONMODEL
     removeDataSetWriterRepresentation(server, dataSetWriter);
@@ -712,6 +732,26 @@ UA_PubSubDataSetField_sampleValue(UA_Server *server, UA_DataSetField *field,
     *value = UA_Server_read(server, &rvid, UA_TIMESTAMPSTORETURN_BOTH);
 }
 
+/* Remove the content of the sampled value that is not enabled in the
+ * DataSetFieldContentMask of the writer */
+static void
+UA_DataSetWriter_applyFieldContentMask(const UA_DataSetWriter *dataSetWriter,
+                                       UA_DataValue *dfv) {
+    /* Deactivate statuscode? */
+    if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_STATUSCODE) == 0)
+        dfv->hasStatus = false;
+
+    /* Deactivate timestamps */
+    if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SOURCETIMESTAMP) == 0)
+        dfv->hasSourceTimestamp = false;
+    if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SOURCEPICOSECONDS) == 0)
+        dfv->hasSourcePicoseconds = false;
+    if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SERVERTIMESTAMP) == 0)
+        dfv->hasServerTimestamp = false;
+    if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SERVERPICOSECONDS) == 0)
+        dfv->hasServerPicoseconds = false;
+}
+
 static UA_StatusCode
 UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMessage *dataSetMessage,
                                                UA_DataSetWriter *dataSetWriter) {
@@ -736,20 +776,7 @@ UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMess
         /* Sample the value */
         UA_DataValue *dfv = &dataSetMessage->data.keyFrameData.dataSetFields[counter];
         UA_PubSubDataSetField_sampleValue(server, dsf, dfv);
-
-        /* Deactivate statuscode? */
-        if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_STATUSCODE) == 0)
-            dfv->hasStatus = false;
-
-        /* Deactivate timestamps */
-        if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SOURCETIMESTAMP) == 0)
-            dfv->hasSourceTimestamp = false;
-        if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SOURCEPICOSECONDS) == 0)
-            dfv->hasSourcePicoseconds = false;
-        if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SERVERTIMESTAMP) == 0)
-            dfv->hasServerTimestamp = false;
-        if((dataSetWriter->config.dataSetFieldContentMask & UA_DATASETFIELDCONTENTMASK_SERVERPICOSECONDS) == 0)
-            dfv->hasServerPicoseconds = false;
+        UA_DataSetWriter_applyFieldContentMask(dataSetWriter, dfv);
 
 #ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
         /* Update lastValue store */
@@ -974,6 +1001,340 @@ UA_DataSetWriter_generateDataSetMessage(UA_Server *server, UA_DataSetMessage *da
     return UA_STATUSCODE_GOOD;
 }
 
+/* Encode the NetworkMessage into the buffer of the WriterGroup. The buffer is
+ * reused in every publish cycle and grows if the NetworkMessage does not fit.
+ * The returned message points into the buffer. */
+static UA_StatusCode
+UA_WriterGroup_encodeNetworkMessage(UA_WriterGroup *writerGroup, const UA_NetworkMessage *nm,
+                                    UA_ByteString *message) {
+    UA_ByteString *buf = &writerGroup->buffer;
+    if(buf->length == 0) {
+        UA_StatusCode retval = UA_ByteString_allocBuffer(buf, UA_PUBSUB_BUFFER_INITIALSIZE);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+
+    while(true) {
+        UA_Byte *bufPos = buf->data;
+        const UA_Byte *bufEnd = &buf->data[buf->length];
+        UA_StatusCode retval = UA_NetworkMessage_encodeBinary(nm, &bufPos, bufEnd);
+        if(retval == UA_STATUSCODE_GOOD) {
+            message->data = buf->data;
+            message->length = (size_t)(bufPos - buf->data);
+            return UA_STATUSCODE_GOOD;
+        }
+
+        /* Without an exchange callback, the end of the buffer is reported as
+         * an encoding error from within nested types. Then only grow the
+         * buffer if the message does not fit. */
+        size_t needed = 0;
+        if(retval == UA_STATUSCODE_BADENCODINGERROR) {
+            needed = UA_NetworkMessage_calcSizeBinary(nm);
+            if(needed <= buf->length)
+                return retval;
+        } else if(retval != UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
+            return retval;
+        }
+        if(buf->length >= UA_PUBSUB_BUFFER_MAXSIZE || needed > UA_PUBSUB_BUFFER_MAXSIZE)
+            return retval;
+
+        size_t newLength = buf->length * 2;
+        if(newLength < needed)
+            newLength = needed;
+        if(newLength > UA_PUBSUB_BUFFER_MAXSIZE)
+            newLength = UA_PUBSUB_BUFFER_MAXSIZE;
+        UA_ByteString_deleteMembers(buf);
+        retval = UA_ByteString_allocBuffer(buf, newLength);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+}
+
+static void
+UA_WriterGroup_freeDataSetMessages(UA_DataSetMessage *dsmStore, size_t dsmCount) {
+    for(size_t i = 0; i < dsmCount; i++)
+        UA_DataSetMessage_free(&dsmStore[i]);
+}
+
+/**********************************************/
+/*           Frozen WriterGroups              */
+/**********************************************/
+
+static UA_DataSetField *
+UA_PublishedDataSet_getFieldByIndex(UA_PublishedDataSet *publishedDataSet, UA_UInt16 index) {
+    UA_DataSetField *dsf;
+    LIST_FOREACH(dsf, &publishedDataSet->fields, listEntry) {
+        if(index == 0)
+            return dsf;
+        index--;
+    }
+    return NULL;
+}
+
+static void
+UA_NetworkMessageTemplate_deleteMembers(UA_NetworkMessageTemplate *t) {
+    UA_ByteString_deleteMembers(&t->message);
+    UA_free(t->offsets);
+    t->offsets = NULL;
+    t->offsetsSize = 0;
+}
+
+/* Encode the NetworkMessage with the DataSetMessages of the writers once and
+ * link the offsets of the changing content with the writers and fields */
+static UA_StatusCode
+UA_WriterGroup_addTemplate(UA_Server *server, UA_WriterGroup *writerGroup,
+                           UA_DataSetWriter **writers, UA_Byte writersCount) {
+    UA_NetworkMessageTemplate *templates = (UA_NetworkMessageTemplate *)
+        UA_realloc(writerGroup->templates,
+                   sizeof(UA_NetworkMessageTemplate) * (writerGroup->templatesSize + 1));
+    if(!templates)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    writerGroup->templates = templates;
+    UA_NetworkMessageTemplate *t = &templates[writerGroup->templatesSize];
+    memset(t, 0, sizeof(UA_NetworkMessageTemplate));
+
+    /* Generate key frames with the current values */
+    UA_STACKARRAY(UA_DataSetMessage, dsmStore, writersCount);
+    UA_STACKARRAY(UA_UInt16, dsWriterIds, writersCount);
+    memset(dsmStore, 0, sizeof(UA_DataSetMessage) * writersCount);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(UA_Byte i = 0; i < writersCount && retval == UA_STATUSCODE_GOOD; i++) {
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+        writers[i]->deltaFrameCounter = 0;
+#endif
+        retval = UA_DataSetWriter_generateDataSetMessage(server, &dsmStore[i], writers[i]);
+        /* The template does not use up a sequence number */
+        if(retval == UA_STATUSCODE_GOOD)
+            writers[i]->actualDataSetMessageSequenceCount--;
+        dsWriterIds[i] = writers[i]->config.dataSetWriterId;
+    }
+
+    UA_NetworkMessage nm;
+    memset(&nm, 0, sizeof(UA_NetworkMessage));
+    nm.version = 1;
+    nm.networkMessageType = UA_NETWORKMESSAGE_DATASET;
+    nm.payloadHeaderEnabled = UA_TRUE;
+    nm.payloadHeader.dataSetPayloadHeader.count = writersCount;
+    nm.payloadHeader.dataSetPayloadHeader.dataSetWriterIds = dsWriterIds;
+    nm.payload.dataSetPayload.dataSetMessages = dsmStore;
+
+    UA_ByteString message;
+    UA_NetworkMessageOffset *offsets = NULL;
+    size_t offsetsSize = 0;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_WriterGroup_encodeNetworkMessage(writerGroup, &nm, &message);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_ByteString_copy(&message, &t->message);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_NetworkMessage_generateOffsets(&nm, &offsets, &offsetsSize);
+    UA_WriterGroup_freeDataSetMessages(dsmStore, writersCount);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NetworkMessageTemplate_deleteMembers(t);
+        return retval;
+    }
+
+    t->offsets = (UA_NetworkMessageTemplateOffset *)
+        UA_calloc(offsetsSize, sizeof(UA_NetworkMessageTemplateOffset));
+    if(!t->offsets && offsetsSize > 0)
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < offsetsSize && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_NetworkMessageTemplateOffset *to = &t->offsets[i];
+        to->offset = offsets[i];
+        to->dataSetWriter = writers[offsets[i].dataSetMessageIndex];
+        if(to->offset.offset + to->offset.size > t->message.length) {
+            retval = UA_STATUSCODE_BADINTERNALERROR;
+            break;
+        }
+        if(to->offset.contentType != UA_NETWORKMESSAGE_OFFSET_FIELD_VARIANT &&
+           to->offset.contentType != UA_NETWORKMESSAGE_OFFSET_FIELD_DATAVALUE)
+            continue;
+        UA_PublishedDataSet *pds =
+            UA_PublishedDataSet_findPDSbyId(server, to->dataSetWriter->connectedDataSet);
+        if(pds)
+            to->field = UA_PublishedDataSet_getFieldByIndex(pds, offsets[i].fieldIndex);
+        if(!to->field)
+            retval = UA_STATUSCODE_BADNOTFOUND;
+    }
+    t->offsetsSize = offsetsSize;
+    UA_free(offsets);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NetworkMessageTemplate_deleteMembers(t);
+        return retval;
+    }
+    writerGroup->templatesSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The DataSetMessages are combined into NetworkMessages the same way as for
+ * the regular publishing. DataSetMessages with promoted fields are sent in a
+ * NetworkMessage of their own. */
+static UA_StatusCode
+UA_WriterGroup_generateTemplates(UA_Server *server, UA_WriterGroup *writerGroup) {
+    UA_UInt16 maxDSMCount = writerGroup->config.maxEncapsulatedDataSetMessageCount;
+    if(maxDSMCount == 0 || maxDSMCount > UA_BYTE_MAX)
+        maxDSMCount = 1;
+
+    UA_STACKARRAY(UA_DataSetWriter *, combinedWriters, writerGroup->writersCount);
+    UA_Byte combinedCount = 0;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_DataSetWriter *dsw;
+    LIST_FOREACH(dsw, &writerGroup->writers, listEntry) {
+        UA_PublishedDataSet *pds = UA_PublishedDataSet_findPDSbyId(server, dsw->connectedDataSet);
+        if(!pds)
+            return UA_STATUSCODE_BADNOTFOUND;
+        if(pds->promotedFieldsCount > 0) {
+            retval = UA_WriterGroup_addTemplate(server, writerGroup, &dsw, 1);
+        } else {
+            combinedWriters[combinedCount] = dsw;
+            combinedCount++;
+            if(combinedCount < maxDSMCount)
+                continue;
+            retval = UA_WriterGroup_addTemplate(server, writerGroup, combinedWriters, combinedCount);
+            combinedCount = 0;
+        }
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    if(combinedCount > 0)
+        retval = UA_WriterGroup_addTemplate(server, writerGroup, combinedWriters, combinedCount);
+    return retval;
+}
+
+static void
+UA_WriterGroup_deleteTemplates(UA_WriterGroup *writerGroup) {
+    for(size_t i = 0; i < writerGroup->templatesSize; i++)
+        UA_NetworkMessageTemplate_deleteMembers(&writerGroup->templates[i]);
+    UA_free(writerGroup->templates);
+    writerGroup->templates = NULL;
+    writerGroup->templatesSize = 0;
+}
+
+UA_StatusCode
+UA_Server_freezeWriterGroupConfiguration(UA_Server *server, const UA_NodeId writerGroup) {
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(wg->configurationFrozen)
+        return UA_STATUSCODE_GOOD;
+    if(wg->config.encodingMimeType != UA_PUBSUB_ENCODING_UADP)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    UA_StatusCode retval = UA_WriterGroup_generateTemplates(server, wg);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Freezing the WriterGroup failed with %s", UA_StatusCode_name(retval));
+        UA_WriterGroup_deleteTemplates(wg);
+        return retval;
+    }
+
+    /* Lock the fields of the PublishedDataSets */
+    UA_DataSetWriter *dsw;
+    LIST_FOREACH(dsw, &wg->writers, listEntry) {
+        UA_PublishedDataSet *pds = UA_PublishedDataSet_findPDSbyId(server, dsw->connectedDataSet);
+        pds->configurationFreezeCounter++;
+    }
+    wg->configurationFrozen = UA_TRUE;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_WriterGroup_unfreezeConfiguration(UA_Server *server, UA_WriterGroup *writerGroup) {
+    if(!writerGroup->configurationFrozen)
+        return;
+    UA_DataSetWriter *dsw;
+    LIST_FOREACH(dsw, &writerGroup->writers, listEntry) {
+        UA_PublishedDataSet *pds = UA_PublishedDataSet_findPDSbyId(server, dsw->connectedDataSet);
+        if(pds)
+            pds->configurationFreezeCounter--;
+    }
+    UA_WriterGroup_deleteTemplates(writerGroup);
+    writerGroup->configurationFrozen = UA_FALSE;
+}
+
+UA_StatusCode
+UA_Server_unfreezeWriterGroupConfiguration(UA_Server *server, const UA_NodeId writerGroup) {
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_WriterGroup_unfreezeConfiguration(server, wg);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Encode the current value of the field in place. A value that is stored in
+ * the node is encoded without copying it out of the information model. */
+static UA_StatusCode
+UA_DataSetField_encodeValueInPlace(UA_Server *server, const UA_NetworkMessageTemplateOffset *to,
+                                   UA_Byte **bufPos, const UA_Byte *bufEnd) {
+    const UA_PublishedVariableDataType *params =
+        &to->field->config.field.variable.publishParameters;
+    if(to->offset.contentType == UA_NETWORKMESSAGE_OFFSET_FIELD_VARIANT &&
+       params->attributeId == UA_ATTRIBUTEID_VALUE && params->indexRange.length == 0) {
+        const UA_Node *node = UA_Nodestore_get(server, &params->publishedVariable);
+        if(node) {
+            const UA_VariableNode *vn = (const UA_VariableNode*)node;
+            if(node->nodeClass == UA_NODECLASS_VARIABLE &&
+               vn->valueSource == UA_VALUESOURCE_DATA &&
+               !vn->value.data.callback.onRead) {
+                UA_StatusCode retval =
+                    UA_Variant_encodeBinary(&vn->value.data.value.value, bufPos, bufEnd);
+                UA_Nodestore_release(server, node);
+                return retval;
+            }
+            UA_Nodestore_release(server, node);
+        }
+    }
+
+    /* Sample the value with a regular read */
+    UA_DataValue value;
+    UA_PubSubDataSetField_sampleValue(server, to->field, &value);
+    UA_StatusCode retval;
+    if(to->offset.contentType == UA_NETWORKMESSAGE_OFFSET_FIELD_VARIANT) {
+        retval = UA_Variant_encodeBinary(&value.value, bufPos, bufEnd);
+    } else {
+        UA_DataSetWriter_applyFieldContentMask(to->dataSetWriter, &value);
+        retval = UA_DataValue_encodeBinary(&value, bufPos, bufEnd);
+    }
+    UA_DataValue_deleteMembers(&value);
+    return retval;
+}
+
+/* Patch the changing content of the templates and send them. Every content is
+ * encoded again in every cycle. So a template that could not be sent is
+ * repaired once the values have the encoded size of the template again. */
+static void
+UA_WriterGroup_publishTemplates(UA_Server *server, UA_WriterGroup *writerGroup,
+                                UA_PubSubConnection *connection) {
+    for(size_t i = 0; i < writerGroup->templatesSize; i++) {
+        UA_NetworkMessageTemplate *t = &writerGroup->templates[i];
+        UA_StatusCode retval = UA_STATUSCODE_GOOD;
+        for(size_t j = 0; j < t->offsetsSize && retval == UA_STATUSCODE_GOOD; j++) {
+            UA_NetworkMessageTemplateOffset *to = &t->offsets[j];
+            UA_Byte *bufPos = &t->message.data[to->offset.offset];
+            const UA_Byte *bufEnd = &bufPos[to->offset.size];
+            if(to->offset.contentType == UA_NETWORKMESSAGE_OFFSET_SEQUENCENUMBER) {
+                retval = UA_UInt16_encodeBinary(&to->dataSetWriter->actualDataSetMessageSequenceCount,
+                                                &bufPos, bufEnd);
+                to->dataSetWriter->actualDataSetMessageSequenceCount++;
+            } else if(to->offset.contentType == UA_NETWORKMESSAGE_OFFSET_TIMESTAMP) {
+                UA_DateTime now = UA_DateTime_now();
+                retval = UA_DateTime_encodeBinary(&now, &bufPos, bufEnd);
+            } else {
+                retval = UA_DataSetField_encodeValueInPlace(server, to, &bufPos, bufEnd);
+            }
+            /* The layout of the NetworkMessage must not change */
+            if(retval == UA_STATUSCODE_GOOD && bufPos != bufEnd)
+                retval = UA_STATUSCODE_BADENCODINGERROR;
+        }
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                         "Publish failed. The content does not fit into the frozen "
+                         "NetworkMessage with %s", UA_StatusCode_name(retval));
+            continue;
+        }
+        connection->channel->send(connection->channel, NULL, &t->message);
+    }
+}
+
 /*
  * This callback triggers the collection and publish of NetworkMessages and the contained DataSetMessages.
  */
@@ -990,21 +1351,27 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
         UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Unknown encoding type.");
         return;
     }
+
+    //frozen WriterGroups only update and send the pre-encoded NetworkMessages
+    if(writerGroup->configurationFrozen) {
+        UA_PubSubConnection *connection = UA_PubSubConnection_findConnectionbyId(server, writerGroup->linkedConnection);
+        if(!connection){
+            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Publish failed. PubSubConnection invalid.");
+            return;
+        }
+        UA_WriterGroup_publishTemplates(server, writerGroup, connection);
+        return;
+    }
     //prevent error if the maxEncapsulatedDataSetMessageCount is set to 0->1
     writerGroup->config.maxEncapsulatedDataSetMessageCount = (UA_UInt16) (writerGroup->config.maxEncapsulatedDataSetMessageCount == 0 ||
                                                                           writerGroup->config.maxEncapsulatedDataSetMessageCount > UA_BYTE_MAX
                                                                           ? 1 : writerGroup->config.maxEncapsulatedDataSetMessageCount);
 
-    UA_DataSetMessage *dsmStore = (UA_DataSetMessage *) UA_calloc(writerGroup->writersCount, sizeof(UA_DataSetMessage));
-    if(!dsmStore) {
-        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "DataSetMessage allocation failed");
-        return;
-    }
-    memset(dsmStore, 0, sizeof(UA_DataSetMessage) * writerGroup->writersCount);
-    //The binary DataSetMessage sizes are part of the payload. Memory is allocated on the stack.
-    UA_STACKARRAY(UA_UInt16, dsmSizes, writerGroup->writersCount);
+    //The DataSetMessages and DataSetWriterIds are part of the payload. Memory is allocated on the stack.
+    //The binary DataSetMessage sizes are written during the encoding.
+    UA_STACKARRAY(UA_DataSetMessage, dsmStore, writerGroup->writersCount);
     UA_STACKARRAY(UA_UInt16, dsWriterIds, writerGroup->writersCount);
-    memset(dsmSizes, 0, writerGroup->writersCount * sizeof(UA_UInt16));
+    memset(dsmStore, 0, sizeof(UA_DataSetMessage) * writerGroup->writersCount);
     memset(dsWriterIds, 0, writerGroup->writersCount * sizeof(UA_UInt16));
     /*
      * Calculate the number of needed NetworkMessages. The previous allocated DataSetMessage array is
@@ -1027,25 +1394,25 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
         UA_PublishedDataSet *tmpPublishedDataSet = UA_PublishedDataSet_findPDSbyId(server, tmpDataSetWriter->connectedDataSet);
         if(!tmpPublishedDataSet) {
             UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Publish failed. PublishedDataSet not found");
+            UA_WriterGroup_freeDataSetMessages(dsmStore, writerGroup->writersCount);
             return;
         }
         if(tmpPublishedDataSet->promotedFieldsCount > 0) {
             if(UA_DataSetWriter_generateDataSetMessage(server, &dsmStore[(writerGroup->writersCount - 1) - singleNetworkMessagesCount],
                                                        tmpDataSetWriter) != UA_STATUSCODE_GOOD){
                 UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Publish failed. DataSetMessage creation failed");
+                UA_WriterGroup_freeDataSetMessages(dsmStore, writerGroup->writersCount);
                 return;
             };
             dsWriterIds[(writerGroup->writersCount - 1) - singleNetworkMessagesCount] = tmpDataSetWriter->config.dataSetWriterId;
-            dsmSizes[(writerGroup->writersCount-1) - singleNetworkMessagesCount] = (UA_UInt16) UA_DataSetMessage_calcSizeBinary(&dsmStore[(writerGroup->writersCount-1)
-                                                                                                                                          - singleNetworkMessagesCount]);
             singleNetworkMessagesCount++;
         } else {
             if(UA_DataSetWriter_generateDataSetMessage(server, &dsmStore[combinedNetworkMessageCount], tmpDataSetWriter) != UA_STATUSCODE_GOOD){
                 UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Publish failed. DataSetMessage creation failed");
+                UA_WriterGroup_freeDataSetMessages(dsmStore, writerGroup->writersCount);
                 return;
             };
             dsWriterIds[combinedNetworkMessageCount] = tmpDataSetWriter->config.dataSetWriterId;
-            dsmSizes[combinedNetworkMessageCount] = (UA_UInt16) UA_DataSetMessage_calcSizeBinary(&dsmStore[combinedNetworkMessageCount]);
             combinedNetworkMessageCount++;
         }
     }
@@ -1056,6 +1423,12 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
                 (combinedNetworkMessageCount % writerGroup->config.maxEncapsulatedDataSetMessageCount) == 0 ? 0 : 1);
         networkMessageCount += combinedNetworkMessageCount;
     }
+    UA_PubSubConnection *connection = UA_PubSubConnection_findConnectionbyId(server, writerGroup->linkedConnection);
+    if(!connection){
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Publish failed. PubSubConnection invalid.");
+        UA_WriterGroup_freeDataSetMessages(dsmStore, writerGroup->writersCount);
+        return;
+    }
     //Alloc memory for the NetworkMessages on the stack
     UA_STACKARRAY(UA_NetworkMessage, nmStore, networkMessageCount);
     memset(nmStore, 0, networkMessageCount * sizeof(UA_NetworkMessage));
@@ -1074,49 +1447,31 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
                     nmStore[i].payloadHeader.dataSetPayloadHeader.count = (UA_Byte) writerGroup->config.maxEncapsulatedDataSetMessageCount;
                     currentDSMPosition = i * writerGroup->config.maxEncapsulatedDataSetMessageCount;
                 }
-                //nmStore[i].payloadHeader.dataSetPayloadHeader.count = (UA_Byte) writerGroup->config.maxEncapsulatedDataSetMessageCount;
-                nmStore[i].payload.dataSetPayload.dataSetMessages = &dsmStore[currentDSMPosition];
-                nmStore->payload.dataSetPayload.sizes = &dsmSizes[currentDSMPosition];
-                nmStore->payloadHeader.dataSetPayloadHeader.dataSetWriterIds = &dsWriterIds[currentDSMPosition];
             } else {
                 currentDSMPosition = i * writerGroup->config.maxEncapsulatedDataSetMessageCount;
                 nmStore[i].payloadHeader.dataSetPayloadHeader.count = (UA_Byte) (currentDSMPosition - ((i - 1) * writerGroup->config.maxEncapsulatedDataSetMessageCount)); //attention cast from uint32 to byte
-                nmStore[i].payload.dataSetPayload.dataSetMessages = &dsmStore[currentDSMPosition];
-                nmStore->payload.dataSetPayload.sizes = &dsmSizes[currentDSMPosition];
-                nmStore->payloadHeader.dataSetPayloadHeader.dataSetWriterIds = &dsWriterIds[currentDSMPosition];
             }
         } else {///create single NetworkMessages (1 DSM per NM)
             nmStore[i].payloadHeader.dataSetPayloadHeader.count = 1;
             currentDSMPosition = (UA_UInt32) combinedNetworkMessageCount + (i - combinedNetworkMessageCount/writerGroup->config.maxEncapsulatedDataSetMessageCount
                                                                             + (combinedNetworkMessageCount % writerGroup->config.maxEncapsulatedDataSetMessageCount) == 0 ? 0 : 1);
-            nmStore[i].payload.dataSetPayload.dataSetMessages = &dsmStore[currentDSMPosition];
-            nmStore->payload.dataSetPayload.sizes = &dsmSizes[currentDSMPosition];
-            nmStore->payloadHeader.dataSetPayloadHeader.dataSetWriterIds = &dsWriterIds[currentDSMPosition];
         }
-        UA_PubSubConnection *connection = UA_PubSubConnection_findConnectionbyId(server, writerGroup->linkedConnection);
-        if(!connection){
-            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER, "Publish failed. PubSubConnection invalid.");
-            return;
-        }
-        //send the prepared messages
-        UA_ByteString buf;
-        size_t msgSize = UA_NetworkMessage_calcSizeBinary(&nmStore[i]);
-        if(UA_ByteString_allocBuffer(&buf, msgSize) == UA_STATUSCODE_GOOD) {
-            UA_Byte *bufPos = buf.data;
-            memset(bufPos, 0, msgSize);
-            const UA_Byte *bufEnd = &(buf.data[buf.length]);
-            if(UA_NetworkMessage_encodeBinary(&nmStore[i], &bufPos, bufEnd) != UA_STATUSCODE_GOOD){
-                UA_ByteString_deleteMembers(&buf);
-                return;
-            };
-            connection->channel->send(connection->channel, NULL, &buf);
+        nmStore[i].payload.dataSetPayload.dataSetMessages = &dsmStore[currentDSMPosition];
+        nmStore[i].payloadHeader.dataSetPayloadHeader.dataSetWriterIds = &dsWriterIds[currentDSMPosition];
+
+        //encode in a single pass and send the prepared messages
+        UA_ByteString message;
+        UA_StatusCode retval = UA_WriterGroup_encodeNetworkMessage(writerGroup, &nmStore[i], &message);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                         "Publish failed. NetworkMessage encoding failed with %s",
+                         UA_StatusCode_name(retval));
+            break;
         }
-        //The stack allocated sizes and dataSetWriterIds field must be set to NULL to prevent invalid free.
-        nmStore[i].payload.dataSetPayload.sizes = NULL;
-        nmStore->payloadHeader.dataSetPayloadHeader.dataSetWriterIds = NULL;
-        UA_ByteString_deleteMembers(&buf);
-        UA_NetworkMessage_deleteMembers(&nmStore[i]);
+        connection->channel->send(connection->channel, NULL, &message);
     }
+    //The NetworkMessages only point to the stack allocated DataSetMessages and DataSetWriterIds
+    UA_WriterGroup_freeDataSetMessages(dsmStore, writerGroup->writersCount);
 }
 
 /*
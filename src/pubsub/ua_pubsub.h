@@ -36,6 +36,7 @@ typedef struct{
     UA_NodeId identifier;
     UA_UInt16 fieldSize;
     UA_UInt16 promotedFieldsCount;
+    UA_UInt16 configurationFreezeCounter; /* Frozen DataSetWriters */
 } UA_PublishedDataSet;
 
 UA_StatusCode
@@ -104,6 +105,20 @@ UA_DataSetWriter_deleteMembers(UA_Server *server, UA_DataSetWriter *dataSetWrite
 /*               WriterGroup                  */
 /**********************************************/
 
+/* Content of a NetworkMessageTemplate that is patched in every publish cycle */
+typedef struct {
+    UA_NetworkMessageOffset offset;
+    UA_DataSetWriter *dataSetWriter;
+    struct UA_DataSetField *field; /* Only for the fields */
+} UA_NetworkMessageTemplateOffset;
+
+/* NetworkMessage of a frozen WriterGroup that is encoded once */
+typedef struct {
+    UA_ByteString message;
+    size_t offsetsSize;
+    UA_NetworkMessageTemplateOffset *offsets;
+} UA_NetworkMessageTemplate;
+
 struct UA_WriterGroup{
     UA_WriterGroupConfig config;
     //internal fields
@@ -114,6 +129,10 @@ struct UA_WriterGroup{
     UA_UInt32 writersCount;
     UA_UInt64 publishCallbackId;
     UA_Boolean publishCallbackIsRegistered;
+    UA_ByteString buffer; /* Reused for encoding the NetworkMessages */
+    UA_Boolean configurationFrozen;
+    size_t templatesSize;
+    UA_NetworkMessageTemplate *templates;
 };
 
 UA_StatusCode
@@ -153,6 +172,8 @@ UA_StatusCode
 UA_WriterGroup_addPublishCallback(UA_Server *server, UA_WriterGroup *writerGroup);
 void
 UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup);
+void
+UA_WriterGroup_unfreezeConfiguration(UA_Server *server, UA_WriterGroup *writerGroup);
 
 #endif /* UA_ENABLE_PUBSUB */
 
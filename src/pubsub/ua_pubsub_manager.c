@@ -210,6 +210,8 @@ UA_Server_removePublishedDataSet(UA_Server *server, UA_NodeId pds) {
     if(!publishedDataSet){
         return UA_STATUSCODE_BADNOTFOUND;
     }
+    if(publishedDataSet->configurationFreezeCounter > 0)
+        return UA_STATUSCODE_BADCONFIGURATIONERROR;
     //search for referenced writers -> delete this writers. (Standard: writer must be connected with PDS)
     for(size_t i = 0; i < server->pubSubManager.connectionsSize; i++){
         UA_WriterGroup *writerGroup;
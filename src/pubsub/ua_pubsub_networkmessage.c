@@ -54,6 +54,16 @@ static UA_Boolean UA_NetworkMessage_ExtendedFlags1Enabled(const UA_NetworkMessag
 static UA_Boolean UA_NetworkMessage_ExtendedFlags2Enabled(const UA_NetworkMessage* src);
 static UA_Boolean UA_DataSetMessageHeader_DataSetFlags2Enabled(const UA_DataSetMessageHeader* src);
 
+/* Sizes are written into space reserved before the sized content. So the
+ * content is encoded only once and does not need a calcSize pass. */
+static UA_StatusCode
+encodeBackPatchedSize(UA_Byte *pos, size_t size) {
+    if(size > UA_UINT16_MAX)
+        return UA_STATUSCODE_BADENCODINGERROR;
+    UA_UInt16 sz = (UA_UInt16)size;
+    return UA_UInt16_encodeBinary(&sz, &pos, pos + sizeof(UA_UInt16));
+}
+
 UA_StatusCode
 UA_NetworkMessage_encodeBinary(const UA_NetworkMessage* src, UA_Byte **bufPos,
                                const UA_Byte *bufEnd) {
@@ -206,6 +216,8 @@ UA_NetworkMessage_encodeBinary(const UA_NetworkMessage* src, UA_Byte **bufPos,
             return UA_STATUSCODE_BADNOTIMPLEMENTED;
             
         rv = UA_Byte_encodeBinary(&(src->payloadHeader.dataSetPayloadHeader.count), bufPos, bufEnd);
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
 
         if(src->payloadHeader.dataSetPayloadHeader.dataSetWriterIds == NULL)
             return UA_STATUSCODE_BADENCODINGERROR;
@@ -219,23 +231,36 @@ UA_NetworkMessage_encodeBinary(const UA_NetworkMessage* src, UA_Byte **bufPos,
     }
 
     // Timestamp
-    if(src->timestampEnabled)
+    if(src->timestampEnabled) {
         rv = UA_DateTime_encodeBinary(&(src->timestamp), bufPos, bufEnd);
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
+    }
 
     // Picoseconds
-    if(src->picosecondsEnabled)
+    if(src->picosecondsEnabled) {
         rv = UA_UInt16_encodeBinary(&(src->picoseconds), bufPos, bufEnd);
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
+    }
 
     // PromotedFields
     if(src->promotedFieldsEnabled) {
-        /* Size (calculate & encode) */
-        UA_UInt16 pfSize = 0;
-        for(UA_UInt16 i = 0; i < src->promotedFieldsSize; i++)
-            pfSize = (UA_UInt16) (pfSize + UA_Variant_calcSizeBinary(&src->promotedFields[i]));
-        rv |= UA_UInt16_encodeBinary(&pfSize, bufPos, bufEnd);
-
-        for (UA_UInt16 i = 0; i < src->promotedFieldsSize; i++)
-            rv |= UA_Variant_encodeBinary(&(src->promotedFields[i]), bufPos, bufEnd);
+        /* The size is written after the fields are encoded */
+        UA_Byte *pfSizePos = *bufPos;
+        if(*bufPos + sizeof(UA_UInt16) > bufEnd)
+            return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+        *bufPos += sizeof(UA_UInt16);
+
+        for (UA_UInt16 i = 0; i < src->promotedFieldsSize; i++) {
+            rv = UA_Variant_encodeBinary(&(src->promotedFields[i]), bufPos, bufEnd);
+            if(rv != UA_STATUSCODE_GOOD)
+                return rv;
+        }
+
+        rv = encodeBackPatchedSize(pfSizePos, (size_t)(*bufPos - pfSizePos) - sizeof(UA_UInt16));
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
     }
 
     // SecurityHeader
@@ -288,31 +313,31 @@ UA_NetworkMessage_encodeBinary(const UA_NetworkMessage* src, UA_Byte **bufPos,
         return UA_STATUSCODE_BADNOTIMPLEMENTED;
         
     UA_Byte count = 1;
+    UA_Byte *sizesPos = NULL;
 
     if(src->payloadHeaderEnabled) {
         count = src->payloadHeader.dataSetPayloadHeader.count;
         if(count > 1) {
-            for (UA_Byte i = 0; i < count; i++) {
-                // initially calculate the size, if not specified
-                UA_UInt16 sz = 0;
-                if((src->payload.dataSetPayload.sizes != NULL) &&
-                   (src->payload.dataSetPayload.sizes[i] != 0)) {
-                    sz = src->payload.dataSetPayload.sizes[i];
-                } else {
-                    sz = (UA_UInt16)UA_DataSetMessage_calcSizeBinary(&src->payload.dataSetPayload.dataSetMessages[i]);
-                }
-
-                rv = UA_UInt16_encodeBinary(&sz, bufPos, bufEnd);
-                if(rv != UA_STATUSCODE_GOOD)
-                    return rv;
-            }
+            /* Reserve the sizes. They are written when the DataSetMessages
+             * are encoded. */
+            if(*bufPos + (count * sizeof(UA_UInt16)) > bufEnd)
+                return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+            sizesPos = *bufPos;
+            *bufPos += count * sizeof(UA_UInt16);
         }
     }
 
     for(UA_Byte i = 0; i < count; i++) {
+        UA_Byte *dsmStart = *bufPos;
         rv = UA_DataSetMessage_encodeBinary(&(src->payload.dataSetPayload.dataSetMessages[i]), bufPos, bufEnd);
         if(rv != UA_STATUSCODE_GOOD)
             return rv;
+        if(sizesPos) {
+            rv = encodeBackPatchedSize(&sizesPos[i * sizeof(UA_UInt16)],
+                                       (size_t)(*bufPos - dsmStart));
+            if(rv != UA_STATUSCODE_GOOD)
+                return rv;
+        }
     }
 
     if(src->securityEnabled) {
@@ -661,7 +686,7 @@ UA_NetworkMessage_decodeBinary(const UA_ByteString *src, size_t *offset, UA_Netw
 
 size_t UA_NetworkMessage_calcSizeBinary(const UA_NetworkMessage* p) {
     size_t retval = 0;
-    UA_Byte byte;
+    UA_Byte byte = 0;
     size_t size = UA_Byte_calcSizeBinary(&byte); // UADPVersion + UADPFlags
     if(UA_NetworkMessage_ExtendedFlags1Enabled(p)) {
         size += UA_Byte_calcSizeBinary(&byte);
@@ -1046,7 +1071,7 @@ UA_DataSetMessageHeader_decodeBinary(const UA_ByteString *src, size_t *offset,
 
 size_t
 UA_DataSetMessageHeader_calcSizeBinary(const UA_DataSetMessageHeader* p) {
-    UA_Byte byte;
+    UA_Byte byte = 0;
     size_t size = UA_Byte_calcSizeBinary(&byte); // DataSetMessage Type + Flags
     if(UA_DataSetMessageHeader_DataSetFlags2Enabled(p))
         size += UA_Byte_calcSizeBinary(&byte);
@@ -1278,4 +1303,92 @@ void UA_DataSetMessage_free(const UA_DataSetMessage* p) {
     }
 }
 
+
+/* The DataSetMessages are encoded at the end of the NetworkMessage. The offsets
+ * within a DataSetMessage follow the layout of the encoding above. */
+UA_StatusCode
+UA_NetworkMessage_generateOffsets(const UA_NetworkMessage* src,
+                                  UA_NetworkMessageOffset **offsets,
+                                  size_t *offsetsSize) {
+    if(src->networkMessageType != UA_NETWORKMESSAGE_DATASET)
+        return UA_STATUSCODE_BADNOTIMPLEMENTED;
+    /* The signature would change with the content */
+    if(src->securityEnabled)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    UA_Byte count = 1;
+    if(src->payloadHeaderEnabled)
+        count = src->payloadHeader.dataSetPayloadHeader.count;
+
+    /* Upper bound for the number of offsets */
+    size_t maxOffsets = 0;
+    size_t dsmSizes = 0;
+    for(UA_Byte i = 0; i < count; i++) {
+        const UA_DataSetMessage *dsm = &src->payload.dataSetPayload.dataSetMessages[i];
+        if(dsm->header.dataSetMessageType != UA_DATASETMESSAGE_DATAKEYFRAME ||
+           dsm->header.fieldEncoding == UA_FIELDENCODING_RAWDATA)
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+        maxOffsets += 2 + (size_t)dsm->data.keyFrameData.fieldCount;
+        dsmSizes += UA_DataSetMessage_calcSizeBinary(dsm);
+    }
+
+    UA_NetworkMessageOffset *o = (UA_NetworkMessageOffset*)
+        UA_calloc(maxOffsets, sizeof(UA_NetworkMessageOffset));
+    if(!o && maxOffsets > 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    size_t oSize = 0;
+    size_t pos = UA_NetworkMessage_calcSizeBinary(src) - dsmSizes;
+    for(UA_Byte i = 0; i < count; i++) {
+        const UA_DataSetMessage *dsm = &src->payload.dataSetPayload.dataSetMessages[i];
+        const UA_DataSetMessageHeader *h = &dsm->header;
+
+        /* DataSetFlags1 and DataSetFlags2 */
+        size_t headerPos = pos + 1;
+        if(UA_DataSetMessageHeader_DataSetFlags2Enabled(h))
+            headerPos++;
+
+        if(h->dataSetMessageSequenceNrEnabled) {
+            o[oSize].contentType = UA_NETWORKMESSAGE_OFFSET_SEQUENCENUMBER;
+            o[oSize].dataSetMessageIndex = i;
+            o[oSize].offset = headerPos;
+            o[oSize].size = UA_UInt16_calcSizeBinary(&h->dataSetMessageSequenceNr);
+            headerPos += o[oSize].size;
+            oSize++;
+        }
+
+        if(h->timestampEnabled) {
+            o[oSize].contentType = UA_NETWORKMESSAGE_OFFSET_TIMESTAMP;
+            o[oSize].dataSetMessageIndex = i;
+            o[oSize].offset = headerPos;
+            o[oSize].size = UA_DateTime_calcSizeBinary(&h->timestamp);
+            oSize++;
+        }
+
+        /* Header and FieldCount */
+        pos += UA_DataSetMessageHeader_calcSizeBinary(h);
+        pos += UA_UInt16_calcSizeBinary(&dsm->data.keyFrameData.fieldCount);
+
+        for(UA_UInt16 j = 0; j < dsm->data.keyFrameData.fieldCount; j++) {
+            const UA_DataValue *field = &dsm->data.keyFrameData.dataSetFields[j];
+            o[oSize].dataSetMessageIndex = i;
+            o[oSize].fieldIndex = j;
+            o[oSize].offset = pos;
+            if(h->fieldEncoding == UA_FIELDENCODING_VARIANT) {
+                o[oSize].contentType = UA_NETWORKMESSAGE_OFFSET_FIELD_VARIANT;
+                o[oSize].size = UA_calcSizeBinary(&field->value, &UA_TYPES[UA_TYPES_VARIANT]);
+            } else {
+                o[oSize].contentType = UA_NETWORKMESSAGE_OFFSET_FIELD_DATAVALUE;
+                o[oSize].size = UA_calcSizeBinary(field, &UA_TYPES[UA_TYPES_DATAVALUE]);
+            }
+            pos += o[oSize].size;
+            oSize++;
+        }
+    }
+
+    *offsets = o;
+    *offsetsSize = oSize;
+    return UA_STATUSCODE_GOOD;
+}
+
 #endif /* UA_ENABLE_PUBSUB */
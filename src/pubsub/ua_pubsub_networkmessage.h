@@ -217,6 +217,37 @@ UA_NetworkMessage_deleteMembers(UA_NetworkMessage* p);
 void
 UA_NetworkMessage_delete(UA_NetworkMessage* p);
 
+/**
+ * NetworkMessage Offsets
+ * ^^^^^^^^^^^^^^^^^^^^^^
+ * Between the publish cycles of a NetworkMessage with a fixed layout, only the
+ * content at the offsets changes. The content can be encoded in place into the
+ * previously encoded NetworkMessage, if its encoded size stays the same. */
+
+typedef enum {
+    UA_NETWORKMESSAGE_OFFSET_SEQUENCENUMBER, /* DataSetMessage header */
+    UA_NETWORKMESSAGE_OFFSET_TIMESTAMP,      /* DataSetMessage header */
+    UA_NETWORKMESSAGE_OFFSET_FIELD_VARIANT,
+    UA_NETWORKMESSAGE_OFFSET_FIELD_DATAVALUE
+} UA_NetworkMessageOffsetType;
+
+typedef struct {
+    UA_NetworkMessageOffsetType contentType;
+    UA_Byte dataSetMessageIndex;
+    UA_UInt16 fieldIndex; /* Only for the fields */
+    size_t offset; /* From the start of the encoded NetworkMessage */
+    size_t size;   /* Encoded size of the content */
+} UA_NetworkMessageOffset;
+
+/* Returns the offsets of the content that is encoded with
+ * UA_NetworkMessage_encodeBinary. Only DataSetMessages with key frames can be
+ * patched in place. The offsets array is allocated and must be freed by the
+ * caller. */
+UA_StatusCode
+UA_NetworkMessage_generateOffsets(const UA_NetworkMessage* src,
+                                  UA_NetworkMessageOffset **offsets,
+                                  size_t *offsetsSize);
+
 
 #ifdef __cplusplus
 } // extern "C"
@@ -94,6 +94,7 @@ UA_VariableNode_copy(const UA_VariableNode *src, UA_VariableNode *dst) {
     dst->accessLevel = src->accessLevel;
     dst->minimumSamplingInterval = src->minimumSamplingInterval;
     dst->historizing = src->historizing;
+    dst->valueVersion = src->valueVersion;
     return retval;
 }
 
@@ -184,6 +185,20 @@ UA_Node_copy(const UA_Node *src, UA_Node *dst) {
             if(retval != UA_STATUSCODE_GOOD)
                 break;
             drefs->targetIdsSize = srefs->targetIdsSize;
+            drefs->targetIdsCapacity = srefs->targetIdsSize;
+
+            /* The positions don't change. The index is copied as is. */
+            if(!srefs->targetIndex)
+                continue;
+            drefs->targetIndex = (size_t*)
+                UA_malloc(sizeof(size_t) * srefs->targetIndexSize);
+            if(!drefs->targetIndex) {
+                retval = UA_STATUSCODE_BADOUTOFMEMORY;
+                break;
+            }
+            memcpy(drefs->targetIndex, srefs->targetIndex,
+                   sizeof(size_t) * srefs->targetIndexSize);
+            drefs->targetIndexSize = srefs->targetIndexSize;
         }
         if(retval != UA_STATUSCODE_GOOD) {
             UA_Node_deleteMembers(dst);
@@ -476,26 +491,133 @@ UA_Node_setAttributes(UA_Node *node, const void *attributes,
 /* Manage References */
 /*********************/
 
+/* Reference kinds with more targets than the threshold get a hash index from
+ * the target NodeId to the position in the targetIds array. The array is kept
+ * for browsing. So small nodes remain compact. The index uses linear probing
+ * and is kept at most half full. */
+#define UA_TARGETINDEX_THRESHOLD 16
+
+static size_t
+targetHash(const UA_ExpandedNodeId *target) {
+    return UA_NodeId_hash(&target->nodeId);
+}
+
+/* Returns the index slot of the target. Or the empty slot that ended the
+ * search. Without fullMatch, only the NodeId of the target is compared. */
+static size_t *
+findTargetSlot(const UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target,
+               UA_Boolean fullMatch) {
+    size_t mask = refs->targetIndexSize - 1;
+    size_t i = targetHash(target) & mask;
+    for(; refs->targetIndex[i] != 0; i = (i + 1) & mask) {
+        const UA_ExpandedNodeId *t = &refs->targetIds[refs->targetIndex[i] - 1];
+        if(fullMatch) {
+            if(UA_ExpandedNodeId_equal(t, target))
+                break;
+        } else if(UA_NodeId_equal(&t->nodeId, &target->nodeId)) {
+            break;
+        }
+    }
+    return &refs->targetIndex[i];
+}
+
+static size_t *
+findEmptyTargetSlot(const UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target) {
+    size_t mask = refs->targetIndexSize - 1;
+    size_t i = targetHash(target) & mask;
+    while(refs->targetIndex[i] != 0)
+        i = (i + 1) & mask;
+    return &refs->targetIndex[i];
+}
+
+/* Returns the index slot pointing to the position in the array */
+static size_t *
+findPositionSlot(const UA_NodeReferenceKind *refs, size_t pos) {
+    size_t mask = refs->targetIndexSize - 1;
+    size_t i = targetHash(&refs->targetIds[pos]) & mask;
+    while(refs->targetIndex[i] != pos + 1)
+        i = (i + 1) & mask;
+    return &refs->targetIndex[i];
+}
+
+/* Empty the slot. Move the following entries back so that they can still be
+ * found from their hash position. */
+static void
+removeTargetSlot(UA_NodeReferenceKind *refs, size_t *slot) {
+    size_t mask = refs->targetIndexSize - 1;
+    size_t i = (size_t)(slot - refs->targetIndex);
+    size_t j = i;
+    while(true) {
+        j = (j + 1) & mask;
+        size_t pos = refs->targetIndex[j];
+        if(pos == 0)
+            break;
+        /* The entry stays if its hash position is (cyclically) within (i, j] */
+        size_t k = targetHash(&refs->targetIds[pos - 1]) & mask;
+        if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        refs->targetIndex[i] = pos;
+        i = j;
+    }
+    refs->targetIndex[i] = 0;
+}
+
+/* Rebuild the index with space for the number of targets */
 static UA_StatusCode
-addReferenceTarget(UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target) {
-    UA_ExpandedNodeId *targets =
-        (UA_ExpandedNodeId*) UA_realloc(refs->targetIds,
-                                        sizeof(UA_ExpandedNodeId) * (refs->targetIdsSize+1));
-    if(!targets)
+resizeTargetIndex(UA_NodeReferenceKind *refs, size_t targets) {
+    size_t indexSize = UA_TARGETINDEX_THRESHOLD * 4;
+    while(indexSize < targets * 4)
+        indexSize *= 2;
+    size_t *index = (size_t*)UA_calloc(indexSize, sizeof(size_t));
+    if(!index)
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_free(refs->targetIndex);
+    refs->targetIndex = index;
+    refs->targetIndexSize = indexSize;
+    for(size_t i = 0; i < refs->targetIdsSize; ++i)
+        *findEmptyTargetSlot(refs, &refs->targetIds[i]) = i + 1;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+addReferenceTarget(UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target) {
+    /* Grow the array. Beyond the threshold, the capacity is doubled. */
+    if(refs->targetIdsSize >= refs->targetIdsCapacity) {
+        size_t capacity = refs->targetIdsSize + 1;
+        if(capacity > UA_TARGETINDEX_THRESHOLD)
+            capacity = refs->targetIdsSize * 2;
+        UA_ExpandedNodeId *targets = (UA_ExpandedNodeId*)
+            UA_realloc(refs->targetIds, sizeof(UA_ExpandedNodeId) * capacity);
+        if(!targets)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        refs->targetIds = targets;
+        refs->targetIdsCapacity = capacity;
+    }
+
+    /* Create or grow the index */
+    size_t newSize = refs->targetIdsSize + 1;
+    if(newSize >= UA_TARGETINDEX_THRESHOLD && newSize * 2 > refs->targetIndexSize) {
+        UA_StatusCode retval = resizeTargetIndex(refs, newSize);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
 
-    refs->targetIds = targets;
     UA_StatusCode retval =
         UA_ExpandedNodeId_copy(target, &refs->targetIds[refs->targetIdsSize]);
-
-    if(retval == UA_STATUSCODE_GOOD) {
-        refs->targetIdsSize++;
-    } else if(refs->targetIdsSize == 0) {
-        /* We had zero references before (realloc was a malloc) */
-        UA_free(refs->targetIds);
-        refs->targetIds = NULL;
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(refs->targetIdsSize == 0) {
+            /* We had zero references before (realloc was a malloc) */
+            UA_free(refs->targetIds);
+            refs->targetIds = NULL;
+            refs->targetIdsCapacity = 0;
+        }
+        return retval;
     }
-    return retval;
+
+    if(refs->targetIndex)
+        *findEmptyTargetSlot(refs, target) = newSize;
+    refs->targetIdsSize = newSize;
+    return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
@@ -537,10 +659,15 @@ UA_Node_addReference(UA_Node *node, const UA_AddReferencesItem *item) {
         }
     }
     if(existingRefs != NULL) {
-        for(size_t i = 0; i < existingRefs->targetIdsSize; i++) {
-            if(UA_ExpandedNodeId_equal(&existingRefs->targetIds[i],
-                                       &item->targetNodeId)) {
+        if(existingRefs->targetIndex) {
+            if(*findTargetSlot(existingRefs, &item->targetNodeId, true) != 0)
                 return UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED;
+        } else {
+            for(size_t i = 0; i < existingRefs->targetIdsSize; i++) {
+                if(UA_ExpandedNodeId_equal(&existingRefs->targetIds[i],
+                                           &item->targetNodeId)) {
+                    return UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED;
+                }
             }
         }
         return addReferenceTarget(existingRefs, &item->targetNodeId);
@@ -557,40 +684,57 @@ UA_Node_deleteReference(UA_Node *node, const UA_DeleteReferencesItem *item) {
         if(!UA_NodeId_equal(&item->referenceTypeId, &refs->referenceTypeId))
             continue;
 
-        for(size_t j = refs->targetIdsSize; j > 0; --j) {
-            if(!UA_NodeId_equal(&item->targetNodeId.nodeId, &refs->targetIds[j-1].nodeId))
+        /* Find the target */
+        size_t j = 0;
+        if(refs->targetIndex) {
+            size_t *slot = findTargetSlot(refs, &item->targetNodeId, false);
+            if(*slot == 0)
                 continue;
-
-            /* Ok, delete the reference */
-            UA_ExpandedNodeId_deleteMembers(&refs->targetIds[j-1]);
-            refs->targetIdsSize--;
-
-            /* One matching target remaining */
-            if(refs->targetIdsSize > 0) {
-                if(j-1 != refs->targetIdsSize) // avoid valgrind error: Source
-                                               // and destination overlap in
-                                               // memcpy
-                    refs->targetIds[j-1] = refs->targetIds[refs->targetIdsSize];
-                return UA_STATUSCODE_GOOD;
+            j = *slot;
+            removeTargetSlot(refs, slot);
+        } else {
+            for(j = refs->targetIdsSize; j > 0; --j) {
+                if(UA_NodeId_equal(&item->targetNodeId.nodeId, &refs->targetIds[j-1].nodeId))
+                    break;
             }
+            if(j == 0)
+                continue;
+        }
 
-            /* Remove refs */
-            UA_free(refs->targetIds);
-            UA_NodeId_deleteMembers(&refs->referenceTypeId);
-            node->referencesSize--;
-            if(node->referencesSize > 0) {
-                if(i-1 != node->referencesSize) // avoid valgrind error: Source
-                                                // and destination overlap in
-                                                // memcpy
-                    node->references[i-1] = node->references[node->referencesSize];
-                return UA_STATUSCODE_GOOD;
+        /* Ok, delete the reference */
+        UA_ExpandedNodeId_deleteMembers(&refs->targetIds[j-1]);
+        refs->targetIdsSize--;
+
+        /* One matching target remaining */
+        if(refs->targetIdsSize > 0) {
+            if(j-1 != refs->targetIdsSize) { // avoid valgrind error: Source
+                                             // and destination overlap in
+                                             // memcpy
+                /* The last target moves into the gap */
+                if(refs->targetIndex)
+                    *findPositionSlot(refs, refs->targetIdsSize) = j;
+                refs->targetIds[j-1] = refs->targetIds[refs->targetIdsSize];
             }
+            return UA_STATUSCODE_GOOD;
+        }
 
-            /* Remove the node references */
-            UA_free(node->references);
-            node->references = NULL;
+        /* Remove refs */
+        UA_free(refs->targetIds);
+        UA_free(refs->targetIndex);
+        UA_NodeId_deleteMembers(&refs->referenceTypeId);
+        node->referencesSize--;
+        if(node->referencesSize > 0) {
+            if(i-1 != node->referencesSize) // avoid valgrind error: Source
+                                            // and destination overlap in
+                                            // memcpy
+                node->references[i-1] = node->references[node->referencesSize];
             return UA_STATUSCODE_GOOD;
         }
+
+        /* Remove the node references */
+        UA_free(node->references);
+        node->references = NULL;
+        return UA_STATUSCODE_GOOD;
     }
     return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
 }
@@ -599,6 +743,7 @@ void UA_Node_deleteReferences(UA_Node *node) {
     for(size_t i = 0; i < node->referencesSize; ++i) {
         UA_NodeReferenceKind *refs = &node->references[i];
         UA_Array_delete(refs->targetIds, refs->targetIdsSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+        UA_free(refs->targetIndex);
         UA_NodeId_deleteMembers(&refs->referenceTypeId);
     }
     if(node->references)
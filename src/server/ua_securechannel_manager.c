@@ -26,9 +26,28 @@ UA_SecureChannelManager_init(UA_SecureChannelManager *cm, UA_Server *server) {
     cm->lastTokenId = STARTTOKENID;
     cm->currentChannelCount = 0;
     cm->server = server;
+
+    /* At most one channel per bucket on average */
+    cm->bucketsSize = 16;
+    while(cm->bucketsSize < server->config.maxSecureChannels)
+        cm->bucketsSize <<= 1;
+    cm->buckets = (struct channel_bucket*)
+        UA_malloc(cm->bucketsSize * sizeof(struct channel_bucket));
+    if(!cm->buckets) {
+        cm->bucketsSize = 0;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for(size_t i = 0; i < cm->bucketsSize; ++i)
+        LIST_INIT(&cm->buckets[i]);
     return UA_STATUSCODE_GOOD;
 }
 
+static struct channel_bucket *
+getChannelBucket(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+    /* The channel ids are sequential. No need to scatter them. */
+    return &cm->buckets[channelId & (cm->bucketsSize - 1)];
+}
+
 void
 UA_SecureChannelManager_deleteMembers(UA_SecureChannelManager *cm) {
     channel_list_entry *entry, *temp;
@@ -37,6 +56,9 @@ UA_SecureChannelManager_deleteMembers(UA_SecureChannelManager *cm) {
         UA_SecureChannel_deleteMembersCleanup(&entry->channel);
         UA_free(entry);
     }
+    UA_free(cm->buckets);
+    cm->buckets = NULL;
+    cm->bucketsSize = 0;
 }
 
 static void
@@ -60,6 +82,8 @@ removeSecureChannel(UA_SecureChannelManager *cm, channel_list_entry *entry) {
 
     /* Detach the channel and make the capacity available */
     LIST_REMOVE(entry, pointers);
+    if(entry->channel.securityToken.channelId != 0)
+        LIST_REMOVE(entry, idPointers);
     UA_atomic_subUInt32(&cm->currentChannelCount, 1);
     return UA_STATUSCODE_GOOD;
 }
@@ -112,6 +136,8 @@ UA_SecureChannelManager_create(UA_SecureChannelManager *const cm, UA_Connection
     if(cm->currentChannelCount >= cm->server->config.maxSecureChannels &&
        !purgeFirstChannelWithoutSession(cm))
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(cm->bucketsSize == 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
 
     UA_LOG_INFO(cm->server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
                 "Creating a new SecureChannel");
@@ -160,6 +186,9 @@ UA_SecureChannelManager_open(UA_SecureChannelManager *cm, UA_SecureChannel *chan
     channel->securityToken.createdAt = UA_DateTime_nowMonotonic();
     channel->securityToken.channelId = cm->lastChannelId++;
     channel->securityToken.createdAt = UA_DateTime_now();
+    /* The channel is the first member of the list entry */
+    LIST_INSERT_HEAD(getChannelBucket(cm, channel->securityToken.channelId),
+                     (channel_list_entry*)channel, idPointers);
 
     /* Set the lifetime. Lifetime 0 -> set the maximum possible */
     channel->securityToken.revisedLifetime =
@@ -230,23 +259,36 @@ UA_SecureChannelManager_renew(UA_SecureChannelManager *cm, UA_SecureChannel *cha
     return UA_STATUSCODE_GOOD;
 }
 
-UA_SecureChannel *
-UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+static channel_list_entry *
+findChannel(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+    /* Fresh channels have the id zero and are not indexed. Closing them (when
+     * the OPN fails) is rare. */
     channel_list_entry *entry;
-    LIST_FOREACH(entry, &cm->channels, pointers) {
+    if(channelId == 0 || cm->bucketsSize == 0) {
+        LIST_FOREACH(entry, &cm->channels, pointers) {
+            if(entry->channel.securityToken.channelId == channelId)
+                return entry;
+        }
+        return NULL;
+    }
+    LIST_FOREACH(entry, getChannelBucket(cm, channelId), idPointers) {
         if(entry->channel.securityToken.channelId == channelId)
-            return &entry->channel;
+            return entry;
     }
     return NULL;
 }
 
+UA_SecureChannel *
+UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+    channel_list_entry *entry = findChannel(cm, channelId);
+    if(!entry)
+        return NULL;
+    return &entry->channel;
+}
+
 UA_StatusCode
 UA_SecureChannelManager_close(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
-    channel_list_entry *entry;
-    LIST_FOREACH(entry, &cm->channels, pointers) {
-        if(entry->channel.securityToken.channelId == channelId)
-            break;
-    }
+    channel_list_entry *entry = findChannel(cm, channelId);
     if(!entry)
         return UA_STATUSCODE_BADINTERNALERROR;
     return removeSecureChannel(cm, entry);
@@ -23,14 +23,24 @@ extern "C" {
 typedef struct channel_list_entry {
     UA_SecureChannel channel;
     LIST_ENTRY(channel_list_entry) pointers;
+    LIST_ENTRY(channel_list_entry) idPointers; /* Bucket by channelId. Only
+                                                * after the channel was
+                                                * opened. */
 } channel_list_entry;
 
+LIST_HEAD(channel_bucket, channel_list_entry);
+
 typedef struct UA_SecureChannelManager {
     LIST_HEAD(channel_list, channel_list_entry) channels; // doubly-linked list of channels
     UA_UInt32 currentChannelCount;
     UA_UInt32 lastChannelId;
     UA_UInt32 lastTokenId;
     UA_Server *server;
+
+    /* Hashed lookup by channelId. The number of buckets is a power of two and
+     * fixed at init from the config maxSecureChannels. */
+    size_t bucketsSize;
+    struct channel_bucket *buckets;
 } UA_SecureChannelManager;
 
 UA_StatusCode
@@ -183,9 +183,9 @@ void UA_Server_delete(UA_Server *server) {
 #ifdef UA_ENABLE_MULTITHREADING
     /* Process new delayed callbacks from the cleanup */
     UA_Server_cleanupDispatchQueue(server);
-    pthread_mutex_destroy(&server->dispatchQueue_accessMutex);
-    pthread_cond_destroy(&server->dispatchQueue_condition);
-    pthread_mutex_destroy(&server->dispatchQueue_conditionMutex);
+    pthread_mutex_destroy(&server->dispatchMutex);
+    pthread_mutex_destroy(&server->idleMutex);
+    pthread_key_delete(server->workerKey);
 #else
     /* Process new delayed callbacks from the cleanup */
     UA_Server_cleanupDelayedCallbacks(server);
@@ -194,6 +194,12 @@ void UA_Server_delete(UA_Server *server) {
     /* Delete the timed work */
     UA_Timer_deleteMembers(&server->timer);
 
+    UA_CustomTypesIndex_deleteMembers(&server->customTypesIndex);
+    UA_SubtypeCache_deleteMembers(&server->subtypeCache);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    UA_EventNotifierCache_deleteMembers(&server->eventNotifierCache);
+#endif
+
     /* Delete the server itself */
     UA_free(server);
 }
@@ -234,6 +240,12 @@ UA_Server_new(const UA_ServerConfig *config) {
     /* Set the config */
     server->config = *config;
 
+    /* Index the custom data types. Without the index (out of memory), the
+     * custom types are scanned during decoding. */
+    UA_CustomTypesIndex_init(&server->customTypesIndex,
+                             server->config.customDataTypesSize,
+                             server->config.customDataTypes);
+
     /* Init start time to zero, the actual start time will be sampled in
      * UA_Server_run_startup() */
     server->startTime = 0;
@@ -247,13 +259,11 @@ UA_Server_new(const UA_ServerConfig *config) {
     UA_Timer_init(&server->timer);
 
     /* Initialized the linked list for delayed callbacks */
-#ifndef UA_ENABLE_MULTITHREADING
     SLIST_INIT(&server->delayedCallbacks);
-#endif
 
-    /* Initialized the dispatch queue for worker threads */
+    /* Initialized the dispatching to worker threads */
 #ifdef UA_ENABLE_MULTITHREADING
-    SIMPLEQ_INIT(&server->dispatchQueue);
+    UA_Server_initDispatch(server);
 #endif
 
     /* Create Namespaces 0 and 1 */
@@ -170,6 +170,14 @@ getServicePointers(UA_UInt32 requestTypeId, const UA_DataType **requestType,
         *responseType = &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSRESPONSE];
         break;
 
+#ifdef UA_ENABLE_HISTORIZING
+    case UA_NS0ID_HISTORYREADREQUEST_ENCODING_DEFAULTBINARY:
+        *service = (UA_Service)Service_HistoryRead;
+        *requestType = &UA_TYPES[UA_TYPES_HISTORYREADREQUEST];
+        *responseType = &UA_TYPES[UA_TYPES_HISTORYREADRESPONSE];
+        break;
+#endif
+
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     case UA_NS0ID_CREATESUBSCRIPTIONREQUEST_ENCODING_DEFAULTBINARY:
         *service = (UA_Service)Service_CreateSubscription;
@@ -424,13 +432,16 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     }
     UA_assert(responseType);
 
-    /* Decode the request */
+    /* Decode the request. The members are allocated from the arena of the
+     * SecureChannel and released all at once with UA_Arena_reset. Strings and
+     * ByteStrings point into the message. Both outlive the service call. The
+     * services copy what they keep. */
     UA_STACKARRAY(UA_Byte, request, requestType->memSize);
     UA_RequestHeader *requestHeader = (UA_RequestHeader*)request;
-    retval = UA_decodeBinary(msg, &offset, request, requestType,
-                             server->config.customDataTypesSize,
-                             server->config.customDataTypes);
+    retval = UA_decodeBinaryArena(msg, &offset, request, requestType,
+                                  &server->customTypesIndex, &channel->requestArena, true);
     if(retval != UA_STATUSCODE_GOOD) {
+        UA_Arena_reset(&channel->requestArena);
         UA_LOG_DEBUG_CHANNEL(server->config.logger, channel,
                              "Could not decode the request");
         return sendServiceFault(channel, msg, requestPos, responseType, requestId, retval);
@@ -458,9 +469,8 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
 
     #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     // set the authenticationToken from the create session request to help fuzzing cover more lines
-    UA_NodeId_deleteMembers(&requestHeader->authenticationToken);
-    if(!UA_NodeId_isNull(&unsafe_fuzz_authenticationToken))
-        UA_NodeId_copy(&unsafe_fuzz_authenticationToken, &requestHeader->authenticationToken);
+    // the token is not copied, as the request memory is released with the arena
+    requestHeader->authenticationToken = unsafe_fuzz_authenticationToken;
     #endif
 
     /* Find the matching session */
@@ -474,7 +484,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
             UA_LOG_DEBUG_CHANNEL(server->config.logger, channel,
                                  "Trying to activate a session that is " \
                                  "not known in the server");
-            UA_deleteMembers(request, requestType);
+            UA_Arena_reset(&channel->requestArena);
             return sendServiceFault(channel, msg, requestPos, responseType,
                                     requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
         }
@@ -491,7 +501,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
             UA_LOG_WARNING_CHANNEL(server->config.logger, channel,
                                    "Service request %i without a valid session",
                                    requestType->binaryEncodingId);
-            UA_deleteMembers(request, requestType);
+            UA_Arena_reset(&channel->requestArena);
             return sendServiceFault(channel, msg, requestPos, responseType,
                                     requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
         }
@@ -509,7 +519,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
                                requestType->binaryEncodingId);
         UA_SessionManager_removeSession(&server->sessionManager,
                                         &session->header.authenticationToken);
-        UA_deleteMembers(request, requestType);
+        UA_Arena_reset(&channel->requestArena);
         return sendServiceFault(channel, msg, requestPos, responseType,
                                 requestId, UA_STATUSCODE_BADSESSIONNOTACTIVATED);
     }
@@ -519,7 +529,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
         UA_LOG_WARNING_CHANNEL(server->config.logger, channel,
                                "Client tries to use a Session that is not "
                                "bound to this SecureChannel");
-        UA_deleteMembers(request, requestType);
+        UA_Arena_reset(&channel->requestArena);
         return sendServiceFault(channel, msg, requestPos, responseType,
                                 requestId, UA_STATUSCODE_BADSESSIONNOTACTIVATED);
     }
@@ -532,7 +542,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     if(requestType == &UA_TYPES[UA_TYPES_PUBLISHREQUEST]) {
         Service_Publish(server, session,
             (const UA_PublishRequest*)request, requestId);
-        UA_deleteMembers(request, requestType);
+        UA_Arena_reset(&channel->requestArena);
         return UA_STATUSCODE_GOOD;
     }
 #endif
@@ -588,7 +598,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
                             "Could not send the message over the SecureChannel "
                             "with StatusCode %s", UA_StatusCode_name(retval));
     /* Clean up */
-    UA_deleteMembers(request, requestType);
+    UA_Arena_reset(&channel->requestArena);
     UA_deleteMembers(response, responseType);
     return retval;
 }
@@ -769,6 +779,7 @@ UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection,
 #else
 
 typedef struct {
+    UA_StrandCallback sc;
     UA_Connection *connection;
     UA_ByteString message;
 } ConnectionMessage;
@@ -779,27 +790,66 @@ workerProcessBinaryMessage(UA_Server *server, ConnectionMessage *cm) {
     UA_free(cm);
 }
 
+/* The network layer releases the message buffer when this function returns.
+ * So the message is copied for the worker. The copy is placed behind the
+ * callback data in the same allocation.
+ *
+ * The messages of a connection are processed in order in the strand of the
+ * connection. Otherwise, the chunks of a message could be reassembled in the
+ * wrong order and the sequence numbers of the SecureChannel would not match.
+ * Messages from different connections are processed in parallel. */
 void
 UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection,
                                UA_ByteString *message) {
+    /* The strand is created with the first message. It is deleted together
+     * with the connection. */
+    if(!connection->strand)
+        connection->strand = UA_Strand_new();
+
     /* Allocate the memory for the callback data */
-    ConnectionMessage *cm = (ConnectionMessage*)UA_malloc(sizeof(ConnectionMessage));
+    ConnectionMessage *cm = NULL;
+    if(connection->strand)
+        cm = (ConnectionMessage*)UA_malloc(sizeof(ConnectionMessage) + message->length);
 
-    /* If malloc failed, execute immediately */
+    /* Out of memory. The message cannot be processed in order. */
     if(!cm) {
-        processBinaryMessage(server, connection, message);
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_NETWORK,
+                     "Connection %i | Cannot queue the message. "
+                     "Closing the connection.", connection->sockfd);
+        connection->close(connection);
         return;
     }
 
-    /* Dispatch to the workers */
+    /* Dispatch to the strand of the connection */
+    cm->sc.callback = (UA_ServerCallback)workerProcessBinaryMessage;
+    cm->sc.data = cm;
     cm->connection = connection;
-    cm->message = *message;
-    UA_Server_workerCallback(server, (UA_ServerCallback)workerProcessBinaryMessage, cm);
+    cm->message.length = message->length;
+    cm->message.data = (UA_Byte*)cm + sizeof(ConnectionMessage);
+    memcpy(cm->message.data, message->data, message->length);
+    UA_Server_strandCallback(server, (UA_Strand*)connection->strand, &cm->sc);
 }
 
 static void
 deleteConnectionTrampoline(UA_Server *server, void *data) {
     UA_Connection *connection = (UA_Connection*)data;
+    /* The strand is processed in batches. Wait for the remaining messages.
+     * Never free the strand and the connection while a worker uses them. If
+     * the callback cannot be added again, the connection is leaked. */
+    if(connection->strand && !UA_Strand_isIdle((UA_Strand*)connection->strand)) {
+        UA_StatusCode retval =
+            UA_Server_delayedCallback(server, deleteConnectionTrampoline, connection);
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_NETWORK,
+                         "Connection %i | Cannot delay the removal with StatusCode %s. "
+                         "The connection is not freed.", connection->sockfd,
+                         UA_StatusCode_name(retval));
+        return;
+    }
+    if(connection->strand) {
+        UA_Strand_delete((UA_Strand*)connection->strand);
+        connection->strand = NULL;
+    }
     connection->free(connection);
 }
 #endif
@@ -22,6 +22,7 @@ extern "C" {
 #include "ua_server.h"
 #include "ua_server_config.h"
 #include "ua_timer.h"
+#include "ua_types_encoding_binary.h"
 #include "ua_connection_internal.h"
 #include "ua_session_manager.h"
 #include "ua_securechannel_manager.h"
@@ -51,11 +52,11 @@ typedef struct {
 struct UA_Worker;
 typedef struct UA_Worker UA_Worker;
 
-struct UA_WorkerCallback;
-typedef struct UA_WorkerCallback UA_WorkerCallback;
+struct UA_WorkDeque;
+typedef struct UA_WorkDeque UA_WorkDeque;
 
-SIMPLEQ_HEAD(UA_DispatchQueue, UA_WorkerCallback);
-typedef struct UA_DispatchQueue UA_DispatchQueue;
+struct UA_Strand;
+typedef struct UA_Strand UA_Strand;
 
 #endif /* UA_ENABLE_MULTITHREADING */
 
@@ -95,6 +96,56 @@ typedef struct serverOnNetwork_hash_entry {
 #endif /* UA_ENABLE_DISCOVERY_MULTICAST */
 #endif /* UA_ENABLE_DISCOVERY */
 
+/* Cached closure of the HasSubtype hierarchy. Every type node in the cache has
+ * a bit position. The supertypes of a type (including itself) are a bitset over
+ * these positions. The bitset is computed on first use and dropped when a
+ * HasSubtype reference of the type or one of its supertypes changes. */
+typedef struct UA_SubtypeEntry {
+    ZIP_ENTRY(UA_SubtypeEntry) zipfields;
+    UA_NodeId nodeId;
+    size_t index;           /* Bit position of the type */
+    UA_Boolean computing;   /* Detect cycles in the hierarchy */
+    size_t supertypesSize;  /* Length of the bitset in bytes */
+    UA_Byte *supertypes;    /* NULL if not computed */
+} UA_SubtypeEntry;
+
+ZIP_HEAD(UA_SubtypeTree, UA_SubtypeEntry);
+
+typedef struct {
+    struct UA_SubtypeTree entries;
+    size_t entriesSize;
+} UA_SubtypeCache;
+
+void UA_SubtypeCache_deleteMembers(UA_SubtypeCache *cache);
+
+/* Drops the cached supertypes of the type and of all its subtypes */
+void UA_SubtypeCache_invalidate(UA_SubtypeCache *cache, const UA_NodeId *typeId);
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+
+/* Cached receivers of the events of an origin node. These are the origin and
+ * its ancestors via hierarchical references. An entry is dropped when a
+ * hierarchical reference to one of the nodes in the chain changes. */
+typedef struct UA_EventNotifierEntry {
+    ZIP_ENTRY(UA_EventNotifierEntry) zipfields;
+    UA_NodeId origin;
+    size_t notifiersSize;
+    UA_NodeId *notifiers;
+} UA_EventNotifierEntry;
+
+ZIP_HEAD(UA_EventNotifierTree, UA_EventNotifierEntry);
+
+typedef struct {
+    struct UA_EventNotifierTree entries;
+} UA_EventNotifierCache;
+
+void UA_EventNotifierCache_deleteMembers(UA_EventNotifierCache *cache);
+
+/* Drops the entries that contain the node in their chain */
+void UA_EventNotifierCache_invalidate(UA_EventNotifierCache *cache, const UA_NodeId *nodeId);
+
+#endif
+
 struct UA_Server {
     /* Meta */
     UA_DateTime startTime;
@@ -140,6 +191,21 @@ struct UA_Server {
     size_t namespacesSize;
     UA_String *namespaces;
 
+    /* Lookup of the custom data types from the config during decoding */
+    UA_CustomTypesIndex customTypesIndex;
+
+    /* Lookup of the HasSubtype hierarchy */
+    UA_SubtypeCache subtypeCache;
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    /* Lookup of the nodes that receive the events of an origin */
+    UA_EventNotifierCache eventNotifierCache;
+#endif
+
+    /* Source for the version of edited VariableNodes. The versions are unique
+     * also for nodes that are removed and added again. */
+    volatile UA_UInt32 valueVersion;
+
     /* Callbacks with a repetition interval */
     UA_Timer timer;
 
@@ -149,10 +215,19 @@ struct UA_Server {
     /* Worker threads */
 #ifdef UA_ENABLE_MULTITHREADING
     UA_Worker *workers; /* there are nThread workers in a running server */
-    UA_DispatchQueue dispatchQueue; /* Dispatch queue for the worker threads */
-    pthread_mutex_t dispatchQueue_accessMutex; /* mutex for access to queue */
-    pthread_cond_t dispatchQueue_condition; /* so the workers don't spin if the queue is empty */
-    pthread_mutex_t dispatchQueue_conditionMutex; /* mutex for access to condition variable */
+    UA_WorkDeque *dispatchDeque; /* Callbacks dispatched outside of the workers */
+    pthread_mutex_t dispatchMutex; /* Serialize dispatching outside of the workers */
+    pthread_key_t workerKey; /* Thread-local pointer to the current worker */
+
+    /* Idle workers wait for a targeted wakeup */
+    LIST_HEAD(UA_IdleWorkers, UA_Worker) idleWorkers;
+    volatile size_t idleWorkersSize;
+    pthread_mutex_t idleMutex;
+
+    /* Epochs for the delayed callbacks */
+    volatile UA_UInt32 epoch;
+    volatile size_t epochCallbacks[2]; /* Unfinished callbacks per epoch parity */
+    struct UA_DelayedCallback * volatile delayedCallbacksNew; /* Lock-free stack */
 #endif
 
     /* For bootstrapping, omit some consistency checks, creating a reference to
@@ -163,6 +238,9 @@ struct UA_Server {
     /* To be cast to UA_LocalMonitoredItem to get the callback and context */
     LIST_HEAD(LocalMonitoredItems, UA_MonitoredItem) localMonitoredItems;
     UA_UInt32 lastLocalMonitoredItemId;
+
+    /* Nodes with MonitoredItems that are sampled on write */
+    struct UA_MonitoredNodeTree monitoredNodes;
 #endif
 
 #ifdef UA_ENABLE_PUBSUB
@@ -226,7 +304,34 @@ UA_Server_delayedFree(UA_Server *server, void *data);
  * finished previous work */
 void UA_Server_cleanupDelayedCallbacks(UA_Server *server);
 #else
+/* Initialize the synchronization primitives for the dispatching */
+void UA_Server_initDispatch(UA_Server *server);
+
+/* Execute all remaining (delayed) callbacks. The workers need to be stopped. */
 void UA_Server_cleanupDispatchQueue(UA_Server *server);
+
+/* The callbacks of a strand are executed one after the other in the order they
+ * were dispatched. Different strands are processed in parallel. The
+ * descriptor is owned by the caller and needs to remain valid until the
+ * callback is executed. Usually it is a member of the callback data. */
+typedef struct UA_StrandCallback {
+    struct UA_StrandCallback *next;
+    UA_ServerCallback callback;
+    void *data;
+} UA_StrandCallback;
+
+UA_Strand * UA_Strand_new(void);
+
+/* All callbacks of the strand need to be finished. For example, delete the
+ * strand in a delayed callback once the strand is idle. */
+void UA_Strand_delete(UA_Strand *strand);
+
+/* No callbacks are queued or executed in the strand */
+UA_Boolean UA_Strand_isIdle(UA_Strand *strand);
+
+void
+UA_Server_strandCallback(UA_Server *server, UA_Strand *strand,
+                         UA_StrandCallback *sc);
 #endif
 
 /* Callback is executed in the same thread or, if possible, dispatched to one of
@@ -247,12 +352,23 @@ UA_UInt16 addNamespace(UA_Server *server, const UA_String name);
 UA_Boolean
 UA_Node_hasSubTypeOrInstances(const UA_Node *node);
 
+/* Order of NodeIds for the zip trees */
+enum ZIP_CMP
+cmpNodeId(const UA_NodeId *a, const UA_NodeId *b);
+
+#define UA_MAX_TREE_RECURSE 50 /* How deep up/down the tree do we recurse at most? */
+
 /* Recursively searches "upwards" in the tree following specific reference types */
 UA_Boolean
 isNodeInTree(UA_Nodestore *ns, const UA_NodeId *leafNode,
              const UA_NodeId *nodeToFind, const UA_NodeId *referenceTypeIds,
              size_t referenceTypeIdsSize);
 
+/* Same as isNodeInTree following only HasSubtype references. Uses the
+ * subtype cache of the server. */
+UA_Boolean
+isSubtypeOf(UA_Server *server, const UA_NodeId *type, const UA_NodeId *superType);
+
 /* Returns an array with the hierarchy of type nodes. The returned array starts
  * at the leaf and continues "upwards" in the hierarchy based on the
  * ``hasSubType`` references. Since multiple-inheritance is possible in general,
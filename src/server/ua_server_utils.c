@@ -12,8 +12,6 @@
 
 #include "ua_server_internal.h"
 
-#define UA_MAX_TREE_RECURSE 50 /* How deep up/down the tree do we recurse at most? */
-
 /********************************/
 /* Information Model Operations */
 /********************************/
@@ -100,6 +98,194 @@ isNodeInTree(UA_Nodestore *ns, const UA_NodeId *leafNode, const UA_NodeId *nodeT
     return isNodeInTreeNoCircular(ns, leafNode, nodeToFind, &visitedRefs, referenceTypeIds, referenceTypeIdsSize);
 }
 
+enum ZIP_CMP
+cmpNodeId(const UA_NodeId *a, const UA_NodeId *b) {
+    if(a->namespaceIndex != b->namespaceIndex)
+        return (a->namespaceIndex < b->namespaceIndex) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->identifierType != b->identifierType)
+        return (a->identifierType < b->identifierType) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    int c = 0;
+    switch(a->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if(a->identifier.numeric != b->identifier.numeric)
+            return (a->identifier.numeric < b->identifier.numeric) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+        return ZIP_CMP_EQ;
+    case UA_NODEIDTYPE_GUID:
+        c = memcmp(&a->identifier.guid, &b->identifier.guid, sizeof(UA_Guid));
+        break;
+    case UA_NODEIDTYPE_STRING:
+    case UA_NODEIDTYPE_BYTESTRING:
+        if(a->identifier.string.length != b->identifier.string.length)
+            return (a->identifier.string.length < b->identifier.string.length) ?
+                ZIP_CMP_LESS : ZIP_CMP_MORE;
+        if(a->identifier.string.length > 0)
+            c = memcmp(a->identifier.string.data, b->identifier.string.data,
+                       a->identifier.string.length);
+        break;
+    }
+    if(c == 0)
+        return ZIP_CMP_EQ;
+    return (c < 0) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+/*****************/
+/* Subtype Cache */
+/*****************/
+
+ZIP_IMPL(UA_SubtypeTree, UA_SubtypeEntry, zipfields, UA_NodeId, nodeId, cmpNodeId)
+
+static UA_Boolean
+hasSupertype(const UA_SubtypeEntry *e, size_t index) {
+    if(index >= e->supertypesSize * 8)
+        return false;
+    return (e->supertypes[index / 8] >> (index % 8)) & 0x01;
+}
+
+/* The cache is changed during the lookup. So it is not used from the worker
+ * threads. */
+#ifndef UA_ENABLE_MULTITHREADING
+
+static UA_SubtypeEntry *
+getSubtypeEntry(UA_SubtypeCache *cache, const UA_NodeId *nodeId) {
+    UA_SubtypeEntry *e = UA_SubtypeTree_ZIP_FIND(&cache->entries, nodeId);
+    if(e)
+        return e;
+    e = (UA_SubtypeEntry*)UA_calloc(1, sizeof(UA_SubtypeEntry));
+    if(!e)
+        return NULL;
+    if(UA_NodeId_copy(nodeId, &e->nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(e);
+        return NULL;
+    }
+    e->index = cache->entriesSize;
+    ++cache->entriesSize;
+    UA_SubtypeTree_ZIP_INSERT(&cache->entries, e);
+    return e;
+}
+
+/* Computes the supertypes from the supertypes of the direct parents. Returns
+ * false for cycles, too deep hierarchies and if out of memory. Then nothing is
+ * cached for the type. */
+static UA_Boolean
+computeSupertypes(UA_Server *server, UA_SubtypeEntry *e, size_t depth) {
+    if(e->supertypes)
+        return true;
+    if(e->computing || depth >= UA_MAX_TREE_RECURSE)
+        return false;
+
+    UA_SubtypeCache *cache = &server->subtypeCache;
+    const UA_Node *node = UA_Nodestore_get(server, &e->nodeId);
+    UA_Boolean complete = true;
+    e->computing = true;
+
+    /* Compute the parents first. This assigns a bit position to all
+     * supertypes. */
+    for(size_t i = 0; node && i < node->referencesSize; ++i) {
+        UA_NodeReferenceKind *refs = &node->references[i];
+        if(!refs->isInverse || !UA_NodeId_equal(&refs->referenceTypeId, &subtypeId))
+            continue;
+        for(size_t j = 0; j < refs->targetIdsSize; ++j) {
+            UA_SubtypeEntry *parent = getSubtypeEntry(cache, &refs->targetIds[j].nodeId);
+            if(!parent || !computeSupertypes(server, parent, depth + 1)) {
+                complete = false;
+                goto cleanup;
+            }
+        }
+    }
+
+    size_t supertypesSize = (cache->entriesSize + 7) / 8;
+    e->supertypes = (UA_Byte*)UA_calloc(supertypesSize, sizeof(UA_Byte));
+    if(!e->supertypes) {
+        complete = false;
+        goto cleanup;
+    }
+    e->supertypesSize = supertypesSize;
+    e->supertypes[e->index / 8] |= (UA_Byte)(0x01 << (e->index % 8));
+
+    /* Merge the supertypes of the parents */
+    for(size_t i = 0; node && i < node->referencesSize; ++i) {
+        UA_NodeReferenceKind *refs = &node->references[i];
+        if(!refs->isInverse || !UA_NodeId_equal(&refs->referenceTypeId, &subtypeId))
+            continue;
+        for(size_t j = 0; j < refs->targetIdsSize; ++j) {
+            const UA_SubtypeEntry *parent =
+                UA_SubtypeTree_ZIP_FIND(&cache->entries, &refs->targetIds[j].nodeId);
+            for(size_t k = 0; k < parent->supertypesSize; ++k)
+                e->supertypes[k] |= parent->supertypes[k];
+        }
+    }
+
+ cleanup:
+    e->computing = false;
+    if(node)
+        UA_Nodestore_release(server, node);
+    return complete;
+}
+
+#endif /* UA_ENABLE_MULTITHREADING */
+
+UA_Boolean
+isSubtypeOf(UA_Server *server, const UA_NodeId *type, const UA_NodeId *superType) {
+    if(UA_NodeId_equal(type, superType))
+        return true;
+
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_SubtypeCache *cache = &server->subtypeCache;
+    UA_SubtypeEntry *e = UA_SubtypeTree_ZIP_FIND(&cache->entries, type);
+    if(!e) {
+        /* Don't add unknown NodeIds (e.g. from a request) to the cache */
+        const UA_Node *node = UA_Nodestore_get(server, type);
+        if(!node)
+            return false;
+        UA_Nodestore_release(server, node);
+        e = getSubtypeEntry(cache, type);
+    }
+
+    if(e && computeSupertypes(server, e, 0)) {
+        /* A supertype without an entry has not been seen when computing the
+         * supertypes of the type */
+        const UA_SubtypeEntry *s = UA_SubtypeTree_ZIP_FIND(&cache->entries, superType);
+        return (s && hasSupertype(e, s->index));
+    }
+#endif
+
+    return isNodeInTree(&server->config.nodestore, type, superType, &subtypeId, 1);
+}
+
+static void
+dropSupertypes(UA_SubtypeEntry *e, void *data) {
+    const UA_SubtypeEntry *changed = (const UA_SubtypeEntry*)data;
+    if(!e->supertypes || !hasSupertype(e, changed->index))
+        return;
+    UA_free(e->supertypes);
+    e->supertypes = NULL;
+    e->supertypesSize = 0;
+}
+
+void
+UA_SubtypeCache_invalidate(UA_SubtypeCache *cache, const UA_NodeId *typeId) {
+    /* The type has no bit position. So it is not contained in any of the
+     * cached supertypes. */
+    UA_SubtypeEntry *changed = UA_SubtypeTree_ZIP_FIND(&cache->entries, typeId);
+    if(!changed)
+        return;
+    UA_SubtypeTree_ZIP_ITER(&cache->entries, dropSupertypes, changed);
+}
+
+static void
+deleteSubtypeEntry(UA_SubtypeEntry *e, void *_) {
+    UA_NodeId_deleteMembers(&e->nodeId);
+    UA_free(e->supertypes);
+    UA_free(e);
+}
+
+void
+UA_SubtypeCache_deleteMembers(UA_SubtypeCache *cache) {
+    UA_SubtypeTree_ZIP_ITER(&cache->entries, deleteSubtypeEntry, NULL);
+    ZIP_INIT(&cache->entries);
+    cache->entriesSize = 0;
+}
+
 const UA_Node *
 getNodeType(UA_Server *server, const UA_Node *node) {
     /* The reference to the parent is different for variable and variabletype */
@@ -271,6 +457,27 @@ getTypeHierarchy(UA_Nodestore *ns, const UA_NodeId *leafType,
     return UA_STATUSCODE_GOOD;
 }
 
+/* Sampling MonitoredItems skip VariableNodes whose version did not change.
+ * Returns whether the node is a VariableNode. */
+static UA_Boolean
+updateValueVersion(UA_Server *server, UA_Node *node) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE)
+        return false;
+    UA_UInt32 version = UA_atomic_addUInt32(&server->valueVersion, 1);
+    if(version == 0) /* Zero is reserved for unversioned nodes */
+        version = UA_atomic_addUInt32(&server->valueVersion, 1);
+    ((UA_VariableNode*)node)->valueVersion = version;
+    return true;
+}
+
+/* Sample the MonitoredItems that wait for a write */
+static void
+notifyWrite(UA_Server *server, const UA_NodeId *nodeId) {
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_MonitoredNode_notifyWrite(server, nodeId);
+#endif
+}
+
 /* For mulithreading: make a copy of the node, edit and replace.
  * For singlethreading: edit the original */
 UA_StatusCode
@@ -283,10 +490,14 @@ UA_Server_editNode(UA_Server *server, UA_Session *session,
     if(!node)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     UA_StatusCode retval = callback(server, session, (UA_Node*)(uintptr_t)node, data);
+    /* The callback may have changed the node also when it failed */
+    if(updateValueVersion(server, (UA_Node*)(uintptr_t)node))
+        notifyWrite(server, nodeId);
     UA_Nodestore_release(server, node);
     return retval;
 #else
     UA_StatusCode retval;
+    UA_Boolean isVariable;
     do {
         /* Get an editable copy of the node */
         UA_Node *node;
@@ -303,8 +514,11 @@ UA_Server_editNode(UA_Server *server, UA_Session *session,
         }
 
         /* Replace the node */
+        isVariable = updateValueVersion(server, node);
         retval = server->config.nodestore.replaceNode(server->config.nodestore.context, node);
     } while(retval != UA_STATUSCODE_GOOD);
+    if(isVariable)
+        notifyWrite(server, nodeId);
     return retval;
 #endif
 }
@@ -24,79 +24,330 @@
 #define UA_MAXTIMEOUT 50 /* Max timeout in ms between main-loop iterations */
 
 /**
- * Worker Threads and Dispatch Queue
- * ---------------------------------
- * The worker threads dequeue callbacks from a central Multi-Producer
- * Multi-Consumer Queue (MPMC). When there are no callbacks, workers go idle.
- * The condition to wake them up is triggered whenever a callback is
- * dispatched.
+ * Worker Threads and Work-Stealing
+ * --------------------------------
+ * Every worker thread owns a work-stealing deque. Callbacks that are dispatched
+ * from a worker are pushed to its own deque. Callbacks dispatched from other
+ * threads (usually the main loop that processes the network layer and the
+ * timer) are pushed to a shared dispatch deque. The owner pushes and takes at
+ * the bottom of its deque. Idle workers steal from the top of the dispatch
+ * deque and the deques of the other workers. The deque is lock-free and based
+ * on the design from
+ *
+ * Chase, David, and Yossi Lev. "Dynamic circular work-stealing deque."
+ * Proceedings of the seventeenth annual ACM symposium on Parallelism in
+ * algorithms and architectures. ACM, 2005.
  *
- * Future Plans: Use work-stealing to load-balance between cores.
  * Le, Nhat Minh, et al. "Correct and efficient work-stealing for weak memory
- * models." ACM SIGPLAN Notices. Vol. 48. No. 8. ACM, 2013. */
+ * models." ACM SIGPLAN Notices. Vol. 48. No. 8. ACM, 2013.
+ *
+ * The atomic operations are implemented with full memory barriers.
+ *
+ * When no work is found, a worker adds itself to the list of idle workers and
+ * waits on its own condition. Dispatching a callback wakes up a single idle
+ * worker (if any).
+ *
+ * The descriptors of the dispatched callbacks are pooled. Every deque has a
+ * pool of descriptors that is only used by its owner (the dispatching thread).
+ * The descriptors are returned by the executing thread to a lock-free stack of
+ * the home deque. The owner takes the entire stack when its pool is empty. So
+ * there is no ABA problem. */
 
 #ifdef UA_ENABLE_MULTITHREADING
 
+#define UA_WORKDEQUE_INITIALSIZE 64
+
+struct UA_WorkerCallback;
+typedef struct UA_WorkerCallback UA_WorkerCallback;
+
+struct UA_WorkerCallback {
+    UA_WorkerCallback *next; /* In the descriptor pool */
+    UA_WorkDeque *home;      /* Return the descriptor to this pool */
+    UA_ServerCallback callback;
+    void *data;
+    UA_Byte epoch;           /* Parity of the epoch when dispatched */
+};
+
+/* Circular buffer of the deque. The buffer is only grown by the owner. Old
+ * buffers can still be accessed by stealing threads and are freed together
+ * with the deque. */
+typedef struct UA_WorkDequeArray {
+    struct UA_WorkDequeArray *retired;
+    size_t size; /* Power of two */
+    UA_WorkerCallback *buf[];
+} UA_WorkDequeArray;
+
+struct UA_WorkDeque {
+    volatile size_t top;
+    volatile size_t bottom;
+    UA_WorkDequeArray * volatile array;
+
+    /* Descriptor pool */
+    UA_WorkerCallback *pool;
+    UA_WorkerCallback * volatile poolReturned;
+};
+
 struct UA_Worker {
     UA_Server *server;
     pthread_t thr;
-    UA_UInt32 counter;
     volatile UA_Boolean running;
 
+    UA_WorkDeque deque;
+
+    /* Wait for a targeted wakeup */
+    LIST_ENTRY(UA_Worker) idleEntry;
+    UA_Boolean idle;
+    pthread_cond_t wakeup;
+
     /* separate cache lines */
-    char padding[64 - sizeof(void*) - sizeof(pthread_t) -
-                 sizeof(UA_UInt32) - sizeof(UA_Boolean)];
+    char padding[64];
 };
 
-struct UA_WorkerCallback {
-    SIMPLEQ_ENTRY(UA_WorkerCallback) next;
-    UA_ServerCallback callback;
-    void *data;
+static UA_StatusCode
+UA_WorkDeque_init(UA_WorkDeque *d) {
+    memset(d, 0, sizeof(UA_WorkDeque));
+    UA_WorkDequeArray *a = (UA_WorkDequeArray*)
+        UA_malloc(sizeof(UA_WorkDequeArray) +
+                  (sizeof(UA_WorkerCallback*) * UA_WORKDEQUE_INITIALSIZE));
+    if(!a)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    a->retired = NULL;
+    a->size = UA_WORKDEQUE_INITIALSIZE;
+    d->array = a;
+    /* Start at 1. So that bottom - 1 never underflows in _take. */
+    d->top = 1;
+    d->bottom = 1;
+    return UA_STATUSCODE_GOOD;
+}
 
-    UA_Boolean delayed;         /* Is it a delayed callback? */
-    UA_Boolean countersSampled; /* Have the worker counters been sampled? */
-    UA_UInt32 workerCounters[]; /* Counter value for each worker */
-};
-typedef struct UA_WorkerCallback WorkerCallback;
+static void
+UA_WorkDeque_deleteMembers(UA_WorkDeque *d) {
+    UA_WorkDequeArray *a = d->array;
+    while(a) {
+        UA_WorkDequeArray *retired = a->retired;
+        UA_free(a);
+        a = retired;
+    }
+    d->array = NULL;
+
+    UA_WorkerCallback *dc = d->pool;
+    while(dc) {
+        UA_WorkerCallback *next = dc->next;
+        UA_free(dc);
+        dc = next;
+    }
+    dc = d->poolReturned;
+    while(dc) {
+        UA_WorkerCallback *next = dc->next;
+        UA_free(dc);
+        dc = next;
+    }
+    d->pool = NULL;
+    d->poolReturned = NULL;
+}
+
+/* Only the owner */
+static UA_StatusCode
+UA_WorkDeque_push(UA_WorkDeque *d, UA_WorkerCallback *dc) {
+    size_t b = d->bottom;
+    size_t t = d->top;
+    UA_WorkDequeArray *a = d->array;
+
+    /* Grow the buffer */
+    if(b - t >= a->size) {
+        UA_WorkDequeArray *newa = (UA_WorkDequeArray*)
+            UA_malloc(sizeof(UA_WorkDequeArray) +
+                      (sizeof(UA_WorkerCallback*) * a->size * 2));
+        if(!newa)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        newa->retired = a;
+        newa->size = a->size * 2;
+        for(size_t i = t; i < b; i++)
+            newa->buf[i & (newa->size - 1)] = a->buf[i & (a->size - 1)];
+        UA_atomic_sync();
+        d->array = newa;
+        a = newa;
+    }
+
+    a->buf[b & (a->size - 1)] = dc;
+    UA_atomic_sync(); /* The entry is visible before bottom is increased */
+    d->bottom = b + 1;
+    return UA_STATUSCODE_GOOD;
+}
 
-/* Forward Declaration */
+/* Only the owner */
+static UA_WorkerCallback *
+UA_WorkDeque_take(UA_WorkDeque *d) {
+    size_t b = d->bottom - 1;
+    UA_WorkDequeArray *a = d->array;
+    d->bottom = b;
+    UA_atomic_sync();
+    size_t t = d->top;
+    if(t > b) {
+        /* Empty */
+        d->bottom = b + 1;
+        return NULL;
+    }
+
+    UA_WorkerCallback *dc = a->buf[b & (a->size - 1)];
+    if(t == b) {
+        /* The last element. Race against the stealing threads. */
+        if(UA_atomic_cmpxchgSize(&d->top, t, t + 1) != t)
+            dc = NULL;
+        d->bottom = b + 1;
+    }
+    return dc;
+}
+
+/* Every thread. Can return NULL if the deque is not empty but another thread
+ * was faster. */
+static UA_WorkerCallback *
+UA_WorkDeque_steal(UA_WorkDeque *d) {
+    size_t t = d->top;
+    UA_atomic_sync();
+    size_t b = d->bottom;
+    if(t >= b)
+        return NULL;
+    UA_atomic_sync();
+    UA_WorkDequeArray *a = d->array;
+    UA_WorkerCallback *dc = a->buf[t & (a->size - 1)];
+    if(UA_atomic_cmpxchgSize(&d->top, t, t + 1) != t)
+        return NULL;
+    return dc;
+}
+
+static UA_Boolean
+UA_WorkDeque_isEmpty(const UA_WorkDeque *d) {
+    return (d->top >= d->bottom);
+}
+
+/* Only the owner */
+static UA_WorkerCallback *
+UA_WorkDeque_allocCallback(UA_WorkDeque *d) {
+    UA_WorkerCallback *dc = d->pool;
+    if(!dc) {
+        dc = (UA_WorkerCallback*)
+            UA_atomic_xchg((void * volatile *)&d->poolReturned, NULL);
+        if(!dc) {
+            dc = (UA_WorkerCallback*)UA_malloc(sizeof(UA_WorkerCallback));
+            if(!dc)
+                return NULL;
+            dc->home = d;
+            return dc;
+        }
+    }
+    d->pool = dc->next;
+    return dc;
+}
+
+/* Every thread */
 static void
-processDelayedCallback(UA_Server *server, WorkerCallback *dc);
+UA_WorkDeque_releaseCallback(UA_WorkerCallback *dc) {
+    UA_WorkDeque *d = dc->home;
+    UA_WorkerCallback *old;
+    do {
+        old = d->poolReturned;
+        dc->next = old;
+    } while(UA_atomic_cmpxchg((void * volatile *)&d->poolReturned,
+                              old, dc) != old);
+}
+
+static UA_Boolean
+hasWork(UA_Server *server) {
+    if(!UA_WorkDeque_isEmpty(server->dispatchDeque))
+        return true;
+    for(size_t i = 0; i < server->config.nThreads; ++i) {
+        if(!UA_WorkDeque_isEmpty(&server->workers[i].deque))
+            return true;
+    }
+    return false;
+}
+
+static UA_WorkerCallback *
+findWork(UA_Worker *worker, size_t workerIndex) {
+    UA_Server *server = worker->server;
+    UA_WorkerCallback *dc = UA_WorkDeque_take(&worker->deque);
+    if(dc)
+        return dc;
+    dc = UA_WorkDeque_steal(server->dispatchDeque);
+    if(dc)
+        return dc;
+    for(size_t i = 1; i < server->config.nThreads; ++i) {
+        UA_Worker *victim =
+            &server->workers[(workerIndex + i) % server->config.nThreads];
+        dc = UA_WorkDeque_steal(&victim->deque);
+        if(dc)
+            return dc;
+    }
+    return NULL;
+}
+
+static void
+executeCallback(UA_Server *server, UA_WorkerCallback *dc) {
+    dc->callback(server, dc->data);
+    UA_atomic_subSize(&server->epochCallbacks[dc->epoch], 1);
+    UA_WorkDeque_releaseCallback(dc);
+}
+
+/* Wake up a single idle worker */
+static void
+wakeupWorker(UA_Server *server) {
+    UA_atomic_sync(); /* The dispatched callback is visible before the check */
+    if(server->idleWorkersSize == 0)
+        return;
+    pthread_mutex_lock(&server->idleMutex);
+    UA_Worker *worker = LIST_FIRST(&server->idleWorkers);
+    if(worker) {
+        LIST_REMOVE(worker, idleEntry);
+        UA_atomic_subSize(&server->idleWorkersSize, 1);
+        worker->idle = false;
+        pthread_cond_signal(&worker->wakeup);
+    }
+    pthread_mutex_unlock(&server->idleMutex);
+}
+
+static void
+waitForWork(UA_Worker *worker) {
+    UA_Server *server = worker->server;
+    pthread_mutex_lock(&server->idleMutex);
+    worker->idle = true;
+    LIST_INSERT_HEAD(&server->idleWorkers, worker, idleEntry);
+    UA_atomic_addSize(&server->idleWorkersSize, 1);
+
+    /* Check again after announcing the idle state. Otherwise, a callback
+     * dispatched in between would not wake up this worker. */
+    if(hasWork(server) || !worker->running) {
+        LIST_REMOVE(worker, idleEntry);
+        UA_atomic_subSize(&server->idleWorkersSize, 1);
+        worker->idle = false;
+        pthread_mutex_unlock(&server->idleMutex);
+        return;
+    }
+
+    while(worker->idle)
+        pthread_cond_wait(&worker->wakeup, &server->idleMutex);
+    pthread_mutex_unlock(&server->idleMutex);
+}
 
 static void *
 workerLoop(UA_Worker *worker) {
     UA_Server *server = worker->server;
-    UA_UInt32 *counter = &worker->counter;
+    size_t workerIndex = (size_t)(worker - server->workers);
     volatile UA_Boolean *running = &worker->running;
+    pthread_setspecific(server->workerKey, worker);
 
     /* Initialize the (thread local) random seed with the ram address
      * of the worker. Not for security-critical entropy! */
     UA_random_seed((uintptr_t)worker);
 
     while(*running) {
-        UA_atomic_addUInt32(counter, 1);
-        pthread_mutex_lock(&server->dispatchQueue_accessMutex);
-        WorkerCallback *dc = SIMPLEQ_FIRST(&server->dispatchQueue);
-        if(dc) {
-            SIMPLEQ_REMOVE_HEAD(&server->dispatchQueue, next);
-        }
-        pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
+        UA_WorkerCallback *dc = findWork(worker, workerIndex);
         if(!dc) {
             /* Nothing to do. Sleep until a callback is dispatched */
-            pthread_mutex_lock(&server->dispatchQueue_conditionMutex);
-            pthread_cond_wait(&server->dispatchQueue_condition,
-                              &server->dispatchQueue_conditionMutex);
-            pthread_mutex_unlock(&server->dispatchQueue_conditionMutex);
-            continue;
-        }
-
-        if(dc->delayed) {
-            processDelayedCallback(server, dc);
+            waitForWork(worker);
             continue;
         }
-
-        dc->callback(server, dc->data);
-        UA_free(dc);
+        executeCallback(server, dc);
     }
 
     UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_SERVER,
@@ -104,19 +355,52 @@ workerLoop(UA_Worker *worker) {
     return NULL;
 }
 
+void
+UA_Server_initDispatch(UA_Server *server) {
+    pthread_mutex_init(&server->dispatchMutex, NULL);
+    pthread_mutex_init(&server->idleMutex, NULL);
+    pthread_key_create(&server->workerKey, NULL);
+    LIST_INIT(&server->idleWorkers);
+}
+
+static void
+processDelayedCallbacks(UA_Server *server, UA_Boolean force);
+
 void UA_Server_cleanupDispatchQueue(UA_Server *server) {
-    while(true) {
-        pthread_mutex_lock(&server->dispatchQueue_accessMutex);
-        WorkerCallback *dc = SIMPLEQ_FIRST(&server->dispatchQueue);
-        if(!dc) {
-            pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
-            break;
+    /* Execute the remaining callbacks. Executing a callback can dispatch new
+     * callbacks. The workers are stopped. So the deques can be emptied from
+     * this thread. */
+    if(server->workers) {
+        UA_Boolean done = false;
+        while(!done) {
+            done = true;
+            UA_WorkerCallback *dc;
+            while((dc = UA_WorkDeque_steal(server->dispatchDeque))) {
+                executeCallback(server, dc);
+                done = false;
+            }
+            for(size_t i = 0; i < server->config.nThreads; ++i) {
+                while((dc = UA_WorkDeque_steal(&server->workers[i].deque))) {
+                    executeCallback(server, dc);
+                    done = false;
+                }
+            }
         }
-        SIMPLEQ_REMOVE_HEAD(&server->dispatchQueue, next);
-        pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
-        dc->callback(server, dc->data);
-        UA_free(dc);
+
+        for(size_t i = 0; i < server->config.nThreads; ++i) {
+            UA_WorkDeque_deleteMembers(&server->workers[i].deque);
+            pthread_cond_destroy(&server->workers[i].wakeup);
+        }
+        UA_free(server->workers);
+        server->workers = NULL;
+        UA_WorkDeque_deleteMembers(server->dispatchDeque);
+        UA_free(server->dispatchDeque);
+        server->dispatchDeque = NULL;
     }
+
+    /* Execute all delayed callbacks. Without workers, callbacks are executed
+     * right away when dispatched. */
+    processDelayedCallbacks(server, true);
 }
 
 #endif
@@ -135,26 +419,161 @@ UA_Server_workerCallback(UA_Server *server, UA_ServerCallback callback,
     /* Execute immediately */
     callback(server, data);
 #else
+    /* Execute immediately if the workers are not running */
+    if(!server->workers) {
+        callback(server, data);
+        return;
+    }
+
+    /* Push to the deque of the current worker. Or to the shared dispatch deque
+     * if we are not in a worker thread. */
+    UA_Worker *worker = (UA_Worker*)pthread_getspecific(server->workerKey);
+    UA_WorkDeque *d = server->dispatchDeque;
+    if(worker)
+        d = &worker->deque;
+    else
+        pthread_mutex_lock(&server->dispatchMutex);
+
     /* Execute immediately if memory could not be allocated */
-    WorkerCallback *dc = (WorkerCallback*)UA_malloc(sizeof(WorkerCallback));
+    UA_WorkerCallback *dc = UA_WorkDeque_allocCallback(d);
     if(!dc) {
+        if(!worker)
+            pthread_mutex_unlock(&server->dispatchMutex);
         callback(server, data);
         return;
     }
-
-    /* Enqueue for the worker threads */
     dc->callback = callback;
     dc->data = data;
-    dc->delayed = false;
-    pthread_mutex_lock(&server->dispatchQueue_accessMutex);
-    SIMPLEQ_INSERT_TAIL(&server->dispatchQueue, dc, next);
-    pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
 
-    /* Wake up sleeping workers */
-    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    /* Count the callback in the current epoch. Retry if the epoch changed
+     * before the counter was increased. */
+    while(true) {
+        UA_UInt32 epoch = server->epoch;
+        dc->epoch = (UA_Byte)(epoch & 0x01);
+        UA_atomic_addSize(&server->epochCallbacks[dc->epoch], 1);
+        if(server->epoch == epoch)
+            break;
+        UA_atomic_subSize(&server->epochCallbacks[dc->epoch], 1);
+    }
+
+    /* Enqueue for the worker threads */
+    UA_StatusCode retval = UA_WorkDeque_push(d, dc);
+    if(!worker)
+        pthread_mutex_unlock(&server->dispatchMutex);
+    if(retval != UA_STATUSCODE_GOOD) {
+        executeCallback(server, dc);
+        return;
+    }
+
+    /* Wake up a sleeping worker */
+    wakeupWorker(server);
 #endif
 }
 
+/**
+ * Strands
+ * -------
+ * A strand is a FIFO queue of callbacks that are executed one after the other.
+ * Only the first callback added to an empty strand dispatches the strand to
+ * the workers. The worker then executes a batch of callbacks and dispatches the
+ * strand again if it is not empty. So at most one worker processes the strand
+ * at any time and the order is retained. Different strands run in parallel on
+ * different workers.
+ *
+ * A busy strand does not occupy a worker indefinitely. Every batch is a new
+ * dispatched callback, so the epoch advances and delayed callbacks are executed
+ * while the strand is processed. Hence, a delayed callback can run before the
+ * strand is empty. Check UA_Strand_isIdle before deleting the strand. */
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+#define UA_STRAND_BATCHSIZE 16
+
+struct UA_Strand {
+    pthread_mutex_t mutex;
+    UA_StrandCallback *first;
+    UA_StrandCallback *last;
+    UA_Boolean scheduled; /* A worker is dispatched or processing */
+};
+
+UA_Strand *
+UA_Strand_new(void) {
+    UA_Strand *strand = (UA_Strand*)UA_calloc(1, sizeof(UA_Strand));
+    if(!strand)
+        return NULL;
+    pthread_mutex_init(&strand->mutex, NULL);
+    return strand;
+}
+
+void
+UA_Strand_delete(UA_Strand *strand) {
+    pthread_mutex_destroy(&strand->mutex);
+    UA_free(strand);
+}
+
+UA_Boolean
+UA_Strand_isIdle(UA_Strand *strand) {
+    pthread_mutex_lock(&strand->mutex);
+    UA_Boolean idle = !strand->scheduled;
+    pthread_mutex_unlock(&strand->mutex);
+    return idle;
+}
+
+static void
+processStrand(UA_Server *server, UA_Strand *strand) {
+    for(size_t i = 0; i <= UA_STRAND_BATCHSIZE; ++i) {
+        pthread_mutex_lock(&strand->mutex);
+        UA_StrandCallback *sc = strand->first;
+        if(!sc) {
+            strand->scheduled = false;
+            pthread_mutex_unlock(&strand->mutex);
+            return;
+        }
+        if(i == UA_STRAND_BATCHSIZE) {
+            pthread_mutex_unlock(&strand->mutex);
+            break;
+        }
+        strand->first = sc->next;
+        if(!strand->first)
+            strand->last = NULL;
+        pthread_mutex_unlock(&strand->mutex);
+
+        /* The descriptor can be freed in the callback */
+        sc->callback(server, sc->data);
+    }
+
+    /* Callbacks remain. The strand stays scheduled. */
+    UA_Server_workerCallback(server, (UA_ServerCallback)processStrand, strand);
+}
+
+void
+UA_Server_strandCallback(UA_Server *server, UA_Strand *strand,
+                         UA_StrandCallback *sc) {
+    /* Execute immediately if the workers are not running */
+    if(!server->workers) {
+        sc->callback(server, sc->data);
+        return;
+    }
+
+    /* Append to the queue */
+    sc->next = NULL;
+    pthread_mutex_lock(&strand->mutex);
+    if(strand->last)
+        strand->last->next = sc;
+    else
+        strand->first = sc;
+    strand->last = sc;
+    UA_Boolean scheduled = strand->scheduled;
+    strand->scheduled = true;
+    pthread_mutex_unlock(&strand->mutex);
+
+    /* Dispatch the strand if it was idle */
+    if(!scheduled)
+        UA_Server_workerCallback(server, (UA_ServerCallback)processStrand, strand);
+}
+
+#endif
+
 /**
  * Delayed Callbacks
  * -----------------
@@ -162,16 +581,17 @@ UA_Server_workerCallback(UA_Server *server, UA_ServerCallback callback,
  * Delayed Callbacks are called only when all callbacks that were dispatched
  * prior are finished. In the single-threaded case, the callback is added to a
  * singly-linked list that is processed at the end of the server's main-loop. In
- * the multi-threaded case, the delay is ensure by a three-step procedure:
+ * the multi-threaded case, the delay is ensured by epochs:
  *
- * 1. The delayed callback is dispatched to the worker queue. So it is only
- *    dequeued when all prior callbacks have been dequeued.
+ * 1. Every dispatched callback is counted in the current epoch (parity) until
+ *    it has finished.
  *
- * 2. When the callback is first dequeued by a worker, sample the counter of all
- *    workers. Once all counters have advanced, the callback is ready.
+ * 2. The main loop advances the epoch when all callbacks from the previous
+ *    epoch (with the same parity as the next epoch) have finished.
  *
- * 3. Check regularly if the callback is ready by adding it back to the dispatch
- *    queue. */
+ * 3. A delayed callback is executed in the main loop once the epoch has
+ *    advanced twice since it was added. Then all callbacks that were
+ *    dispatched prior have finished. */
 
 /* Delayed callback to free the subscription memory */
 static void
@@ -186,14 +606,17 @@ UA_Server_delayedFree(UA_Server *server, void *data) {
     return UA_Server_delayedCallback(server, freeCallback, data);
 }
 
-#ifndef UA_ENABLE_MULTITHREADING
-
 typedef struct UA_DelayedCallback {
     SLIST_ENTRY(UA_DelayedCallback) next;
     UA_ServerCallback callback;
     void *data;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_UInt32 epoch; /* Epoch when the callback was added */
+#endif
 } UA_DelayedCallback;
 
+#ifndef UA_ENABLE_MULTITHREADING
+
 UA_StatusCode
 UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback,
                           void *data) {
@@ -219,73 +642,65 @@ void UA_Server_cleanupDelayedCallbacks(UA_Server *server) {
 
 #else /* UA_ENABLE_MULTITHREADING */
 
+/* Can be called from every thread. The delayed callbacks are added to a
+ * lock-free stack that is emptied in the main loop. */
 UA_StatusCode
 UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback,
                           void *data) {
-    size_t dcsize = sizeof(WorkerCallback) +
-        (sizeof(UA_UInt32) * server->config.nThreads);
-    WorkerCallback *dc = (WorkerCallback*)UA_malloc(dcsize);
+    UA_DelayedCallback *dc =
+        (UA_DelayedCallback*)UA_malloc(sizeof(UA_DelayedCallback));
     if(!dc)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
-    /* Enqueue for the worker threads */
     dc->callback = callback;
     dc->data = data;
-    dc->delayed = true;
-    dc->countersSampled = false;
-    pthread_mutex_lock(&server->dispatchQueue_accessMutex);
-    SIMPLEQ_INSERT_TAIL(&server->dispatchQueue, dc, next);
-    pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
-
-    /* Wake up sleeping workers */
-    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    dc->epoch = server->epoch;
+    UA_DelayedCallback *old;
+    do {
+        old = server->delayedCallbacksNew;
+        dc->next.sle_next = old;
+    } while(UA_atomic_cmpxchg((void * volatile *)&server->delayedCallbacksNew,
+                              old, dc) != old);
     return UA_STATUSCODE_GOOD;
 }
 
-/* Called from the worker loop */
+/* Called from the main loop. Force executes all delayed callbacks (when the
+ * workers are stopped). */
 static void
-processDelayedCallback(UA_Server *server, WorkerCallback *dc) {
-    /* Set the worker counters */
-    if(!dc->countersSampled) {
-        for(size_t i = 0; i < server->config.nThreads; ++i)
-            dc->workerCounters[i] = server->workers[i].counter;
-        dc->countersSampled = true;
-
-        /* Re-add to the dispatch queue */
-        pthread_mutex_lock(&server->dispatchQueue_accessMutex);
-        SIMPLEQ_INSERT_TAIL(&server->dispatchQueue, dc, next);
-        pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
-
-        /* Wake up sleeping workers */
-        pthread_cond_broadcast(&server->dispatchQueue_condition);
-        return;
+processDelayedCallbacks(UA_Server *server, UA_Boolean force) {
+    /* Advance the epoch if all callbacks of the previous epoch have finished */
+    UA_UInt32 epoch = server->epoch;
+    if(server->epochCallbacks[(epoch + 1) & 0x01] == 0) {
+        epoch++;
+        server->epoch = epoch;
+        UA_atomic_sync();
     }
 
-    /* Have all other jobs finished? */
-    UA_Boolean ready = true;
-    for(size_t i = 0; i < server->config.nThreads; ++i) {
-        if(dc->workerCounters[i] == server->workers[i].counter) {
-            ready = false;
-            break;
-        }
+    /* Move the newly added delayed callbacks into the (main-thread only)
+     * list */
+    UA_DelayedCallback *dc = (UA_DelayedCallback*)
+        UA_atomic_xchg((void * volatile *)&server->delayedCallbacksNew, NULL);
+    while(dc) {
+        UA_DelayedCallback *next = SLIST_NEXT(dc, next);
+        SLIST_INSERT_HEAD(&server->delayedCallbacks, dc, next);
+        dc = next;
     }
 
-    /* Re-add to the dispatch queue.
-     * TODO: What is the impact of this loop?
-     * Can we add a small delay here? */
-    if(!ready) {
-        pthread_mutex_lock(&server->dispatchQueue_accessMutex);
-        SIMPLEQ_INSERT_TAIL(&server->dispatchQueue, dc, next);
-        pthread_mutex_unlock(&server->dispatchQueue_accessMutex);
-
-        /* Wake up sleeping workers */
-        pthread_cond_broadcast(&server->dispatchQueue_condition);
-        return;
+    /* Execute the delayed callbacks that are ready. A callback can add new
+     * delayed callbacks. They are processed in the next iteration. */
+    UA_DelayedCallback *dc_tmp;
+    SLIST_FOREACH_SAFE(dc, &server->delayedCallbacks, next, dc_tmp) {
+        if(!force && (UA_UInt32)(epoch - dc->epoch) < 2)
+            continue;
+        SLIST_REMOVE(&server->delayedCallbacks, dc, UA_DelayedCallback, next);
+        dc->callback(server, dc->data);
+        UA_free(dc);
     }
 
-    /* Execute the callback */
-    dc->callback(server, dc->data);
-    UA_free(dc);
+    /* Delayed callbacks that were added during the forced cleanup */
+    if(force && (server->delayedCallbacksNew ||
+                 !SLIST_EMPTY(&server->delayedCallbacks)))
+        processDelayedCallbacks(server, true);
 }
 
 #endif
@@ -324,19 +739,42 @@ UA_Server_run_startup(UA_Server *server) {
 #ifdef UA_ENABLE_MULTITHREADING
     UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Spinning up %u worker thread(s)", server->config.nThreads);
-    pthread_mutex_init(&server->dispatchQueue_accessMutex, NULL);
-    pthread_cond_init(&server->dispatchQueue_condition, NULL);
-    pthread_mutex_init(&server->dispatchQueue_conditionMutex, NULL);
-    server->workers = (UA_Worker*)UA_malloc(server->config.nThreads * sizeof(UA_Worker));
-    if(!server->workers)
+    server->dispatchDeque = (UA_WorkDeque*)UA_malloc(sizeof(UA_WorkDeque));
+    if(!server->dispatchDeque)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(UA_WorkDeque_init(server->dispatchDeque) != UA_STATUSCODE_GOOD) {
+        UA_free(server->dispatchDeque);
+        server->dispatchDeque = NULL;
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_Worker *workers = (UA_Worker*)
+        UA_calloc(server->config.nThreads, sizeof(UA_Worker));
+    if(!workers) {
+        UA_WorkDeque_deleteMembers(server->dispatchDeque);
+        UA_free(server->dispatchDeque);
+        server->dispatchDeque = NULL;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
     for(size_t i = 0; i < server->config.nThreads; ++i) {
-        UA_Worker *worker = &server->workers[i];
+        UA_Worker *worker = &workers[i];
         worker->server = server;
-        worker->counter = 0;
         worker->running = true;
-        pthread_create(&worker->thr, NULL, (void* (*)(void*))workerLoop, worker);
+        pthread_cond_init(&worker->wakeup, NULL);
+        retval |= UA_WorkDeque_init(&worker->deque);
     }
+    if(retval != UA_STATUSCODE_GOOD) {
+        server->workers = workers;
+        UA_Server_cleanupDispatchQueue(server);
+        return retval;
+    }
+
+    /* Workers access the deques of the other workers. Set server->workers
+     * before the threads are started. */
+    server->workers = workers;
+    for(size_t i = 0; i < server->config.nThreads; ++i)
+        pthread_create(&workers[i].thr, NULL, (void* (*)(void*))workerLoop,
+                       &workers[i]);
 #endif
 
     /* Start the multicast discovery server */
@@ -376,9 +814,11 @@ UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 
 #ifndef UA_ENABLE_MULTITHREADING
     /* Process delayed callbacks when all callbacks and network events are done.
-     * If multithreading is enabled, the cleanup of delayed values is attempted
-     * by a callback in the job queue. */
+     * If multithreading is enabled, the delayed callbacks are executed when
+     * all prior dispatched callbacks have finished. */
     UA_Server_cleanupDelayedCallbacks(server);
+#else
+    processDelayedCallbacks(server, false);
 #endif
 
 #if defined(UA_ENABLE_DISCOVERY_MULTICAST) && !defined(UA_ENABLE_MULTITHREADING)
@@ -417,17 +857,24 @@ UA_Server_run_shutdown(UA_Server *server) {
         UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                     "Shutting down %u worker thread(s)",
                     server->config.nThreads);
-        for(size_t i = 0; i < server->config.nThreads; ++i)
-            server->workers[i].running = false;
-        pthread_cond_broadcast(&server->dispatchQueue_condition);
+        pthread_mutex_lock(&server->idleMutex);
+        for(size_t i = 0; i < server->config.nThreads; ++i) {
+            UA_Worker *worker = &server->workers[i];
+            worker->running = false;
+            if(worker->idle) {
+                LIST_REMOVE(worker, idleEntry);
+                UA_atomic_subSize(&server->idleWorkersSize, 1);
+                worker->idle = false;
+                pthread_cond_signal(&worker->wakeup);
+            }
+        }
+        pthread_mutex_unlock(&server->idleMutex);
         for(size_t i = 0; i < server->config.nThreads; ++i)
             pthread_join(server->workers[i].thr, NULL);
-        UA_free(server->workers);
-        server->workers = NULL;
     }
 
     /* Execute the remaining callbacks in the dispatch queue. Also executes
-     * delayed callbacks. */
+     * delayed callbacks. Frees the workers. */
     UA_Server_cleanupDispatchQueue(server);
 #else
     /* Process remaining delayed callbacks */
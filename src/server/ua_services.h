@@ -325,8 +325,13 @@ void Service_Write(UA_Server *server, UA_Session *session,
  * ^^^^^^^^^^^^^^^^^^^
  * Used to read historical values or Events of one or more Nodes. Servers may
  * make historical values available to Clients using this Service, although the
- * historical values themselves are not visible in the AddressSpace. */
-/* Not Implemented */
+ * historical values themselves are not visible in the AddressSpace. Only
+ * ReadRawModifiedDetails are supported. */
+#ifdef UA_ENABLE_HISTORIZING
+void Service_HistoryRead(UA_Server *server, UA_Session *session,
+                         const UA_HistoryReadRequest *request,
+                         UA_HistoryReadResponse *response);
+#endif
 
 /**
  * HistoryUpdate Service
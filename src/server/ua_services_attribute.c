@@ -111,6 +111,28 @@ readIsAbstractAttribute(const UA_Node *node, UA_Variant *v) {
     return UA_STATUSCODE_GOOD;
 }
 
+#ifdef UA_ENABLE_HISTORIZING
+/* Hand the value of a historizing VariableNode to the history database */
+static void
+historizeValue(UA_Server *server, UA_Session *session,
+               const UA_VariableNode *vn, const UA_DataValue *value) {
+    UA_HistoryDatabase *hdb = &server->config.historyDatabase;
+    if(!vn->historizing || !hdb->setValue)
+        return;
+    UA_DataValue v = *value;
+    if(!v.hasSourceTimestamp) {
+        v.sourceTimestamp = UA_DateTime_now();
+        v.hasSourceTimestamp = true;
+    }
+    if(!v.hasServerTimestamp) {
+        v.serverTimestamp = UA_DateTime_now();
+        v.hasServerTimestamp = true;
+    }
+    hdb->setValue(server, hdb->context, &session->sessionId, session->sessionHandle,
+                  &vn->nodeId, &v);
+}
+#endif
+
 static UA_StatusCode
 readValueAttributeFromNode(UA_Server *server, UA_Session *session,
                            const UA_VariableNode *vn, UA_DataValue *v,
@@ -165,6 +187,13 @@ readValueAttributeComplete(UA_Server *server, UA_Session *session,
     else
         retval = readValueAttributeFromDataSource(server, session, vn, v, timestamps, rangeptr);
 
+#ifdef UA_ENABLE_HISTORIZING
+    /* Values stored in the node are historized when they are written */
+    if(retval == UA_STATUSCODE_GOOD && !rangeptr &&
+       vn->valueSource == UA_VALUESOURCE_DATASOURCE)
+        historizeValue(server, session, vn, v);
+#endif
+
     /* Clean up */
     if(rangeptr)
         UA_free(range.dimensions);
@@ -592,12 +621,12 @@ compatibleDataType(UA_Server *server, const UA_NodeId *dataType,
         return true;
 
     /* Is the value-type a subtype of the required type? */
-    if(isNodeInTree(&server->config.nodestore, dataType, constraintDataType, &subtypeId, 1))
+    if(isSubtypeOf(server, dataType, constraintDataType))
         return true;
 
     /* Enum allows Int32 (only) */
     if(UA_NodeId_equal(dataType, &UA_TYPES[UA_TYPES_INT32].typeId) &&
-       isNodeInTree(&server->config.nodestore, constraintDataType, &enumNodeId, &subtypeId, 1))
+       isSubtypeOf(server, constraintDataType, &enumNodeId))
         return true;
 
     /* More checks for the data type of real values (variants) */
@@ -609,8 +638,7 @@ compatibleDataType(UA_Server *server, const UA_NodeId *dataType,
         if(dataType->namespaceIndex == 0 &&
            dataType->identifierType == UA_NODEIDTYPE_NUMERIC &&
            dataType->identifier.numeric <= 25 &&
-           isNodeInTree(&server->config.nodestore, constraintDataType,
-                        dataType, &subtypeId, 1))
+           isSubtypeOf(server, constraintDataType, dataType))
             return true;
     }
 
@@ -1075,6 +1103,11 @@ writeValueAttribute(UA_Server *server, UA_Session *session,
         else
             retval = writeValueAttributeWithRange(node, &adjustedValue, rangeptr);
 
+#ifdef UA_ENABLE_HISTORIZING
+        if(retval == UA_STATUSCODE_GOOD)
+            historizeValue(server, session, node, &node->value.data.value);
+#endif
+
         /* Callback after writing */
         if(retval == UA_STATUSCODE_GOOD && node->value.data.callback.onWrite)
             node->value.data.callback.onWrite(server, &session->sessionId,
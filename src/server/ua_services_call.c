@@ -113,7 +113,6 @@ validMethodArguments(UA_Server *server, const UA_MethodNode *method,
 }
 
 static const UA_NodeId hasComponentNodeId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASCOMPONENT}};
-static const UA_NodeId hasSubTypeNodeId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASSUBTYPE}};
 
 static void
 callWithMethodAndObject(UA_Server *server, UA_Session *session,
@@ -147,8 +146,7 @@ callWithMethodAndObject(UA_Server *server, UA_Session *session,
         UA_NodeReferenceKind *rk = &object->references[i];
         if(rk->isInverse)
             continue;
-        if(!isNodeInTree(&server->config.nodestore, &rk->referenceTypeId,
-                         &hasComponentNodeId, &hasSubTypeNodeId, 1))
+        if(!isSubtypeOf(server, &rk->referenceTypeId, &hasComponentNodeId))
             continue;
         for(size_t j = 0; j < rk->targetIdsSize; ++j) {
             if(UA_NodeId_equal(&rk->targetIds[j].nodeId, &request->methodId)) {
@@ -0,0 +1,97 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ua_server_internal.h"
+#include "ua_services.h"
+
+#ifdef UA_ENABLE_HISTORIZING
+
+typedef struct {
+    const UA_ReadRawModifiedDetails *details;
+    UA_TimestampsToReturn timestampsToReturn;
+    UA_Boolean releaseContinuationPoints;
+} HistoryReadContext;
+
+static UA_StatusCode
+checkHistoryReadAccess(UA_Server *server, UA_Session *session,
+                       const UA_NodeId *nodeId) {
+    const UA_Node *node = UA_Nodestore_get(server, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    if(node->nodeClass != UA_NODECLASS_VARIABLE) {
+        retval = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    } else if(session != &adminSession) {
+        if(!(vn->accessLevel & UA_ACCESSLEVELMASK_HISTORYREAD)) {
+            retval = UA_STATUSCODE_BADNOTREADABLE;
+        } else {
+            UA_Byte userAccessLevel = server->config.accessControl.
+                getUserAccessLevel(server, &server->config.accessControl,
+                                   &session->sessionId, session->sessionHandle,
+                                   &node->nodeId, node->context);
+            if(!(userAccessLevel & UA_ACCESSLEVELMASK_HISTORYREAD))
+                retval = UA_STATUSCODE_BADUSERACCESSDENIED;
+        }
+    }
+    UA_Nodestore_release(server, node);
+    return retval;
+}
+
+static void
+Operation_HistoryRead(UA_Server *server, UA_Session *session,
+                      HistoryReadContext *ctx, const UA_HistoryReadValueId *id,
+                      UA_HistoryReadResult *result) {
+    result->statusCode = checkHistoryReadAccess(server, session, &id->nodeId);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        return;
+
+    UA_HistoryDatabase *hdb = &server->config.historyDatabase;
+    hdb->readRaw(server, hdb->context, &session->sessionId, session->sessionHandle,
+                 ctx->details, ctx->timestampsToReturn, ctx->releaseContinuationPoints,
+                 server->config.maxReturnDataValues, id, result);
+}
+
+void
+Service_HistoryRead(UA_Server *server, UA_Session *session,
+                    const UA_HistoryReadRequest *request,
+                    UA_HistoryReadResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session,
+                         "Processing HistoryReadRequest");
+
+    if(!server->config.historyDatabase.readRaw) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+        return;
+    }
+
+    /* Only raw and modified values are supported */
+    const UA_ExtensionObject *details = &request->historyReadDetails;
+    if((details->encoding != UA_EXTENSIONOBJECT_DECODED &&
+        details->encoding != UA_EXTENSIONOBJECT_DECODED_NODELETE) ||
+       details->content.decoded.type != &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS]) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+        return;
+    }
+
+    /* History values always have a timestamp */
+    if(request->timestampsToReturn > UA_TIMESTAMPSTORETURN_BOTH) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADTIMESTAMPSTORETURNINVALID;
+        return;
+    }
+
+    HistoryReadContext ctx;
+    ctx.details = (const UA_ReadRawModifiedDetails*)details->content.decoded.data;
+    ctx.timestampsToReturn = request->timestampsToReturn;
+    ctx.releaseContinuationPoints = request->releaseContinuationPoints;
+    response->responseHeader.serviceResult =
+        UA_Server_processServiceOperations(server, session,
+                                           (UA_ServiceOperation)Operation_HistoryRead, &ctx,
+                                           &request->nodesToReadSize,
+                                           &UA_TYPES[UA_TYPES_HISTORYREADVALUEID],
+                                           &response->resultsSize,
+                                           &UA_TYPES[UA_TYPES_HISTORYREADRESULT]);
+}
+
+#endif /* UA_ENABLE_HISTORIZING */
@@ -132,8 +132,7 @@ checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeCl
     }
 
     /* Test if the referencetype is hierarchical */
-    if(!isNodeInTree(&server->config.nodestore, referenceTypeId,
-                     &hierarchicalReferences, &subtypeId, 1)) {
+    if(!isSubtypeOf(server, referenceTypeId, &hierarchicalReferences)) {
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Reference type to the parent is not hierarchical");
         return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
@@ -411,7 +410,7 @@ static void deleteReferencesSubset(UA_Node *node, size_t referencesSkipSize, UA_
     }
 
     /* Now copy the remaining references to a new array */
-    UA_NodeReferenceKind *newReferences = (UA_NodeReferenceKind *)UA_malloc(sizeof(UA_NodeReferenceKind) * (newSize));
+    UA_NodeReferenceKind *newReferences = (UA_NodeReferenceKind *)UA_calloc(newSize, sizeof(UA_NodeReferenceKind));
     size_t curr = 0;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; ++i) {
@@ -1227,6 +1226,15 @@ removeDeconstructedNode(UA_Server *server, UA_Session *session,
 
     /* Remove the node in the nodestore */
     UA_Nodestore_remove(server, &node->nodeId);
+    UA_SubtypeCache_invalidate(&server->subtypeCache, &node->nodeId);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    UA_EventNotifierCache_invalidate(&server->eventNotifierCache, &node->nodeId);
+#endif
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* MonitoredItems waiting for a write see that the node is gone */
+    UA_MonitoredNode_notifyWrite(server, &node->nodeId);
+#endif
 }
 
 static void
@@ -1308,6 +1316,20 @@ deleteOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
     return UA_Node_deleteReference(node, item);
 }
 
+/* The child of the reference and all nodes below have a changed hierarchy */
+static void
+invalidateHierarchyCaches(UA_Server *server, const UA_NodeId *referenceTypeId,
+                          const UA_NodeId *sourceNodeId, const UA_NodeId *targetNodeId,
+                          UA_Boolean isForward) {
+    const UA_NodeId *child = isForward ? targetNodeId : sourceNodeId;
+    if(UA_NodeId_equal(referenceTypeId, &subtypeId))
+        UA_SubtypeCache_invalidate(&server->subtypeCache, child);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    if(isSubtypeOf(server, referenceTypeId, &hierarchicalReferences))
+        UA_EventNotifierCache_invalidate(&server->eventNotifierCache, child);
+#endif
+}
+
 static void
 Operation_addReference(UA_Server *server, UA_Session *session, void *context,
                        const UA_AddReferencesItem *item, UA_StatusCode *retval) {
@@ -1325,6 +1347,9 @@ Operation_addReference(UA_Server *server, UA_Session *session, void *context,
         return;
     }
 
+    invalidateHierarchyCaches(server, &item->referenceTypeId, &item->sourceNodeId,
+                              &item->targetNodeId.nodeId, item->isForward);
+
     /* Add the first direction */
     *retval = UA_Server_editNode(server, session, &item->sourceNodeId,
                                  (UA_EditNodeCallback)addOneWayReference,
@@ -1421,6 +1446,9 @@ Operation_deleteReference(UA_Server *server, UA_Session *session, void *context,
         return;
     }
 
+    invalidateHierarchyCaches(server, &item->referenceTypeId, &item->sourceNodeId,
+                              &item->targetNodeId.nodeId, item->isForward);
+
     // TODO: Check consistency constraints, remove the references.
     *retval = UA_Server_editNode(server, session, &item->sourceNodeId,
                                  (UA_EditNodeCallback)deleteOneWayReference,
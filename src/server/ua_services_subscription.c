@@ -158,7 +158,7 @@ static UA_StatusCode
 setMonitoredItemSettings(UA_Server *server, UA_MonitoredItem *mon,
                          UA_MonitoringMode monitoringMode,
                          const UA_MonitoringParameters *params,
-                         // This parameter is optional and used only if mon->lastValue is not set yet.
+                         // This parameter is optional and used only if mon->lastSampledValue is not set yet.
                          // Then numeric type will be detected from this value. Set null as defaut.
                          const UA_DataType* dataType) {
 
@@ -172,11 +172,11 @@ setMonitoredItemSettings(UA_Server *server, UA_MonitoredItem *mon,
         if (filter->deadbandType == UA_DEADBANDTYPE_PERCENT) {
             return UA_STATUSCODE_BADMONITOREDITEMFILTERUNSUPPORTED;
         }
-        if (UA_Variant_isEmpty(&mon->lastValue)) {
+        if (UA_Variant_isEmpty(&mon->lastSampledValue.value)) {
             if (!dataType || !isDataTypeNumeric(dataType))
                 return UA_STATUSCODE_BADFILTERNOTALLOWED;
         } else
-        if (!isDataTypeNumeric(mon->lastValue.type)) {
+        if (!isDataTypeNumeric(mon->lastSampledValue.value.type)) {
             return UA_STATUSCODE_BADFILTERNOTALLOWED;
         }
         UA_DataChangeFilter_copy(filter, &(mon->filter.dataChangeFilter));
@@ -517,8 +517,7 @@ Operation_SetMonitoringMode(UA_Server *server, UA_Session *session,
         }
 
         /* Initialize lastSampledValue */
-        UA_ByteString_deleteMembers(&mon->lastSampledValue);
-        UA_Variant_deleteMembers(&mon->lastValue);
+        UA_MonitoredItem_resetLastSample(mon);
     }
 }
 
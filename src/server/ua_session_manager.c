@@ -12,11 +12,46 @@
 #include "ua_session_manager.h"
 #include "ua_server_internal.h"
 
+static enum ZIP_CMP
+cmpTimeout(const UA_DateTime *a, const UA_DateTime *b) {
+    if(*a != *b)
+        return (*a < *b) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    /* Several sessions can time out at the same time. The keys are unique by
+     * their address within the entry. The tree is never searched by key. */
+    if(a == b)
+        return ZIP_CMP_EQ;
+    return ((uintptr_t)a < (uintptr_t)b) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_IMPL(session_timeout_zip, session_list_entry, timeoutZipfields,
+         UA_DateTime, timeout, cmpTimeout)
+
+static struct session_bucket *
+getSessionBucket(struct session_bucket *buckets, size_t bucketsSize, const UA_NodeId *id) {
+    return &buckets[UA_NodeId_hash(id) & (bucketsSize - 1)];
+}
+
 UA_StatusCode
 UA_SessionManager_init(UA_SessionManager *sm, UA_Server *server) {
     LIST_INIT(&sm->sessions);
+    ZIP_INIT(&sm->timeouts);
     sm->currentSessionCount = 0;
     sm->server = server;
+
+    /* At most one session per bucket on average */
+    sm->bucketsSize = 16;
+    while(sm->bucketsSize < server->config.maxSessions)
+        sm->bucketsSize <<= 1;
+    sm->tokenBuckets = (struct session_bucket*)
+        UA_malloc(2 * sm->bucketsSize * sizeof(struct session_bucket));
+    if(!sm->tokenBuckets) {
+        sm->bucketsSize = 0;
+        sm->idBuckets = NULL;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    sm->idBuckets = &sm->tokenBuckets[sm->bucketsSize];
+    for(size_t i = 0; i < 2 * sm->bucketsSize; ++i)
+        LIST_INIT(&sm->tokenBuckets[i]);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -27,6 +62,11 @@ void UA_SessionManager_deleteMembers(UA_SessionManager *sm) {
         UA_Session_deleteMembersCleanup(&current->session, sm->server);
         UA_free(current);
     }
+    ZIP_INIT(&sm->timeouts);
+    UA_free(sm->tokenBuckets);
+    sm->tokenBuckets = NULL;
+    sm->idBuckets = NULL;
+    sm->bucketsSize = 0;
 }
 
 /* Delayed callback to free the session memory */
@@ -58,6 +98,9 @@ removeSession(UA_SessionManager *sm, session_list_entry *sentry) {
     /* Detach the session from the session manager and make the capacity
      * available */
     LIST_REMOVE(sentry, pointers);
+    LIST_REMOVE(sentry, tokenPointers);
+    LIST_REMOVE(sentry, idPointers);
+    session_timeout_zip_ZIP_REMOVE(&sm->timeouts, sentry);
     UA_atomic_subUInt32(&sm->currentSessionCount, 1);
     return UA_STATUSCODE_GOOD;
 }
@@ -65,39 +108,58 @@ removeSession(UA_SessionManager *sm, session_list_entry *sentry) {
 void
 UA_SessionManager_cleanupTimedOut(UA_SessionManager *sm,
                                   UA_DateTime nowMonotonic) {
-    session_list_entry *sentry, *temp;
-    LIST_FOREACH_SAFE(sentry, &sm->sessions, pointers, temp) {
-        /* Session has timed out? */
-        if(sentry->session.validTill >= nowMonotonic)
+    /* Only visit sessions whose timeout key has been reached */
+    session_list_entry *sentry;
+    while((sentry = session_timeout_zip_ZIP_MIN(&sm->timeouts)) &&
+          sentry->timeout < nowMonotonic) {
+        /* The session was used in the meantime. Move to the new timeout. */
+        if(sentry->session.validTill >= nowMonotonic) {
+            session_timeout_zip_ZIP_REMOVE(&sm->timeouts, sentry);
+            sentry->timeout = sentry->session.validTill;
+            session_timeout_zip_ZIP_INSERT(&sm->timeouts, sentry);
             continue;
+        }
+
+        /* Session has timed out */
         UA_LOG_INFO_SESSION(sm->server->config.logger, &sentry->session,
                             "Session has timed out");
         sm->server->config.accessControl.closeSession(sm->server,
                                                       &sm->server->config.accessControl,
                                                       &sentry->session.sessionId,
                                                       sentry->session.sessionHandle);
-        removeSession(sm, sentry);
+        if(removeSession(sm, sentry) != UA_STATUSCODE_GOOD)
+            break; /* Try again next time */
     }
 }
 
-UA_Session *
-UA_SessionManager_getSessionByToken(UA_SessionManager *sm, const UA_NodeId *token) {
-    session_list_entry *current = NULL;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        /* Token does not match */
-        if(!UA_NodeId_equal(&current->session.header.authenticationToken, token))
-            continue;
-
-        /* Session has timed out */
-        if(UA_DateTime_nowMonotonic() > current->session.validTill) {
-            UA_LOG_INFO_SESSION(sm->server->config.logger, &current->session,
-                                "Client tries to use a session that has timed out");
-            return NULL;
-        }
+static UA_Session *
+checkTimedOut(UA_SessionManager *sm, session_list_entry *sentry) {
+    if(UA_DateTime_nowMonotonic() > sentry->session.validTill) {
+        UA_LOG_INFO_SESSION(sm->server->config.logger, &sentry->session,
+                            "Client tries to use a session that has timed out");
+        return NULL;
+    }
+    return &sentry->session;
+}
 
-        /* Ok, return */
-        return &current->session;
+static session_list_entry *
+findByToken(UA_SessionManager *sm, const UA_NodeId *token) {
+    if(sm->bucketsSize == 0)
+        return NULL;
+    session_list_entry *current;
+    LIST_FOREACH(current, getSessionBucket(sm->tokenBuckets, sm->bucketsSize, token),
+                 tokenPointers) {
+        if(UA_NodeId_equal(&current->session.header.authenticationToken, token))
+            return current;
     }
+    return NULL;
+}
+
+UA_Session *
+UA_SessionManager_getSessionByToken(UA_SessionManager *sm, const UA_NodeId *token) {
+    session_list_entry *current = findByToken(sm, token);
+    if(current)
+        return checkTimedOut(sm, current);
 
     /* Session not found */
     UA_LOG_INFO(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
@@ -108,21 +170,13 @@ UA_SessionManager_getSessionByToken(UA_SessionManager *sm, const UA_NodeId *toke
 
 UA_Session *
 UA_SessionManager_getSessionById(UA_SessionManager *sm, const UA_NodeId *sessionId) {
-    session_list_entry *current = NULL;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        /* Token does not match */
-        if(!UA_NodeId_equal(&current->session.sessionId, sessionId))
-            continue;
-
-        /* Session has timed out */
-        if(UA_DateTime_nowMonotonic() > current->session.validTill) {
-            UA_LOG_INFO_SESSION(sm->server->config.logger, &current->session,
-                                "Client tries to use a session that has timed out");
-            return NULL;
+    if(sm->bucketsSize > 0) {
+        session_list_entry *current;
+        LIST_FOREACH(current, getSessionBucket(sm->idBuckets, sm->bucketsSize, sessionId),
+                     idPointers) {
+            if(UA_NodeId_equal(&current->session.sessionId, sessionId))
+                return checkTimedOut(sm, current);
         }
-
-        /* Ok, return */
-        return &current->session;
     }
 
     /* Session not found */
@@ -138,6 +192,8 @@ UA_SessionManager_createSession(UA_SessionManager *sm, UA_SecureChannel *channel
                                 const UA_CreateSessionRequest *request, UA_Session **session) {
     if(sm->currentSessionCount >= sm->server->config.maxSessions)
         return UA_STATUSCODE_BADTOOMANYSESSIONS;
+    if(sm->bucketsSize == 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
 
     session_list_entry *newentry = (session_list_entry *)UA_malloc(sizeof(session_list_entry));
     if(!newentry)
@@ -155,18 +211,22 @@ UA_SessionManager_createSession(UA_SessionManager *sm, UA_SecureChannel *channel
         newentry->session.timeout = sm->server->config.maxSessionTimeout;
 
     UA_Session_updateLifetime(&newentry->session);
+    newentry->timeout = newentry->session.validTill;
     LIST_INSERT_HEAD(&sm->sessions, newentry, pointers);
+    LIST_INSERT_HEAD(getSessionBucket(sm->tokenBuckets, sm->bucketsSize,
+                               &newentry->session.header.authenticationToken),
+                     newentry, tokenPointers);
+    LIST_INSERT_HEAD(getSessionBucket(sm->idBuckets, sm->bucketsSize,
+                               &newentry->session.sessionId),
+                     newentry, idPointers);
+    session_timeout_zip_ZIP_INSERT(&sm->timeouts, newentry);
     *session = &newentry->session;
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_SessionManager_removeSession(UA_SessionManager *sm, const UA_NodeId *token) {
-    session_list_entry *current;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        if(UA_NodeId_equal(&current->session.header.authenticationToken, token))
-            break;
-    }
+    session_list_entry *current = findByToken(sm, token);
     if(!current)
         return UA_STATUSCODE_BADSESSIONIDINVALID;
     return removeSession(sm, current);
@@ -23,13 +23,32 @@ extern "C" {
 
 typedef struct session_list_entry {
     LIST_ENTRY(session_list_entry) pointers;
+    LIST_ENTRY(session_list_entry) tokenPointers; /* Bucket by authenticationToken */
+    LIST_ENTRY(session_list_entry) idPointers;    /* Bucket by sessionId */
+    ZIP_ENTRY(session_list_entry) timeoutZipfields;
+    UA_DateTime timeout; /* Key in the timeout tree. The session lifetime is
+                          * updated with every request. The tree is only
+                          * updated when the key is reached during cleanup.
+                          * So timeout <= session.validTill. */
     UA_Session session;
 } session_list_entry;
 
+LIST_HEAD(session_bucket, session_list_entry);
+ZIP_HEAD(session_timeout_zip, session_list_entry);
+
 typedef struct UA_SessionManager {
     LIST_HEAD(session_list, session_list_entry) sessions; // doubly-linked list of sessions
     UA_UInt32 currentSessionCount;
     UA_Server *server;
+
+    /* Hashed lookup. The number of buckets is a power of two and fixed at
+     * init from the config maxSessions. */
+    size_t bucketsSize;
+    struct session_bucket *tokenBuckets;
+    struct session_bucket *idBuckets;
+
+    /* Sessions ordered by their timeout */
+    struct session_timeout_zip timeouts;
 } UA_SessionManager;
 
 UA_StatusCode
@@ -368,6 +368,19 @@ void
 UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
     UA_LOG_DEBUG_SESSION(server->config.logger, sub->session, "Subscription %u | "
                          "Publish Callback", sub->subscriptionId);
+
+    /* Backpressure. The client does not read the responses fast enough. Keep
+     * the notifications in the queues of the MonitoredItems and retry in the
+     * next publishing interval. */
+    UA_SecureChannel *channel = sub->session->header.channel;
+    if(channel && channel->connection &&
+       UA_Connection_isCongested(channel->connection)) {
+        UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
+                             "Subscription %u | The connection is congested. "
+                             "Defer publishing.", sub->subscriptionId);
+        return;
+    }
+
     /* Dequeue a response */
     UA_PublishResponseEntry *pre = UA_Session_dequeuePublishReq(sub->session);
     if(pre) {
@@ -417,7 +430,6 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
     }
 
     /* We want to send a response. Is the channel open? */
-    UA_SecureChannel *channel = sub->session->header.channel;
     if(!channel || !pre) {
         UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
                              "Subscription %u | Want to send a publish response but can't. "
@@ -80,6 +80,15 @@ void UA_Notification_delete(UA_Subscription *sub, UA_MonitoredItem *mon,
 
 typedef TAILQ_HEAD(NotificationQueue, UA_Notification) NotificationQueue;
 
+/* The MonitoredItems that are sampled when the node is written */
+typedef struct UA_MonitoredNode {
+    ZIP_ENTRY(UA_MonitoredNode) zipfields;
+    UA_NodeId nodeId;
+    LIST_HEAD(, UA_MonitoredItem) monitoredItems;
+} UA_MonitoredNode;
+
+ZIP_HEAD(UA_MonitoredNodeTree, UA_MonitoredNode);
+
 struct UA_MonitoredItem {
     LIST_ENTRY(UA_MonitoredItem) listEntry;
     UA_Subscription *subscription;
@@ -103,13 +112,22 @@ struct UA_MonitoredItem {
 #endif
         UA_DataChangeFilter dataChangeFilter;
     } filter;
-    UA_Variant lastValue;
 
     /* Sample Callback */
     UA_UInt64 sampleCallbackId;
-    UA_ByteString lastSampledValue;
     UA_Boolean sampleCallbackIsRegistered;
 
+    /* Sample when the node is written. The sample callback is registered only
+     * until no more writes arrive within the sampling interval. */
+    UA_MonitoredNode *monitoredNode;
+    LIST_ENTRY(UA_MonitoredItem) monitoredNodeEntry;
+
+    /* The last sample with the DataChangeFilter applied. The version of the
+     * sampled VariableNode is zero if the sample cannot be reused. */
+    UA_Boolean hasLastSample;
+    UA_UInt32 lastSampledVersion;
+    UA_DataValue lastSampledValue;
+
     /* Notification Queue */
     NotificationQueue queue;
     UA_UInt32 queueSize;
@@ -121,9 +139,14 @@ struct UA_MonitoredItem {
 void UA_MonitoredItem_init(UA_MonitoredItem *mon, UA_Subscription *sub);
 void UA_MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *mon);
 void UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *mon);
+/* The next sample is always reported as a change */
+void UA_MonitoredItem_resetLastSample(UA_MonitoredItem *mon);
 UA_StatusCode UA_MonitoredItem_registerSampleCallback(UA_Server *server, UA_MonitoredItem *mon);
 UA_StatusCode UA_MonitoredItem_unregisterSampleCallback(UA_Server *server, UA_MonitoredItem *mon);
 
+/* Sample the MonitoredItems that wait for a write of the node */
+void UA_MonitoredNode_notifyWrite(UA_Server *server, const UA_NodeId *nodeId);
+
 /* Remove entries until mon->maxQueueSize is reached. Sets infobits for lost
  * data if required. */
 UA_StatusCode MonitoredItem_ensureQueueSpace(UA_Server *server, UA_MonitoredItem *mon);
@@ -10,12 +10,9 @@
 
 #include "ua_server_internal.h"
 #include "ua_subscription.h"
-#include "ua_types_encoding_binary.h"
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
-#define UA_VALUENCODING_MAXSTACK 512
-
 void UA_MonitoredItem_init(UA_MonitoredItem *mon, UA_Subscription *sub) {
     memset(mon, 0, sizeof(UA_MonitoredItem));
     mon->subscription = sub;
@@ -82,8 +79,7 @@ void UA_MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *monitoredItem)
 
     /* Remove the monitored item */
     UA_String_deleteMembers(&monitoredItem->indexRange);
-    UA_ByteString_deleteMembers(&monitoredItem->lastSampledValue);
-    UA_Variant_deleteMembers(&monitoredItem->lastValue);
+    UA_DataValue_deleteMembers(&monitoredItem->lastSampledValue);
     UA_NodeId_deleteMembers(&monitoredItem->monitoredNodeId);
     UA_Server_delayedFree(server, monitoredItem);
 }
@@ -267,23 +263,17 @@ updateNeededForFilteredValue(const UA_Variant *value, const UA_Variant *oldValue
     return false;
 }
 
-/* When a change is detected, encoding contains the heap-allocated binary encoded value */
+/* Has the filtered sample changed from the last one? */
 static UA_Boolean
-detectValueChangeWithFilter(UA_Server *server, UA_MonitoredItem *mon, UA_DataValue *value,
-                            UA_ByteString *encoding) {
-    UA_Session *session = &adminSession;
-    UA_UInt32 subscriptionId = 0;
-    UA_Subscription *sub = mon->subscription;
-    if(sub) {
-        session = sub->session;
-        subscriptionId = sub->subscriptionId;
-    }
+detectValueChange(UA_MonitoredItem *mon, const UA_DataValue *value) {
+    if(!mon->hasLastSample)
+        return true;
 
     if(isDataTypeNumeric(value->value.type) &&
        (mon->filter.dataChangeFilter.trigger == UA_DATACHANGETRIGGER_STATUSVALUE ||
         mon->filter.dataChangeFilter.trigger == UA_DATACHANGETRIGGER_STATUSVALUETIMESTAMP)) {
         if(mon->filter.dataChangeFilter.deadbandType == UA_DEADBANDTYPE_ABSOLUTE) {
-            if(!updateNeededForFilteredValue(&value->value, &mon->lastValue,
+            if(!updateNeededForFilteredValue(&value->value, &mon->lastSampledValue.value,
                                              mon->filter.dataChangeFilter.deadbandValue))
                 return false;
         }
@@ -295,105 +285,64 @@ detectValueChangeWithFilter(UA_Server *server, UA_MonitoredItem *mon, UA_DataVal
         }*/
     }
 
-    /* Stack-allocate some memory for the value encoding. We might heap-allocate
-     * more memory if needed. This is just enough for scalars and small
-     * structures. */
-    UA_STACKARRAY(UA_Byte, stackValueEncoding, UA_VALUENCODING_MAXSTACK);
-    UA_ByteString valueEncoding;
-    valueEncoding.data = stackValueEncoding;
-    valueEncoding.length = UA_VALUENCODING_MAXSTACK;
-
-    /* Encode the value */
-    UA_Byte *bufPos = valueEncoding.data;
-    const UA_Byte *bufEnd = &valueEncoding.data[valueEncoding.length];
-    UA_StatusCode retval = UA_encodeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE],
-                                           &bufPos, &bufEnd, NULL, NULL);
-    if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
-        size_t binsize = UA_calcSizeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE]);
-        if(binsize == 0)
-            return false;
-        retval = UA_ByteString_allocBuffer(&valueEncoding, binsize);
-        if(retval == UA_STATUSCODE_GOOD) {
-            bufPos = valueEncoding.data;
-            bufEnd = &valueEncoding.data[valueEncoding.length];
-            retval = UA_encodeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE],
-                                     &bufPos, &bufEnd, NULL, NULL);
-        }
-    }
+    /* Compare the typed values. This is equivalent to comparing the binary
+     * encoding but does not allocate. */
+    return !UA_equal(value, &mon->lastSampledValue, &UA_TYPES[UA_TYPES_DATAVALUE]);
+}
 
+/* Store the filtered sample for the comparison with the next sample */
+static void
+storeLastSample(UA_Server *server, UA_MonitoredItem *mon,
+                const UA_DataValue *value, UA_UInt32 version) {
+    UA_DataValue_deleteMembers(&mon->lastSampledValue);
+    UA_StatusCode retval = UA_DataValue_copy(value, &mon->lastSampledValue);
     if(retval != UA_STATUSCODE_GOOD) {
+        UA_Session *session = &adminSession;
+        UA_UInt32 subscriptionId = 0;
+        if(mon->subscription) {
+            session = mon->subscription->session;
+            subscriptionId = mon->subscription->subscriptionId;
+        }
         UA_LOG_WARNING_SESSION(server->config.logger, session,
                                "Subscription %u | MonitoredItem %i | "
-                               "Could not encode the value the MonitoredItem with status %s",
-                               subscriptionId, mon->monitoredItemId, UA_StatusCode_name(retval));
-        return false;
-    }
-
-    /* Has the value changed? */
-    valueEncoding.length = (uintptr_t)bufPos - (uintptr_t)valueEncoding.data;
-    UA_Boolean changed = (!mon->lastSampledValue.data ||
-                          !UA_String_equal(&valueEncoding, &mon->lastSampledValue));
-
-    /* No change */
-    if(!changed) {
-        if(valueEncoding.data != stackValueEncoding)
-            UA_ByteString_deleteMembers(&valueEncoding);
-        return false;
-    }
-
-    /* Change detected. Copy encoding on the heap if necessary. */
-    if(valueEncoding.data == stackValueEncoding) {
-        retval = UA_ByteString_copy(&valueEncoding, encoding);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_WARNING_SESSION(server->config.logger, session,
-                                   "Subscription %u | MonitoredItem %i | "
-                                   "Detected change, but could not allocate memory for the notification"
-                                   "with status %s", subscriptionId, mon->monitoredItemId,
-                                   UA_StatusCode_name(retval));
-            return false;
-        }
-        return true;
-    }
-
-    *encoding = valueEncoding;
-    return true;
-}
-
-/* Has this sample changed from the last one? The method may allocate additional
- * space for the encoding buffer. Detect the change in encoding->data. */
-static UA_Boolean
-detectValueChange(UA_Server *server, UA_MonitoredItem *mon,
-                  UA_DataValue value, UA_ByteString *encoding) {
-    /* Apply Filter */
-    if(mon->filter.dataChangeFilter.trigger == UA_DATACHANGETRIGGER_STATUS)
-        value.hasValue = false;
-
-    value.hasServerTimestamp = false;
-    value.hasServerPicoseconds = false;
-    if(mon->filter.dataChangeFilter.trigger < UA_DATACHANGETRIGGER_STATUSVALUETIMESTAMP) {
-        value.hasSourceTimestamp = false;
-        value.hasSourcePicoseconds = false;
+                               "Could not store the sample with status %s",
+                               subscriptionId, mon->monitoredItemId,
+                               UA_StatusCode_name(retval));
+        UA_MonitoredItem_resetLastSample(mon);
+        return;
     }
-
-    /* Detect the value change */
-    return detectValueChangeWithFilter(server, mon, &value, encoding);
+    mon->hasLastSample = true;
+    mon->lastSampledVersion = version;
 }
 
-/* Returns whether the sample was stored in the MonitoredItem */
+/* Returns whether the sample was stored in the MonitoredItem. The version is
+ * that of the sampled VariableNode or zero. */
 static UA_Boolean
 sampleCallbackWithValue(UA_Server *server, UA_MonitoredItem *monitoredItem,
-                        UA_DataValue *value) {
+                        UA_DataValue *value, UA_UInt32 version) {
     UA_assert(monitoredItem->monitoredItemType == UA_MONITOREDITEMTYPE_CHANGENOTIFY);
     UA_Subscription *sub = monitoredItem->subscription;
 
-    /* Contains heap-allocated binary encoding of the value if a change was detected */
-    UA_ByteString binaryEncoding = UA_BYTESTRING_NULL;
+    /* Apply the filter to a shallow copy of the value */
+    UA_DataValue filtered = *value;
+    if(monitoredItem->filter.dataChangeFilter.trigger == UA_DATACHANGETRIGGER_STATUS)
+        filtered.hasValue = false;
+    filtered.hasServerTimestamp = false;
+    filtered.hasServerPicoseconds = false;
+    if(monitoredItem->filter.dataChangeFilter.trigger < UA_DATACHANGETRIGGER_STATUSVALUETIMESTAMP) {
+        filtered.hasSourceTimestamp = false;
+        filtered.hasSourcePicoseconds = false;
+    }
 
-    /* Has the value changed? Allocates memory in binaryEncoding if necessary.
-     * value is edited internally so we make a shallow copy. */
-    UA_Boolean changed = detectValueChange(server, monitoredItem, *value, &binaryEncoding);
-    if(!changed)
+    /* Has the value changed? */
+    if(!detectValueChange(monitoredItem, &filtered)) {
+        /* The last sample is also up to date for the current node version */
+        monitoredItem->lastSampledVersion = version;
         return false;
+    }
+
+    /* Store the sample before the value is moved to the notification */
+    storeLastSample(server, monitoredItem, &filtered, version);
 
     UA_Boolean storedValue = false;
     if(sub) {
@@ -404,7 +353,7 @@ sampleCallbackWithValue(UA_Server *server, UA_MonitoredItem *monitoredItem,
                                    "Subscription %u | MonitoredItem %i | "
                                    "Item for the publishing queue could not be allocated",
                                    sub->subscriptionId, monitoredItem->monitoredItemId);
-            UA_ByteString_deleteMembers(&binaryEncoding);
+            UA_MonitoredItem_resetLastSample(monitoredItem);
             return false;
         }
 
@@ -428,15 +377,44 @@ sampleCallbackWithValue(UA_Server *server, UA_MonitoredItem *monitoredItem,
                                               value);
     }
 
-    /* Store the encoding for comparison */
-    UA_ByteString_deleteMembers(&monitoredItem->lastSampledValue);
-    monitoredItem->lastSampledValue = binaryEncoding;
-    UA_Variant_deleteMembers(&monitoredItem->lastValue);
-    UA_Variant_copy(&value->value, &monitoredItem->lastValue);
-
     return storedValue;
 }
 
+/* Returns the version of the sampled VariableNode if it can be used to detect
+ * that the value is unchanged. Otherwise zero. Values from a DataSource or with
+ * an onRead callback change without an edit of the node. */
+static UA_UInt32
+getValueVersion(UA_Server *server, UA_Session *session, UA_MonitoredItem *mon) {
+    if(mon->attributeId != UA_ATTRIBUTEID_VALUE)
+        return 0;
+    const UA_Node *node = UA_Nodestore_get(server, &mon->monitoredNodeId);
+    if(!node)
+        return 0;
+    UA_UInt32 version = 0;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    if(node->nodeClass == UA_NODECLASS_VARIABLE &&
+       vn->valueSource == UA_VALUESOURCE_DATA &&
+       !vn->value.data.callback.onRead) {
+        version = vn->valueVersion;
+        /* The access rights of the user are not part of the version */
+        if(session != &adminSession &&
+           !(vn->accessLevel & UA_ACCESSLEVELMASK_READ &
+             server->config.accessControl.getUserAccessLevel(server, &server->config.accessControl,
+                                                             &session->sessionId, session->sessionHandle,
+                                                             &node->nodeId, node->context)))
+            version = 0;
+    }
+    UA_Nodestore_release(server, node);
+    return version;
+}
+
+void
+UA_MonitoredItem_resetLastSample(UA_MonitoredItem *mon) {
+    UA_DataValue_deleteMembers(&mon->lastSampledValue);
+    mon->hasLastSample = false;
+    mon->lastSampledVersion = 0;
+}
+
 void
 UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *monitoredItem) {
     UA_Session *session = &adminSession;
@@ -454,6 +432,11 @@ UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *monitoredIt
         return;
     }
 
+    /* The node was not edited since the last sample. Skip the sampling. */
+    UA_UInt32 version = getValueVersion(server, session, monitoredItem);
+    if(version != 0 && version == monitoredItem->lastSampledVersion)
+        return;
+
     /* Sample the value */
     UA_ReadValueId rvid;
     UA_ReadValueId_init(&rvid);
@@ -462,23 +445,140 @@ UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *monitoredIt
     rvid.indexRange = monitoredItem->indexRange;
     UA_DataValue value = UA_Server_readWithSession(server, session, &rvid, monitoredItem->timestampsToReturn);
 
+    /* Don't reuse samples where the read failed */
+    if(value.hasStatus && value.status != UA_STATUSCODE_GOOD)
+        version = 0;
+
     /* Operate on the sample */
-    UA_Boolean storedValue = sampleCallbackWithValue(server, monitoredItem, &value);
+    UA_Boolean storedValue = sampleCallbackWithValue(server, monitoredItem, &value, version);
 
     /* Delete the sample if it was not stored in the MonitoredItem  */
     if(!storedValue)
         UA_DataValue_deleteMembers(&value);
 }
 
+/*******************/
+/* Sample on Write */
+/*******************/
+
+/* The nodes are written from the worker threads. The tree of MonitoredNodes is
+ * not locked. So the MonitoredItems are always sampled in the interval with
+ * multithreading. */
+#ifndef UA_ENABLE_MULTITHREADING
+
+ZIP_IMPL(UA_MonitoredNodeTree, UA_MonitoredNode, zipfields,
+         UA_NodeId, nodeId, cmpNodeId)
+
+/* Only values stored in the node change with a write */
+static UA_Boolean
+canSampleOnWrite(UA_Server *server, UA_MonitoredItem *mon) {
+    if(!server->config.sampleOnWrite || mon->attributeId != UA_ATTRIBUTEID_VALUE)
+        return false;
+    const UA_Node *node = UA_Nodestore_get(server, &mon->monitoredNodeId);
+    if(!node)
+        return false;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    UA_Boolean res = (node->nodeClass == UA_NODECLASS_VARIABLE &&
+                      vn->valueSource == UA_VALUESOURCE_DATA &&
+                      !vn->value.data.callback.onRead);
+    UA_Nodestore_release(server, node);
+    return res;
+}
+
+static UA_StatusCode
+addToMonitoredNode(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_MonitoredNode *mn =
+        UA_MonitoredNodeTree_ZIP_FIND(&server->monitoredNodes, &mon->monitoredNodeId);
+    if(!mn) {
+        mn = (UA_MonitoredNode*)UA_malloc(sizeof(UA_MonitoredNode));
+        if(!mn)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_StatusCode retval = UA_NodeId_copy(&mon->monitoredNodeId, &mn->nodeId);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_free(mn);
+            return retval;
+        }
+        LIST_INIT(&mn->monitoredItems);
+        UA_MonitoredNodeTree_ZIP_INSERT(&server->monitoredNodes, mn);
+    }
+    LIST_INSERT_HEAD(&mn->monitoredItems, mon, monitoredNodeEntry);
+    mon->monitoredNode = mn;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+removeFromMonitoredNode(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_MonitoredNode *mn = mon->monitoredNode;
+    LIST_REMOVE(mon, monitoredNodeEntry);
+    mon->monitoredNode = NULL;
+    if(!LIST_EMPTY(&mn->monitoredItems))
+        return;
+    UA_MonitoredNodeTree_ZIP_REMOVE(&server->monitoredNodes, mn);
+    UA_NodeId_deleteMembers(&mn->nodeId);
+    UA_free(mn);
+}
+
+/* Samples in the interval while the node is written. Stops when no write
+ * arrived since the last sample. */
+static void
+sampleOnWriteCallback(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_UInt32 version = mon->lastSampledVersion;
+    UA_MonitoredItem_sampleCallback(server, mon);
+    /* Without a version, fall back to sampling in the interval */
+    if(version == 0 || version != mon->lastSampledVersion)
+        return;
+    mon->sampleCallbackIsRegistered = false;
+    UA_Server_removeRepeatedCallback(server, mon->sampleCallbackId);
+}
+
+void
+UA_MonitoredNode_notifyWrite(UA_Server *server, const UA_NodeId *nodeId) {
+    if(ZIP_EMPTY(&server->monitoredNodes))
+        return;
+    UA_MonitoredNode *mn = UA_MonitoredNodeTree_ZIP_FIND(&server->monitoredNodes, nodeId);
+    if(!mn)
+        return;
+    UA_MonitoredItem *mon, *mon_tmp;
+    LIST_FOREACH_SAFE(mon, &mn->monitoredItems, monitoredNodeEntry, mon_tmp) {
+        /* Rate-limited. The next sample is already scheduled. */
+        if(mon->sampleCallbackIsRegistered)
+            continue;
+
+        /* Schedule the next sample before sampling. The local callback might
+         * write to the node again. */
+        UA_StatusCode retval =
+            UA_Server_addRepeatedCallback(server, (UA_ServerCallback)sampleOnWriteCallback,
+                                          mon, (UA_UInt32)mon->samplingInterval,
+                                          &mon->sampleCallbackId);
+        if(retval == UA_STATUSCODE_GOOD)
+            mon->sampleCallbackIsRegistered = true;
+        UA_MonitoredItem_sampleCallback(server, mon);
+    }
+}
+
+#else
+
+void
+UA_MonitoredNode_notifyWrite(UA_Server *server, const UA_NodeId *nodeId) {}
+
+#endif /* UA_ENABLE_MULTITHREADING */
+
 UA_StatusCode
 UA_MonitoredItem_registerSampleCallback(UA_Server *server, UA_MonitoredItem *mon) {
-    if(mon->sampleCallbackIsRegistered)
+    if(mon->sampleCallbackIsRegistered || mon->monitoredNode)
         return UA_STATUSCODE_GOOD;
 
     /* Only DataChange MonitoredItems have a callback with a sampling interval */
     if(mon->monitoredItemType != UA_MONITOREDITEMTYPE_CHANGENOTIFY)
         return UA_STATUSCODE_GOOD;
 
+#ifndef UA_ENABLE_MULTITHREADING
+    /* Wait for writes to the node */
+    if(canSampleOnWrite(server, mon) &&
+       addToMonitoredNode(server, mon) == UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_GOOD;
+#endif
+
     UA_StatusCode retval =
         UA_Server_addRepeatedCallback(server, (UA_ServerCallback)UA_MonitoredItem_sampleCallback,
                                       mon, (UA_UInt32)mon->samplingInterval, &mon->sampleCallbackId);
@@ -489,6 +589,10 @@ UA_MonitoredItem_registerSampleCallback(UA_Server *server, UA_MonitoredItem *mon
 
 UA_StatusCode
 UA_MonitoredItem_unregisterSampleCallback(UA_Server *server, UA_MonitoredItem *mon) {
+#ifndef UA_ENABLE_MULTITHREADING
+    if(mon->monitoredNode)
+        removeFromMonitoredNode(server, mon);
+#endif
     if(!mon->sampleCallbackIsRegistered)
         return UA_STATUSCODE_GOOD;
     mon->sampleCallbackIsRegistered = false;
@@ -10,16 +10,6 @@
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
 
-typedef struct Events_nodeListElement {
-    LIST_ENTRY(Events_nodeListElement) listEntry;
-    UA_NodeId nodeId;
-} Events_nodeListElement;
-
-struct getNodesHandle {
-    UA_Server *server;
-    LIST_HEAD(Events_nodeList, Events_nodeListElement) nodes;
-};
-
 /* generates a unique event id */
 static UA_StatusCode
 UA_Event_generateEventId(UA_Server *server, UA_ByteString *generatedId) {
@@ -51,9 +41,8 @@ UA_Server_createEvent(UA_Server *server, const UA_NodeId eventType, UA_NodeId *o
     }
 
     /* Make sure the eventType is a subtype of BaseEventType */
-    UA_NodeId hasSubtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
     UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
-    if(!isNodeInTree(&server->config.nodestore, &eventType, &baseEventTypeId, &hasSubtypeId, 1)) {
+    if(!isSubtypeOf(server, &eventType, &baseEventTypeId)) {
         UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_USERLAND,
                      "Event type must be a subtype of BaseEventType!");
         return UA_STATUSCODE_BADINVALIDARGUMENT;
@@ -117,9 +106,8 @@ isValidEvent(UA_Server *server, const UA_NodeId *validEventParent, const UA_Node
         UA_BrowsePathResult_deleteMembers(&bpr);
         return UA_FALSE;
     }
-    UA_NodeId hasSubtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    UA_Boolean tmp = isNodeInTree(&server->config.nodestore, &bpr.targets[0].targetId.nodeId,
-                                  validEventParent, &hasSubtypeId, 1);
+    UA_Boolean tmp = isSubtypeOf(server, &bpr.targets[0].targetId.nodeId,
+                                 validEventParent);
     UA_BrowsePathResult_deleteMembers(&bpr);
     return tmp;
 }
@@ -239,6 +227,91 @@ UA_Server_filterEvent(UA_Server *server, UA_Session *session,
     return UA_STATUSCODE_GOOD;
 }
 
+/* An event without a node representation */
+typedef struct {
+    const UA_NodeId *eventType;
+    size_t standardFieldsSize;
+    const UA_EventField *standardFields;
+    size_t fieldsSize;
+    const UA_EventField *fields;
+    const UA_EventField *timeField; /* Used if Time is not among the fields */
+} UA_EventFields;
+
+static UA_Boolean
+matchEventField(const UA_SimpleAttributeOperand *sao, const UA_EventField *field) {
+    if(sao->browsePathSize != field->browsePathSize)
+        return false;
+    for(size_t i = 0; i < sao->browsePathSize; i++) {
+        if(!UA_QualifiedName_equal(&sao->browsePath[i], &field->browsePath[i]))
+            return false;
+    }
+    return true;
+}
+
+static const UA_Variant *
+findEventField(const UA_EventFields *event, const UA_SimpleAttributeOperand *sao) {
+    for(size_t i = 0; i < event->standardFieldsSize; i++) {
+        if(matchEventField(sao, &event->standardFields[i]))
+            return &event->standardFields[i].value;
+    }
+    for(size_t i = 0; i < event->fieldsSize; i++) {
+        if(matchEventField(sao, &event->fields[i]))
+            return &event->fields[i].value;
+    }
+    if(matchEventField(sao, event->timeField))
+        return &event->timeField->value;
+    return NULL;
+}
+
+/* Same as UA_Server_filterEvent. But the select clauses are evaluated against
+ * the fields of the event instead of the children of an event node. */
+static UA_StatusCode
+UA_Server_filterEventFields(UA_Server *server, UA_Session *session,
+                            const UA_EventFields *event, UA_EventFilter *filter,
+                            UA_EventNotification *notification) {
+    if(filter->selectClausesSize == 0)
+        return UA_STATUSCODE_BADEVENTFILTERINVALID;
+
+    UA_EventFieldList_init(&notification->fields);
+    notification->fields.eventFields = (UA_Variant *)
+        UA_Array_new(filter->selectClausesSize, &UA_TYPES[UA_TYPES_VARIANT]);
+    if(!notification->fields.eventFields)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    notification->fields.eventFieldsSize = filter->selectClausesSize;
+
+    UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
+    for(size_t i = 0; i < filter->selectClausesSize; i++) {
+        const UA_SimpleAttributeOperand *sao = &filter->selectClauses[i];
+        UA_Variant *field = &notification->fields.eventFields[i];
+        if(!UA_NodeId_equal(&sao->typeDefinitionId, &baseEventTypeId) &&
+           !isSubtypeOf(server, event->eventType, &sao->typeDefinitionId))
+            continue;
+
+        /* Attribute of the type definition */
+        if(sao->browsePathSize == 0) {
+            resolveSimpleAttributeOperand(server, session, NULL, sao, field);
+            continue;
+        }
+
+        /* The fields have only values */
+        if(sao->attributeId != UA_ATTRIBUTEID_VALUE)
+            continue;
+        const UA_Variant *value = findEventField(event, sao);
+        if(!value)
+            continue;
+        if(sao->indexRange.length == 0) {
+            UA_Variant_copy(value, field);
+            continue;
+        }
+        UA_NumericRange range;
+        if(UA_NumericRange_parseFromString(&range, &sao->indexRange) != UA_STATUSCODE_GOOD)
+            continue;
+        UA_Variant_copyRange(value, field, range);
+        UA_free(range.dimensions);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
 static UA_StatusCode
 eventSetStandardFields(UA_Server *server, const UA_NodeId *event,
                        const UA_NodeId *origin, UA_ByteString *outEventId) {
@@ -306,40 +379,189 @@ eventSetStandardFields(UA_Server *server, const UA_NodeId *event,
     return UA_STATUSCODE_GOOD;
 }
 
-/* Insert each node into the list (passed as handle) */
+/*************************/
+/* Event Notifier Cache  */
+/*************************/
+
+ZIP_IMPL(UA_EventNotifierTree, UA_EventNotifierEntry, zipfields, UA_NodeId, origin, cmpNodeId)
+
+static UA_Boolean
+containsNotifier(const UA_EventNotifierEntry *e, const UA_NodeId *nodeId) {
+    for(size_t i = 0; i < e->notifiersSize; i++) {
+        if(UA_NodeId_equal(&e->notifiers[i], nodeId))
+            return true;
+    }
+    return false;
+}
+
 static UA_StatusCode
-getParentsNodeIteratorCallback(UA_NodeId parentId, UA_Boolean isInverse,
-                               UA_NodeId referenceTypeId, struct getNodesHandle *handle) {
-    /* Parents have an inverse reference */
-    if(!isInverse)
-        return UA_STATUSCODE_GOOD;
+addNotifier(UA_EventNotifierEntry *e, const UA_NodeId *nodeId) {
+    /* Grow at powers of two */
+    if((e->notifiersSize & (e->notifiersSize - 1)) == 0) {
+        size_t capacity = (e->notifiersSize == 0) ? 4 : e->notifiersSize * 2;
+        UA_NodeId *notifiers = (UA_NodeId*)
+            UA_realloc(e->notifiers, sizeof(UA_NodeId) * capacity);
+        if(!notifiers)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        e->notifiers = notifiers;
+    }
+    UA_StatusCode retval = UA_NodeId_copy(nodeId, &e->notifiers[e->notifiersSize]);
+    if(retval == UA_STATUSCODE_GOOD)
+        e->notifiersSize++;
+    return retval;
+}
 
-    /* Is this a hierarchical reference? */
-    if(!isNodeInTree(&handle->server->config.nodestore, &referenceTypeId,
-                     &hierarchicalReferences, &subtypeId, 1))
+/* Add the parents via inverse hierarchical references and their parents */
+static UA_StatusCode
+addParentNotifiers(UA_Server *server, UA_EventNotifierEntry *e,
+                   const UA_NodeId *nodeId, size_t depth) {
+    if(depth >= UA_MAX_TREE_RECURSE)
         return UA_STATUSCODE_GOOD;
+    const UA_Node *node = UA_Nodestore_get(server, nodeId);
+    if(!node)
+        return UA_STATUSCODE_GOOD;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; i++) {
+        const UA_NodeReferenceKind *refs = &node->references[i];
+        if(!refs->isInverse ||
+           !isSubtypeOf(server, &refs->referenceTypeId, &hierarchicalReferences))
+            continue;
+        for(size_t j = 0; j < refs->targetIdsSize && retval == UA_STATUSCODE_GOOD; j++) {
+            const UA_NodeId *parent = &refs->targetIds[j].nodeId;
+            if(containsNotifier(e, parent))
+                continue;
+            retval = addNotifier(e, parent);
+            if(retval == UA_STATUSCODE_GOOD)
+                retval = addParentNotifiers(server, e, parent, depth + 1);
+        }
+    }
+    UA_Nodestore_release(server, node);
+    return retval;
+}
 
-    Events_nodeListElement *entry = (Events_nodeListElement *) UA_malloc(sizeof(Events_nodeListElement));
-    if(!entry)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
+static void
+deleteEventNotifiers(UA_EventNotifierEntry *e) {
+    UA_Array_delete(e->notifiers, e->notifiersSize, &UA_TYPES[UA_TYPES_NODEID]);
+    e->notifiers = NULL;
+    e->notifiersSize = 0;
+}
+
+static void
+deleteEventNotifierEntry(UA_EventNotifierEntry *e, void *_) {
+    UA_NodeId_deleteMembers(&e->origin);
+    deleteEventNotifiers(e);
+    UA_free(e);
+}
+
+static const UA_NodeId objectsFolderId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_OBJECTSFOLDER}};
+static const UA_NodeId parentReferences_events[2] =
+    {{0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_ORGANIZES}},
+     {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASCOMPONENT}}};
 
-    UA_StatusCode retval = UA_NodeId_copy(&parentId, &entry->nodeId);
+/* The origin and all nodes that reach it via hierarchical references. An
+ * entry without notifiers needs to be computed. */
+static UA_StatusCode
+computeEventNotifiers(UA_Server *server, UA_EventNotifierEntry *e) {
+    /* Make sure the origin is in the ObjectsFolder (TODO: or in the ViewsFolder) */
+    if(!isNodeInTree(&server->config.nodestore, &e->origin, &objectsFolderId,
+                     parentReferences_events, 2)) {
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_USERLAND,
+                     "Node for event must be in ObjectsFolder!");
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+
+    /* The origin receives its own events */
+    UA_StatusCode retval = addNotifier(e, &e->origin);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = addParentNotifiers(server, e, &e->origin, 0);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_free(entry);
-        return retval;
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Events: Could not create the list of nodes listening "
+                       "on the event with StatusCode %s", UA_StatusCode_name(retval));
+        deleteEventNotifiers(e);
     }
+    return retval;
+}
 
-    LIST_INSERT_HEAD(&handle->nodes, entry, listEntry);
+/* The cache is changed during the lookup. So it is not used from the worker
+ * threads. The entry is computed for every event instead. */
+static UA_EventNotifierEntry *
+getEventNotifiers(UA_Server *server, const UA_NodeId *origin, UA_StatusCode *retval) {
+    UA_EventNotifierEntry *e = NULL;
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_EventNotifierCache *cache = &server->eventNotifierCache;
+    e = UA_EventNotifierTree_ZIP_FIND(&cache->entries, origin);
+    if(e && e->notifiersSize > 0)
+        return e;
+#endif
+
+    if(!e) {
+        e = (UA_EventNotifierEntry*)UA_calloc(1, sizeof(UA_EventNotifierEntry));
+        if(!e) {
+            *retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            return NULL;
+        }
+        *retval = UA_NodeId_copy(origin, &e->origin);
+        if(*retval != UA_STATUSCODE_GOOD) {
+            UA_free(e);
+            return NULL;
+        }
+#ifndef UA_ENABLE_MULTITHREADING
+        UA_EventNotifierTree_ZIP_INSERT(&cache->entries, e);
+#endif
+    }
 
-    /* Recursion */
-    UA_Server_forEachChildNodeCall(handle->server, parentId, (UA_NodeIteratorCallback)getParentsNodeIteratorCallback, handle);
-    return UA_STATUSCODE_GOOD;
+    /* A failed entry remains in the cache without notifiers */
+    *retval = computeEventNotifiers(server, e);
+    if(*retval != UA_STATUSCODE_GOOD) {
+#ifdef UA_ENABLE_MULTITHREADING
+        deleteEventNotifierEntry(e, NULL);
+#endif
+        return NULL;
+    }
+    return e;
+}
+
+static void
+releaseEventNotifiers(UA_EventNotifierEntry *e) {
+#ifdef UA_ENABLE_MULTITHREADING
+    deleteEventNotifierEntry(e, NULL);
+#endif
+}
+
+static void
+dropEventNotifiers(UA_EventNotifierEntry *e, void *data) {
+    if(containsNotifier(e, (const UA_NodeId*)data))
+        deleteEventNotifiers(e);
 }
 
+void
+UA_EventNotifierCache_invalidate(UA_EventNotifierCache *cache, const UA_NodeId *nodeId) {
+    /* Remove the entry of a deleted origin */
+    UA_EventNotifierEntry *e = UA_EventNotifierTree_ZIP_FIND(&cache->entries, nodeId);
+    if(e) {
+        UA_EventNotifierTree_ZIP_REMOVE(&cache->entries, e);
+        deleteEventNotifierEntry(e, NULL);
+    }
+    /* Recompute the entries that contain the node on their next use */
+    UA_EventNotifierTree_ZIP_ITER(&cache->entries, dropEventNotifiers, (void*)(uintptr_t)nodeId);
+}
+
+void
+UA_EventNotifierCache_deleteMembers(UA_EventNotifierCache *cache) {
+    UA_EventNotifierTree_ZIP_ITER(&cache->entries, deleteEventNotifierEntry, NULL);
+    ZIP_INIT(&cache->entries);
+}
+
+/*****************/
+/* Event Trigger */
+/*****************/
+
 /* Filters an event according to the filter specified by mon and then adds it to
- * mons notification queue */
+ * mons notification queue. The event is either a node or a list of fields. */
 static UA_StatusCode
-UA_Event_addEventToMonitoredItem(UA_Server *server, const UA_NodeId *event,
+UA_Event_addEventToMonitoredItem(UA_Server *server, const UA_NodeId *eventNode,
+                                 const UA_EventFields *eventFields,
                                  UA_MonitoredItem *mon) {
     UA_Notification *notification = (UA_Notification *) UA_malloc(sizeof(UA_Notification));
     if(!notification)
@@ -350,9 +572,15 @@ UA_Event_addEventToMonitoredItem(UA_Server *server, const UA_NodeId *event,
     UA_Session *session = sub->session;
 
     /* Apply the filter */
-    UA_StatusCode retval = UA_Server_filterEvent(server, session, event,
-                                                 &mon->filter.eventFilter,
-                                                 &notification->data.event);
+    UA_StatusCode retval;
+    if(eventNode)
+        retval = UA_Server_filterEvent(server, session, eventNode,
+                                       &mon->filter.eventFilter,
+                                       &notification->data.event);
+    else
+        retval = UA_Server_filterEventFields(server, session, eventFields,
+                                             &mon->filter.eventFilter,
+                                             &notification->data.event);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_free(notification);
         return retval;
@@ -364,62 +592,52 @@ UA_Event_addEventToMonitoredItem(UA_Server *server, const UA_NodeId *event,
     return UA_STATUSCODE_GOOD;
 }
 
-static const UA_NodeId objectsFolderId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_OBJECTSFOLDER}};
-static const UA_NodeId parentReferences_events[2] =
-    {{0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_ORGANIZES}},
-     {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASCOMPONENT}}};
+/* Add the event to the monitored items of the origin and all its parents */
+static void
+notifyEventNotifiers(UA_Server *server, const UA_EventNotifierEntry *e,
+                     const UA_NodeId *eventNode, const UA_EventFields *eventFields) {
+    for(size_t i = 0; i < e->notifiersSize; i++) {
+        const UA_ObjectNode *node = (const UA_ObjectNode *)
+            UA_Nodestore_get(server, &e->notifiers[i]);
+        if(!node)
+            continue;
+        if(node->nodeClass == UA_NODECLASS_OBJECT) {
+            for(UA_MonitoredItem *monIter = node->monitoredItemQueue; monIter != NULL; monIter = monIter->next) {
+                UA_StatusCode retval =
+                    UA_Event_addEventToMonitoredItem(server, eventNode, eventFields, monIter);
+                if(retval != UA_STATUSCODE_GOOD) {
+                    UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                                   "Events: Could not add the event to a listening node with StatusCode %s",
+                                   UA_StatusCode_name(retval));
+                }
+            }
+        }
+        UA_Nodestore_release(server, (const UA_Node *) node);
+    }
+}
 
 UA_StatusCode
 UA_Server_triggerEvent(UA_Server *server, const UA_NodeId eventNodeId, const UA_NodeId origin,
                        UA_ByteString *outEventId, const UA_Boolean deleteEventNode) {
-    /* Make sure the origin is in the ObjectsFolder (TODO: or in the ViewsFolder) */
-    if(!isNodeInTree(&server->config.nodestore, &origin, &objectsFolderId, parentReferences_events, 2)) {
-        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_USERLAND,
-                     "Node for event must be in ObjectsFolder!");
-        return UA_STATUSCODE_BADINVALIDARGUMENT;
-    }
-
-    UA_StatusCode retval = eventSetStandardFields(server, &eventNodeId, &origin, outEventId);
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
-                       "Events: Could not set the standard event fields with StatusCode %s",
-                       UA_StatusCode_name(retval));
+    /* Get the nodes listening on the event. Checks that the origin is in the
+     * ObjectsFolder. */
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_EventNotifierEntry *notifiers = getEventNotifiers(server, &origin, &retval);
+    if(!notifiers)
         return retval;
-    }
 
-    /* Get an array with all parents. The first call to
-     * getParentsNodeIteratorCallback adds the emitting node itself. */
-    struct getNodesHandle parentHandle;
-    parentHandle.server = server;
-    LIST_INIT(&parentHandle.nodes);
-    retval = getParentsNodeIteratorCallback(origin, UA_TRUE, parentReferences_events[1], &parentHandle);
+    retval = eventSetStandardFields(server, &eventNodeId, &origin, outEventId);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
-                       "Events: Could not create the list of nodes listening on the event with StatusCode %s",
+                       "Events: Could not set the standard event fields with StatusCode %s",
                        UA_StatusCode_name(retval));
+        releaseEventNotifiers(notifiers);
         return retval;
     }
 
     /* Add the event to each node's monitored items */
-    Events_nodeListElement *parentIter, *tmp_parentIter;
-    LIST_FOREACH_SAFE(parentIter, &parentHandle.nodes, listEntry, tmp_parentIter) {
-        const UA_ObjectNode *node = (const UA_ObjectNode *) UA_Nodestore_get(server, &parentIter->nodeId);
-        if(node->nodeClass == UA_NODECLASS_OBJECT) {
-            for(UA_MonitoredItem *monIter = node->monitoredItemQueue; monIter != NULL; monIter = monIter->next) {
-                retval = UA_Event_addEventToMonitoredItem(server, &eventNodeId, monIter);
-                if(retval != UA_STATUSCODE_GOOD) {
-                    UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
-                                   "Events: Could not add the event to a listening node with StatusCode %s",
-                                   UA_StatusCode_name(retval));
-                }
-            }
-        }
-        UA_Nodestore_release(server, (const UA_Node *) node);
-
-        LIST_REMOVE(parentIter, listEntry);
-        UA_NodeId_deleteMembers(&parentIter->nodeId);
-        UA_free(parentIter);
-    }
+    notifyEventNotifiers(server, notifiers, &eventNodeId, NULL);
+    releaseEventNotifiers(notifiers);
 
     /* Delete the node representation of the event */
     if(deleteEventNode) {
@@ -434,4 +652,78 @@ UA_Server_triggerEvent(UA_Server *server, const UA_NodeId eventNodeId, const UA_
     return UA_STATUSCODE_GOOD;
 }
 
+enum {
+    UA_EVENTFIELD_EVENTID,
+    UA_EVENTFIELD_EVENTTYPE,
+    UA_EVENTFIELD_SOURCENODE,
+    UA_EVENTFIELD_RECEIVETIME,
+    UA_EVENTFIELD_TIME,
+    UA_EVENTFIELDS_STANDARD
+};
+
+UA_StatusCode
+UA_Server_emitEvent(UA_Server *server, const UA_NodeId eventType, const UA_NodeId origin,
+                    size_t fieldsSize, const UA_EventField *fields,
+                    UA_ByteString *outEventId) {
+    /* Make sure the eventType is a subtype of BaseEventType */
+    UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
+    if(!isSubtypeOf(server, &eventType, &baseEventTypeId)) {
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_USERLAND,
+                     "Event type must be a subtype of BaseEventType!");
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_EventNotifierEntry *notifiers = getEventNotifiers(server, &origin, &retval);
+    if(!notifiers)
+        return retval;
+
+    UA_ByteString eventId = UA_BYTESTRING_NULL;
+    retval = UA_Event_generateEventId(server, &eventId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        releaseEventNotifiers(notifiers);
+        return retval;
+    }
+
+    /* The fields set by the server. Point into the stack without copying. */
+    UA_QualifiedName names[UA_EVENTFIELDS_STANDARD] = {
+        UA_QUALIFIEDNAME(0, "EventId"), UA_QUALIFIEDNAME(0, "EventType"),
+        UA_QUALIFIEDNAME(0, "SourceNode"), UA_QUALIFIEDNAME(0, "ReceiveTime"),
+        UA_QUALIFIEDNAME(0, "Time")};
+    UA_EventField standardFields[UA_EVENTFIELDS_STANDARD];
+    for(size_t i = 0; i < UA_EVENTFIELDS_STANDARD; i++) {
+        standardFields[i].browsePathSize = 1;
+        standardFields[i].browsePath = &names[i];
+    }
+    UA_DateTime now = UA_DateTime_now();
+    UA_Variant_setScalar(&standardFields[UA_EVENTFIELD_EVENTID].value,
+                         &eventId, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    UA_Variant_setScalar(&standardFields[UA_EVENTFIELD_EVENTTYPE].value,
+                         (void*)(uintptr_t)&eventType, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Variant_setScalar(&standardFields[UA_EVENTFIELD_SOURCENODE].value,
+                         (void*)(uintptr_t)&origin, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Variant_setScalar(&standardFields[UA_EVENTFIELD_RECEIVETIME].value,
+                         &now, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Variant_setScalar(&standardFields[UA_EVENTFIELD_TIME].value,
+                         &now, &UA_TYPES[UA_TYPES_DATETIME]);
+
+    UA_EventFields event;
+    event.eventType = &eventType;
+    event.standardFields = standardFields;
+    event.standardFieldsSize = UA_EVENTFIELD_TIME;
+    event.fields = fields;
+    event.fieldsSize = fieldsSize;
+    event.timeField = &standardFields[UA_EVENTFIELD_TIME];
+
+    notifyEventNotifiers(server, notifiers, NULL, &event);
+    releaseEventNotifiers(notifiers);
+
+    /* Return the EventId */
+    if(outEventId)
+        *outEventId = eventId;
+    else
+        UA_ByteString_deleteMembers(&eventId);
+    return UA_STATUSCODE_GOOD;
+}
+
 #endif /* UA_ENABLE_SUBSCRIPTIONS_EVENTS */
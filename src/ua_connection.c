@@ -22,6 +22,123 @@ void UA_Connection_deleteMembers(UA_Connection *connection) {
     UA_ByteString_deleteMembers(&connection->incompleteMessage);
 }
 
+/***************/
+/* Buffer Pool */
+/***************/
+
+/* Every buffer is preceded by a header with the allocated size. Unused buffers
+ * are linked in a stack through the header. */
+typedef struct PooledBuffer {
+    struct PooledBuffer *next;
+    size_t size;
+} PooledBuffer;
+
+struct UA_BufferPool {
+    size_t bufferSize;
+    size_t maxPooled;
+    PooledBuffer *first;
+    UA_BufferPoolStatistics stats;
+#ifdef UA_ENABLE_MULTITHREADING
+    void * volatile lock; /* The critical sections are only a few instructions
+                           * long. So we spin. */
+#endif
+};
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_BUFFERPOOL_LOCK(pool)                                       \
+    while(UA_atomic_cmpxchg(&(pool)->lock, NULL, (void*)(pool)) != NULL) {}
+# define UA_BUFFERPOOL_UNLOCK(pool) UA_atomic_xchg(&(pool)->lock, NULL)
+#else
+# define UA_BUFFERPOOL_LOCK(pool)
+# define UA_BUFFERPOOL_UNLOCK(pool)
+#endif
+
+UA_BufferPool *
+UA_BufferPool_new(size_t bufferSize, size_t maxPooled) {
+    UA_BufferPool *pool = (UA_BufferPool*)UA_calloc(1, sizeof(UA_BufferPool));
+    if(!pool)
+        return NULL;
+    pool->bufferSize = bufferSize;
+    pool->maxPooled = maxPooled;
+    return pool;
+}
+
+void
+UA_BufferPool_delete(UA_BufferPool *pool) {
+    PooledBuffer *b = pool->first;
+    while(b) {
+        PooledBuffer *next = b->next;
+        UA_free(b);
+        b = next;
+    }
+    UA_free(pool);
+}
+
+UA_StatusCode
+UA_BufferPool_get(UA_BufferPool *pool, size_t length, UA_ByteString *buf) {
+    /* Take from the pool */
+    PooledBuffer *b = NULL;
+    if(length <= pool->bufferSize) {
+        UA_BUFFERPOOL_LOCK(pool);
+        b = pool->first;
+        if(b) {
+            pool->first = b->next;
+            pool->stats.pooled--;
+            pool->stats.reused++;
+        }
+        UA_BUFFERPOOL_UNLOCK(pool);
+    }
+
+    /* Allocate a new buffer. Small buffers get the full size so that they can
+     * be recycled. */
+    if(!b) {
+        size_t size = (length <= pool->bufferSize) ? pool->bufferSize : length;
+        b = (PooledBuffer*)UA_malloc(sizeof(PooledBuffer) + size);
+        if(!b) {
+            *buf = UA_BYTESTRING_NULL;
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        b->size = size;
+        UA_BUFFERPOOL_LOCK(pool);
+        pool->stats.allocated++;
+        UA_BUFFERPOOL_UNLOCK(pool);
+    }
+
+    buf->data = (UA_Byte*)b + sizeof(PooledBuffer);
+    buf->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_BufferPool_release(UA_BufferPool *pool, UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    PooledBuffer *b = (PooledBuffer*)(uintptr_t)(buf->data - sizeof(PooledBuffer));
+    *buf = UA_BYTESTRING_NULL;
+
+    /* Put back into the pool */
+    UA_BUFFERPOOL_LOCK(pool);
+    if(b->size == pool->bufferSize && pool->stats.pooled < pool->maxPooled) {
+        b->next = pool->first;
+        pool->first = b;
+        pool->stats.pooled++;
+        UA_BUFFERPOOL_UNLOCK(pool);
+        return;
+    }
+    pool->stats.freed++;
+    UA_BUFFERPOOL_UNLOCK(pool);
+
+    /* The pool is full or the buffer has a different size */
+    UA_free(b);
+}
+
+void
+UA_BufferPool_getStatistics(UA_BufferPool *pool, UA_BufferPoolStatistics *stats) {
+    UA_BUFFERPOOL_LOCK(pool);
+    *stats = pool->stats;
+    UA_BUFFERPOOL_UNLOCK(pool);
+}
+
 /* Hides somme errors before sending them to a client according to the
  * standard. */
 static void
@@ -61,34 +178,121 @@ UA_Connection_sendError(UA_Connection *connection, UA_TcpErrorMessage *error) {
     connection->send(connection, &msg);
 }
 
+/* Check the header of a chunk and decode the chunk length. At least 8 bytes
+ * must be available. */
 static UA_StatusCode
-prependIncompleteChunk(UA_Connection *connection, UA_ByteString *message) {
-    /* Allocate the new message buffer */
-    size_t length = connection->incompleteMessage.length + message->length;
-    UA_Byte *data = (UA_Byte*)UA_realloc(connection->incompleteMessage.data, length);
-    if(!data) {
-        UA_ByteString_deleteMembers(&connection->incompleteMessage);
-        return UA_STATUSCODE_BADOUTOFMEMORY;
+checkChunkHeader(const UA_Connection *connection, const UA_Byte *pos,
+                 UA_UInt32 *chunk_length) {
+    /* Check the message type */
+    UA_MessageType msgtype = (UA_MessageType)
+        ((UA_UInt32)pos[0] + ((UA_UInt32)pos[1] << 8) + ((UA_UInt32)pos[2] << 16));
+    if(msgtype != UA_MESSAGETYPE_MSG && msgtype != UA_MESSAGETYPE_ERR &&
+       msgtype != UA_MESSAGETYPE_OPN && msgtype != UA_MESSAGETYPE_HEL &&
+       msgtype != UA_MESSAGETYPE_ACK && msgtype != UA_MESSAGETYPE_CLO) {
+        /* The message type is not recognized */
+        return UA_STATUSCODE_BADTCPMESSAGETYPEINVALID;
     }
 
-    /* Copy / release the current message buffer */
-    memcpy(&data[connection->incompleteMessage.length], message->data, message->length);
-    message->length = length;
-    message->data = data;
-    connection->incompleteMessage = UA_BYTESTRING_NULL;
+    UA_Byte isFinal = pos[3];
+    if(isFinal != 'C' && isFinal != 'F' && isFinal != 'A') {
+        /* The message type is not recognized */
+        return UA_STATUSCODE_BADTCPMESSAGETYPEINVALID;
+    }
+
+    UA_ByteString temp = { 8, (UA_Byte*)(uintptr_t)pos };
+    size_t temp_offset = 4;
+    /* Decoding the UInt32 cannot fail */
+    UA_UInt32_decodeBinary(&temp, &temp_offset, chunk_length);
+
+    /* The message size is not allowed */
+    if(*chunk_length < 16 || *chunk_length > connection->localConf.recvBufferSize)
+        return UA_STATUSCODE_BADTCPMESSAGETOOLARGE;
     return UA_STATUSCODE_GOOD;
 }
 
+/* Store the beginning of a chunk until the remainder arrives. The buffer is
+ * allocated with the full chunk length announced in the header. So every byte
+ * is copied only once, regardless of how many packets the chunk is split
+ * into. Until the header is complete, only the 8 header bytes are
+ * allocated. */
 static UA_StatusCode
-bufferIncompleteChunk(UA_Connection *connection, const UA_Byte *pos, size_t length) {
+bufferIncompleteChunk(UA_Connection *connection, const UA_Byte *pos,
+                      size_t length, UA_UInt32 chunk_length) {
     UA_assert(length > 0);
-    UA_StatusCode retval = UA_ByteString_allocBuffer(&connection->incompleteMessage, length);
-    if(retval != UA_STATUSCODE_GOOD)
-        return retval;
+    UA_assert(length < chunk_length);
+    connection->incompleteMessage.data = (UA_Byte*)UA_malloc(chunk_length);
+    if(!connection->incompleteMessage.data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
     memcpy(connection->incompleteMessage.data, pos, length);
+    connection->incompleteMessage.length = length;
     return UA_STATUSCODE_GOOD;
 }
 
+/* Append the bytes of the received packet that are missing for the buffered
+ * chunk. The chunk is processed once it is complete. The capacity of
+ * incompleteMessage is implicit: 8 bytes while the header is incomplete, the
+ * chunk length from the header afterwards. */
+static UA_StatusCode
+completeIncompleteChunk(UA_Connection *connection, void *application,
+                        UA_Connection_processChunk processCallback,
+                        const UA_Byte **posp, const UA_Byte *end, UA_Boolean *done) {
+    UA_ByteString *chunk = &connection->incompleteMessage;
+    size_t length = (uintptr_t)end - (uintptr_t)*posp;
+    size_t missing;
+
+    /* Complete the header first */
+    if(chunk->length < 8) {
+        missing = 8 - chunk->length;
+        if(missing > length)
+            missing = length;
+        memcpy(&chunk->data[chunk->length], *posp, missing);
+        chunk->length += missing;
+        *posp += missing;
+        length -= missing;
+        if(chunk->length < 8) {
+            *done = true;
+            return UA_STATUSCODE_GOOD;
+        }
+
+        /* Grow the buffer to the announced chunk length */
+        UA_UInt32 chunk_length = 0;
+        UA_StatusCode retval = checkChunkHeader(connection, chunk->data, &chunk_length);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_ByteString_deleteMembers(chunk);
+            return retval;
+        }
+        UA_Byte *data = (UA_Byte*)UA_realloc(chunk->data, chunk_length);
+        if(!data) {
+            UA_ByteString_deleteMembers(chunk);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        chunk->data = data;
+    }
+
+    /* Copy the missing part of the chunk */
+    UA_UInt32 chunk_length = 0;
+    size_t offset = 4;
+    UA_ByteString header = { 8, chunk->data };
+    UA_UInt32_decodeBinary(&header, &offset, &chunk_length);
+    missing = chunk_length - chunk->length;
+    if(missing > length)
+        missing = length;
+    memcpy(&chunk->data[chunk->length], *posp, missing);
+    chunk->length += missing;
+    *posp += missing;
+    if(chunk->length < chunk_length) {
+        *done = true;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Process the complete chunk. Afterwards, connection->incompleteMessage is
+     * empty again. */
+    *done = false;
+    UA_StatusCode retval = processCallback(application, connection, chunk);
+    UA_ByteString_deleteMembers(chunk);
+    return retval;
+}
+
 static UA_StatusCode
 processChunk(UA_Connection *connection, void *application,
              UA_Connection_processChunk processCallback,
@@ -98,47 +302,25 @@ processChunk(UA_Connection *connection, void *application,
 
     /* At least 8 byte needed for the header. Wait for the next chunk. */
     if(length < 8) {
-        if(length > 0)
-            bufferIncompleteChunk(connection, pos, length);
         *done = true;
+        if(length > 0)
+            return bufferIncompleteChunk(connection, pos, length, 8);
         return UA_STATUSCODE_GOOD;
     }
 
-    /* Check the message type */
-    UA_MessageType msgtype = (UA_MessageType)
-        ((UA_UInt32)pos[0] + ((UA_UInt32)pos[1] << 8) + ((UA_UInt32)pos[2] << 16));
-    if(msgtype != UA_MESSAGETYPE_MSG && msgtype != UA_MESSAGETYPE_ERR &&
-       msgtype != UA_MESSAGETYPE_OPN && msgtype != UA_MESSAGETYPE_HEL &&
-       msgtype != UA_MESSAGETYPE_ACK && msgtype != UA_MESSAGETYPE_CLO) {
-        /* The message type is not recognized */
-        return UA_STATUSCODE_BADTCPMESSAGETYPEINVALID;
-    }
-
-    UA_Byte isFinal = pos[3];
-    if(isFinal != 'C' && isFinal != 'F' && isFinal != 'A') {
-        /* The message type is not recognized */
-        return UA_STATUSCODE_BADTCPMESSAGETYPEINVALID;
-    }
-
     UA_UInt32 chunk_length = 0;
-    UA_ByteString temp = { 8, (UA_Byte*)(uintptr_t)pos }; /* At least 8 byte left */
-    size_t temp_offset = 4;
-    /* Decoding the UInt32 cannot fail */
-    UA_UInt32_decodeBinary(&temp, &temp_offset, &chunk_length);
-
-    /* The message size is not allowed */
-    if(chunk_length < 16 || chunk_length > connection->localConf.recvBufferSize)
-        return UA_STATUSCODE_BADTCPMESSAGETOOLARGE;
+    UA_StatusCode retval = checkChunkHeader(connection, pos, &chunk_length);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
 
     /* Wait for the next packet to process the complete chunk */
     if(chunk_length > length) {
-        bufferIncompleteChunk(connection, pos, length);
         *done = true;
-        return UA_STATUSCODE_GOOD;
+        return bufferIncompleteChunk(connection, pos, length, chunk_length);
     }
 
     /* Process the chunk; forward the position pointer */
-    temp.length = chunk_length;
+    UA_ByteString temp = { chunk_length, (UA_Byte*)(uintptr_t)pos };
     *posp += chunk_length;
     *done = false;
     return processCallback(application, connection, &temp);
@@ -148,30 +330,22 @@ UA_StatusCode
 UA_Connection_processChunks(UA_Connection *connection, void *application,
                             UA_Connection_processChunk processCallback,
                             const UA_ByteString *packet) {
-    /* If we have stored an incomplete chunk, prefix to the received message.
-     * After this block, connection->incompleteMessage is always empty. The
-     * message and the buffer is released if allocating the memory fails. */
-    UA_Boolean realloced = false;
-    UA_ByteString message = *packet;
-    UA_StatusCode retval;
-    if(connection->incompleteMessage.length > 0) {
-        retval = prependIncompleteChunk(connection, &message);
-        if(retval != UA_STATUSCODE_GOOD)
-            return retval;
-        realloced = true;
-    }
+    const UA_Byte *pos = packet->data;
+    const UA_Byte *end = &packet->data[packet->length];
+    UA_Boolean done = false;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+
+    /* If we have stored an incomplete chunk, complete it with the beginning of
+     * the received packet. The remainder of the packet is processed in
+     * place. */
+    if(connection->incompleteMessage.length > 0)
+        retval = completeIncompleteChunk(connection, application, processCallback,
+                                         &pos, end, &done);
 
     /* Loop over the received chunks. pos is increased with each chunk. */
-    const UA_Byte *pos = message.data;
-    const UA_Byte *end = &message.data[message.length];
-    UA_Boolean done = true;
-    do {
+    while(!done && retval == UA_STATUSCODE_GOOD)
         retval = processChunk(connection, application, processCallback,
                               &pos, end, &done);
-    } while(!done && retval == UA_STATUSCODE_GOOD);
-
-    if(realloced)
-        UA_ByteString_deleteMembers(&message);
     return retval;
 }
 
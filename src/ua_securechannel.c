@@ -79,6 +79,17 @@ UA_SecureChannel_init(UA_SecureChannel *channel,
     return retval;
 }
 
+static void
+deleteChunkEntry(struct ChunkEntry *chunkEntry) {
+    struct ChunkSegment *segment;
+    while((segment = SIMPLEQ_FIRST(&chunkEntry->segments))) {
+        SIMPLEQ_REMOVE_HEAD(&chunkEntry->segments, next);
+        UA_free(segment);
+    }
+    LIST_REMOVE(chunkEntry, pointers);
+    UA_free(chunkEntry);
+}
+
 void
 UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
     /* Delete members */
@@ -87,6 +98,7 @@ UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
     UA_ByteString_deleteMembers(&channel->remoteNonce);
     UA_ChannelSecurityToken_deleteMembers(&channel->securityToken);
     UA_ChannelSecurityToken_deleteMembers(&channel->nextSecurityToken);
+    UA_Arena_deleteMembers(&channel->requestArena);
 
     /* Delete the channel context for the security policy */
     if(channel->securityPolicy)
@@ -109,11 +121,8 @@ UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
 
     /* Remove the buffered chunks */
     struct ChunkEntry *ch, *temp_ch;
-    LIST_FOREACH_SAFE(ch, &channel->chunks, pointers, temp_ch) {
-        UA_ByteString_deleteMembers(&ch->bytes);
-        LIST_REMOVE(ch, pointers);
-        UA_free(ch);
-    }
+    LIST_FOREACH_SAFE(ch, &channel->chunks, pointers, temp_ch)
+        deleteChunkEntry(ch);
 }
 
 UA_StatusCode
@@ -723,41 +732,66 @@ UA_SecureChannel_sendSymmetricMessage(UA_SecureChannel *channel, UA_UInt32 reque
 /* Assemble Complete Message */
 /*****************************/
 
-static void
-UA_SecureChannel_removeChunks(UA_SecureChannel *channel, UA_UInt32 requestId) {
+static struct ChunkEntry *
+findChunkEntry(UA_SecureChannel *channel, UA_UInt32 requestId) {
     struct ChunkEntry *ch;
     LIST_FOREACH(ch, &channel->chunks, pointers) {
-        if(ch->requestId == requestId) {
-            UA_ByteString_deleteMembers(&ch->bytes);
-            LIST_REMOVE(ch, pointers);
-            UA_free(ch);
-            return;
-        }
+        if(ch->requestId == requestId)
+            return ch;
     }
+    return NULL;
+}
+
+static void
+UA_SecureChannel_removeChunks(UA_SecureChannel *channel, UA_UInt32 requestId) {
+    struct ChunkEntry *ch = findChunkEntry(channel, requestId);
+    if(ch)
+        deleteChunkEntry(ch);
 }
 
+/* Check the limits for received messages from the local connection config. 0
+ * means unlimited. */
 static UA_StatusCode
-appendChunk(struct ChunkEntry *chunkEntry, const UA_ByteString *chunkBody) {
-    UA_Byte *new_bytes = (UA_Byte *)
-        UA_realloc(chunkEntry->bytes.data, chunkEntry->bytes.length + chunkBody->length);
-    if(!new_bytes) {
-        UA_ByteString_deleteMembers(&chunkEntry->bytes);
+checkChunkLimits(const UA_SecureChannel *channel, size_t messageSize,
+                 UA_UInt32 chunkCount) {
+    const UA_Connection *connection = channel->connection;
+    if(!connection)
+        return UA_STATUSCODE_GOOD;
+    if(connection->localConf.maxMessageSize != 0 &&
+       messageSize > connection->localConf.maxMessageSize)
+        return UA_STATUSCODE_BADTCPMESSAGETOOLARGE;
+    if(connection->localConf.maxChunkCount != 0 &&
+       chunkCount > connection->localConf.maxChunkCount)
+        return UA_STATUSCODE_BADTCPMESSAGETOOLARGE;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Copy the chunk body into a new segment. The chunk buffer is released after
+ * processing. So the body cannot be referenced in place. */
+static UA_StatusCode
+appendChunk(UA_SecureChannel *channel, struct ChunkEntry *chunkEntry,
+            const UA_ByteString *chunkBody) {
+    UA_StatusCode retval = checkChunkLimits(channel, chunkEntry->messageSize +
+                                            chunkBody->length, chunkEntry->chunkCount + 1);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    struct ChunkSegment *segment = (struct ChunkSegment*)
+        UA_malloc(sizeof(struct ChunkSegment) + chunkBody->length);
+    if(!segment)
         return UA_STATUSCODE_BADOUTOFMEMORY;
-    }
-    chunkEntry->bytes.data = new_bytes;
-    memcpy(&chunkEntry->bytes.data[chunkEntry->bytes.length], chunkBody->data, chunkBody->length);
-    chunkEntry->bytes.length += chunkBody->length;
+    segment->length = chunkBody->length;
+    memcpy((UA_Byte*)segment + sizeof(struct ChunkSegment), chunkBody->data, chunkBody->length);
+    SIMPLEQ_INSERT_TAIL(&chunkEntry->segments, segment, next);
+    chunkEntry->messageSize += chunkBody->length;
+    chunkEntry->chunkCount++;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
 UA_SecureChannel_appendChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
                              const UA_ByteString *chunkBody) {
-    struct ChunkEntry *ch;
-    LIST_FOREACH(ch, &channel->chunks, pointers) {
-        if(ch->requestId == requestId)
-            break;
-    }
+    struct ChunkEntry *ch = findChunkEntry(channel, requestId);
 
     /* No chunkentry on the channel, create one */
     if(!ch) {
@@ -765,38 +799,66 @@ UA_SecureChannel_appendChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
         if(!ch)
             return UA_STATUSCODE_BADOUTOFMEMORY;
         ch->requestId = requestId;
-        UA_ByteString_init(&ch->bytes);
+        SIMPLEQ_INIT(&ch->segments);
+        ch->messageSize = 0;
+        ch->chunkCount = 0;
         LIST_INSERT_HEAD(&channel->chunks, ch, pointers);
     }
 
-    return appendChunk(ch, chunkBody);
+    UA_StatusCode retval = appendChunk(channel, ch, chunkBody);
+    if(retval != UA_STATUSCODE_GOOD)
+        deleteChunkEntry(ch);
+    return retval;
+}
+
+/* Gather the segments and the final chunk body into a buffer of the exact
+ * message size. Every byte is copied once. */
+static UA_StatusCode
+gatherChunks(UA_SecureChannel *channel, struct ChunkEntry *chunkEntry,
+             const UA_ByteString *chunkBody, UA_ByteString *message) {
+    size_t messageSize = chunkEntry->messageSize + chunkBody->length;
+    UA_StatusCode retval = checkChunkLimits(channel, messageSize,
+                                            chunkEntry->chunkCount + 1);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    retval = UA_ByteString_allocBuffer(message, messageSize);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    size_t pos = 0;
+    struct ChunkSegment *segment;
+    SIMPLEQ_FOREACH(segment, &chunkEntry->segments, next) {
+        memcpy(&message->data[pos], (UA_Byte*)segment + sizeof(struct ChunkSegment),
+               segment->length);
+        pos += segment->length;
+    }
+    memcpy(&message->data[pos], chunkBody->data, chunkBody->length);
+    return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
 UA_SecureChannel_finalizeChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
                                const UA_ByteString *chunkBody, UA_MessageType messageType,
                                UA_ProcessMessageCallback callback, void *application) {
-    struct ChunkEntry *chunkEntry;
-    LIST_FOREACH(chunkEntry, &channel->chunks, pointers) {
-        if(chunkEntry->requestId == requestId)
-            break;
-    }
-
-    UA_ByteString bytes;
+    /* Single-chunk messages are processed in place */
+    struct ChunkEntry *chunkEntry = findChunkEntry(channel, requestId);
     if(!chunkEntry) {
-        bytes = *chunkBody;
-    } else {
-        UA_StatusCode retval = appendChunk(chunkEntry, chunkBody);
+        UA_StatusCode retval = checkChunkLimits(channel, chunkBody->length, 1);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
-        bytes = chunkEntry->bytes;
-        LIST_REMOVE(chunkEntry, pointers);
-        UA_free(chunkEntry);
+        UA_ByteString bytes = *chunkBody;
+        return callback(application, channel, messageType, requestId, &bytes);
     }
 
-    UA_StatusCode retval = callback(application, channel, messageType, requestId, &bytes);
-    if(chunkEntry)
-        UA_ByteString_deleteMembers(&bytes);
+    UA_ByteString bytes;
+    UA_StatusCode retval = gatherChunks(channel, chunkEntry, chunkBody, &bytes);
+    deleteChunkEntry(chunkEntry);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    retval = callback(application, channel, messageType, requestId, &bytes);
+    UA_ByteString_deleteMembers(&bytes);
     return retval;
 }
 
@@ -17,6 +17,7 @@ extern "C" {
 
 #include "../deps/queue.h"
 #include "ua_types.h"
+#include "ua_util.h"
 #include "ua_transport_generated.h"
 #include "ua_connection_internal.h"
 #include "ua_plugin_securitypolicy.h"
@@ -43,11 +44,20 @@ typedef struct UA_SessionHeader {
     UA_SecureChannel *channel; /* The pointer back to the SecureChannel in the session. */
 } UA_SessionHeader;
 
-/* For chunked requests */
+/* For chunked requests. The payload of every intermediate chunk is copied
+ * into a segment. The segments are gathered into a single buffer of the exact
+ * message size only once the final chunk arrives. */
+struct ChunkSegment {
+    SIMPLEQ_ENTRY(ChunkSegment) next;
+    size_t length; /* The payload follows the segment header */
+};
+
 struct ChunkEntry {
     LIST_ENTRY(ChunkEntry) pointers;
     UA_UInt32 requestId;
-    UA_ByteString bytes;
+    SIMPLEQ_HEAD(chunk_segmentlist, ChunkSegment) segments;
+    size_t messageSize; /* Sum of the segment lengths */
+    UA_UInt32 chunkCount;
 };
 
 typedef enum {
@@ -80,6 +90,9 @@ struct UA_SecureChannel {
 
     LIST_HEAD(session_pointerlist, UA_SessionHeader) sessions;
     LIST_HEAD(chunk_pointerlist, ChunkEntry) chunks;
+
+    /* Memory of the request that is currently processed */
+    UA_Arena requestArena;
 };
 
 UA_StatusCode
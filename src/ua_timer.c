@@ -15,31 +15,73 @@
  * by Dmitry Vyukov.
  * http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
  *
- * The RepeatedCallback structure is used both in the sorted list of callbacks
+ * The RepeatedCallback structure is used both in the zip trees of callbacks
  * and in the MPSC changes queue. For the changes queue, we differentiate
  * between three cases encoded in the callback pointer.
  *
- * callback > 0x01: add the new repeated callback to the sorted list
+ * callback > 0x01: add the new repeated callback to the trees
  * callback == 0x00: remove the callback with the same id
- * callback == 0x01: change the interval of the existing callback */
+ * callback == 0x01: change the interval of the existing callback
+ *
+ * Callbacks with the same execution timestamp and interval are grouped into a
+ * bucket. Only the first callback of the bucket (the bucket "leader") is in
+ * the tree sorted by the execution timestamp. The other callbacks are in a
+ * linked list of the leader. So adding, removing and re-arming a callback is
+ * O(log n) in the number of buckets. All callbacks of a bucket are dispatched
+ * and re-armed together. */
 
 #define REMOVE_SENTINEL 0x00
 #define CHANGE_SENTINEL 0x01
 
+typedef struct {
+    UA_DateTime nextTime; /* The next time when the callbacks are to be
+                           * executed */
+    UA_UInt64 interval;   /* Interval in 100ns resolution */
+} UA_TimerDeadline;
+
 struct UA_TimerCallbackEntry {
-    SLIST_ENTRY(UA_TimerCallbackEntry) next; /* Next element in the list */
-    UA_DateTime nextTime;                    /* The next time when the callbacks
-                                              * are to be executed */
-    UA_UInt64 interval;                      /* Interval in 100ns resolution */
+    SLIST_ENTRY(UA_TimerCallbackEntry) next; /* Next element in the MPSC
+                                              * changes queue */
+    ZIP_ENTRY(UA_TimerCallbackEntry) zipfields;   /* Tree by deadline */
+    ZIP_ENTRY(UA_TimerCallbackEntry) idZipfields; /* Tree by id */
+
+    UA_Boolean leader; /* Is the entry in the tree sorted by deadline? */
+    LIST_ENTRY(UA_TimerCallbackEntry) bucketEntry; /* If not the leader */
+    LIST_HEAD(, UA_TimerCallbackEntry) bucket;     /* If the leader */
+
+    UA_TimerDeadline deadline;
     UA_UInt64 id;                            /* Id of the repeated callback */
 
     UA_TimerCallback callback;
     void *data;
 };
 
+static enum ZIP_CMP
+cmpDeadline(const UA_TimerDeadline *a, const UA_TimerDeadline *b) {
+    if(a->nextTime != b->nextTime)
+        return (a->nextTime < b->nextTime) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->interval != b->interval)
+        return (a->interval < b->interval) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    return ZIP_CMP_EQ;
+}
+
+ZIP_IMPL(UA_TimerZip, UA_TimerCallbackEntry, zipfields,
+         UA_TimerDeadline, deadline, cmpDeadline)
+
+static enum ZIP_CMP
+cmpId(const UA_UInt64 *a, const UA_UInt64 *b) {
+    if(*a == *b)
+        return ZIP_CMP_EQ;
+    return (*a < *b) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_IMPL(UA_TimerIdZip, UA_TimerCallbackEntry, idZipfields,
+         UA_UInt64, id, cmpId)
+
 void
 UA_Timer_init(UA_Timer *t) {
-    SLIST_INIT(&t->repeatedCallbacks);
+    ZIP_INIT(&t->root);
+    ZIP_INIT(&t->idRoot);
     t->changes_head = (UA_TimerCallbackEntry*)&t->changes_stub;
     t->changes_tail = (UA_TimerCallbackEntry*)&t->changes_stub;
     t->changes_stub = NULL;
@@ -84,6 +126,20 @@ dequeueChange(UA_Timer *t) {
     return NULL;
 }
 
+/* The goal is to have many repeated callbacks with the same repetition
+ * interval in a bucket. So they can be dispatched and re-armed together. The
+ * first execution is aligned to a multiple of the interval (at most one second)
+ * of the monotonic clock. So the first execution lies between "nextTime - 1s"
+ * and "nextTime". */
+static UA_DateTime
+firstExecution(UA_UInt64 interval) {
+    UA_DateTime nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)interval;
+    UA_DateTime grid = (UA_DateTime)interval;
+    if(grid > UA_DATETIME_SEC)
+        grid = UA_DATETIME_SEC;
+    return nextTime - (nextTime % grid);
+}
+
 /* Adding repeated callbacks: Add an entry with the "nextTime" timestamp in the
  * future. This will be picked up in the next iteration and inserted at the
  * correct place. So that the next execution takes place ät "nextTime". */
@@ -106,11 +162,11 @@ UA_Timer_addRepeatedCallback(UA_Timer *t, UA_TimerCallback callback,
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     /* Set the repeated callback */
-    tc->interval = (UA_UInt64)interval * UA_DATETIME_MSEC;
+    tc->deadline.interval = (UA_UInt64)interval * UA_DATETIME_MSEC;
+    tc->deadline.nextTime = firstExecution(tc->deadline.interval);
     tc->id = ++t->idCounter;
     tc->callback = callback;
     tc->data = data;
-    tc->nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)tc->interval;
 
     /* Set the output identifier */
     if(callbackId)
@@ -121,30 +177,48 @@ UA_Timer_addRepeatedCallback(UA_Timer *t, UA_TimerCallback callback,
     return UA_STATUSCODE_GOOD;
 }
 
+/* Add the entry to the bucket with the same deadline. Or become the leader of
+ * a new bucket. */
 static void
-addTimerCallbackEntry(UA_Timer *t, UA_TimerCallbackEntry * UA_RESTRICT tc) {
-    /* Find the last entry before this callback */
-    UA_TimerCallbackEntry *tmpTc, *afterTc = NULL;
-    SLIST_FOREACH(tmpTc, &t->repeatedCallbacks, next) {
-        if(tmpTc->nextTime >= tc->nextTime)
-            break;
-        afterTc = tmpTc;
-
-        /* The goal is to have many repeated callbacks with the same repetition
-         * interval in a "block" in order to reduce linear search for re-entry
-         * to the sorted list after processing. Allow the first execution to lie
-         * between "nextTime - 1s" and "nextTime" if this adjustment groups
-         * callbacks with the same repetition interval. */
-        if(tmpTc->interval == tc->interval &&
-           tmpTc->nextTime > (tc->nextTime - UA_DATETIME_SEC))
-            tc->nextTime = tmpTc->nextTime;
+addToBucket(UA_Timer *t, UA_TimerCallbackEntry *tc) {
+    UA_TimerCallbackEntry *leader = UA_TimerZip_ZIP_FIND(&t->root, &tc->deadline);
+    if(leader) {
+        tc->leader = false;
+        LIST_INSERT_HEAD(&leader->bucket, tc, bucketEntry);
+        return;
     }
+    tc->leader = true;
+    LIST_INIT(&tc->bucket);
+    UA_TimerZip_ZIP_INSERT(&t->root, tc);
+}
+
+static void
+removeFromBucket(UA_Timer *t, UA_TimerCallbackEntry *tc) {
+    if(!tc->leader) {
+        LIST_REMOVE(tc, bucketEntry);
+        return;
+    }
+
+    /* Remove the leader from the tree */
+    UA_TimerZip_ZIP_REMOVE(&t->root, tc);
+    UA_TimerCallbackEntry *newLeader = LIST_FIRST(&tc->bucket);
+    if(!newLeader)
+        return;
 
-    /* Add the repeated callback */
-    if(afterTc)
-        SLIST_INSERT_AFTER(afterTc, tc, next);
-    else
-        SLIST_INSERT_HEAD(&t->repeatedCallbacks, tc, next);
+    /* The next entry in the bucket becomes the leader and takes over the
+     * remaining list */
+    LIST_REMOVE(newLeader, bucketEntry);
+    newLeader->leader = true;
+    newLeader->bucket.lh_first = tc->bucket.lh_first;
+    if(newLeader->bucket.lh_first)
+        newLeader->bucket.lh_first->bucketEntry.le_prev = &newLeader->bucket.lh_first;
+    UA_TimerZip_ZIP_INSERT(&t->root, newLeader);
+}
+
+static void
+addTimerCallbackEntry(UA_Timer *t, UA_TimerCallbackEntry * UA_RESTRICT tc) {
+    UA_TimerIdZip_ZIP_INSERT(&t->idRoot, tc);
+    addToBucket(t, tc);
 }
 
 UA_StatusCode
@@ -161,9 +235,9 @@ UA_Timer_changeRepeatedCallbackInterval(UA_Timer *t, UA_UInt64 callbackId,
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     /* Set the repeated callback */
-    tc->interval = (UA_UInt64)interval * UA_DATETIME_MSEC;
+    tc->deadline.interval = (UA_UInt64)interval * UA_DATETIME_MSEC;
+    tc->deadline.nextTime = firstExecution(tc->deadline.interval);
     tc->id = callbackId;
-    tc->nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)tc->interval;
     tc->callback = (UA_TimerCallback)CHANGE_SENTINEL;
 
     /* Enqueue the changes in the MPSC queue */
@@ -173,28 +247,15 @@ UA_Timer_changeRepeatedCallbackInterval(UA_Timer *t, UA_UInt64 callbackId,
 
 static void
 changeTimerCallbackEntryInterval(UA_Timer *t, UA_UInt64 callbackId,
-                                 UA_UInt64 interval, UA_DateTime nextTime) {
-    /* Remove from the sorted list */
-    UA_TimerCallbackEntry *tc, *prev = NULL;
-    SLIST_FOREACH(tc, &t->repeatedCallbacks, next) {
-        if(callbackId == tc->id) {
-            if(prev)
-                SLIST_REMOVE_AFTER(prev, next);
-            else
-                SLIST_REMOVE_HEAD(&t->repeatedCallbacks, next);
-            break;
-        }
-        prev = tc;
-    }
+                                 const UA_TimerDeadline *deadline) {
+    UA_TimerCallbackEntry *tc = UA_TimerIdZip_ZIP_FIND(&t->idRoot, &callbackId);
     if(!tc)
         return;
 
-    /* Adjust settings */
-    tc->interval = interval;
-    tc->nextTime = nextTime;
-
-    /* Reinsert at the new position */
-    addTimerCallbackEntry(t, tc);
+    /* Move to the bucket of the new deadline */
+    removeFromBucket(t, tc);
+    tc->deadline = *deadline;
+    addToBucket(t, tc);
 }
 
 /* Removing a repeated callback: Add an entry with the "nextTime" timestamp set
@@ -219,18 +280,12 @@ UA_Timer_removeRepeatedCallback(UA_Timer *t, UA_UInt64 callbackId) {
 
 static void
 removeRepeatedCallback(UA_Timer *t, UA_UInt64 callbackId) {
-    UA_TimerCallbackEntry *tc, *prev = NULL;
-    SLIST_FOREACH(tc, &t->repeatedCallbacks, next) {
-        if(callbackId == tc->id) {
-            if(prev)
-                SLIST_REMOVE_AFTER(prev, next);
-            else
-                SLIST_REMOVE_HEAD(&t->repeatedCallbacks, next);
-            UA_free(tc);
-            break;
-        }
-        prev = tc;
-    }
+    UA_TimerCallbackEntry *tc = UA_TimerIdZip_ZIP_FIND(&t->idRoot, &callbackId);
+    if(!tc)
+        return;
+    UA_TimerIdZip_ZIP_REMOVE(&t->idRoot, tc);
+    removeFromBucket(t, tc);
+    UA_free(tc);
 }
 
 /* Process the changes that were added to the MPSC queue (by other threads) */
@@ -244,8 +299,7 @@ processChanges(UA_Timer *t) {
             UA_free(change);
             break;
         case CHANGE_SENTINEL:
-            changeTimerCallbackEntryInterval(t, change->id, change->interval,
-                                           change->nextTime);
+            changeTimerCallbackEntryInterval(t, change->id, &change->deadline);
             UA_free(change);
             break;
         default:
@@ -254,6 +308,19 @@ processChanges(UA_Timer *t) {
     }
 }
 
+/* Move all callbacks of the bucket "from" into the bucket "to". The cost is
+ * linear in the size of "from". But the buckets stay merged afterwards. */
+static void
+mergeBuckets(UA_TimerCallbackEntry *to, UA_TimerCallbackEntry *from) {
+    UA_TimerCallbackEntry *tc;
+    while((tc = LIST_FIRST(&from->bucket))) {
+        LIST_REMOVE(tc, bucketEntry);
+        LIST_INSERT_HEAD(&to->bucket, tc, bucketEntry);
+    }
+    from->leader = false;
+    LIST_INSERT_HEAD(&to->bucket, from, bucketEntry);
+}
+
 UA_DateTime
 UA_Timer_process(UA_Timer *t, UA_DateTime nowMonotonic,
                  UA_TimerDispatchCallback dispatchCallback,
@@ -261,90 +328,54 @@ UA_Timer_process(UA_Timer *t, UA_DateTime nowMonotonic,
     /* Insert and remove callbacks */
     processChanges(t);
 
-    /* Find the last callback to be executed now */
-    UA_TimerCallbackEntry *firstAfter, *lastNow = NULL;
-    SLIST_FOREACH(firstAfter, &t->repeatedCallbacks, next) {
-        if(firstAfter->nextTime > nowMonotonic)
-            break;
-        lastNow = firstAfter;
-    }
-
-    /* Nothing to do */
-    if(!lastNow) {
-        if(firstAfter)
-            return firstAfter->nextTime;
-        return UA_INT64_MAX;
-    }
-
-    /* Put the callbacks that are executed now in a separate list */
-    UA_TimerCallbackList executedNowList;
-    executedNowList.slh_first = SLIST_FIRST(&t->repeatedCallbacks);
-    lastNow->next.sle_next = NULL;
+    /* Process the buckets in the order of their deadline */
+    UA_TimerCallbackEntry *leader;
+    while((leader = UA_TimerZip_ZIP_MIN(&t->root)) &&
+          leader->deadline.nextTime <= nowMonotonic) {
+        UA_TimerZip_ZIP_REMOVE(&t->root, leader);
 
-    /* Fake entry to represent the first element in the newly-sorted list */
-    UA_TimerCallbackEntry tmp_first;
-    tmp_first.nextTime = nowMonotonic - 1; /* never matches for last_dispatched */
-    tmp_first.next.sle_next = firstAfter;
-    UA_TimerCallbackEntry *last_dispatched = &tmp_first;
-
-    /* Iterate over the list of callbacks to process now */
-    UA_TimerCallbackEntry *tc;
-    while((tc = SLIST_FIRST(&executedNowList))) {
-        /* Remove from the list */
-        SLIST_REMOVE_HEAD(&executedNowList, next);
-
-        /* Dispatch/process callback */
-        dispatchCallback(application, tc->callback, tc->data);
+        /* Dispatch/process the callbacks of the bucket. Changes to the timer
+         * from within the callbacks are only processed after the loop. So the
+         * bucket cannot be modified here. */
+        dispatchCallback(application, leader->callback, leader->data);
+        UA_TimerCallbackEntry *tc;
+        LIST_FOREACH(tc, &leader->bucket, bucketEntry)
+            dispatchCallback(application, tc->callback, tc->data);
 
         /* Set the time for the next execution. Prevent an infinite loop by
-         * forcing the next processing into the next iteration. */
-        tc->nextTime += (UA_Int64)tc->interval;
-        if(tc->nextTime < nowMonotonic)
-            tc->nextTime = nowMonotonic + 1;
-
-        /* Find the new position for tc to keep the list sorted */
-        UA_TimerCallbackEntry *prev_tc;
-        if(last_dispatched->nextTime == tc->nextTime) {
-            /* We try to "batch" repeatedCallbacks with the same interval. This
-             * saves a linear search when the last dispatched entry has the same
-             * nextTime timestamp as this entry. */
-            UA_assert(last_dispatched != &tmp_first);
-            prev_tc = last_dispatched;
-        } else {
-            /* Find the position for the next execution by a linear search
-             * starting at last_dispatched or the first element */
-            if(last_dispatched->nextTime < tc->nextTime)
-                prev_tc = last_dispatched;
-            else
-                prev_tc = &tmp_first;
-
-            while(true) {
-                UA_TimerCallbackEntry *n = SLIST_NEXT(prev_tc, next);
-                if(!n || n->nextTime >= tc->nextTime)
-                    break;
-                prev_tc = n;
-            }
-
-            /* Update last_dispatched */
-            last_dispatched = tc;
-        }
-
-        /* Add entry to the new position in the sorted list */
-        SLIST_INSERT_AFTER(prev_tc, tc, next);
+         * forcing the next processing into the next iteration. Skip the
+         * missed executions and keep the phase, so that the bucket stays
+         * aligned with other buckets of the same interval. */
+        UA_DateTime interval = (UA_DateTime)leader->deadline.interval;
+        leader->deadline.nextTime += interval;
+        if(leader->deadline.nextTime <= nowMonotonic)
+            leader->deadline.nextTime += interval *
+                (((nowMonotonic - leader->deadline.nextTime) / interval) + 1);
+
+        /* Re-insert the bucket. Merge with an existing bucket if the deadline
+         * is the same. */
+        UA_TimerCallbackEntry *existing =
+            UA_TimerZip_ZIP_FIND(&t->root, &leader->deadline);
+        if(existing)
+            mergeBuckets(existing, leader);
+        else
+            UA_TimerZip_ZIP_INSERT(&t->root, leader);
     }
 
-    /* Set the entry-point for the newly sorted list */
-    t->repeatedCallbacks.slh_first = tmp_first.next.sle_next;
-
     /* Re-repeat processAddRemoved since one of the callbacks might have removed
      * or added a callback. So we return a correct timeout. */
     processChanges(t);
 
     /* Return timestamp of next repetition */
-    tc = SLIST_FIRST(&t->repeatedCallbacks);
-    if(!tc)
+    leader = UA_TimerZip_ZIP_MIN(&t->root);
+    if(!leader)
         return UA_INT64_MAX; /* Main-loop has a max timeout / will continue earlier */
-    return tc->nextTime;
+    return leader->deadline.nextTime;
+}
+
+static void
+freeEntry(UA_TimerCallbackEntry *tc, void *data) {
+    UA_free(tc);
 }
 
 void
@@ -352,10 +383,8 @@ UA_Timer_deleteMembers(UA_Timer *t) {
     /* Process changes to empty the MPSC queue */
     processChanges(t);
 
-    /* Remove repeated callbacks */
-    UA_TimerCallbackEntry *current;
-    while((current = SLIST_FIRST(&t->repeatedCallbacks))) {
-        SLIST_REMOVE_HEAD(&t->repeatedCallbacks, next);
-        UA_free(current);
-    }
+    /* Remove repeated callbacks. All callbacks are contained in the id tree. */
+    UA_TimerIdZip_ZIP_ITER(&t->idRoot, freeEntry, NULL);
+    ZIP_INIT(&t->root);
+    ZIP_INIT(&t->idRoot);
 }
@@ -24,12 +24,22 @@ extern "C" {
 struct UA_TimerCallbackEntry;
 typedef struct UA_TimerCallbackEntry UA_TimerCallbackEntry;
 
-/* Linked-list definition */
-typedef SLIST_HEAD(UA_TimerCallbackList, UA_TimerCallbackEntry) UA_TimerCallbackList;
+/* Tree definitions */
+ZIP_HEAD(UA_TimerZip, UA_TimerCallbackEntry);
+typedef struct UA_TimerZip UA_TimerZip;
+
+ZIP_HEAD(UA_TimerIdZip, UA_TimerCallbackEntry);
+typedef struct UA_TimerIdZip UA_TimerIdZip;
 
 typedef struct {
-    /* The linked list of callbacks is sorted according to the execution timestamp. */
-    UA_TimerCallbackList repeatedCallbacks;
+    /* Callbacks with the same execution timestamp and interval are grouped in
+     * a bucket. The first callback of the bucket is contained in a tree that
+     * is sorted by the execution timestamp. The buckets are dispatched and
+     * re-inserted as a whole. */
+    UA_TimerZip root;
+
+    /* All callbacks in a tree sorted by their identifier */
+    UA_TimerIdZip idRoot;
 
     /* Changes to the repeated callbacks in a multi-producer single-consumer queue */
     UA_TimerCallbackEntry * volatile changes_head;
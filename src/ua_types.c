@@ -37,20 +37,20 @@ const UA_Guid UA_GUID_NULL = {0, 0, 0, {0,0,0,0,0,0,0,0}};
 const UA_NodeId UA_NODEID_NULL = {0, UA_NODEIDTYPE_NUMERIC, {0}};
 const UA_ExpandedNodeId UA_EXPANDEDNODEID_NULL = {{0, UA_NODEIDTYPE_NUMERIC, {0}}, {0, NULL}, 0};
 
-/* TODO: The standard-defined types are ordered. See if binary search is
- * more efficient. */
 const UA_DataType *
 UA_findDataType(const UA_NodeId *typeId) {
     if(typeId->identifierType != UA_NODEIDTYPE_NUMERIC)
         return NULL;
 
     /* Always look in built-in types first
-     * (may contain data types from all namespaces) */
-    for(size_t i = 0; i < UA_TYPES_COUNT; ++i) {
-        if(UA_TYPES[i].typeId.identifier.numeric == typeId->identifier.numeric
-           && UA_TYPES[i].typeId.namespaceIndex == typeId->namespaceIndex)
-            return &UA_TYPES[i];
-    }
+     * (may contain data types from all namespaces). The generated perfect
+     * hash maps the identifier to the only candidate. */
+    UA_UInt16 index = UA_TYPES_TYPEID_HASH[typeId->identifier.numeric %
+                                           UA_TYPES_TYPEID_HASHSIZE];
+    if(index < UA_TYPES_COUNT &&
+       UA_TYPES[index].typeId.identifier.numeric == typeId->identifier.numeric &&
+       UA_TYPES[index].typeId.namespaceIndex == typeId->namespaceIndex)
+        return &UA_TYPES[index];
 
     /* TODO When other namespace look in custom types, too, requires access to custom types array here! */
     /*if(typeId->namespaceIndex != 0) {
@@ -1037,6 +1037,233 @@ UA_delete(void *p, const UA_DataType *type) {
     UA_free(p);
 }
 
+/************/
+/* Equality */
+/************/
+
+/* Two values are equal if they have the same binary encoding. Types with an
+ * identical memory layout are compared with memcmp. */
+
+static UA_Boolean
+arrayEqual(const void *p1, const void *p2, size_t size, const UA_DataType *type);
+
+static UA_Boolean
+equalMem(const void *p1, const void *p2, const UA_DataType *type) {
+    return (memcmp(p1, p2, type->memSize) == 0);
+}
+
+static UA_Boolean
+String_equal(const UA_String *p1, const UA_String *p2, const UA_DataType *_) {
+    return UA_String_equal(p1, p2);
+}
+
+static UA_Boolean
+NodeId_equal(const UA_NodeId *p1, const UA_NodeId *p2, const UA_DataType *_) {
+    return UA_NodeId_equal(p1, p2);
+}
+
+static UA_Boolean
+ExpandedNodeId_equal(const UA_ExpandedNodeId *p1, const UA_ExpandedNodeId *p2,
+                     const UA_DataType *_) {
+    return UA_ExpandedNodeId_equal(p1, p2);
+}
+
+static UA_Boolean
+QualifiedName_equal(const UA_QualifiedName *p1, const UA_QualifiedName *p2,
+                    const UA_DataType *_) {
+    return UA_QualifiedName_equal(p1, p2);
+}
+
+static UA_Boolean
+LocalizedText_equal(const UA_LocalizedText *p1, const UA_LocalizedText *p2,
+                    const UA_DataType *_) {
+    return (UA_String_equal(&p1->locale, &p2->locale) &&
+            UA_String_equal(&p1->text, &p2->text));
+}
+
+static UA_Boolean
+ExtensionObject_equal(const UA_ExtensionObject *p1, const UA_ExtensionObject *p2,
+                      const UA_DataType *_) {
+    /* The NODELETE flag does not change the content */
+    UA_ExtensionObjectEncoding e1 = p1->encoding;
+    UA_ExtensionObjectEncoding e2 = p2->encoding;
+    if(e1 == UA_EXTENSIONOBJECT_DECODED_NODELETE)
+        e1 = UA_EXTENSIONOBJECT_DECODED;
+    if(e2 == UA_EXTENSIONOBJECT_DECODED_NODELETE)
+        e2 = UA_EXTENSIONOBJECT_DECODED;
+    if(e1 != e2)
+        return false;
+    if(e1 < UA_EXTENSIONOBJECT_DECODED)
+        return (UA_NodeId_equal(&p1->content.encoded.typeId, &p2->content.encoded.typeId) &&
+                UA_String_equal(&p1->content.encoded.body, &p2->content.encoded.body));
+    if(p1->content.decoded.type != p2->content.decoded.type)
+        return false;
+    if(!p1->content.decoded.data || !p2->content.decoded.data)
+        return (p1->content.decoded.data == p2->content.decoded.data);
+    return UA_equal(p1->content.decoded.data, p2->content.decoded.data,
+                    p1->content.decoded.type);
+}
+
+static UA_Boolean
+Variant_equal(const UA_Variant *p1, const UA_Variant *p2, const UA_DataType *_) {
+    if(p1->type != p2->type)
+        return false;
+    if(!p1->type)
+        return true; /* Both variants are empty */
+    UA_Boolean scalar = UA_Variant_isScalar(p1);
+    if(scalar != UA_Variant_isScalar(p2))
+        return false;
+    if(p1->arrayLength != p2->arrayLength)
+        return false;
+    if(!scalar && (p1->data == NULL) != (p2->data == NULL))
+        return false; /* Null array vs. empty array */
+    if(p1->arrayDimensionsSize != p2->arrayDimensionsSize ||
+       !arrayEqual(p1->arrayDimensions, p2->arrayDimensions,
+                   p1->arrayDimensionsSize, &UA_TYPES[UA_TYPES_UINT32]))
+        return false;
+    return arrayEqual(p1->data, p2->data, scalar ? 1 : p1->arrayLength, p1->type);
+}
+
+static UA_Boolean
+DataValue_equal(const UA_DataValue *p1, const UA_DataValue *p2, const UA_DataType *_) {
+    if(p1->hasValue != p2->hasValue ||
+       p1->hasStatus != p2->hasStatus ||
+       p1->hasSourceTimestamp != p2->hasSourceTimestamp ||
+       p1->hasServerTimestamp != p2->hasServerTimestamp ||
+       p1->hasSourcePicoseconds != p2->hasSourcePicoseconds ||
+       p1->hasServerPicoseconds != p2->hasServerPicoseconds)
+        return false;
+    if(p1->hasStatus && p1->status != p2->status)
+        return false;
+    if(p1->hasSourceTimestamp && p1->sourceTimestamp != p2->sourceTimestamp)
+        return false;
+    if(p1->hasServerTimestamp && p1->serverTimestamp != p2->serverTimestamp)
+        return false;
+    if(p1->hasSourcePicoseconds && p1->sourcePicoseconds != p2->sourcePicoseconds)
+        return false;
+    if(p1->hasServerPicoseconds && p1->serverPicoseconds != p2->serverPicoseconds)
+        return false;
+    return (!p1->hasValue || Variant_equal(&p1->value, &p2->value, NULL));
+}
+
+static UA_Boolean
+DiagnosticInfo_equal(const UA_DiagnosticInfo *p1, const UA_DiagnosticInfo *p2,
+                     const UA_DataType *_) {
+    if(p1->hasSymbolicId != p2->hasSymbolicId ||
+       p1->hasNamespaceUri != p2->hasNamespaceUri ||
+       p1->hasLocalizedText != p2->hasLocalizedText ||
+       p1->hasLocale != p2->hasLocale ||
+       p1->hasAdditionalInfo != p2->hasAdditionalInfo ||
+       p1->hasInnerStatusCode != p2->hasInnerStatusCode ||
+       p1->hasInnerDiagnosticInfo != p2->hasInnerDiagnosticInfo)
+        return false;
+    if((p1->hasSymbolicId && p1->symbolicId != p2->symbolicId) ||
+       (p1->hasNamespaceUri && p1->namespaceUri != p2->namespaceUri) ||
+       (p1->hasLocalizedText && p1->localizedText != p2->localizedText) ||
+       (p1->hasLocale && p1->locale != p2->locale) ||
+       (p1->hasInnerStatusCode && p1->innerStatusCode != p2->innerStatusCode))
+        return false;
+    if(p1->hasAdditionalInfo && !UA_String_equal(&p1->additionalInfo, &p2->additionalInfo))
+        return false;
+    if(!p1->hasInnerDiagnosticInfo)
+        return true;
+    if(!p1->innerDiagnosticInfo || !p2->innerDiagnosticInfo)
+        return (p1->innerDiagnosticInfo == p2->innerDiagnosticInfo);
+    return DiagnosticInfo_equal(p1->innerDiagnosticInfo, p2->innerDiagnosticInfo, NULL);
+}
+
+static UA_Boolean
+equalStructure(const void *p1, const void *p2, const UA_DataType *type);
+
+typedef UA_Boolean
+(*UA_equalSignature)(const void *p1, const void *p2, const UA_DataType *type);
+
+static const UA_equalSignature equalJumpTable[UA_BUILTIN_TYPES_COUNT + 1] = {
+    (UA_equalSignature)equalMem, // Boolean
+    (UA_equalSignature)equalMem, // SByte
+    (UA_equalSignature)equalMem, // Byte
+    (UA_equalSignature)equalMem, // Int16
+    (UA_equalSignature)equalMem, // UInt16
+    (UA_equalSignature)equalMem, // Int32
+    (UA_equalSignature)equalMem, // UInt32
+    (UA_equalSignature)equalMem, // Int64
+    (UA_equalSignature)equalMem, // UInt64
+    (UA_equalSignature)equalMem, // Float
+    (UA_equalSignature)equalMem, // Double
+    (UA_equalSignature)String_equal,
+    (UA_equalSignature)equalMem, // DateTime
+    (UA_equalSignature)equalMem, // Guid
+    (UA_equalSignature)String_equal, // ByteString
+    (UA_equalSignature)String_equal, // XmlElement
+    (UA_equalSignature)NodeId_equal,
+    (UA_equalSignature)ExpandedNodeId_equal,
+    (UA_equalSignature)equalMem, // StatusCode
+    (UA_equalSignature)QualifiedName_equal,
+    (UA_equalSignature)LocalizedText_equal,
+    (UA_equalSignature)ExtensionObject_equal,
+    (UA_equalSignature)DataValue_equal,
+    (UA_equalSignature)Variant_equal,
+    (UA_equalSignature)DiagnosticInfo_equal,
+    (UA_equalSignature)equalStructure // all others
+};
+
+static UA_Boolean
+equalStructure(const void *p1, const void *p2, const UA_DataType *type) {
+    uintptr_t ptr1 = (uintptr_t)p1;
+    uintptr_t ptr2 = (uintptr_t)p2;
+    u8 membersSize = type->membersSize;
+    for(size_t i = 0; i < membersSize; ++i) {
+        const UA_DataTypeMember *m= &type->members[i];
+        const UA_DataType *typelists[2] = { UA_TYPES, &type[-type->typeIndex] };
+        const UA_DataType *mt = &typelists[!m->namespaceZero][m->memberTypeIndex];
+        ptr1 += m->padding;
+        ptr2 += m->padding;
+        if(!m->isArray) {
+            size_t fi = mt->builtin ? mt->typeIndex : UA_BUILTIN_TYPES_COUNT;
+            if(!equalJumpTable[fi]((const void*)ptr1, (const void*)ptr2, mt))
+                return false;
+            ptr1 += mt->memSize;
+            ptr2 += mt->memSize;
+        } else {
+            const size_t size = *((const size_t*)ptr1);
+            if(size != *((const size_t*)ptr2))
+                return false;
+            ptr1 += sizeof(size_t);
+            ptr2 += sizeof(size_t);
+            if(!arrayEqual(*(void* const*)ptr1, *(void* const*)ptr2, size, mt))
+                return false;
+            ptr1 += sizeof(void*);
+            ptr2 += sizeof(void*);
+        }
+    }
+    return true;
+}
+
+static UA_Boolean
+arrayEqual(const void *p1, const void *p2, size_t size, const UA_DataType *type) {
+    if(size == 0)
+        return true;
+    if(p1 == p2)
+        return true;
+    if(type->overlayable)
+        return (memcmp(p1, p2, type->memSize * size) == 0);
+    uintptr_t ptr1 = (uintptr_t)p1;
+    uintptr_t ptr2 = (uintptr_t)p2;
+    size_t fi = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
+    for(size_t i = 0; i < size; ++i) {
+        if(!equalJumpTable[fi]((const void*)ptr1, (const void*)ptr2, type))
+            return false;
+        ptr1 += type->memSize;
+        ptr2 += type->memSize;
+    }
+    return true;
+}
+
+UA_Boolean
+UA_equal(const void *p1, const void *p2, const UA_DataType *type) {
+    return arrayEqual(p1, p2, 1, type);
+}
+
 /******************/
 /* Array Handling */
 /******************/
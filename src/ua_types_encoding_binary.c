@@ -36,15 +36,19 @@
 
 #define UA_ENCODING_MAX_RECURSION 20
 
-typedef struct {
+typedef struct UA_BinaryEncodingCtx {
     /* Pointers to the current position and the last position in the buffer */
     u8 *pos;
     const u8 *end;
 
     u16 depth; /* How often did we en-/decoding recurse? */
 
-    size_t customTypesArraySize;
-    const UA_DataType *customTypesArray;
+    const UA_CustomTypesIndex *customTypesIndex;
+
+    /* Decoded values are allocated from the arena if it is set */
+    UA_Arena *arena;
+    UA_Boolean borrow; /* Point into the buffer instead of copying. Only with
+                        * an arena, so that nothing is freed individually. */
 
     UA_exchangeEncodeBuffer exchangeBufferCallback;
     void *exchangeBufferCallbackHandle;
@@ -75,6 +79,73 @@ extern const calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES_CO
 static status encodeBinaryInternal(const void *src, const UA_DataType *type, Ctx *ctx);
 static status decodeBinaryInternal(void *dst, const UA_DataType *type, Ctx *ctx);
 
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+/* Position of the generated functions in the specialized jumptables plus one.
+ * Only for the types in UA_TYPES. */
+static UA_INLINE size_t
+specializedIndex(const UA_DataType *type) {
+    if(type->typeIndex >= UA_TYPES_COUNT || type != &UA_TYPES[type->typeIndex])
+        return 0;
+    return UA_specializedBinaryIndex[type->typeIndex];
+}
+
+/* Used in the generated functions. Encoding a member that reaches the end of
+ * the buffer is retried after exchanging the buffer. As in
+ * encodeBinaryInternal. */
+#define ENCODE_MEMBER(SRC, FUNC, TYPE) do {                             \
+        u8 *oldpos = ctx->pos;                                          \
+        ret = FUNC(SRC, TYPE, ctx);                                     \
+        if(ret == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)              \
+            ret = encodeMemberRetry(SRC, TYPE, oldpos, ctx);            \
+        if(ret != UA_STATUSCODE_GOOD)                                   \
+            return ret;                                                 \
+    } while(0)
+#define ENCODE_ARRAY(SRC, LENGTH, TYPE) do {                            \
+        ret = Array_encodeBinary(SRC, LENGTH, TYPE, ctx);               \
+        if(ret != UA_STATUSCODE_GOOD)                                   \
+            return ret;                                                 \
+    } while(0)
+#define DECODE_MEMBER(DST, FUNC, TYPE) do {                             \
+        ret = FUNC(DST, TYPE, ctx);                                     \
+        if(ret != UA_STATUSCODE_GOOD)                                   \
+            return ret;                                                 \
+    } while(0)
+#define DECODE_ARRAY(DST, LENGTH, TYPE) do {                            \
+        ret = Array_decodeBinary((void**)DST, LENGTH, TYPE, ctx);       \
+        if(ret != UA_STATUSCODE_GOOD)                                   \
+            return ret;                                                 \
+    } while(0)
+
+/* Floating point numbers are en-/decoded as integers if the memory layout
+ * matches the binary encoding. See the jumptables. */
+#if UA_BINARY_OVERLAYABLE_FLOAT
+# define Float_encodeSpecialized(SRC, TYPE, CTX) UInt32_encodeBinary((const u32*)(SRC), TYPE, CTX)
+# define Float_decodeSpecialized(DST, TYPE, CTX) UInt32_decodeBinary((u32*)(DST), TYPE, CTX)
+# define Double_encodeSpecialized(SRC, TYPE, CTX) UInt64_encodeBinary((const u64*)(SRC), TYPE, CTX)
+# define Double_decodeSpecialized(DST, TYPE, CTX) UInt64_decodeBinary((u64*)(DST), TYPE, CTX)
+#else
+# define Float_encodeSpecialized Float_encodeBinary
+# define Float_decodeSpecialized Float_decodeBinary
+# define Double_encodeSpecialized Double_encodeBinary
+# define Double_decodeSpecialized Double_decodeBinary
+#endif
+#endif
+
+/* Memory for decoded values. With an arena, the memory is released with the
+ * arena and not freed individually. */
+static void *
+decodeCalloc(Ctx *ctx, size_t nmemb, size_t size) {
+    if(ctx->arena)
+        return UA_Arena_calloc(ctx->arena, nmemb, size);
+    return UA_calloc(nmemb, size);
+}
+
+static void
+decodeDeleteMembers(Ctx *ctx, void *p, const UA_DataType *type) {
+    if(!ctx->arena)
+        UA_deleteMembers(p, type);
+}
+
 /**
  * Chunking
  * ^^^^^^^^
@@ -107,6 +178,28 @@ static status exchangeBuffer(Ctx *ctx) {
     return ctx->exchangeBufferCallback(ctx->exchangeBufferCallbackHandle, &ctx->pos, &ctx->end);
 }
 
+/* The encoding of a structure member reached the end of the buffer. Reset to
+ * the position before the member, exchange the buffer and encode the member
+ * again. */
+static status
+encodeMemberRetry(const void *src, const UA_DataType *type, u8 *oldpos, Ctx *ctx) {
+    size_t encode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
+    status ret = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    while(ret == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
+        ctx->pos = oldpos; /* exchange/send the buffer */
+        ret = exchangeBuffer(ctx);
+        if(ret == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED || ctx->pos + type->memSize > ctx->end) {
+            /* the send buffer is too small to encode the member, even after exchangeBuffer */
+            return UA_STATUSCODE_BADRESPONSETOOLARGE;
+        }
+        if(ret != UA_STATUSCODE_GOOD)
+            return ret;
+        oldpos = ctx->pos;
+        ret = encodeBinaryJumpTable[encode_index](src, type, ctx);
+    }
+    return ret;
+}
+
 /* If encoding fails, exchange the buffer and try again. It is assumed that the
  * following encoding never fails on a fresh buffer. This is true for numerical
  * types. */
@@ -510,15 +603,31 @@ Array_decodeBinary(void *UA_RESTRICT *UA_RESTRICT dst, size_t *out_length,
     if(ctx->pos + ((type->memSize * length) / 32) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
 
+    /* Point into the buffer if the overlayable array is aligned for the type */
+    if(ctx->borrow && type->overlayable) {
+        uintptr_t align = type->memSize & (~type->memSize + 1); /* lowest bit */
+        if(align > 8)
+            align = 8;
+        if(((uintptr_t)ctx->pos & (align - 1)) == 0) {
+            if(ctx->end < ctx->pos + (type->memSize * length))
+                return UA_STATUSCODE_BADDECODINGERROR;
+            *dst = ctx->pos;
+            ctx->pos += type->memSize * length;
+            *out_length = length;
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+
     /* Allocate memory */
-    *dst = UA_calloc(length, type->memSize);
+    *dst = decodeCalloc(ctx, length, type->memSize);
     if(!*dst)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     if(type->overlayable) {
         /* memcpy overlayable array */
         if(ctx->end < ctx->pos + (type->memSize * length)) {
-            UA_free(*dst);
+            if(!ctx->arena)
+                UA_free(*dst);
             *dst = NULL;
             return UA_STATUSCODE_BADDECODINGERROR;
         }
@@ -532,7 +641,8 @@ Array_decodeBinary(void *UA_RESTRICT *UA_RESTRICT dst, size_t *out_length,
             ret = decodeBinaryJumpTable[decode_index]((void*)ptr, type, ctx);
             if(ret != UA_STATUSCODE_GOOD) {
                 /* +1 because last element is also already initialized */
-                UA_Array_delete(*dst, i+1, type);
+                if(!ctx->arena)
+                    UA_Array_delete(*dst, i+1, type);
                 *dst = NULL;
                 return ret;
             }
@@ -806,6 +916,92 @@ DECODE_BINARY(LocalizedText) {
 
 /* The binary encoding has a different nodeid from the data type. So it is not
  * possible to reuse UA_findDataType */
+
+static UA_UInt32
+customTypesHash(UA_UInt16 namespaceIndex, UA_UInt32 binaryEncodingId) {
+    /* Knuth's multiplicative hash. The low bits of the encoding ids are
+     * mostly sequential. Mix the high bits down. */
+    UA_UInt32 h = binaryEncodingId * 2654435761u;
+    return (h ^ (h >> 16)) + namespaceIndex;
+}
+
+static const UA_DataType *
+findCustomType(const UA_CustomTypesIndex *index, UA_UInt16 namespaceIndex,
+               UA_UInt32 binaryEncodingId) {
+    const UA_DataType *types = index->customTypes;
+
+    /* No index. Scan the custom types. */
+    if(index->slotsSize == 0) {
+        for(size_t i = 0; i < index->customTypesSize; ++i) {
+            if(types[i].binaryEncodingId == binaryEncodingId &&
+               types[i].typeId.namespaceIndex == namespaceIndex)
+                return &types[i];
+        }
+        return NULL;
+    }
+
+    /* Linear probing until an empty slot is found */
+    size_t mask = index->slotsSize - 1;
+    size_t slot = customTypesHash(namespaceIndex, binaryEncodingId) & mask;
+    for(; index->slots[slot] != 0; slot = (slot + 1) & mask) {
+        const UA_DataType *type = &types[index->slots[slot] - 1];
+        if(type->binaryEncodingId == binaryEncodingId &&
+           type->typeId.namespaceIndex == namespaceIndex)
+            return type;
+    }
+    return NULL;
+}
+
+UA_StatusCode
+UA_CustomTypesIndex_init(UA_CustomTypesIndex *index, size_t customTypesSize,
+                         const UA_DataType *customTypes) {
+    index->customTypesSize = customTypesSize;
+    index->customTypes = customTypes;
+    index->slotsSize = 0;
+    index->slots = NULL;
+    if(customTypesSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    /* At most half of the slots are used */
+    size_t slotsSize = 8;
+    while(slotsSize < 2 * customTypesSize)
+        slotsSize <<= 1;
+    size_t *slots = (size_t*)UA_calloc(slotsSize, sizeof(size_t));
+    if(!slots)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Insert in the array order. If the same encoding id appears twice, the
+     * first type is found (as when scanning the array). */
+    size_t mask = slotsSize - 1;
+    for(size_t i = 0; i < customTypesSize; ++i) {
+        const UA_DataType *type = &customTypes[i];
+        size_t slot = customTypesHash(type->typeId.namespaceIndex,
+                                      type->binaryEncodingId) & mask;
+        UA_Boolean duplicate = false;
+        for(; slots[slot] != 0; slot = (slot + 1) & mask) {
+            const UA_DataType *other = &customTypes[slots[slot] - 1];
+            if(other->binaryEncodingId == type->binaryEncodingId &&
+               other->typeId.namespaceIndex == type->typeId.namespaceIndex) {
+                duplicate = true;
+                break;
+            }
+        }
+        if(!duplicate)
+            slots[slot] = i + 1;
+    }
+
+    index->slotsSize = slotsSize;
+    index->slots = slots;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_CustomTypesIndex_deleteMembers(UA_CustomTypesIndex *index) {
+    UA_free(index->slots);
+    index->slots = NULL;
+    index->slotsSize = 0;
+}
+
 static const UA_DataType *
 UA_findDataTypeByBinaryInternal(const UA_NodeId *typeId, Ctx *ctx) {
     /* We only store a numeric identifier for the encoding nodeid of data types */
@@ -813,21 +1009,19 @@ UA_findDataTypeByBinaryInternal(const UA_NodeId *typeId, Ctx *ctx) {
         return NULL;
 
     /* Always look in built-in types first
-     * (may contain data types from all namespaces) */
-    for(size_t i = 0; i < UA_TYPES_COUNT; ++i) {
-        if(UA_TYPES[i].binaryEncodingId == typeId->identifier.numeric &&
-           UA_TYPES[i].typeId.namespaceIndex == typeId->namespaceIndex)
-            return &UA_TYPES[i];
-    }
+     * (may contain data types from all namespaces). The generated perfect
+     * hash maps the identifier to the only candidate. */
+    UA_UInt16 index = UA_TYPES_BINARYENCODINGID_HASH[typeId->identifier.numeric %
+                                                     UA_TYPES_BINARYENCODINGID_HASHSIZE];
+    if(index < UA_TYPES_COUNT &&
+       UA_TYPES[index].binaryEncodingId == typeId->identifier.numeric &&
+       UA_TYPES[index].typeId.namespaceIndex == typeId->namespaceIndex)
+        return &UA_TYPES[index];
 
     /* When other namespace look in custom types, too */
-    if(typeId->namespaceIndex != 0) {
-        for(size_t i = 0; i < ctx->customTypesArraySize; ++i) {
-            if(ctx->customTypesArray[i].binaryEncodingId == typeId->identifier.numeric &&
-               ctx->customTypesArray[i].typeId.namespaceIndex == typeId->namespaceIndex)
-                return &ctx->customTypesArray[i];
-        }
-    }
+    if(typeId->namespaceIndex != 0 && ctx->customTypesIndex)
+        return findCustomType(ctx->customTypesIndex, typeId->namespaceIndex,
+                              typeId->identifier.numeric);
 
     return NULL;
 }
@@ -835,8 +1029,7 @@ UA_findDataTypeByBinaryInternal(const UA_NodeId *typeId, Ctx *ctx) {
 const UA_DataType *
 UA_findDataTypeByBinary(const UA_NodeId *typeId) {
     Ctx ctx;
-    ctx.customTypesArraySize = 0;
-    ctx.customTypesArray = NULL;
+    ctx.customTypesIndex = NULL;
     return UA_findDataTypeByBinaryInternal(typeId, &ctx);
 }
 
@@ -908,12 +1101,15 @@ ExtensionObject_decodeBinaryContent(UA_ExtensionObject *dst, const UA_NodeId *ty
     /* Unknown type, just take the binary content */
     if(!type) {
         dst->encoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
-        UA_NodeId_copy(typeId, &dst->content.encoded.typeId);
+        if(ctx->arena)
+            dst->content.encoded.typeId = *typeId; /* The arena keeps the memory */
+        else
+            UA_NodeId_copy(typeId, &dst->content.encoded.typeId);
         return DECODE_DIRECT(&dst->content.encoded.body, String); /* ByteString */
     }
 
     /* Allocate memory */
-    dst->content.decoded.data = UA_new(type);
+    dst->content.decoded.data = decodeCalloc(ctx, 1, type->memSize);
     if(!dst->content.decoded.data)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -939,13 +1135,13 @@ DECODE_BINARY(ExtensionObject) {
     ret |= DECODE_DIRECT(&binTypeId, NodeId);
     ret |= DECODE_DIRECT(&encoding, Byte);
     if(ret != UA_STATUSCODE_GOOD) {
-        UA_NodeId_deleteMembers(&binTypeId);
+        decodeDeleteMembers(ctx, &binTypeId, &UA_TYPES[UA_TYPES_NODEID]);
         return ret;
     }
 
     if(encoding == UA_EXTENSIONOBJECT_ENCODED_BYTESTRING) {
         ret = ExtensionObject_decodeBinaryContent(dst, &binTypeId, ctx);
-        UA_NodeId_deleteMembers(&binTypeId);
+        decodeDeleteMembers(ctx, &binTypeId, &UA_TYPES[UA_TYPES_NODEID]);
     } else if(encoding == UA_EXTENSIONOBJECT_ENCODED_NOBODY) {
         dst->encoding = (UA_ExtensionObjectEncoding)encoding;
         dst->content.encoded.typeId = binTypeId; /* move to dst */
@@ -955,9 +1151,10 @@ DECODE_BINARY(ExtensionObject) {
         dst->content.encoded.typeId = binTypeId; /* move to dst */
         ret = DECODE_DIRECT(&dst->content.encoded.body, String); /* ByteString */
         if(ret != UA_STATUSCODE_GOOD)
-            UA_NodeId_deleteMembers(&dst->content.encoded.typeId);
+            decodeDeleteMembers(ctx, &dst->content.encoded.typeId,
+                                &UA_TYPES[UA_TYPES_NODEID]);
     } else {
-        UA_NodeId_deleteMembers(&binTypeId);
+        decodeDeleteMembers(ctx, &binTypeId, &UA_TYPES[UA_TYPES_NODEID]);
         ret = UA_STATUSCODE_BADDECODINGERROR;
     }
 
@@ -1072,7 +1269,7 @@ Variant_decodeBinaryUnwrapExtensionObject(UA_Variant *dst, Ctx *ctx) {
     u8 encoding;
     ret = DECODE_DIRECT(&encoding, Byte);
     if(ret != UA_STATUSCODE_GOOD) {
-        UA_NodeId_deleteMembers(&typeId);
+        decodeDeleteMembers(ctx, &typeId, &UA_TYPES[UA_TYPES_NODEID]);
         return ret;
     }
 
@@ -1085,11 +1282,11 @@ Variant_decodeBinaryUnwrapExtensionObject(UA_Variant *dst, Ctx *ctx) {
         /* Reset and decode as ExtensionObject */
         dst->type = &UA_TYPES[UA_TYPES_EXTENSIONOBJECT];
         ctx->pos = old_pos;
-        UA_NodeId_deleteMembers(&typeId);
+        decodeDeleteMembers(ctx, &typeId, &UA_TYPES[UA_TYPES_NODEID]);
     }
 
     /* Allocate memory */
-    dst->data = UA_new(dst->type);
+    dst->data = decodeCalloc(ctx, 1, dst->type->memSize);
     if(!dst->data)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -1098,7 +1295,8 @@ Variant_decodeBinaryUnwrapExtensionObject(UA_Variant *dst, Ctx *ctx) {
     return decodeBinaryJumpTable[decode_index](dst->data, dst->type, ctx);
 }
 
-/* The resulting variant always has the storagetype UA_VARIANT_DATA. */
+/* The resulting variant has the storagetype UA_VARIANT_DATA. Or
+ * UA_VARIANT_DATA_NODELETE if the memory is taken from an arena. */
 DECODE_BINARY(Variant) {
     /* Decode the encoding byte */
     u8 encodingByte;
@@ -1110,6 +1308,10 @@ DECODE_BINARY(Variant) {
     if(encodingByte == 0)
         return UA_STATUSCODE_GOOD;
 
+    /* The content is released with the arena */
+    if(ctx->arena)
+        dst->storageType = UA_VARIANT_DATA_NODELETE;
+
     /* Does the variant contain an array? */
     const UA_Boolean isArray = (encodingByte & UA_VARIANT_ENCODINGMASKTYPE_ARRAY) > 0;
 
@@ -1134,7 +1336,7 @@ DECODE_BINARY(Variant) {
     if(isArray) {
         ret = Array_decodeBinary(&dst->data, &dst->arrayLength, dst->type, ctx);
     } else if(typeIndex != UA_TYPES_EXTENSIONOBJECT) {
-        dst->data = UA_new(dst->type);
+        dst->data = decodeCalloc(ctx, 1, dst->type->memSize);
         if(!dst->data)
             return UA_STATUSCODE_BADOUTOFMEMORY;
         ret = decodeBinaryJumpTable[typeIndex](dst->data, dst->type, ctx);
@@ -1322,7 +1524,7 @@ DECODE_BINARY(DiagnosticInfo) {
     if(encodingMask & 0x40) {
         /* innerDiagnosticInfo is allocated on the heap */
         dst->innerDiagnosticInfo = (UA_DiagnosticInfo*)
-            UA_calloc(1, sizeof(UA_DiagnosticInfo));
+            decodeCalloc(ctx, 1, sizeof(UA_DiagnosticInfo));
         if(!dst->innerDiagnosticInfo)
             return UA_STATUSCODE_BADOUTOFMEMORY;
         dst->hasInnerDiagnosticInfo = true;
@@ -1378,6 +1580,15 @@ encodeBinaryInternal(const void *src, const UA_DataType *type, Ctx *ctx) {
         return UA_STATUSCODE_BADENCODINGERROR;
     ctx->depth++;
 
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+    size_t si = specializedIndex(type);
+    if(si > 0) {
+        status sret = UA_encodeBinarySpecializedJumpTable[si - 1](src, type, ctx);
+        ctx->depth--;
+        return sret;
+    }
+#endif
+
     uintptr_t ptr = (uintptr_t)src;
     status ret = UA_STATUSCODE_GOOD;
     u8 membersSize = type->membersSize;
@@ -1388,21 +1599,11 @@ encodeBinaryInternal(const void *src, const UA_DataType *type, Ctx *ctx) {
         if(!member->isArray) {
             ptr += member->padding;
             size_t encode_index = membertype->builtin ? membertype->typeIndex : UA_BUILTIN_TYPES_COUNT;
-            size_t memSize = membertype->memSize;
             u8 *oldpos = ctx->pos;
             ret = encodeBinaryJumpTable[encode_index]((const void*)ptr, membertype, ctx);
-            ptr += memSize;
-            if(ret == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
-                ctx->pos = oldpos; /* exchange/send the buffer */
-                ret = exchangeBuffer(ctx);
-                ptr -= member->padding + memSize; /* encode the same member in the next iteration */
-                if(ret == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED || ctx->pos + memSize > ctx->end) {
-                    /* the send buffer is too small to encode the member, even after exchangeBuffer */
-                    ret = UA_STATUSCODE_BADRESPONSETOOLARGE;
-                    break;
-                }
-                --i;
-            }
+            if(ret == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+                ret = encodeMemberRetry((const void*)ptr, membertype, oldpos, ctx);
+            ptr += membertype->memSize;
         } else {
             ptr += member->padding;
             const size_t length = *((const size_t*)ptr);
@@ -1475,6 +1676,15 @@ decodeBinaryInternal(void *dst, const UA_DataType *type, Ctx *ctx) {
         return UA_STATUSCODE_BADENCODINGERROR;
     ctx->depth++;
 
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+    size_t si = specializedIndex(type);
+    if(si > 0) {
+        status sret = UA_decodeBinarySpecializedJumpTable[si - 1](dst, type, ctx);
+        ctx->depth--;
+        return sret;
+    }
+#endif
+
     uintptr_t ptr = (uintptr_t)dst;
     status ret = UA_STATUSCODE_GOOD;
     u8 membersSize = type->membersSize;
@@ -1505,13 +1715,35 @@ status
 UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst,
                 const UA_DataType *type, size_t customTypesSize,
                 const UA_DataType *customTypes) {
+    /* Without an index, the custom types are scanned */
+    UA_CustomTypesIndex customTypesIndex;
+    customTypesIndex.customTypesSize = customTypesSize;
+    customTypesIndex.customTypes = customTypes;
+    customTypesIndex.slotsSize = 0;
+    customTypesIndex.slots = NULL;
+    return UA_decodeBinaryIndexed(src, offset, dst, type, &customTypesIndex);
+}
+
+status
+UA_decodeBinaryIndexed(const UA_ByteString *src, size_t *offset, void *dst,
+                       const UA_DataType *type,
+                       const UA_CustomTypesIndex *customTypesIndex) {
+    return UA_decodeBinaryArena(src, offset, dst, type, customTypesIndex, NULL, false);
+}
+
+status
+UA_decodeBinaryArena(const UA_ByteString *src, size_t *offset, void *dst,
+                     const UA_DataType *type,
+                     const UA_CustomTypesIndex *customTypesIndex,
+                     UA_Arena *arena, UA_Boolean borrow) {
     /* Set up the context */
     Ctx ctx;
     ctx.pos = &src->data[*offset];
     ctx.end = &src->data[src->length];
     ctx.depth = 0;
-    ctx.customTypesArraySize = customTypesSize;
-    ctx.customTypesArray = customTypes;
+    ctx.customTypesIndex = customTypesIndex;
+    ctx.arena = arena;
+    ctx.borrow = (arena != NULL) && borrow;
 
     /* Decode */
     memset(dst, 0, type->memSize); /* Initialize the value */
@@ -1521,8 +1753,9 @@ UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst,
         /* Set the new offset */
         *offset = (size_t)(ctx.pos - src->data) / sizeof(u8);
     } else {
-        /* Clean up */
-        UA_deleteMembers(dst, type);
+        /* Clean up. Memory from the arena is released with the arena. */
+        if(!arena)
+            UA_deleteMembers(dst, type);
         memset(dst, 0, type->memSize);
     }
     return ret;
@@ -1742,6 +1975,12 @@ const calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1
 
 size_t
 UA_calcSizeBinary(const void *p, const UA_DataType *type) {
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+    size_t si = specializedIndex(type);
+    if(si > 0)
+        return UA_calcSizeBinarySpecializedJumpTable[si - 1](p, type);
+#endif
+
     size_t s = 0;
     uintptr_t ptr = (uintptr_t)p;
     u8 membersSize = type->membersSize;
@@ -1764,3 +2003,8 @@ UA_calcSizeBinary(const void *p, const UA_DataType *type) {
     }
     return s;
 }
+
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+/* In the amalgamation, the generated file follows at this position */
+#include "ua_types_generated_encoding_specialized.h"
+#endif
@@ -17,6 +17,7 @@ extern "C" {
 #endif
 
 #include "ua_types.h"
+#include "ua_util.h"
 
 typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle, UA_Byte **bufPos,
                                                  const UA_Byte **bufEnd);
@@ -67,6 +68,46 @@ UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst,
                 const UA_DataType *type, size_t customTypesSize,
                 const UA_DataType *customTypes) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
 
+/* Hash index over the binaryEncodingId of an array of custom types. Decoding
+ * an ExtensionObject looks up the type with every occurrence. The index is
+ * built once for the (constant) custom types of a server or client. */
+typedef struct {
+    size_t customTypesSize;
+    const UA_DataType *customTypes;
+    size_t slotsSize; /* Power of two. Zero if the index could not be
+                       * allocated. Then the custom types are scanned. */
+    size_t *slots;    /* Index in customTypes plus one. Zero marks an empty
+                       * slot. */
+} UA_CustomTypesIndex;
+
+UA_StatusCode
+UA_CustomTypesIndex_init(UA_CustomTypesIndex *index, size_t customTypesSize,
+                         const UA_DataType *customTypes);
+
+void
+UA_CustomTypesIndex_deleteMembers(UA_CustomTypesIndex *index);
+
+/* Same as UA_decodeBinary, but looks up custom types in the index */
+UA_StatusCode
+UA_decodeBinaryIndexed(const UA_ByteString *src, size_t *offset, void *dst,
+                       const UA_DataType *type,
+                       const UA_CustomTypesIndex *customTypesIndex) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
+/* Same as UA_decodeBinaryIndexed, but all memory of the decoded value is taken
+ * from the arena. The value must not be deleted with UA_deleteMembers. Its
+ * memory is released when the arena is reset. The heap is used if the arena is
+ * NULL.
+ *
+ * @param borrow With an arena, Strings, ByteStrings and overlayable arrays
+ *        point into src instead of being copied. Then the decoded value must
+ *        not outlive src. Values that are kept longer need to be copied with
+ *        UA_copy. */
+UA_StatusCode
+UA_decodeBinaryArena(const UA_ByteString *src, size_t *offset, void *dst,
+                     const UA_DataType *type,
+                     const UA_CustomTypesIndex *customTypesIndex,
+                     UA_Arena *arena, UA_Boolean borrow) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
 /* Returns the number of bytes the value p takes in binary encoding. Returns
  * zero if an error occurs. UA_calcSizeBinary is thread-safe and reentrant since
  * it does not access global (thread-local) variables. */
@@ -76,6 +117,30 @@ UA_calcSizeBinary(const void *p, const UA_DataType *type);
 const UA_DataType *
 UA_findDataTypeByBinary(const UA_NodeId *typeId);
 
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+/* Generated functions for frequently used structures in UA_TYPES. They
+ * en-/decode the members in sequence instead of interpreting the type
+ * description. The index maps the typeIndex to the position in the specialized
+ * jumptables plus one, or zero if there is no specialized function. Defined in
+ * ua_types_generated_encoding_specialized.h, which is included at the end of
+ * ua_types_encoding_binary.c. */
+struct UA_BinaryEncodingCtx;
+
+typedef UA_StatusCode
+(*UA_encodeBinarySpecializedSignature)(const void *src, const UA_DataType *type,
+                                       struct UA_BinaryEncodingCtx *ctx);
+typedef UA_StatusCode
+(*UA_decodeBinarySpecializedSignature)(void *dst, const UA_DataType *type,
+                                       struct UA_BinaryEncodingCtx *ctx);
+typedef size_t
+(*UA_calcSizeBinarySpecializedSignature)(const void *p, const UA_DataType *type);
+
+extern const UA_Byte UA_specializedBinaryIndex[];
+extern const UA_encodeBinarySpecializedSignature UA_encodeBinarySpecializedJumpTable[];
+extern const UA_decodeBinarySpecializedSignature UA_decodeBinarySpecializedJumpTable[];
+extern const UA_calcSizeBinarySpecializedSignature UA_calcSizeBinarySpecializedJumpTable[];
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -100,3 +100,89 @@ UA_parseEndpointUrl(const UA_String *endpointUrl, UA_String *outHostname,
 
     return UA_STATUSCODE_GOOD;
 }
+
+/* Arena Allocator */
+
+/* Alignment of the memory returned from the arena. Sufficient for all members
+ * of the builtin and generated types. */
+#define UA_ARENA_ALIGN 16
+#define UA_ARENA_ROUNDUP(s) (((s) + (UA_ARENA_ALIGN - 1)) & ~(size_t)(UA_ARENA_ALIGN - 1))
+
+struct UA_ArenaBlock {
+    UA_ArenaBlock *next;
+    size_t size; /* Usable bytes after the header */
+    size_t used;
+};
+
+#define UA_ARENA_HEADERSIZE UA_ARENA_ROUNDUP(sizeof(UA_ArenaBlock))
+
+static UA_ArenaBlock *
+UA_Arena_addBlock(UA_Arena *arena, size_t size) {
+    UA_ArenaBlock *block = (UA_ArenaBlock*)UA_malloc(UA_ARENA_HEADERSIZE + size);
+    if(!block)
+        return NULL;
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->totalSize += size;
+    return block;
+}
+
+void
+UA_Arena_init(UA_Arena *arena) {
+    memset(arena, 0, sizeof(UA_Arena));
+}
+
+void *
+UA_Arena_calloc(UA_Arena *arena, size_t nmemb, size_t size) {
+    if(size > 0 && nmemb > (SIZE_MAX - UA_ARENA_ALIGN) / size)
+        return NULL;
+    size_t length = UA_ARENA_ROUNDUP(nmemb * size);
+
+    /* Take a new block that is at least twice the size of the current one */
+    UA_ArenaBlock *block = arena->blocks;
+    if(!block || block->size - block->used < length) {
+        size_t blockSize = UA_ARENA_BLOCKSIZE;
+        if(block && block->size * 2 > blockSize)
+            blockSize = block->size * 2;
+        if(length > blockSize)
+            blockSize = length;
+        block = UA_Arena_addBlock(arena, blockSize);
+        if(!block)
+            return NULL;
+    }
+
+    void *p = (UA_Byte*)block + UA_ARENA_HEADERSIZE + block->used;
+    block->used += length;
+    memset(p, 0, length);
+    return p;
+}
+
+void
+UA_Arena_reset(UA_Arena *arena) {
+    /* Only one block that is not too large. Keep it. */
+    UA_ArenaBlock *block = arena->blocks;
+    if(block && !block->next && block->size <= UA_ARENA_MAXRETAIN) {
+        block->used = 0;
+        return;
+    }
+
+    /* Free the blocks and replace them with a single block of the same size */
+    size_t totalSize = arena->totalSize;
+    UA_Arena_deleteMembers(arena);
+    if(totalSize > 0 && totalSize <= UA_ARENA_MAXRETAIN)
+        UA_Arena_addBlock(arena, totalSize);
+}
+
+void
+UA_Arena_deleteMembers(UA_Arena *arena) {
+    UA_ArenaBlock *block = arena->blocks;
+    while(block) {
+        UA_ArenaBlock *next = block->next;
+        UA_free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->totalSize = 0;
+}
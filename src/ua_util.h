@@ -23,6 +23,9 @@ extern "C" {
 /* BSD Queue Macros */
 #include "../deps/queue.h"
 
+/* Zip Tree Macros */
+#include "../deps/ziptree.h"
+
 /* Macro-Expand for MSVC workarounds */
 #define UA_MACRO_EXPAND(x) x
 
@@ -106,6 +109,29 @@ UA_atomic_cmpxchg(void * volatile * addr, void *expected, void *newptr) {
 #endif
 }
 
+static UA_INLINE size_t
+UA_atomic_cmpxchgSize(volatile size_t *addr, size_t expected, size_t newval) {
+#ifndef UA_ENABLE_MULTITHREADING
+    size_t old = *addr;
+    if(old == expected) {
+        *addr = newval;
+    }
+    return old;
+#else
+# ifdef _MSC_VER /* Visual Studio */
+#  ifdef _WIN64
+    return (size_t)_InterlockedCompareExchange64((volatile __int64*)addr,
+                                                 (__int64)newval, (__int64)expected);
+#  else
+    return (size_t)_InterlockedCompareExchange((volatile long*)addr,
+                                               (long)newval, (long)expected);
+#  endif
+# else /* GCC/Clang */
+    return __sync_val_compare_and_swap(addr, expected, newval);
+# endif
+#endif
+}
+
 static UA_INLINE uint32_t
 UA_atomic_addUInt32(volatile uint32_t *addr, uint32_t increase) {
 #ifndef UA_ENABLE_MULTITHREADING
@@ -173,6 +199,35 @@ size_t UA_readNumber(u8 *buf, size_t buflen, u32 *number);
 #define UA_MIN(A,B) (A > B ? B : A)
 #define UA_MAX(A,B) (A > B ? A : B)
 
+/* Arena Allocator
+ * ---------------
+ * Bump allocator for values that share a lifetime, for example a decoded
+ * request. The memory is released all at once when the arena is reset. Values
+ * allocated from the arena must not be deleted with the _deleteMembers
+ * methods. After a reset, the arena keeps a single block large enough for the
+ * previous use (up to UA_ARENA_MAXRETAIN bytes). So that repeated uses of
+ * similar size need no allocation from the heap. */
+
+#define UA_ARENA_BLOCKSIZE 4096
+#define UA_ARENA_MAXRETAIN 65536
+
+typedef struct UA_ArenaBlock UA_ArenaBlock;
+
+typedef struct {
+    UA_ArenaBlock *blocks; /* The current block first */
+    size_t totalSize;      /* Size of all blocks */
+} UA_Arena;
+
+void UA_Arena_init(UA_Arena *arena);
+
+/* Returns zeroed memory or NULL if no memory could be allocated */
+void * UA_Arena_calloc(UA_Arena *arena, size_t nmemb, size_t size);
+
+/* Release all memory taken from the arena */
+void UA_Arena_reset(UA_Arena *arena);
+
+void UA_Arena_deleteMembers(UA_Arena *arena);
+
 #ifdef UA_DEBUG_DUMP_PKGS
 void UA_EXPORT UA_dump_hex_pkg(UA_Byte* buffer, size_t bufferLen);
 #endif
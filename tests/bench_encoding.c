@@ -0,0 +1,188 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Compare the specialized binary encoding of frequently used structures with
+ * the generic encoding that interprets the type description. A copy of the type
+ * description is not part of UA_TYPES and always uses the generic encoding.
+ * Structures with structure members are not compared, as the members would
+ * still use the specialized encoding.
+ *
+ * Usage: bench_encoding [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ua_types.h"
+#include "ua_nodeids.h"
+#include "ua_types_generated_handling.h"
+#include "ua_types_encoding_binary.h"
+
+static void
+fillRequestHeader(void *p) {
+    UA_RequestHeader *rh = (UA_RequestHeader*)p;
+    rh->authenticationToken = UA_NODEID_GUID(0, UA_Guid_random());
+    rh->timestamp = UA_DateTime_now();
+    rh->requestHandle = 1234;
+    rh->timeoutHint = 10000;
+}
+
+static void
+fillReadValueId(void *p) {
+    UA_ReadValueId *rvi = (UA_ReadValueId*)p;
+    rvi->nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+    rvi->attributeId = UA_ATTRIBUTEID_VALUE;
+}
+
+static void
+fillWriteValue(void *p) {
+    UA_WriteValue *wv = (UA_WriteValue*)p;
+    wv->nodeId = UA_NODEID_NUMERIC(1, 4711);
+    wv->attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_Double d = 42.0;
+    UA_Variant_setScalarCopy(&wv->value.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    wv->value.hasValue = true;
+    wv->value.sourceTimestamp = UA_DateTime_now();
+    wv->value.hasSourceTimestamp = true;
+}
+
+static void
+fillBrowseDescription(void *p) {
+    UA_BrowseDescription *bd = (UA_BrowseDescription*)p;
+    bd->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd->browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    bd->includeSubtypes = true;
+    bd->resultMask = UA_BROWSERESULTMASK_ALL;
+}
+
+static void
+fillReferenceDescription(void *p) {
+    UA_ReferenceDescription *rd = (UA_ReferenceDescription*)p;
+    rd->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rd->isForward = true;
+    rd->nodeId.nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+    rd->browseName = UA_QUALIFIEDNAME_ALLOC(1, "the answer");
+    rd->displayName = UA_LOCALIZEDTEXT_ALLOC("en-US", "the answer");
+    rd->nodeClass = UA_NODECLASS_VARIABLE;
+    rd->typeDefinition.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+}
+
+static void
+fillMonitoredItemNotification(void *p) {
+    UA_MonitoredItemNotification *min = (UA_MonitoredItemNotification*)p;
+    min->clientHandle = 17;
+    UA_Int32 i = 42;
+    UA_Variant_setScalarCopy(&min->value.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+    min->value.hasValue = true;
+    min->value.sourceTimestamp = UA_DateTime_now();
+    min->value.hasSourceTimestamp = true;
+    min->value.serverTimestamp = UA_DateTime_now();
+    min->value.hasServerTimestamp = true;
+}
+
+static void
+fillSubscriptionAcknowledgement(void *p) {
+    UA_SubscriptionAcknowledgement *sa = (UA_SubscriptionAcknowledgement*)p;
+    sa->subscriptionId = 1;
+    sa->sequenceNumber = 4711;
+}
+
+typedef struct {
+    const char *name;
+    size_t typeIndex;
+    void (*fill)(void *p);
+} BenchType;
+
+static const BenchType benchTypes[] = {
+    {"RequestHeader", UA_TYPES_REQUESTHEADER, fillRequestHeader},
+    {"ReadValueId", UA_TYPES_READVALUEID, fillReadValueId},
+    {"WriteValue", UA_TYPES_WRITEVALUE, fillWriteValue},
+    {"BrowseDescription", UA_TYPES_BROWSEDESCRIPTION, fillBrowseDescription},
+    {"ReferenceDescription", UA_TYPES_REFERENCEDESCRIPTION, fillReferenceDescription},
+    {"MonitoredItemNotification", UA_TYPES_MONITOREDITEMNOTIFICATION, fillMonitoredItemNotification},
+    {"SubscriptionAcknowledgement", UA_TYPES_SUBSCRIPTIONACKNOWLEDGEMENT, fillSubscriptionAcknowledgement}
+};
+
+/* Returns the nanoseconds per encoding, decoding and calcSize */
+static UA_StatusCode
+benchEncoding(const void *value, const UA_DataType *type,
+              size_t iterations, double *ns) {
+    size_t size = UA_calcSizeBinary(value, type);
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&buf, size);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    clock_t start = clock();
+    for(size_t i = 0; i < iterations && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_Byte *pos = buf.data;
+        const UA_Byte *end = &buf.data[buf.length];
+        retval = UA_encodeBinary(value, type, &pos, &end, NULL, NULL);
+    }
+    ns[0] = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (double)iterations;
+
+    void *dst = UA_new(type);
+    start = clock();
+    for(size_t i = 0; i < iterations && retval == UA_STATUSCODE_GOOD; i++) {
+        size_t offset = 0;
+        retval = UA_decodeBinary(&buf, &offset, dst, type, 0, NULL);
+        UA_deleteMembers(dst, type);
+    }
+    ns[1] = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (double)iterations;
+    UA_delete(dst, type);
+
+    size_t total = 0;
+    start = clock();
+    for(size_t i = 0; i < iterations; i++)
+        total += UA_calcSizeBinary(value, type);
+    ns[2] = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (double)iterations;
+    if(total != size * iterations)
+        retval = UA_STATUSCODE_BADENCODINGERROR;
+
+    UA_ByteString_deleteMembers(&buf);
+    return retval;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = 200000;
+    if(argc > 1)
+        iterations = (size_t)strtoul(argv[1], NULL, 10);
+    if(iterations == 0)
+        iterations = 1;
+
+#ifndef UA_ENABLE_SPECIALIZED_ENCODING
+    printf("Built without UA_ENABLE_SPECIALIZED_ENCODING. "
+           "Both columns use the generic encoding.\n");
+#endif
+    printf("%-30s %6s %21s %21s %21s\n", "ns per op (specialized/generic)",
+           "bytes", "encode", "decode", "calcSize");
+
+    int result = EXIT_SUCCESS;
+    for(size_t i = 0; i < sizeof(benchTypes) / sizeof(BenchType); i++) {
+        const UA_DataType *type = &UA_TYPES[benchTypes[i].typeIndex];
+        UA_DataType generic = *type;
+        void *value = UA_new(type);
+        benchTypes[i].fill(value);
+
+        double specialized_ns[3], generic_ns[3];
+        UA_StatusCode retval = benchEncoding(value, type, iterations, specialized_ns);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = benchEncoding(value, &generic, iterations, generic_ns);
+        if(retval == UA_STATUSCODE_GOOD) {
+            printf("%-30s %6lu", benchTypes[i].name,
+                   (unsigned long)UA_calcSizeBinary(value, type));
+            for(size_t j = 0; j < 3; j++)
+                printf("  %6.1f/%6.1f (%4.2fx)", specialized_ns[j], generic_ns[j],
+                       specialized_ns[j] > 0 ? generic_ns[j] / specialized_ns[j] : 0.0);
+            printf("\n");
+        } else {
+            printf("%s: failed with StatusCode %s\n", benchTypes[i].name,
+                   UA_StatusCode_name(retval));
+            result = EXIT_FAILURE;
+        }
+        UA_delete(value, type);
+    }
+    return result;
+}
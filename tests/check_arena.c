@@ -0,0 +1,319 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* The heap allocations are counted by wrapping malloc and friends in the
+ * linker (-Wl,--wrap=malloc). So the reduction of the allocations with the
+ * arena can be measured. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_types_generated_handling.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_util.h"
+#include "check.h"
+
+static size_t allocations;
+static size_t frees;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void __wrap_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    allocations++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    if(ptr)
+        frees++;
+    __real_free(ptr);
+}
+
+/* Encode a ReadRequest for items with string NodeIds */
+static UA_ByteString
+encodeReadRequest(size_t items) {
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    request.nodesToRead = (UA_ReadValueId*)
+        UA_Array_new(items, &UA_TYPES[UA_TYPES_READVALUEID]);
+    ck_assert_ptr_ne(request.nodesToRead, NULL);
+    request.nodesToReadSize = items;
+    for(size_t i = 0; i < items; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "the.answer.%lu", (unsigned long)i);
+        request.nodesToRead[i].nodeId = UA_NODEID_STRING_ALLOC(1, name);
+        request.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&buf, 65536);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Byte *pos = buf.data;
+    const UA_Byte *end = &buf.data[buf.length];
+    retval = UA_encodeBinary(&request, &UA_TYPES[UA_TYPES_READREQUEST],
+                             &pos, &end, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    buf.length = (size_t)(pos - buf.data);
+    UA_ReadRequest_deleteMembers(&request);
+    return buf;
+}
+
+/* Decoding into the arena gives the same value */
+static void
+checkRoundtrip(const UA_ByteString *encoded, const void *decoded,
+               const UA_DataType *type) {
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&buf, encoded->length);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Byte *pos = buf.data;
+    const UA_Byte *end = &buf.data[buf.length];
+    retval = UA_encodeBinary(decoded, type, &pos, &end, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq((size_t)(pos - buf.data), encoded->length);
+    ck_assert(memcmp(buf.data, encoded->data, encoded->length) == 0);
+    UA_ByteString_deleteMembers(&buf);
+}
+
+START_TEST(Arena_alignedAndZeroed) {
+    UA_Arena arena;
+    UA_Arena_init(&arena);
+    for(size_t i = 1; i < 1000; ++i) {
+        UA_Byte *p = (UA_Byte*)UA_Arena_calloc(&arena, i, 3);
+        ck_assert_ptr_ne(p, NULL);
+        ck_assert_uint_eq((uintptr_t)p % 16, 0);
+        for(size_t j = 0; j < i * 3; ++j)
+            ck_assert_uint_eq(p[j], 0);
+        memset(p, 0xff, i * 3);
+    }
+    ck_assert_ptr_eq(UA_Arena_calloc(&arena, SIZE_MAX / 2, 4), NULL);
+    UA_Arena_deleteMembers(&arena);
+} END_TEST
+
+START_TEST(Arena_resetKeepsOneBlock) {
+    UA_Arena arena;
+    UA_Arena_init(&arena);
+    for(size_t i = 0; i < 100; ++i)
+        UA_Arena_calloc(&arena, 1, 300);
+    UA_Arena_reset(&arena);
+
+    /* The same allocations fit into the retained block */
+    allocations = 0;
+    for(size_t i = 0; i < 100; ++i)
+        UA_Arena_calloc(&arena, 1, 300);
+    UA_Arena_reset(&arena);
+    ck_assert_uint_eq(allocations, 0);
+
+    /* Large blocks are not retained */
+    frees = 0;
+    UA_Arena_calloc(&arena, 1, UA_ARENA_MAXRETAIN + 1);
+    UA_Arena_reset(&arena);
+    ck_assert_uint_gt(frees, 0);
+    UA_Arena_deleteMembers(&arena);
+} END_TEST
+
+START_TEST(Arena_decodeVariants) {
+    UA_Variant v[3];
+    UA_String s = UA_STRING("open62541");
+    UA_Variant_setScalar(&v[0], &s, &UA_TYPES[UA_TYPES_STRING]);
+    UA_Int32 ints[4] = {1, 2, 3, 4};
+    UA_Variant_setArray(&v[1], ints, 4, &UA_TYPES[UA_TYPES_INT32]);
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "the.answer");
+    UA_Variant_setScalar(&v[2], &rvi, &UA_TYPES[UA_TYPES_READVALUEID]);
+    UA_Variant array;
+    UA_Variant_setArray(&array, v, 3, &UA_TYPES[UA_TYPES_VARIANT]);
+
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&buf, 1024);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Byte *pos = buf.data;
+    const UA_Byte *end = &buf.data[buf.length];
+    retval = UA_encodeBinary(&array, &UA_TYPES[UA_TYPES_VARIANT], &pos, &end, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    buf.length = (size_t)(pos - buf.data);
+
+    UA_Arena arena;
+    UA_Arena_init(&arena);
+    UA_Variant decoded;
+    size_t offset = 0;
+    retval = UA_decodeBinaryArena(&buf, &offset, &decoded, &UA_TYPES[UA_TYPES_VARIANT],
+                                  NULL, &arena, false);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(offset, buf.length);
+    ck_assert_uint_eq(decoded.arrayLength, 3);
+    UA_Variant *inner = (UA_Variant*)decoded.data;
+    ck_assert_ptr_eq(inner[2].type, &UA_TYPES[UA_TYPES_READVALUEID]);
+    checkRoundtrip(&buf, &decoded, &UA_TYPES[UA_TYPES_VARIANT]);
+
+    /* Failed decoding leaves the memory to the arena */
+    buf.length -= 4;
+    offset = 0;
+    retval = UA_decodeBinaryArena(&buf, &offset, &decoded, &UA_TYPES[UA_TYPES_VARIANT],
+                                  NULL, &arena, false);
+    ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+
+    UA_Arena_deleteMembers(&arena);
+    UA_ByteString_deleteMembers(&buf);
+} END_TEST
+
+/* Benchmark the number of heap allocations to decode and release a large
+ * ReadRequest */
+START_TEST(Arena_decodeReadRequestAllocations) {
+    const size_t items = 1000;
+    UA_ByteString buf = encodeReadRequest(items);
+
+    /* Decode on the heap */
+    UA_ReadRequest request;
+    size_t offset = 0;
+    allocations = 0;
+    frees = 0;
+    UA_StatusCode retval = UA_decodeBinaryIndexed(&buf, &offset, &request,
+                                                  &UA_TYPES[UA_TYPES_READREQUEST], NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_ReadRequest_deleteMembers(&request);
+    size_t heapAllocations = allocations;
+    size_t heapFrees = frees;
+
+    /* Decode into the arena. Warm up once. */
+    UA_Arena arena;
+    UA_Arena_init(&arena);
+    offset = 0;
+    retval = UA_decodeBinaryArena(&buf, &offset, &request,
+                                  &UA_TYPES[UA_TYPES_READREQUEST], NULL, &arena, false);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    checkRoundtrip(&buf, &request, &UA_TYPES[UA_TYPES_READREQUEST]);
+    UA_Arena_reset(&arena);
+
+    offset = 0;
+    allocations = 0;
+    frees = 0;
+    retval = UA_decodeBinaryArena(&buf, &offset, &request,
+                                  &UA_TYPES[UA_TYPES_READREQUEST], NULL, &arena, false);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Arena_reset(&arena);
+    size_t arenaAllocations = allocations;
+    size_t arenaFrees = frees;
+
+    printf("ReadRequest with %lu items: %lu allocations and %lu frees on the heap, "
+           "%lu allocations and %lu frees with the arena\n", (unsigned long)items,
+           (unsigned long)heapAllocations, (unsigned long)heapFrees,
+           (unsigned long)arenaAllocations, (unsigned long)arenaFrees);
+    ck_assert_uint_gt(heapAllocations, items);
+    ck_assert_uint_lt(arenaAllocations * 100, heapAllocations);
+
+    /* Smaller requests are decoded without any heap allocation */
+    UA_ByteString_deleteMembers(&buf);
+    buf = encodeReadRequest(100);
+    for(size_t i = 0; i < 2; ++i) {
+        offset = 0;
+        allocations = 0;
+        retval = UA_decodeBinaryArena(&buf, &offset, &request,
+                                      &UA_TYPES[UA_TYPES_READREQUEST], NULL, &arena, false);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_Arena_reset(&arena);
+    }
+    ck_assert_uint_eq(allocations, 0);
+
+    UA_Arena_deleteMembers(&arena);
+    UA_ByteString_deleteMembers(&buf);
+} END_TEST
+
+/* Strings point into the buffer. Overlayable arrays only if they are aligned. */
+START_TEST(Arena_decodeBorrowed) {
+    UA_ByteString buf = encodeReadRequest(1000);
+
+    UA_Arena arena;
+    UA_Arena_init(&arena);
+    UA_ReadRequest request;
+    size_t offset = 0;
+    UA_StatusCode retval =
+        UA_decodeBinaryArena(&buf, &offset, &request, &UA_TYPES[UA_TYPES_READREQUEST],
+                             NULL, &arena, false);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    size_t copiedSize = arena.totalSize;
+    UA_Arena_deleteMembers(&arena);
+
+    offset = 0;
+    retval = UA_decodeBinaryArena(&buf, &offset, &request, &UA_TYPES[UA_TYPES_READREQUEST],
+                                  NULL, &arena, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    checkRoundtrip(&buf, &request, &UA_TYPES[UA_TYPES_READREQUEST]);
+    for(size_t i = 0; i < request.nodesToReadSize; ++i) {
+        const UA_String *id = &request.nodesToRead[i].nodeId.identifier.string;
+        ck_assert(id->data > buf.data && id->data < &buf.data[buf.length]);
+    }
+    printf("ReadRequest with 1000 items: %lu bytes in the arena, "
+           "%lu bytes when borrowing the strings\n",
+           (unsigned long)copiedSize, (unsigned long)arena.totalSize);
+    ck_assert_uint_le(arena.totalSize, copiedSize);
+    UA_Arena_reset(&arena);
+
+    /* An Int32 array at an odd position is copied */
+    UA_Int32 ints[4] = {1, 2, 3, 4};
+    UA_Variant v;
+    UA_Variant_setArray(&v, ints, 4, &UA_TYPES[UA_TYPES_INT32]);
+    for(size_t shift = 0; shift < 4; ++shift) {
+        UA_Byte *pos = &buf.data[shift];
+        const UA_Byte *end = &buf.data[buf.length];
+        retval = UA_encodeBinary(&v, &UA_TYPES[UA_TYPES_VARIANT], &pos, &end, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_Variant decoded;
+        offset = shift;
+        retval = UA_decodeBinaryArena(&buf, &offset, &decoded, &UA_TYPES[UA_TYPES_VARIANT],
+                                      NULL, &arena, true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(decoded.storageType, UA_VARIANT_DATA_NODELETE);
+        ck_assert_uint_eq((uintptr_t)decoded.data % sizeof(UA_Int32), 0);
+        ck_assert(memcmp(decoded.data, ints, sizeof(ints)) == 0);
+        UA_Arena_reset(&arena);
+    }
+
+    UA_Arena_deleteMembers(&arena);
+    UA_ByteString_deleteMembers(&buf);
+} END_TEST
+
+static Suite *testSuite_arena(void) {
+    Suite *s = suite_create("Arena");
+    TCase *tc = tcase_create("arena");
+    tcase_add_test(tc, Arena_alignedAndZeroed);
+    tcase_add_test(tc, Arena_resetKeepsOneBlock);
+    tcase_add_test(tc, Arena_decodeVariants);
+    tcase_add_test(tc, Arena_decodeReadRequestAllocations);
+    tcase_add_test(tc, Arena_decodeBorrowed);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_arena();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -8,9 +8,15 @@
 #include "ua_types_generated_handling.h"
 #include "ua_types_generated_encoding_binary.h"
 #include "ua_securechannel.h"
+#include "ua_connection_internal.h"
+#include "ua_securitypolicy_none.h"
+#include "ua_log_stdout.h"
 #include "ua_util.h"
+#include "testing_networklayers.h"
 #include "check.h"
 
+#include <time.h>
+
 UA_ByteString *buffers;
 size_t bufIndex;
 size_t counter;
@@ -152,6 +158,174 @@ START_TEST(encodeTwoStringsIntoTenChunksShallWork) {
     UA_String_deleteMembers(&string);
 } END_TEST
 
+/* Decode a multi-chunk message that arrives in small packets */
+
+#define REASSEMBLY_CHUNKSIZE 8192
+#define REASSEMBLY_HEADERSIZE 24 /* Message, security and sequence header */
+#define REASSEMBLY_PACKETSIZE 1460 /* Typical TCP segment size */
+
+static UA_Connection reassemblyConnection;
+static UA_SecureChannel reassemblyChannel;
+static UA_SecurityPolicy reassemblyPolicy;
+static size_t messagesReceived;
+static UA_ByteString expectedPayload;
+
+static void
+setup_reassembly(void) {
+    messagesReceived = 0;
+    expectedPayload = UA_BYTESTRING_NULL;
+    UA_SecurityPolicy_None(&reassemblyPolicy, NULL, UA_BYTESTRING_NULL,
+                           UA_Log_Stdout);
+    UA_SecureChannel_init(&reassemblyChannel, &reassemblyPolicy,
+                          &UA_BYTESTRING_NULL);
+    reassemblyChannel.securityMode = UA_MESSAGESECURITYMODE_NONE;
+    reassemblyConnection = createDummyConnection(65535, NULL);
+    UA_Connection_attachSecureChannel(&reassemblyConnection, &reassemblyChannel);
+}
+
+static void
+teardown_reassembly(void) {
+    UA_SecureChannel_deleteMembersCleanup(&reassemblyChannel);
+    reassemblyPolicy.deleteMembers(&reassemblyPolicy);
+    reassemblyConnection.close(&reassemblyConnection);
+    UA_Connection_deleteMembers(&reassemblyConnection);
+    UA_ByteString_deleteMembers(&expectedPayload);
+}
+
+static void
+writeUInt32(UA_Byte *pos, UA_UInt32 value) {
+    pos[0] = (UA_Byte)value;
+    pos[1] = (UA_Byte)(value >> 8);
+    pos[2] = (UA_Byte)(value >> 16);
+    pos[3] = (UA_Byte)(value >> 24);
+}
+
+/* Encode a MSG with the given payload length into consecutive chunks. The
+ * payload is also stored in expectedPayload. Returns the number of chunks. */
+static size_t
+encodeChunkedMessage(UA_ByteString *stream, size_t payloadLength) {
+    const size_t bodySize = REASSEMBLY_CHUNKSIZE - REASSEMBLY_HEADERSIZE;
+    size_t chunks = (payloadLength + bodySize - 1) / bodySize;
+    UA_StatusCode retval =
+        UA_ByteString_allocBuffer(stream, payloadLength + chunks * REASSEMBLY_HEADERSIZE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_ByteString_allocBuffer(&expectedPayload, payloadLength);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < payloadLength; i++)
+        expectedPayload.data[i] = (UA_Byte)((i * 31) ^ (i >> 8));
+
+    UA_Byte *pos = stream->data;
+    size_t written = 0;
+    for(size_t i = 0; i < chunks; i++) {
+        size_t body = payloadLength - written;
+        if(body > bodySize)
+            body = bodySize;
+        memcpy(pos, "MSG", 3);
+        pos[3] = (i + 1 == chunks) ? 'F' : 'C';
+        writeUInt32(&pos[4], (UA_UInt32)(body + REASSEMBLY_HEADERSIZE));
+        writeUInt32(&pos[8], 0); /* SecureChannelId */
+        writeUInt32(&pos[12], 0); /* TokenId */
+        writeUInt32(&pos[16], (UA_UInt32)(i + 1)); /* SequenceNumber */
+        writeUInt32(&pos[20], 1); /* RequestId */
+        pos += REASSEMBLY_HEADERSIZE;
+        memcpy(pos, &expectedPayload.data[written], body);
+        pos += body;
+        written += body;
+    }
+    return chunks;
+}
+
+static UA_StatusCode
+checkMessage(void *application, UA_SecureChannel *channel,
+             UA_MessageType messageType, UA_UInt32 requestId,
+             const UA_ByteString *message) {
+    ck_assert_uint_eq(messageType, UA_MESSAGETYPE_MSG);
+    ck_assert_uint_eq(requestId, 1);
+    ck_assert(UA_ByteString_equal(message, &expectedPayload));
+    messagesReceived++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+processReassemblyChunk(void *application, UA_Connection *connection,
+                       UA_ByteString *chunk) {
+    return UA_SecureChannel_processChunk(connection->channel, chunk,
+                                         checkMessage, NULL);
+}
+
+static UA_StatusCode
+receiveInPackets(const UA_ByteString *stream, size_t packetSize) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t pos = 0; pos < stream->length && retval == UA_STATUSCODE_GOOD;
+        pos += packetSize) {
+        UA_ByteString packet = {packetSize, &stream->data[pos]};
+        if(pos + packetSize > stream->length)
+            packet.length = stream->length - pos;
+        retval = UA_Connection_processChunks(&reassemblyConnection, NULL,
+                                             processReassemblyChunk, &packet);
+    }
+    return retval;
+}
+
+START_TEST(reassembleChunksFromSmallPackets) {
+    /* Packet boundaries at every possible position within the header */
+    UA_ByteString stream;
+    encodeChunkedMessage(&stream, 3 * REASSEMBLY_CHUNKSIZE);
+    for(size_t packetSize = 1; packetSize <= REASSEMBLY_HEADERSIZE; packetSize++) {
+        reassemblyChannel.receiveSequenceNumber = 0;
+        UA_StatusCode retval = receiveInPackets(&stream, packetSize);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(reassemblyConnection.incompleteMessage.length, 0);
+    }
+    ck_assert_uint_eq(messagesReceived, REASSEMBLY_HEADERSIZE);
+    UA_ByteString_deleteMembers(&stream);
+} END_TEST
+
+START_TEST(reassembleChunksRespectsMaxChunkCount) {
+    reassemblyConnection.localConf.maxChunkCount = 4;
+    UA_ByteString stream;
+    encodeChunkedMessage(&stream, 10 * REASSEMBLY_CHUNKSIZE);
+    UA_StatusCode retval = receiveInPackets(&stream, REASSEMBLY_PACKETSIZE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTCPMESSAGETOOLARGE);
+    ck_assert_uint_eq(messagesReceived, 0);
+    ck_assert(LIST_EMPTY(&reassemblyChannel.chunks));
+    UA_ByteString_deleteMembers(&stream);
+} END_TEST
+
+START_TEST(reassembleChunksRespectsMaxMessageSize) {
+    reassemblyConnection.localConf.maxMessageSize = 5 * REASSEMBLY_CHUNKSIZE;
+    UA_ByteString stream;
+    encodeChunkedMessage(&stream, 10 * REASSEMBLY_CHUNKSIZE);
+    UA_StatusCode retval = receiveInPackets(&stream, REASSEMBLY_PACKETSIZE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTCPMESSAGETOOLARGE);
+    ck_assert_uint_eq(messagesReceived, 0);
+    ck_assert(LIST_EMPTY(&reassemblyChannel.chunks));
+    UA_ByteString_deleteMembers(&stream);
+} END_TEST
+
+static void
+reassemblySpeed(size_t payloadLength) {
+    UA_ByteString stream;
+    size_t chunks = encodeChunkedMessage(&stream, payloadLength);
+
+    clock_t begin = clock();
+    UA_StatusCode retval = receiveInPackets(&stream, REASSEMBLY_PACKETSIZE);
+    clock_t end = clock();
+
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(messagesReceived, 1);
+    printf("Reassembled a message of %lu bytes from %lu chunks in %lu "
+           "packets in %f s\n", (unsigned long)payloadLength,
+           (unsigned long)chunks,
+           (unsigned long)((stream.length + REASSEMBLY_PACKETSIZE - 1) / REASSEMBLY_PACKETSIZE),
+           (double)(end - begin) / CLOCKS_PER_SEC);
+    UA_ByteString_deleteMembers(&stream);
+}
+
+START_TEST(reassembleChunksSpeed16MB) {
+    reassemblySpeed(16 * 1024 * 1024);
+} END_TEST
+
 int main(void) {
     Suite *s = suite_create("Chunked encoding");
     TCase *tc_message = tcase_create("encode chunking");
@@ -160,6 +334,14 @@ int main(void) {
     tcase_add_test(tc_message,encodeTwoStringsIntoTenChunksShallWork);
     suite_add_tcase(s, tc_message);
 
+    TCase *tc_reassembly = tcase_create("decode chunking");
+    tcase_add_checked_fixture(tc_reassembly, setup_reassembly, teardown_reassembly);
+    tcase_add_test(tc_reassembly, reassembleChunksFromSmallPackets);
+    tcase_add_test(tc_reassembly, reassembleChunksRespectsMaxChunkCount);
+    tcase_add_test(tc_reassembly, reassembleChunksRespectsMaxMessageSize);
+    tcase_add_test(tc_reassembly, reassembleChunksSpeed16MB);
+    suite_add_tcase(s, tc_reassembly);
+
     SRunner *sr = srunner_create(s);
     srunner_set_fork_status(sr, CK_NOFORK);
     srunner_run_all(sr, CK_NORMAL);
@@ -0,0 +1,221 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ua_types.h"
+#include "ua_timer.h"
+#include "check.h"
+#include "testing_clock.h"
+
+static size_t dispatched;
+
+static void
+dispatchCallback(void *application, UA_TimerCallback callback, void *data) {
+    dispatched++;
+    callback(application, data);
+}
+
+static void
+countCallback(void *application, void *data) {
+    (*(size_t*)data)++;
+}
+
+START_TEST(Timer_addRemove) {
+    UA_Timer t;
+    UA_Timer_init(&t);
+
+    size_t count = 0;
+    UA_UInt64 id1, id2;
+    UA_StatusCode retval =
+        UA_Timer_addRepeatedCallback(&t, countCallback, &count, 10, &id1);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Timer_addRepeatedCallback(&t, countCallback, &count, 20, &id2);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_ne(id1, id2);
+
+    /* The interval needs to be at least 5ms */
+    retval = UA_Timer_addRepeatedCallback(&t, countCallback, &count, 1, NULL);
+    ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+
+    /* Both callbacks execute within 20ms */
+    UA_fakeSleep(20);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 2);
+
+    /* Only the 10ms callback executes after another 10ms */
+    UA_fakeSleep(10);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 3);
+
+    /* Removing takes effect in the next processing */
+    UA_Timer_removeRepeatedCallback(&t, id1);
+    UA_fakeSleep(10);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 4);
+
+    UA_fakeSleep(10);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 4);
+
+    UA_Timer_deleteMembers(&t);
+}
+END_TEST
+
+START_TEST(Timer_changeInterval) {
+    UA_Timer t;
+    UA_Timer_init(&t);
+
+    size_t count = 0;
+    UA_UInt64 id;
+    UA_Timer_addRepeatedCallback(&t, countCallback, &count, 10, &id);
+    UA_Timer_changeRepeatedCallbackInterval(&t, id, 1000);
+
+    UA_fakeSleep(100);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 0);
+
+    UA_fakeSleep(1000);
+    UA_DateTime next =
+        UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 1);
+    ck_assert(next > UA_DateTime_nowMonotonic());
+
+    UA_Timer_deleteMembers(&t);
+}
+END_TEST
+
+/* Callbacks with the same interval are batched and a missed execution does not
+ * lead to a catch-up of all intermediate executions */
+START_TEST(Timer_batchAndSkip) {
+    UA_Timer t;
+    UA_Timer_init(&t);
+
+    size_t count = 0;
+    for(size_t i = 0; i < 100; i++)
+        UA_Timer_addRepeatedCallback(&t, countCallback, &count, 50, NULL);
+
+    UA_fakeSleep(50);
+    UA_DateTime next =
+        UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 100);
+    ck_assert(next > UA_DateTime_nowMonotonic());
+
+    UA_fakeSleep(500);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(count, 200);
+
+    UA_Timer_deleteMembers(&t);
+}
+END_TEST
+
+static UA_Timer *selfTimer;
+
+static void
+removeSelfCallback(void *application, void *data) {
+    UA_Timer_removeRepeatedCallback(selfTimer, *(UA_UInt64*)data);
+}
+
+START_TEST(Timer_removeFromCallback) {
+    UA_Timer t;
+    UA_Timer_init(&t);
+    selfTimer = &t;
+
+    size_t count = 0;
+    UA_UInt64 id;
+    UA_Timer_addRepeatedCallback(&t, removeSelfCallback, &id, 10, &id);
+    UA_Timer_addRepeatedCallback(&t, countCallback, &count, 10, NULL);
+
+    UA_fakeSleep(10);
+    dispatched = 0;
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(dispatched, 2);
+
+    UA_fakeSleep(10);
+    dispatched = 0;
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    ck_assert_uint_eq(dispatched, 1);
+    ck_assert_uint_eq(count, 2);
+
+    UA_Timer_deleteMembers(&t);
+}
+END_TEST
+
+/* Measure the cost of processing the timer for many callbacks with different
+ * intervals. In every iteration, all callbacks with a deadline are dispatched
+ * and re-armed. */
+static void
+timerSpeed(size_t callbacks) {
+    UA_Timer t;
+    UA_Timer_init(&t);
+
+    size_t count = 0;
+    UA_UInt64 *ids = (UA_UInt64*)UA_malloc(sizeof(UA_UInt64) * callbacks);
+    ck_assert_ptr_ne(ids, NULL);
+
+    clock_t begin = clock();
+    for(size_t i = 0; i < callbacks; i++)
+        UA_Timer_addRepeatedCallback(&t, countCallback, &count,
+                                     (UA_UInt32)(5 + (i % 50) * 5), &ids[i]);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    clock_t added = clock();
+
+    for(size_t i = 0; i < 1000; i++) {
+        UA_fakeSleep(5);
+        UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    }
+    clock_t processed = clock();
+
+    for(size_t i = 0; i < callbacks; i++)
+        UA_Timer_removeRepeatedCallback(&t, ids[i]);
+    UA_Timer_process(&t, UA_DateTime_nowMonotonic(), dispatchCallback, NULL);
+    clock_t removed = clock();
+
+    ck_assert_uint_gt(count, callbacks);
+    printf("%lu callbacks: add %f s, process 1000 iterations (%lu "
+           "dispatches) %f s, remove %f s\n", (unsigned long)callbacks,
+           (double)(added - begin) / CLOCKS_PER_SEC, (unsigned long)count,
+           (double)(processed - added) / CLOCKS_PER_SEC,
+           (double)(removed - processed) / CLOCKS_PER_SEC);
+
+    UA_free(ids);
+    UA_Timer_deleteMembers(&t);
+}
+
+START_TEST(Timer_speed10k) {
+    timerSpeed(10000);
+}
+END_TEST
+
+START_TEST(Timer_speed100k) {
+    timerSpeed(100000);
+}
+END_TEST
+
+static Suite* testSuite_Timer(void) {
+    Suite *s = suite_create("Timer");
+    TCase *tc_timer = tcase_create("Timer");
+    tcase_add_test(tc_timer, Timer_addRemove);
+    tcase_add_test(tc_timer, Timer_changeInterval);
+    tcase_add_test(tc_timer, Timer_batchAndSkip);
+    tcase_add_test(tc_timer, Timer_removeFromCallback);
+    suite_add_tcase(s, tc_timer);
+    TCase *tc_speed = tcase_create("Timer Speed");
+    tcase_add_test(tc_speed, Timer_speed10k);
+    tcase_add_test(tc_speed, Timer_speed100k);
+    suite_add_tcase(s, tc_speed);
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_Timer();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
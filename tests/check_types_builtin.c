@@ -1451,6 +1451,94 @@ START_TEST(UA_ExtensionObject_encodeDecodeShallWorkOnExtensionObject) {
 }
 END_TEST
 
+START_TEST(UA_findDataType_shallFindAllTypes) {
+    for(size_t i = 0; i < UA_TYPES_COUNT; ++i) {
+        const UA_DataType *type = &UA_TYPES[i];
+        if(type->typeId.identifier.numeric == 0)
+            continue;
+        ck_assert_ptr_eq(UA_findDataType(&type->typeId), type);
+        if(type->binaryEncodingId == 0)
+            continue;
+        UA_NodeId encodingId = UA_NODEID_NUMERIC(type->typeId.namespaceIndex,
+                                                 type->binaryEncodingId);
+        ck_assert_ptr_eq(UA_findDataTypeByBinary(&encodingId), type);
+    }
+}
+END_TEST
+
+START_TEST(UA_findDataType_shallNotFindUnknownTypes) {
+    UA_NodeId unknown = UA_NODEID_NUMERIC(0, UA_TYPES_TYPEID_HASHSIZE +
+                                          UA_TYPES[UA_TYPES_INT32].typeId.identifier.numeric);
+    ck_assert_ptr_eq(UA_findDataType(&unknown), NULL);
+    UA_NodeId otherNamespace = UA_NODEID_NUMERIC(1, UA_TYPES[UA_TYPES_INT32].typeId.identifier.numeric);
+    ck_assert_ptr_eq(UA_findDataType(&otherNamespace), NULL);
+    UA_NodeId stringId = UA_NODEID_STRING(0, "Int32");
+    ck_assert_ptr_eq(UA_findDataType(&stringId), NULL);
+    UA_NodeId typeIdNotEncodingId = UA_NODEID_NUMERIC(0, UA_TYPES[UA_TYPES_READREQUEST].typeId.identifier.numeric);
+    ck_assert_ptr_eq(UA_findDataTypeByBinary(&typeIdNotEncodingId), NULL);
+}
+END_TEST
+
+START_TEST(UA_equal_shallCompareDataValues) {
+    UA_Int32 arr[3] = {1, 2, 3};
+    UA_DataValue dv1;
+    UA_DataValue_init(&dv1);
+    UA_Variant_setArray(&dv1.value, arr, 3, &UA_TYPES[UA_TYPES_INT32]);
+    dv1.hasValue = true;
+    dv1.hasSourceTimestamp = true;
+    dv1.sourceTimestamp = 1234;
+
+    UA_DataValue dv2;
+    UA_StatusCode retval = UA_DataValue_copy(&dv1, &dv2);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_equal(&dv1, &dv2, &UA_TYPES[UA_TYPES_DATAVALUE]));
+
+    /* Unset fields are ignored */
+    dv2.serverTimestamp = 5678;
+    ck_assert(UA_equal(&dv1, &dv2, &UA_TYPES[UA_TYPES_DATAVALUE]));
+    dv2.hasServerTimestamp = true;
+    ck_assert(!UA_equal(&dv1, &dv2, &UA_TYPES[UA_TYPES_DATAVALUE]));
+    dv2.hasServerTimestamp = false;
+
+    ((UA_Int32*)dv2.value.data)[2] = 4;
+    ck_assert(!UA_equal(&dv1, &dv2, &UA_TYPES[UA_TYPES_DATAVALUE]));
+    ((UA_Int32*)dv2.value.data)[2] = 3;
+
+    /* A scalar is not an array of length one */
+    UA_Variant_deleteMembers(&dv2.value);
+    UA_Variant_setScalarCopy(&dv2.value, &arr[0], &UA_TYPES[UA_TYPES_INT32]);
+    dv1.value.arrayLength = 1;
+    ck_assert(!UA_equal(&dv1, &dv2, &UA_TYPES[UA_TYPES_DATAVALUE]));
+    UA_DataValue_deleteMembers(&dv2);
+}
+END_TEST
+
+START_TEST(UA_equal_shallCompareStructures) {
+    UA_ApplicationDescription ad1;
+    UA_ApplicationDescription_init(&ad1);
+    ad1.applicationUri = UA_STRING("urn:application");
+    ad1.applicationName = UA_LOCALIZEDTEXT("en-US", "application");
+    UA_String urls[2] = {UA_STRING("opc.tcp://a"), UA_STRING("opc.tcp://b")};
+    ad1.discoveryUrlsSize = 2;
+    ad1.discoveryUrls = urls;
+
+    UA_ApplicationDescription ad2;
+    UA_StatusCode retval = UA_ApplicationDescription_copy(&ad1, &ad2);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_equal(&ad1, &ad2, &UA_TYPES[UA_TYPES_APPLICATIONDESCRIPTION]));
+
+    ad1.discoveryUrlsSize = 1;
+    ck_assert(!UA_equal(&ad1, &ad2, &UA_TYPES[UA_TYPES_APPLICATIONDESCRIPTION]));
+    ad1.discoveryUrlsSize = 2;
+    urls[1] = UA_STRING("opc.tcp://c");
+    ck_assert(!UA_equal(&ad1, &ad2, &UA_TYPES[UA_TYPES_APPLICATIONDESCRIPTION]));
+    urls[1] = UA_STRING("opc.tcp://b");
+    ad1.applicationType = UA_APPLICATIONTYPE_CLIENT;
+    ck_assert(!UA_equal(&ad1, &ad2, &UA_TYPES[UA_TYPES_APPLICATIONDESCRIPTION]));
+    UA_ApplicationDescription_deleteMembers(&ad2);
+}
+END_TEST
+
 static Suite *testSuite_builtin(void) {
     Suite *s = suite_create("Built-in Data Types 62541-6 Table 1");
 
@@ -1523,6 +1611,16 @@ static Suite *testSuite_builtin(void) {
     tcase_add_test(tc_copy, UA_LocalizedText_copycstringShallWorkOnInputExample);
     tcase_add_test(tc_copy, UA_DataValue_copyShallWorkOnInputExample);
     suite_add_tcase(s, tc_copy);
+
+    TCase *tc_lookup = tcase_create("lookup");
+    tcase_add_test(tc_lookup, UA_findDataType_shallFindAllTypes);
+    tcase_add_test(tc_lookup, UA_findDataType_shallNotFindUnknownTypes);
+    suite_add_tcase(s, tc_lookup);
+
+    TCase *tc_equal = tcase_create("equal");
+    tcase_add_test(tc_equal, UA_equal_shallCompareDataValues);
+    tcase_add_test(tc_equal, UA_equal_shallCompareStructures);
+    suite_add_tcase(s, tc_equal);
     return s;
 }
 
@@ -193,12 +193,96 @@ START_TEST(parseCustomArray) {
     UA_ByteString_deleteMembers(&buf);
 } END_TEST
 
+/* Many types with the same layout, only the encoding ids differ */
+#define MANY_TYPES 1000
+
+START_TEST(parseCustomExtensionObjectIndexed) {
+    UA_DataType *types = (UA_DataType*)UA_malloc(MANY_TYPES * sizeof(UA_DataType));
+    ck_assert_ptr_ne(types, NULL);
+    for(size_t i = 0; i < MANY_TYPES; ++i) {
+        types[i] = PointType;
+        types[i].typeId.namespaceIndex = (UA_UInt16)(1 + i % 3);
+        types[i].typeId.identifier.numeric = (UA_UInt32)(10000 + i);
+        types[i].typeIndex = (UA_UInt16)i;
+        types[i].binaryEncodingId = (UA_UInt16)(20000 + i);
+    }
+
+    UA_CustomTypesIndex index;
+    UA_StatusCode retval = UA_CustomTypesIndex_init(&index, MANY_TYPES, types);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    Point p;
+    p.x = 1.0;
+    p.y = 2.0;
+    p.z = 3.0;
+    UA_ByteString buf;
+    retval = UA_ByteString_allocBuffer(&buf, 64);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    for(size_t i = 0; i < MANY_TYPES; i += 7) {
+        UA_ExtensionObject eo;
+        UA_ExtensionObject_init(&eo);
+        eo.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+        eo.content.decoded.data = &p;
+        eo.content.decoded.type = &types[i];
+        UA_Byte *bufPos = buf.data;
+        const UA_Byte *bufEnd = &buf.data[buf.length];
+        retval = UA_encodeBinary(&eo, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT],
+                                 &bufPos, &bufEnd, NULL, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        UA_ByteString encoded = {(uintptr_t)(bufPos - buf.data), buf.data};
+
+        /* The index and the scan find the same type */
+        UA_ExtensionObject eo2;
+        size_t offset = 0;
+        retval = UA_decodeBinaryIndexed(&encoded, &offset, &eo2,
+                                        &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], &index);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(eo2.encoding, UA_EXTENSIONOBJECT_DECODED);
+        ck_assert(eo2.content.decoded.type == &types[i]);
+        UA_ExtensionObject_deleteMembers(&eo2);
+
+        offset = 0;
+        retval = UA_decodeBinary(&encoded, &offset, &eo2,
+                                 &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], MANY_TYPES, types);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(eo2.content.decoded.type == &types[i]);
+        UA_ExtensionObject_deleteMembers(&eo2);
+    }
+
+    /* An unknown encoding id in a known namespace remains encoded */
+    UA_ExtensionObject eo;
+    UA_ExtensionObject_init(&eo);
+    eo.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    eo.content.decoded.data = &p;
+    eo.content.decoded.type = &types[0];
+    types[0].binaryEncodingId = 30000;
+    UA_Byte *bufPos = buf.data;
+    const UA_Byte *bufEnd = &buf.data[buf.length];
+    retval = UA_encodeBinary(&eo, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT],
+                             &bufPos, &bufEnd, NULL, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_ByteString encoded = {(uintptr_t)(bufPos - buf.data), buf.data};
+    UA_ExtensionObject eo2;
+    size_t offset = 0;
+    retval = UA_decodeBinaryIndexed(&encoded, &offset, &eo2,
+                                    &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], &index);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(eo2.encoding, UA_EXTENSIONOBJECT_ENCODED_BYTESTRING);
+    UA_ExtensionObject_deleteMembers(&eo2);
+
+    UA_CustomTypesIndex_deleteMembers(&index);
+    UA_ByteString_deleteMembers(&buf);
+    UA_free(types);
+} END_TEST
+
 int main(void) {
     Suite *s  = suite_create("Test Custom DataType Encoding");
     TCase *tc = tcase_create("test cases");
     tcase_add_test(tc, parseCustomScalar);
     tcase_add_test(tc, parseCustomScalarExtensionObject);
     tcase_add_test(tc, parseCustomArray);
+    tcase_add_test(tc, parseCustomExtensionObjectIndexed);
     suite_add_tcase(s, tc);
 
     SRunner *sr = srunner_create(s);
@@ -5,6 +5,7 @@
 #define _XOPEN_SOURCE 500
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "ua_types.h"
 #include "ua_server.h"
@@ -277,6 +278,65 @@ START_TEST(decodeComplexTypeFromRandomBufferShallSurvive) {
 }
 END_TEST
 
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+/* Compare the specialized binary encoding against the generic encoding. A copy
+ * of the type description is not part of UA_TYPES and always uses the generic
+ * encoding. The random buffers contain mostly zeroes. So that the decoding
+ * succeeds for structures with arrays and optional fields. */
+START_TEST(specializedEncodingShallMatchGeneric) {
+    UA_DataType generic = UA_TYPES[_i];
+    UA_ByteString msg1, msg2, msg3;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&msg1, 256);
+    retval |= UA_ByteString_allocBuffer(&msg2, 512);
+    retval |= UA_ByteString_allocBuffer(&msg3, 512);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+#ifdef _WIN32
+    srand(42);
+#else
+    srandom(42);
+#endif
+    for(int n = 0; n < RANDOM_TESTS; n++) {
+        for(size_t i = 0; i < msg1.length; i++) {
+#ifdef _WIN32
+            UA_UInt32 rnd = (UA_UInt32)rand();
+#else
+            UA_UInt32 rnd = (UA_UInt32)random();
+#endif
+            msg1.data[i] = ((rnd >> 8) % 4 == 0) ? (UA_Byte)rnd : 0;
+        }
+
+        size_t pos1 = 0, pos2 = 0;
+        void *obj1 = UA_new(&UA_TYPES[_i]);
+        void *obj2 = UA_new(&UA_TYPES[_i]);
+        UA_StatusCode ret1 = UA_decodeBinary(&msg1, &pos1, obj1, &UA_TYPES[_i], 0, NULL);
+        UA_StatusCode ret2 = UA_decodeBinary(&msg1, &pos2, obj2, &generic, 0, NULL);
+        ck_assert_int_eq(ret1 == UA_STATUSCODE_GOOD, ret2 == UA_STATUSCODE_GOOD);
+        if(ret1 == UA_STATUSCODE_GOOD) {
+            ck_assert_uint_eq(pos1, pos2);
+            ck_assert_uint_eq(UA_calcSizeBinary(obj1, &UA_TYPES[_i]),
+                              UA_calcSizeBinary(obj2, &generic));
+            UA_Byte *bufPos2 = msg2.data, *bufPos3 = msg3.data;
+            const UA_Byte *bufEnd2 = &msg2.data[msg2.length];
+            const UA_Byte *bufEnd3 = &msg3.data[msg3.length];
+            ret1 = UA_encodeBinary(obj1, &UA_TYPES[_i], &bufPos2, &bufEnd2, NULL, NULL);
+            ret2 = UA_encodeBinary(obj1, &generic, &bufPos3, &bufEnd3, NULL, NULL);
+            ck_assert_int_eq(ret1, ret2);
+            if(ret1 == UA_STATUSCODE_GOOD) {
+                ck_assert_uint_eq((uintptr_t)(bufPos2 - msg2.data),
+                                  (uintptr_t)(bufPos3 - msg3.data));
+                ck_assert(memcmp(msg2.data, msg3.data, (size_t)(bufPos2 - msg2.data)) == 0);
+            }
+        }
+        UA_delete(obj1, &UA_TYPES[_i]);
+        UA_delete(obj2, &UA_TYPES[_i]);
+    }
+    UA_ByteString_deleteMembers(&msg1);
+    UA_ByteString_deleteMembers(&msg2);
+    UA_ByteString_deleteMembers(&msg3);
+}
+END_TEST
+#endif
+
 START_TEST(calcSizeBinaryShallBeCorrect) {
     /* Empty variants (with no type defined) cannot be encoded. This is
      * intentional. Discovery configuration is just a base class and void * */
@@ -342,6 +402,10 @@ int main(void) {
                         UA_TYPES_BOOLEAN, UA_TYPES_DOUBLE);
     tcase_add_loop_test(tc, decodeComplexTypeFromRandomBufferShallSurvive,
                         UA_TYPES_NODEID, UA_TYPES_COUNT - 1);
+#ifdef UA_ENABLE_SPECIALIZED_ENCODING
+    tcase_add_loop_test(tc, specializedEncodingShallMatchGeneric,
+                        UA_TYPES_NODEID, UA_TYPES_COUNT - 1);
+#endif
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Test calcSizeBinary");
@@ -3,10 +3,12 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "ua_types.h"
 #include "ua_client.h"
 #include "ua_util.h"
+#include "ua_plugin_network.h"
 #include "check.h"
 
 START_TEST(EndpointUrl_split) {
@@ -155,6 +157,66 @@ START_TEST(StatusCode_msg) {
 }
 END_TEST
 
+START_TEST(BufferPool_reuse) {
+    UA_BufferPool *pool = UA_BufferPool_new(1024, 2);
+    ck_assert_ptr_ne(pool, NULL);
+
+    /* A released buffer is handed out again */
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_BufferPool_get(pool, 100, &buf);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(buf.length, 100);
+    UA_Byte *data = buf.data;
+    buf.length = 10; /* The length may be reduced */
+    UA_BufferPool_release(pool, &buf);
+    ck_assert_ptr_eq(buf.data, NULL);
+    retval = UA_BufferPool_get(pool, 1024, &buf);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(buf.data, data);
+    memset(buf.data, 0, buf.length); /* The full size is usable */
+
+    UA_BufferPoolStatistics stats;
+    UA_BufferPool_getStatistics(pool, &stats);
+    ck_assert_uint_eq(stats.allocated, 1);
+    ck_assert_uint_eq(stats.reused, 1);
+    ck_assert_uint_eq(stats.pooled, 0);
+
+    UA_BufferPool_release(pool, &buf);
+    UA_BufferPool_delete(pool);
+}
+END_TEST
+
+START_TEST(BufferPool_limits) {
+    UA_BufferPool *pool = UA_BufferPool_new(1024, 2);
+    ck_assert_ptr_ne(pool, NULL);
+
+    /* Larger buffers are not recycled */
+    UA_ByteString large;
+    UA_StatusCode retval = UA_BufferPool_get(pool, 4096, &large);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    memset(large.data, 0, large.length);
+    UA_BufferPool_release(pool, &large);
+
+    /* Only two unused buffers are kept */
+    UA_ByteString bufs[3];
+    for(size_t i = 0; i < 3; i++) {
+        retval = UA_BufferPool_get(pool, 512, &bufs[i]);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    for(size_t i = 0; i < 3; i++)
+        UA_BufferPool_release(pool, &bufs[i]);
+
+    UA_BufferPoolStatistics stats;
+    UA_BufferPool_getStatistics(pool, &stats);
+    ck_assert_uint_eq(stats.allocated, 4);
+    ck_assert_uint_eq(stats.reused, 0);
+    ck_assert_uint_eq(stats.freed, 2);
+    ck_assert_uint_eq(stats.pooled, 2);
+
+    UA_BufferPool_delete(pool);
+}
+END_TEST
+
 static Suite* testSuite_Utils(void) {
     Suite *s = suite_create("Utils");
     TCase *tc_endpointUrl_split = tcase_create("EndpointUrl_split");
@@ -164,6 +226,10 @@ static Suite* testSuite_Utils(void) {
     tcase_add_test(tc_utils, readNumber);
     tcase_add_test(tc_utils, StatusCode_msg);
     suite_add_tcase(s,tc_utils);
+    TCase *tc_bufferPool = tcase_create("BufferPool");
+    tcase_add_test(tc_bufferPool, BufferPool_reuse);
+    tcase_add_test(tc_bufferPool, BufferPool_limits);
+    suite_add_tcase(s,tc_bufferPool);
     return s;
 }
 
@@ -203,6 +203,76 @@ START_TEST(Client_read_async_timed)
         UA_Client_delete(client);
     }END_TEST
 
+/* Measure the responses per second with many pending requests. The pipeline
+ * is refilled as the responses arrive. The requests have no timeout. So every
+ * response is matched against a full table of pending calls. */
+#define PIPELINE_DEPTH 5000
+#define PIPELINE_REQUESTS 50000
+
+static void
+pipelineReadCallback(UA_Client *client, void *userdata,
+                     UA_UInt32 requestId, const UA_ReadResponse *response) {
+    size_t *received = (size_t*)userdata;
+    if(response->responseHeader.serviceResult == UA_STATUSCODE_GOOD)
+        (*received)++;
+}
+
+START_TEST(Client_read_async_pipeline)
+    {
+        UA_ClientConfig clientConfig = UA_ClientConfig_default;
+        clientConfig.outStandingPublishRequests = 0;
+
+        UA_Client *client = UA_Client_new(clientConfig);
+        UA_StatusCode retval = UA_Client_connect(client,
+                "opc.tcp://localhost:4840");
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+        UA_ReadRequest rr;
+        UA_ReadRequest_init(&rr);
+        UA_ReadValueId rvid;
+        UA_ReadValueId_init(&rvid);
+        rvid.attributeId = UA_ATTRIBUTEID_VALUE;
+        rvid.nodeId = UA_NODEID_NUMERIC(0,
+                UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
+        rr.nodesToRead = &rvid;
+        rr.nodesToReadSize = 1;
+
+        size_t sent = 0;
+        size_t received = 0;
+        size_t idle = 0;
+        UA_DateTime begin = UA_realNowMonotonic();
+        while(received < PIPELINE_REQUESTS && idle < 5000) {
+            /* Refill the pipeline */
+            while(sent < PIPELINE_REQUESTS && sent - received < PIPELINE_DEPTH) {
+                retval = __UA_Client_AsyncServiceEx(client, &rr,
+                        &UA_TYPES[UA_TYPES_READREQUEST],
+                        (UA_ClientAsyncServiceCallback) pipelineReadCallback,
+                        &UA_TYPES[UA_TYPES_READRESPONSE], &received, NULL, 0);
+                ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+                sent++;
+            }
+
+            /* Process the available responses */
+            size_t before = received;
+            retval = UA_Client_run_iterate(client, 0);
+            ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+            if(received == before) {
+                idle++;
+                UA_realSleep(1);
+            }
+        }
+        /* Wall time. The testing clock in UA_DateTime_nowMonotonic does not
+         * advance by itself. */
+        double elapsed = (double)(UA_realNowMonotonic() - begin) / UA_DATETIME_SEC;
+        ck_assert_uint_eq(received, PIPELINE_REQUESTS);
+        printf("%u async reads with %u pending: %.3fs, %.0f responses/s\n",
+               PIPELINE_REQUESTS, PIPELINE_DEPTH, elapsed,
+               elapsed > 0 ? (double)PIPELINE_REQUESTS / elapsed : 0.0);
+
+        UA_Client_disconnect(client);
+        UA_Client_delete(client);
+    }END_TEST
+
 static UA_Boolean inactivityCallbackTriggered = false;
 
 static void inactivityCallback(UA_Client *client) {
@@ -249,6 +319,7 @@ static Suite* testSuite_Client(void) {
     tcase_add_checked_fixture(tc_client, setup, teardown);
     tcase_add_test(tc_client, Client_read_async);
     tcase_add_test(tc_client, Client_read_async_timed);
+    tcase_add_test(tc_client, Client_read_async_pipeline);
     tcase_add_test(tc_client, Client_connectivity_check);
     tcase_add_test(tc_client, Client_highlevel_async_readValue);
 
@@ -0,0 +1,143 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Throughput of the symmetric cryptography of the SecurityPolicies. Every
+ * chunk is signed and encrypted, then decrypted and verified. As for a
+ * SecureChannel in the SignAndEncrypt mode.
+ *
+ * Usage: bench_encryption [chunks] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ua_types.h"
+#include "ua_plugin_securitypolicy.h"
+#include "ua_securitypolicy_basic128rsa15.h"
+#include "ua_securitypolicy_basic256sha256.h"
+#include "ua_pki_certificate.h"
+#include "ua_log_stdout.h"
+#include "certificates.h"
+
+#define CHUNK_SIZE 8192
+
+typedef UA_StatusCode
+(*createPolicy)(UA_SecurityPolicy *policy, UA_CertificateVerification *cv,
+                const UA_ByteString localCertificate,
+                const UA_ByteString localPrivateKey, UA_Logger logger);
+
+/* Use the same keys in both directions. So the chunks can be decrypted and
+ * verified with the same channel context. */
+static UA_StatusCode
+setKeys(const UA_SecurityPolicy *policy, void *cc) {
+    const UA_SecurityPolicyCryptoModule *cm = &policy->symmetricModule.cryptoModule;
+    const UA_SecurityPolicyChannelModule *chm = &policy->channelModule;
+    size_t signingKeyLength = cm->signatureAlgorithm.getLocalKeyLength(policy, cc);
+    size_t encryptionKeyLength = cm->encryptionAlgorithm.getLocalKeyLength(policy, cc);
+    size_t blockSize = cm->encryptionAlgorithm.getLocalBlockSize(policy, cc);
+
+    UA_ByteString buf;
+    UA_StatusCode retval =
+        UA_ByteString_allocBuffer(&buf, signingKeyLength + encryptionKeyLength + blockSize);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = policy->symmetricModule.generateNonce(policy, &buf);
+
+    const UA_ByteString signingKey = {signingKeyLength, buf.data};
+    const UA_ByteString encryptingKey = {encryptionKeyLength, buf.data + signingKeyLength};
+    const UA_ByteString iv = {blockSize, buf.data + signingKeyLength + encryptionKeyLength};
+    retval |= chm->setLocalSymSigningKey(cc, &signingKey);
+    retval |= chm->setLocalSymEncryptingKey(cc, &encryptingKey);
+    retval |= chm->setLocalSymIv(cc, &iv);
+    retval |= chm->setRemoteSymSigningKey(cc, &signingKey);
+    retval |= chm->setRemoteSymEncryptingKey(cc, &encryptingKey);
+    retval |= chm->setRemoteSymIv(cc, &iv);
+    UA_ByteString_deleteMembers(&buf);
+    return retval;
+}
+
+static UA_StatusCode
+processChunks(const UA_SecurityPolicy *policy, void *cc, size_t chunks) {
+    const UA_SecurityPolicyCryptoModule *cm = &policy->symmetricModule.cryptoModule;
+    size_t sigSize = cm->signatureAlgorithm.getLocalSignatureSize(policy, cc);
+
+    UA_ByteString chunk, signature;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&chunk, CHUNK_SIZE);
+    retval |= UA_ByteString_allocBuffer(&signature, sigSize);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&chunk);
+        UA_ByteString_deleteMembers(&signature);
+        return retval;
+    }
+
+    for(size_t i = 0; i < chunks && retval == UA_STATUSCODE_GOOD; i++) {
+        memset(chunk.data, (int)(i & 0xff), chunk.length);
+        retval = cm->signatureAlgorithm.sign(policy, cc, &chunk, &signature);
+        retval |= cm->encryptionAlgorithm.encrypt(policy, cc, &chunk);
+        retval |= cm->encryptionAlgorithm.decrypt(policy, cc, &chunk);
+        retval |= cm->signatureAlgorithm.verify(policy, cc, &chunk, &signature);
+        if(chunk.data[0] != (UA_Byte)(i & 0xff) ||
+           chunk.data[CHUNK_SIZE - 1] != (UA_Byte)(i & 0xff))
+            retval = UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+    }
+
+    UA_ByteString_deleteMembers(&chunk);
+    UA_ByteString_deleteMembers(&signature);
+    return retval;
+}
+
+static int
+benchPolicy(const char *name, createPolicy create, size_t chunks) {
+    UA_ByteString certificate = {CERT_DER_LENGTH, CERT_DER_DATA};
+    UA_ByteString privateKey = {KEY_DER_LENGTH, KEY_DER_DATA};
+
+    UA_CertificateVerification cv;
+    UA_CertificateVerification_AcceptAll(&cv);
+    UA_SecurityPolicy policy;
+    UA_StatusCode retval = create(&policy, &cv, certificate, privateKey, UA_Log_Stdout);
+    if(retval != UA_STATUSCODE_GOOD) {
+        printf("%s: could not create the policy\n", name);
+        cv.deleteMembers(&cv);
+        return EXIT_FAILURE;
+    }
+
+    void *cc = NULL;
+    retval = policy.channelModule.newContext(&policy, &certificate, &cc);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = setKeys(&policy, cc);
+
+    clock_t start = clock();
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = processChunks(&policy, cc, chunks);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    if(retval == UA_STATUSCODE_GOOD) {
+        double mb = (double)(chunks * CHUNK_SIZE) / (1024.0 * 1024.0);
+        printf("%s: %lu chunks of %d bytes in %.3fs (%.1f MB/s, %.1f us per chunk)\n",
+               name, (unsigned long)chunks, CHUNK_SIZE, seconds,
+               seconds > 0 ? mb / seconds : 0.0,
+               seconds * 1e6 / (double)chunks);
+    } else {
+        printf("%s: failed with StatusCode %s\n", name, UA_StatusCode_name(retval));
+    }
+
+    if(cc)
+        policy.channelModule.deleteContext(cc);
+    policy.deleteMembers(&policy);
+    cv.deleteMembers(&cv);
+    return (retval == UA_STATUSCODE_GOOD) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    size_t chunks = 10000;
+    if(argc > 1)
+        chunks = (size_t)strtoul(argv[1], NULL, 10);
+    if(chunks == 0)
+        chunks = 1;
+
+    int result = benchPolicy("Basic128Rsa15", UA_SecurityPolicy_Basic128Rsa15, chunks);
+    result |= benchPolicy("Basic256Sha256", UA_SecurityPolicy_Basic256Sha256, chunks);
+    return result;
+}
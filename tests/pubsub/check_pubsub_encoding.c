@@ -1305,6 +1305,12 @@ START_TEST(UA_PubSub_EnDecode_ShallWorkOn2DSVariant) {
     ck_assert(m.payloadHeaderEnabled == m2.payloadHeaderEnabled);
     ck_assert_uint_eq(m2.payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0], dsWriter1);
     ck_assert_uint_eq(m2.payloadHeader.dataSetPayloadHeader.dataSetWriterIds[1], dsWriter2);
+    /* The sizes are written during the encoding */
+    ck_assert_uint_eq((uintptr_t)(bufPos - buffer.data), msgSize);
+    ck_assert_uint_eq(m2.payload.dataSetPayload.sizes[0],
+                      UA_DataSetMessage_calcSizeBinary(&m.payload.dataSetPayload.dataSetMessages[0]));
+    ck_assert_uint_eq(m2.payload.dataSetPayload.sizes[1],
+                      UA_DataSetMessage_calcSizeBinary(&m.payload.dataSetPayload.dataSetMessages[1]));
     ck_assert(m.payload.dataSetPayload.dataSetMessages[0].header.dataSetMessageValid == m2.payload.dataSetPayload.dataSetMessages[0].header.dataSetMessageValid);
     ck_assert(m.payload.dataSetPayload.dataSetMessages[0].header.fieldEncoding == m2.payload.dataSetPayload.dataSetMessages[0].header.fieldEncoding);
     ck_assert_int_eq(m2.payload.dataSetPayload.dataSetMessages[0].data.keyFrameData.fieldCount, fieldCountDS1);
@@ -413,6 +413,122 @@ START_TEST(PublishDataSetFieldAsDeltaFrame){
             UA_WriterGroup_publishCallback(server, wg);
         } END_TEST
 
+static void
+addPublishedField(UA_NodeId pds, UA_NodeId variable) {
+    UA_DataSetFieldConfig dataSetFieldConfig;
+    memset(&dataSetFieldConfig, 0, sizeof(UA_DataSetFieldConfig));
+    dataSetFieldConfig.dataSetFieldType = UA_PUBSUB_DATASETFIELD_VARIABLE;
+    dataSetFieldConfig.field.variable.fieldNameAlias = UA_STRING("field");
+    dataSetFieldConfig.field.variable.promotedField = UA_FALSE;
+    dataSetFieldConfig.field.variable.publishParameters.publishedVariable = variable;
+    dataSetFieldConfig.field.variable.publishParameters.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_Server_addDataSetField(server, pds, &dataSetFieldConfig, NULL);
+}
+
+START_TEST(FreezeWriterGroupLocksConfiguration){
+        setupDataSetFieldTestEnvironment();
+        addPublishedField(publishedDataSet1, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME));
+        ck_assert_int_eq(UA_Server_freezeWriterGroupConfiguration(server, writerGroup1), UA_STATUSCODE_GOOD);
+        UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup1);
+        ck_assert(wg->configurationFrozen);
+        ck_assert_uint_eq(wg->templatesSize, 2);
+
+        UA_DataSetFieldConfig fieldConfig;
+        memset(&fieldConfig, 0, sizeof(UA_DataSetFieldConfig));
+        fieldConfig.dataSetFieldType = UA_PUBSUB_DATASETFIELD_VARIABLE;
+        fieldConfig.field.variable.fieldNameAlias = UA_STRING("field 2");
+        ck_assert_int_eq(UA_Server_addDataSetField(server, publishedDataSet1, &fieldConfig, NULL).result,
+                         UA_STATUSCODE_BADCONFIGURATIONERROR);
+        ck_assert_int_eq(UA_Server_addDataSetField(server, publishedDataSet2, &fieldConfig, NULL).result,
+                         UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(UA_Server_removeDataSetWriter(server, dataSetWriter1),
+                         UA_STATUSCODE_BADCONFIGURATIONERROR);
+        ck_assert_int_eq(UA_Server_removePublishedDataSet(server, publishedDataSet1),
+                         UA_STATUSCODE_BADCONFIGURATIONERROR);
+        UA_DataSetWriterConfig dataSetWriterConfig;
+        memset(&dataSetWriterConfig, 0, sizeof(dataSetWriterConfig));
+        dataSetWriterConfig.name = UA_STRING("DataSetWriter 4");
+        ck_assert_int_eq(UA_Server_addDataSetWriter(server, writerGroup1, publishedDataSet2,
+                                                    &dataSetWriterConfig, NULL),
+                         UA_STATUSCODE_BADCONFIGURATIONERROR);
+        UA_WriterGroup_publishCallback(server, wg);
+
+        ck_assert_int_eq(UA_Server_unfreezeWriterGroupConfiguration(server, writerGroup1), UA_STATUSCODE_GOOD);
+        ck_assert(!wg->configurationFrozen);
+        ck_assert_uint_eq(wg->templatesSize, 0);
+        ck_assert_int_eq(UA_Server_addDataSetField(server, publishedDataSet1, &fieldConfig, NULL).result,
+                         UA_STATUSCODE_GOOD);
+
+        /* Removed with the frozen configuration */
+        ck_assert_int_eq(UA_Server_freezeWriterGroupConfiguration(server, writerGroup1), UA_STATUSCODE_GOOD);
+    } END_TEST
+
+static void
+decodeFrozenNetworkMessage(UA_WriterGroup *wg, UA_NetworkMessage *nm) {
+    ck_assert_uint_eq(wg->templatesSize, 1);
+    size_t offset = 0;
+    ck_assert_int_eq(UA_NetworkMessage_decodeBinary(&wg->templates[0].message, &offset, nm),
+                     UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(offset, wg->templates[0].message.length);
+    ck_assert_int_eq(nm->payloadHeader.dataSetPayloadHeader.count, 1);
+}
+
+START_TEST(PublishFrozenWriterGroupPatchesValues){
+        setupDataSetWriterTestEnvironment();
+        UA_NodeId variable = UA_NODEID_STRING(1, "frozen.value");
+        UA_VariableAttributes attr = UA_VariableAttributes_default;
+        UA_Int32 value = 42;
+        UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+        ck_assert_int_eq(UA_Server_addVariableNode(server, variable, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                   UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                   UA_QUALIFIEDNAME(1, "frozen value"),
+                                                   UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                                   attr, NULL, NULL), UA_STATUSCODE_GOOD);
+
+        UA_UadpDataSetWriterMessageDataType uadpConfig;
+        memset(&uadpConfig, 0, sizeof(UA_UadpDataSetWriterMessageDataType));
+        uadpConfig.dataSetMessageContentMask = (UA_UadpDataSetMessageContentMask)
+            (UA_UADPDATASETMESSAGECONTENTMASK_SEQUENCENUMBER | UA_UADPDATASETMESSAGECONTENTMASK_TIMESTAMP);
+        UA_DataSetWriterConfig dataSetWriterConfig;
+        memset(&dataSetWriterConfig, 0, sizeof(dataSetWriterConfig));
+        dataSetWriterConfig.name = UA_STRING("DataSetWriter 1");
+        dataSetWriterConfig.messageSettings.encoding = UA_EXTENSIONOBJECT_DECODED;
+        dataSetWriterConfig.messageSettings.content.decoded.type = &UA_TYPES[UA_TYPES_UADPDATASETWRITERMESSAGEDATATYPE];
+        dataSetWriterConfig.messageSettings.content.decoded.data = &uadpConfig;
+        UA_Server_addDataSetWriter(server, writerGroup1, publishedDataSet1, &dataSetWriterConfig, &dataSetWriter1);
+        addPublishedField(publishedDataSet1, variable);
+
+        ck_assert_int_eq(UA_Server_freezeWriterGroupConfiguration(server, writerGroup1), UA_STATUSCODE_GOOD);
+        UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup1);
+        UA_NetworkMessage nm;
+        decodeFrozenNetworkMessage(wg, &nm);
+        UA_DataSetMessage *dsm = &nm.payload.dataSetPayload.dataSetMessages[0];
+        ck_assert(dsm->header.dataSetMessageSequenceNrEnabled);
+        ck_assert(dsm->header.timestampEnabled);
+        ck_assert_int_eq(dsm->data.keyFrameData.fieldCount, 1);
+        ck_assert_int_eq(*(UA_Int32*)dsm->data.keyFrameData.dataSetFields[0].value.data, 42);
+        UA_UInt16 sequenceNumber = dsm->header.dataSetMessageSequenceNr;
+        UA_NetworkMessage_deleteMembers(&nm);
+
+        /* Only the content at the offsets changes */
+        UA_ByteString frozen;
+        UA_ByteString_copy(&wg->templates[0].message, &frozen);
+        UA_WriterGroup_publishCallback(server, wg);
+        value = 4711;
+        UA_Variant v;
+        UA_Variant_setScalar(&v, &value, &UA_TYPES[UA_TYPES_INT32]);
+        ck_assert_int_eq(UA_Server_writeValue(server, variable, v), UA_STATUSCODE_GOOD);
+        UA_WriterGroup_publishCallback(server, wg);
+        ck_assert_uint_eq(wg->templates[0].message.length, frozen.length);
+        UA_ByteString_deleteMembers(&frozen);
+
+        decodeFrozenNetworkMessage(wg, &nm);
+        dsm = &nm.payload.dataSetPayload.dataSetMessages[0];
+        ck_assert_int_eq(dsm->header.dataSetMessageSequenceNr, (UA_UInt16)(sequenceNumber + 1));
+        ck_assert_int_eq(*(UA_Int32*)dsm->data.keyFrameData.dataSetFields[0].value.data, 4711);
+        UA_NetworkMessage_deleteMembers(&nm);
+    } END_TEST
+
 int main(void) {
     TCase *tc_add_pubsub_writergroup = tcase_create("PubSub WriterGroup items handling");
     tcase_add_checked_fixture(tc_add_pubsub_writergroup, setup, teardown);
@@ -442,6 +558,8 @@ int main(void) {
     tcase_add_checked_fixture(tc_pubsub_publish, setup, teardown);
     tcase_add_test(tc_pubsub_publish, SinglePublishDataSetField);
     tcase_add_test(tc_pubsub_publish, PublishDataSetFieldAsDeltaFrame);
+    tcase_add_test(tc_pubsub_publish, FreezeWriterGroupLocksConfiguration);
+    tcase_add_test(tc_pubsub_publish, PublishFrozenWriterGroupPatchesValues);
 
     Suite *s = suite_create("PubSub WriterGroups/Writer/Fields handling and publishing");
     suite_add_tcase(s, tc_add_pubsub_writergroup);
@@ -0,0 +1,248 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _XOPEN_SOURCE
+# define _XOPEN_SOURCE 700
+#endif
+#ifndef _DEFAULT_SOURCE
+# define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "ua_server.h"
+#include "ua_history_mmap.h"
+#include "check.h"
+
+/* Small segments to test the rollover */
+#define SEGMENT_SIZE 4096
+
+static char directory[] = "/tmp/check_history_mmap_XXXXXX";
+static UA_HistoryDatabase hdb;
+static UA_NodeId nodeId;
+
+static size_t
+countSegments(void) {
+    DIR *dir = opendir(directory);
+    ck_assert_ptr_ne(dir, NULL);
+    size_t count = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir))) {
+        if(strstr(entry->d_name, ".uahs"))
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+static void setup(void) {
+    ck_assert_ptr_ne(mkdtemp(directory), NULL);
+    hdb = UA_HistoryDatabase_mmap(directory, SEGMENT_SIZE, 0);
+    ck_assert(hdb.readRaw != NULL);
+    nodeId = UA_NODEID_STRING(1, "temperature");
+}
+
+static void teardown(void) {
+    hdb.deleteMembers(&hdb);
+    DIR *dir = opendir(directory);
+    struct dirent *entry;
+    while((entry = readdir(dir))) {
+        if(entry->d_name[0] == '.')
+            continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        unlink(path);
+    }
+    closedir(dir);
+    rmdir(directory);
+    strcpy(&directory[strlen(directory) - 6], "XXXXXX");
+}
+
+/* Store the values first..last with the source timestamps first..last */
+static void
+storeValues(UA_Int32 first, UA_Int32 last) {
+    for(UA_Int32 i = first; i <= last; ++i) {
+        UA_DataValue dv;
+        UA_DataValue_init(&dv);
+        UA_Variant_setScalar(&dv.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        dv.hasValue = true;
+        dv.sourceTimestamp = i * UA_DATETIME_SEC;
+        dv.hasSourceTimestamp = true;
+        dv.serverTimestamp = i * UA_DATETIME_SEC + 1;
+        dv.hasServerTimestamp = true;
+        hdb.setValue(NULL, hdb.context, NULL, NULL, &nodeId, &dv);
+    }
+}
+
+static void
+readRaw(UA_ReadRawModifiedDetails *details, const UA_ByteString *cp,
+        UA_HistoryReadResult *result) {
+    UA_HistoryReadValueId id;
+    UA_HistoryReadValueId_init(&id);
+    id.nodeId = nodeId;
+    if(cp)
+        id.continuationPoint = *cp;
+    UA_HistoryReadResult_init(result);
+    hdb.readRaw(NULL, hdb.context, NULL, NULL, details, UA_TIMESTAMPSTORETURN_BOTH,
+                false, 0, &id, result);
+}
+
+static UA_HistoryData *
+getHistoryData(UA_HistoryReadResult *result) {
+    ck_assert_int_eq(result->historyData.encoding, UA_EXTENSIONOBJECT_DECODED);
+    ck_assert_ptr_eq(result->historyData.content.decoded.type,
+                     &UA_TYPES[UA_TYPES_HISTORYDATA]);
+    return (UA_HistoryData*)result->historyData.content.decoded.data;
+}
+
+static void
+checkValue(const UA_DataValue *dv, UA_Int32 expected) {
+    ck_assert(dv->hasValue);
+    ck_assert_ptr_eq(dv->value.type, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_int_eq(*(UA_Int32*)dv->value.data, expected);
+    ck_assert(dv->hasSourceTimestamp);
+    ck_assert_int_eq(dv->sourceTimestamp, expected * UA_DATETIME_SEC);
+    ck_assert(dv->hasServerTimestamp);
+    ck_assert_int_eq(dv->serverTimestamp, expected * UA_DATETIME_SEC + 1);
+}
+
+/* Read all values in [first, last] in pages of the given size */
+static void
+checkRange(UA_Int32 first, UA_Int32 last, UA_UInt32 pageSize) {
+    UA_Boolean reverse = (first > last);
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = first * UA_DATETIME_SEC;
+    details.endTime = (reverse ? last - 1 : last + 1) * UA_DATETIME_SEC;
+    details.numValuesPerNode = pageSize;
+
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    UA_Int32 next = first;
+    do {
+        UA_HistoryReadResult result;
+        readRaw(&details, &cp, &result);
+        UA_ByteString_deleteMembers(&cp);
+        ck_assert_int_eq(result.statusCode, UA_STATUSCODE_GOOD);
+        UA_HistoryData *data = getHistoryData(&result);
+        for(size_t i = 0; i < data->dataValuesSize; ++i) {
+            checkValue(&data->dataValues[i], next);
+            next += reverse ? -1 : 1;
+        }
+        cp = result.continuationPoint;
+        result.continuationPoint = UA_BYTESTRING_NULL;
+        UA_HistoryReadResult_deleteMembers(&result);
+    } while(cp.length > 0);
+    ck_assert_int_eq(next, reverse ? last - 1 : last + 1);
+}
+
+START_TEST(AppendAcrossSegments) {
+    storeValues(1, 1000);
+    ck_assert_uint_gt(countSegments(), 1);
+    checkRange(1, 1000, 0);
+    checkRange(250, 750, 33);
+    checkRange(900, 100, 64);
+} END_TEST
+
+START_TEST(DropOlderValues) {
+    storeValues(10, 20);
+    storeValues(5, 15);
+    storeValues(21, 30);
+    checkRange(10, 30, 0);
+} END_TEST
+
+START_TEST(ReloadSegments) {
+    storeValues(1, 500);
+    hdb.deleteMembers(&hdb);
+    hdb = UA_HistoryDatabase_mmap(directory, SEGMENT_SIZE, 0);
+    ck_assert(hdb.readRaw != NULL);
+    checkRange(1, 500, 0);
+
+    /* Append after the loaded values */
+    storeValues(501, 600);
+    checkRange(450, 600, 40);
+} END_TEST
+
+START_TEST(DropOldestSegments) {
+    hdb.deleteMembers(&hdb);
+    hdb = UA_HistoryDatabase_mmap(directory, SEGMENT_SIZE, 3);
+    storeValues(1, 2000);
+    ck_assert_uint_eq(countSegments(), 3);
+
+    /* The newest values remain */
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 1;
+    details.endTime = 2001 * UA_DATETIME_SEC;
+    UA_HistoryReadResult result;
+    readRaw(&details, NULL, &result);
+    ck_assert_int_eq(result.statusCode, UA_STATUSCODE_GOOD);
+    UA_HistoryData *data = getHistoryData(&result);
+    ck_assert_uint_gt(data->dataValuesSize, 0);
+    ck_assert_uint_lt(data->dataValuesSize, 2000);
+    UA_Int32 first = 2001 - (UA_Int32)data->dataValuesSize;
+    for(size_t i = 0; i < data->dataValuesSize; ++i)
+        checkValue(&data->dataValues[i], first + (UA_Int32)i);
+    UA_HistoryReadResult_deleteMembers(&result);
+} END_TEST
+
+START_TEST(LargeValueAfterSmallValues) {
+    storeValues(1, 300);
+
+    /* Larger than the value region of a segment balanced for Int32 values */
+    UA_ByteString large;
+    ck_assert_int_eq(UA_ByteString_allocBuffer(&large, 3500), UA_STATUSCODE_GOOD);
+    memset(large.data, 0xab, large.length);
+    UA_DataValue dv;
+    UA_DataValue_init(&dv);
+    UA_Variant_setScalar(&dv.value, &large, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    dv.hasValue = true;
+    dv.sourceTimestamp = 301 * UA_DATETIME_SEC;
+    dv.hasSourceTimestamp = true;
+    hdb.setValue(NULL, hdb.context, NULL, NULL, &nodeId, &dv);
+    storeValues(302, 310);
+    checkRange(1, 300, 0);
+    checkRange(302, 310, 0);
+
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 301 * UA_DATETIME_SEC;
+    details.endTime = 302 * UA_DATETIME_SEC;
+    UA_HistoryReadResult result;
+    readRaw(&details, NULL, &result);
+    UA_HistoryData *data = getHistoryData(&result);
+    ck_assert_uint_eq(data->dataValuesSize, 1);
+    ck_assert(UA_Variant_hasScalarType(&data->dataValues[0].value,
+                                       &UA_TYPES[UA_TYPES_BYTESTRING]));
+    ck_assert(UA_ByteString_equal((UA_ByteString*)data->dataValues[0].value.data, &large));
+    UA_HistoryReadResult_deleteMembers(&result);
+    UA_ByteString_deleteMembers(&large);
+} END_TEST
+
+static Suite * testSuite_history_mmap(void) {
+    Suite *s = suite_create("history_mmap");
+    TCase *tc = tcase_create("segments");
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, AppendAcrossSegments);
+    tcase_add_test(tc, DropOlderValues);
+    tcase_add_test(tc, ReloadSegments);
+    tcase_add_test(tc, DropOldestSegments);
+    tcase_add_test(tc, LargeValueAfterSmallValues);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_history_mmap();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr,CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
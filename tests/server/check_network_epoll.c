@@ -0,0 +1,382 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel.h"
+#include "ua_client_highlevel_async.h"
+#include "ua_config_default.h"
+#include "ua_network_epoll.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_transport_generated.h"
+#include "ua_transport_generated_encoding_binary.h"
+#include "ua_server_internal.h"
+#include "testing_clock.h"
+#include "check.h"
+#include "thread_wrapper.h"
+
+#define PORT 4840
+#define CONNECTIONS 3000
+/* The TCP client uses select. So the file descriptors of both sides need to
+ * stay below FD_SETSIZE. */
+#define SESSIONS 400
+
+UA_Server *server;
+UA_ServerConfig *config;
+UA_Boolean running;
+THREAD_HANDLE server_thread;
+
+static int sockets[CONNECTIONS];
+static size_t socketsSize;
+
+static void
+setup(void) {
+    config = UA_ServerConfig_new_minimal(PORT, NULL);
+    config->networkLayers[0].deleteMembers(&config->networkLayers[0]);
+    config->networkLayers[0] =
+        UA_ServerNetworkLayerEpoll(UA_ConnectionConfig_default, PORT, config->logger);
+    config->maxSecureChannels = SESSIONS + 10;
+    config->maxSessions = SESSIONS + 10;
+    server = UA_Server_new(config);
+    UA_StatusCode retval = UA_Server_run_startup(server);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Two file descriptors per loopback connection */
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    socketsSize = CONNECTIONS;
+    if(rl.rlim_cur < 2 * CONNECTIONS + 64) {
+        rl.rlim_cur = 2 * CONNECTIONS + 64;
+        if(rl.rlim_cur > rl.rlim_max)
+            rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        if(rl.rlim_cur < 2 * CONNECTIONS + 64)
+            socketsSize = (rl.rlim_cur - 64) / 2;
+    }
+}
+
+static void
+teardown(void) {
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+
+static int
+connectSocket(void) {
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    ck_assert_int_ge(s, 0);
+    int opts = fcntl(s, F_GETFL);
+    fcntl(s, F_SETFL, opts | O_NONBLOCK);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int res = connect(s, (struct sockaddr*)&addr, sizeof(addr));
+    ck_assert(res == 0 || errno == EINPROGRESS);
+    return s;
+}
+
+static void
+sendHello(int s) {
+    UA_Byte buf[128];
+    UA_TcpHelloMessage hello;
+    memset(&hello, 0, sizeof(UA_TcpHelloMessage));
+    hello.receiveBufferSize = 65535;
+    hello.sendBufferSize = 65535;
+    hello.endpointUrl = UA_STRING("opc.tcp://localhost:4840");
+    UA_TcpMessageHeader header;
+    header.messageTypeAndChunkType = UA_MESSAGETYPE_HEL + UA_CHUNKTYPE_FINAL;
+    header.messageSize = (UA_UInt32)(8 + UA_calcSizeBinary(&hello,
+                                     &UA_TRANSPORT[UA_TRANSPORT_TCPHELLOMESSAGE]));
+    UA_Byte *pos = buf;
+    UA_StatusCode retval = UA_TcpMessageHeader_encodeBinary(&header, &pos, &buf[128]);
+    retval |= UA_TcpHelloMessage_encodeBinary(&hello, &pos, &buf[128]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ssize_t n = send(s, buf, header.messageSize, MSG_NOSIGNAL);
+    ck_assert_int_eq(n, header.messageSize);
+}
+
+/* Returns 1 if an ACK was received, 0 if nothing is available and -1 if the
+ * connection was closed */
+static int
+receiveAck(int s) {
+    UA_Byte buf[64];
+    ssize_t n = recv(s, buf, sizeof(buf), 0);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    if(n <= 0)
+        return -1;
+    ck_assert_int_ge(n, 8);
+    ck_assert(memcmp(buf, "ACKF", 4) == 0);
+    return 1;
+}
+
+/* Open thousands of connections from the same thread. The server is iterated
+ * without waiting in between. */
+START_TEST(Epoll_manyConnections) {
+    clock_t begin = clock();
+
+    /* Connect all sockets. Let the server accept regularly so that the backlog
+     * does not overflow. */
+    for(size_t i = 0; i < socketsSize; i++) {
+        sockets[i] = connectSocket();
+        if(i % 100 == 99)
+            UA_Server_run_iterate(server, false);
+    }
+
+    /* Complete the handshake on all connections */
+    for(size_t i = 0; i < socketsSize; i++)
+        sendHello(sockets[i]);
+    UA_Boolean *acked = (UA_Boolean*)UA_calloc(socketsSize, sizeof(UA_Boolean));
+    ck_assert_ptr_ne(acked, NULL);
+    size_t ackCount = 0;
+    for(size_t round = 0; round < 10000 && ackCount < socketsSize; round++) {
+        UA_Server_run_iterate(server, false);
+        for(size_t i = 0; i < socketsSize; i++) {
+            if(acked[i])
+                continue;
+            int res = receiveAck(sockets[i]);
+            ck_assert_int_ge(res, 0);
+            if(res == 1) {
+                acked[i] = true;
+                ackCount++;
+            }
+        }
+    }
+    UA_free(acked);
+    ck_assert_uint_eq(ackCount, socketsSize);
+    double handshake = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+    /* The cost of an iteration does not depend on idle connections */
+    begin = clock();
+    for(size_t i = 0; i < 10000; i++)
+        UA_Server_run_iterate(server, false);
+    double idle = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+    printf("%lu connections: handshake %f s, idle iteration %f us\n",
+           (unsigned long)socketsSize, handshake, idle * 100.0);
+
+    /* Closing on the client side is picked up by the server */
+    for(size_t i = 0; i < socketsSize; i++)
+        close(sockets[i]);
+    for(size_t i = 0; i < 10; i++)
+        UA_Server_run_iterate(server, false);
+}
+END_TEST
+
+/* Connections without a HEL message are closed after the timeout */
+START_TEST(Epoll_helloTimeout) {
+    int s = connectSocket();
+    UA_Server_run_iterate(server, false);
+    UA_Server_run_iterate(server, false);
+    ck_assert_int_eq(receiveAck(s), 0);
+
+    UA_fakeSleep(121000);
+    UA_Server_run_iterate(server, false);
+    UA_Server_run_iterate(server, false);
+    ck_assert_int_eq(receiveAck(s), -1);
+    close(s);
+}
+END_TEST
+
+THREAD_CALLBACK(serverloop) {
+    while(running)
+        UA_Server_run_iterate(server, true);
+    return 0;
+}
+
+/* Full client sessions that remain open at the same time */
+START_TEST(Epoll_manySessions) {
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+
+    UA_Client **clients = (UA_Client**)UA_calloc(SESSIONS, sizeof(UA_Client*));
+    ck_assert_ptr_ne(clients, NULL);
+    for(size_t i = 0; i < SESSIONS; i++) {
+        clients[i] = UA_Client_new(UA_ClientConfig_default);
+        UA_StatusCode retval = UA_Client_connect(clients[i], "opc.tcp://localhost:4840");
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    for(size_t i = 0; i < SESSIONS; i++) {
+        UA_Variant val;
+        UA_Variant_init(&val);
+        UA_NodeId nodeId =
+            UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_STATE);
+        UA_StatusCode retval = UA_Client_readValueAttribute(clients[i], nodeId, &val);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_Variant_deleteMembers(&val);
+    }
+
+    for(size_t i = 0; i < SESSIONS; i++) {
+        UA_Client_disconnect(clients[i]);
+        UA_Client_delete(clients[i]);
+    }
+    UA_free(clients);
+
+    running = false;
+    THREAD_JOIN(server_thread);
+
+    /* The buffers are recycled. Only a fraction of them was allocated. */
+    UA_BufferPoolStatistics stats;
+    UA_ServerNetworkLayerEpoll_getBufferPoolStatistics(&config->networkLayers[0],
+                                                       &stats);
+    printf("%lu sessions: %lu buffers allocated, %lu reused\n",
+           (unsigned long)SESSIONS, (unsigned long)stats.allocated,
+           (unsigned long)stats.reused);
+    ck_assert_uint_gt(stats.reused, 4 * stats.allocated);
+}
+END_TEST
+
+/* The backpressure test requires that requests are processed within the
+ * server iteration */
+#ifndef UA_ENABLE_MULTITHREADING
+
+/* Every read of the large variable returns a 4MB array */
+#define LARGEARRAY (1024 * 1024)
+static size_t largeReads;
+
+static UA_StatusCode
+readLarge(UA_Server *s, const UA_NodeId *sessionId, void *sessionContext,
+          const UA_NodeId *nodeId, void *nodeContext, UA_Boolean sourceTimeStamp,
+          const UA_NumericRange *range, UA_DataValue *value) {
+    largeReads++;
+    UA_UInt32 *array = (UA_UInt32*)UA_Array_new(LARGEARRAY, &UA_TYPES[UA_TYPES_UINT32]);
+    if(!array)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_Variant_setArray(&value->value, array, LARGEARRAY, &UA_TYPES[UA_TYPES_UINT32]);
+    value->hasValue = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t largeResponses;
+
+static void
+largeReadCallback(UA_Client *client, void *userdata,
+                  UA_UInt32 requestId, UA_ReadResponse *rr) {
+    ck_assert_uint_eq(rr->responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(rr->resultsSize, 1);
+    ck_assert_uint_eq(rr->results[0].value.arrayLength, LARGEARRAY);
+    largeResponses++;
+}
+
+static UA_Connection *
+serverConnection(void) {
+    channel_list_entry *entry = LIST_FIRST(&server->secureChannelManager.channels);
+    ck_assert_ptr_ne(entry, NULL);
+    return entry->channel.connection;
+}
+
+/* A client that does not read its responses. The server queues the responses
+ * and stops reading requests once the connection is congested. */
+START_TEST(Epoll_backpressure) {
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_DataSource ds;
+    ds.read = readLarge;
+    ds.write = NULL;
+    UA_NodeId largeId = UA_NODEID_STRING(1, "large");
+    UA_StatusCode retval =
+        UA_Server_addDataSourceVariableNode(server, largeId,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "large"),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                            attr, ds, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Connect with the server running in the background */
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+    UA_Client *client = UA_Client_new(UA_ClientConfig_default);
+    retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    running = false;
+    THREAD_JOIN(server_thread);
+
+    /* Send requests one by one without reading the responses */
+    largeReads = 0;
+    largeResponses = 0;
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = largeId;
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = &rvi;
+    request.nodesToReadSize = 1;
+    for(size_t i = 0; i < 10; i++) {
+        retval = UA_Client_sendAsyncReadRequest(client, &request,
+                                                largeReadCallback, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        for(size_t j = 0; j < 10; j++)
+            UA_Server_run_iterate(server, false);
+    }
+
+    /* The responses are queued and the server stopped reading */
+    UA_Connection *c = serverConnection();
+    ck_assert(UA_Connection_isCongested(c));
+    ck_assert_uint_lt(largeReads, 10);
+    size_t queued = c->sendQueueSize;
+    printf("Congested after %lu reads with %lu queued bytes\n",
+           (unsigned long)largeReads, (unsigned long)queued);
+
+    /* The client reads. The server flushes the queue and continues. The
+     * client iterates without a timeout as the testing clock stands still. */
+    for(size_t i = 0; i < 10000 && largeResponses < 10; i++) {
+        UA_Server_run_iterate(server, false);
+        UA_Client_run_iterate(client, 0);
+    }
+    ck_assert_uint_eq(largeReads, 10);
+    ck_assert_uint_eq(largeResponses, 10);
+    ck_assert_uint_eq(c->sendQueueSize, 0);
+
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    running = false;
+    THREAD_JOIN(server_thread);
+}
+END_TEST
+
+#endif /* UA_ENABLE_MULTITHREADING */
+
+static Suite* testSuite_NetworkEpoll(void) {
+    Suite *s = suite_create("Network Epoll");
+    TCase *tc_epoll = tcase_create("Epoll");
+    tcase_add_checked_fixture(tc_epoll, setup, teardown);
+    tcase_add_test(tc_epoll, Epoll_helloTimeout);
+    tcase_add_test(tc_epoll, Epoll_manyConnections);
+    tcase_add_test(tc_epoll, Epoll_manySessions);
+#ifndef UA_ENABLE_MULTITHREADING
+    tcase_add_test(tc_epoll, Epoll_backpressure);
+#endif
+    suite_add_tcase(s, tc_epoll);
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_NetworkEpoll();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,8 +24,12 @@
  * released */
 typedef struct UA_NodeMapEntry {
     struct UA_NodeMapEntry *orig; /* the version this is a copy from (or NULL) */
-    UA_UInt16 refCount; /* How many consumers have a reference to the node? */
+    UA_UInt32 refCount; /* How many consumers have a reference to the node? */
     UA_Boolean deleted; /* Node was marked as deleted and can be deleted when refCount == 0 */
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_UInt32 retiredEpoch;
+    struct UA_NodeMapEntry *retiredNext;
+#endif
     UA_Node node;
 } UA_NodeMapEntry;
 
@@ -200,6 +204,88 @@ START_TEST(failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+static void checkFound(UA_UInt32 first, UA_UInt32 last) {
+    for(UA_UInt32 i = first; i < last; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC((UA_UInt16)(i % 3), i);
+        const UA_Node* nr = ns.getNode(ns.context, &id);
+        ck_assert_ptr_ne(nr, NULL);
+        ns.releaseNode(ns.context, nr);
+    }
+}
+
+/* The hash-map is resized incrementally. All nodes are found while the nodes
+ * are copied to the resized hash-map. */
+START_TEST(findNodesDuringResize) {
+    for(UA_UInt32 i = 1; i <= 5000; i++) {
+        UA_Node* n = createNode((UA_Int16)(i % 3), i);
+        ck_assert_int_eq(ns.insertNode(ns.context, n, NULL), UA_STATUSCODE_GOOD);
+        if(i % 250 == 0)
+            checkFound(1, i + 1);
+    }
+
+    /* Replace some nodes in between */
+    for(UA_UInt32 i = 1; i <= 5000; i += 7) {
+        UA_NodeId id = UA_NODEID_NUMERIC((UA_UInt16)(i % 3), i);
+        UA_Node* n;
+        ck_assert_int_eq(ns.getNodeCopy(ns.context, &id, &n), UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(ns.replaceNode(ns.context, n), UA_STATUSCODE_GOOD);
+    }
+
+    /* Shrink the hash-map */
+    for(UA_UInt32 i = 1; i <= 4900; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC((UA_UInt16)(i % 3), i);
+        ck_assert_int_eq(ns.removeNode(ns.context, &id), UA_STATUSCODE_GOOD);
+        if(i % 250 == 0)
+            checkFound(i + 1, 5001);
+    }
+
+    /* Removed nodes are not found */
+    UA_NodeId id = UA_NODEID_NUMERIC(1, 4900);
+    const UA_Node* nr = ns.getNode(ns.context, &id);
+    ck_assert_ptr_eq(nr, NULL);
+
+    /* Every node is visited once */
+    zeroCnt = 0;
+    visitCnt = 0;
+    ns.iterate(ns.context, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, 100);
+}
+END_TEST
+
+static void setupSharded(void) {
+    UA_Nodestore_default_newSharded(&ns, 4);
+}
+
+START_TEST(findNodesInShards) {
+    for(UA_UInt32 i = 1; i <= 1000; i++) {
+        UA_Node* n = createNode((UA_Int16)(i % 3), i);
+        ck_assert_int_eq(ns.insertNode(ns.context, n, NULL), UA_STATUSCODE_GOOD);
+    }
+    checkFound(1, 1001);
+
+    /* The same identifier in another namespace */
+    UA_NodeId id = UA_NODEID_NUMERIC(1, 3);
+    const UA_Node* nr = ns.getNode(ns.context, &id);
+    ck_assert_ptr_eq(nr, NULL);
+
+    /* Random identifiers are unique within the namespace */
+    UA_Node* n = createNode(2, 0);
+    UA_NodeId addedId;
+    ck_assert_int_eq(ns.insertNode(ns.context, n, &addedId), UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(addedId.namespaceIndex, 2);
+    nr = ns.getNode(ns.context, &addedId);
+    ck_assert_ptr_ne(nr, NULL);
+    ns.releaseNode(ns.context, nr);
+
+    zeroCnt = 0;
+    visitCnt = 0;
+    ns.iterate(ns.context, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, 1001);
+}
+END_TEST
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -264,6 +350,96 @@ START_TEST(profileGetDelete) {
 }
 END_TEST
 
+/* Readers run concurrently with a writer that replaces the nodes */
+#define READ_ROUNDS 200
+
+static void replaceNodes(void) {
+    UA_NodeId id = UA_NODEID_NUMERIC(0, 0);
+    for(UA_UInt32 i = 0; i < N; i++) {
+        id.identifier.numeric = i+1;
+        UA_Node *node = NULL;
+        UA_StatusCode retval = ns.getNodeCopy(ns.context, &id, &node);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        retval = ns.replaceNode(ns.context, node);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+}
+
+static UA_Boolean readNodes(void) {
+    UA_NodeId id = UA_NODEID_NUMERIC(0, 0);
+    UA_Boolean found = true;
+    for(UA_UInt32 i = 0; i < N; i++) {
+        id.identifier.numeric = i+1;
+        const UA_Node *node = ns.getNode(ns.context, &id);
+        if(!node)
+            found = false;
+        ns.releaseNode(ns.context, node);
+    }
+    return found;
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+struct UA_NodeStoreReadTest {
+    volatile size_t *runningReaders;
+    UA_Boolean found;
+};
+
+static void *profileReadThread(void *arg) {
+    struct UA_NodeStoreReadTest *test = (struct UA_NodeStoreReadTest*)arg;
+    test->found = true;
+    for(size_t i = 0; i < READ_ROUNDS; i++)
+        test->found &= readNodes();
+    UA_atomic_subSize(test->runningReaders, 1);
+    return NULL;
+}
+#endif
+
+START_TEST(profileReadThroughput) {
+    for(UA_UInt32 i = 0; i < N; i++) {
+        UA_Node *n = createNode(0,i+1);
+        ns.insertNode(ns.context, n, NULL);
+    }
+
+    size_t replaced = 0;
+    clock_t begin, end;
+    begin = clock();
+#ifdef UA_ENABLE_MULTITHREADING
+    volatile size_t runningReaders = THREADS;
+    pthread_t t[THREADS];
+    struct UA_NodeStoreReadTest p[THREADS];
+    for(int i = 0; i < THREADS; i++) {
+        p[i].runningReaders = &runningReaders;
+        pthread_create(&t[i], NULL, profileReadThread, &p[i]);
+    }
+    while(runningReaders > 0) {
+        replaceNodes();
+        replaced += N;
+    }
+    for(int i = 0; i < THREADS; i++) {
+        pthread_join(t[i], NULL);
+        ck_assert(p[i].found);
+    }
+    end = clock();
+    printf("Time for %d reads on %d threads with %d concurrent replacements: %fs.\n",
+           THREADS * READ_ROUNDS * N, THREADS, (int)replaced,
+           (double)(end - begin) / CLOCKS_PER_SEC);
+#else
+    /* No concurrent access without multithreading. Alternate the reads and
+     * the replacements. */
+    for(size_t i = 0; i < READ_ROUNDS; i++) {
+        ck_assert(readNodes());
+        if(i % 10 == 0) {
+            replaceNodes();
+            replaced += N;
+        }
+    }
+    end = clock();
+    printf("Time for single-threaded %d reads with %d replacements: %fs.\n",
+           READ_ROUNDS * N, (int)replaced, (double)(end - begin) / CLOCKS_PER_SEC);
+#endif
+}
+END_TEST
+
 static Suite * namespace_suite (void) {
     Suite *s = suite_create ("UA_NodeStore");
 
@@ -287,10 +463,23 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_iterate, iterateOverUA_NodeStoreShallNotVisitEmptyNodes);
     tcase_add_test (tc_iterate, iterateOverExpandedNamespaceShallNotVisitEmptyNodes);
     suite_add_tcase (s, tc_iterate);
-    
+
+    TCase* tc_resize = tcase_create ("Resize");
+    tcase_add_checked_fixture(tc_resize, setup, teardown);
+    tcase_add_test (tc_resize, findNodesDuringResize);
+    suite_add_tcase (s, tc_resize);
+
+    TCase* tc_sharded = tcase_create ("Sharded");
+    tcase_add_checked_fixture(tc_sharded, setupSharded, teardown);
+    tcase_add_test (tc_sharded, findNodesInShards);
+    tcase_add_test (tc_sharded, findNodesDuringResize);
+    tcase_add_test (tc_sharded, replaceOldNode);
+    suite_add_tcase (s, tc_sharded);
+
     TCase* tc_profile = tcase_create ("Profile");
     tcase_add_checked_fixture(tc_profile, setup, teardown);
     tcase_add_test (tc_profile, profileGetDelete);
+    tcase_add_test (tc_profile, profileReadThroughput);
     suite_add_tcase (s, tc_profile);
 
     return s;
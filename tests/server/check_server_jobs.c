@@ -69,12 +69,136 @@ START_TEST(Server_repeatedCallbackRemoveItself) {
 }
 END_TEST
 
+#define DISPATCHED_CALLBACKS 100000
+
+static volatile size_t dispatchedCount;
+static UA_Boolean delayedExecuted;
+
+static void
+countCallback(UA_Server *serverPtr, void *data) {
+    UA_atomic_addSize(&dispatchedCount, 1);
+}
+
+static void
+delayedCountCallback(UA_Server *serverPtr, void *data) {
+    /* All callbacks dispatched before have finished */
+    ck_assert_uint_eq(dispatchedCount, DISPATCHED_CALLBACKS);
+    delayedExecuted = true;
+}
+
+START_TEST(Server_dispatchDelayedCallback) {
+    dispatchedCount = 0;
+    delayedExecuted = false;
+    for(size_t i = 0; i < DISPATCHED_CALLBACKS; i++)
+        UA_Server_workerCallback(server, countCallback, NULL);
+    UA_Server_delayedCallback(server, delayedCountCallback, NULL);
+
+    for(size_t i = 0; i < 1000 && !delayedExecuted; i++) {
+        UA_Server_run_iterate(server, false);
+        UA_realSleep(1);
+    }
+    ck_assert_uint_eq(delayedExecuted, true);
+    ck_assert_uint_eq(dispatchedCount, DISPATCHED_CALLBACKS);
+}
+END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+#define STRAND_CALLBACKS 1000
+
+typedef struct {
+    UA_StrandCallback sc;
+    size_t index;
+} StrandTestCallback;
+
+static StrandTestCallback strandCallbacks[STRAND_CALLBACKS];
+static size_t strandOrder[STRAND_CALLBACKS];
+static volatile size_t strandCount;
+
+static void
+recordStrandCallback(UA_Server *serverPtr, void *data) {
+    StrandTestCallback *stc = (StrandTestCallback*)data;
+    strandOrder[strandCount] = stc->index;
+    UA_atomic_addSize(&strandCount, 1);
+}
+
+/* The callbacks are executed in the order they were added. Also across the
+ * batches of the strand. */
+START_TEST(Server_strandFifo) {
+    UA_Strand *strand = UA_Strand_new();
+    ck_assert_ptr_ne(strand, NULL);
+    strandCount = 0;
+    for(size_t i = 0; i < STRAND_CALLBACKS; i++) {
+        strandCallbacks[i].sc.callback = recordStrandCallback;
+        strandCallbacks[i].sc.data = &strandCallbacks[i];
+        strandCallbacks[i].index = i;
+        UA_Server_strandCallback(server, strand, &strandCallbacks[i].sc);
+    }
+
+    for(size_t i = 0; i < 1000 && !UA_Strand_isIdle(strand); i++)
+        UA_realSleep(1);
+    ck_assert(UA_Strand_isIdle(strand));
+    ck_assert_uint_eq(strandCount, STRAND_CALLBACKS);
+    for(size_t i = 0; i < STRAND_CALLBACKS; i++)
+        ck_assert_uint_eq(strandOrder[i], i);
+    UA_Strand_delete(strand);
+}
+END_TEST
+
+static UA_Strand *busyStrand;
+static StrandTestCallback busyCallback;
+static volatile UA_Boolean busyRunning;
+
+/* Adds itself to the strand again. So the strand is never empty. */
+static void
+busyStrandCallback(UA_Server *serverPtr, void *data) {
+    if(busyRunning)
+        UA_Server_strandCallback(serverPtr, busyStrand, &busyCallback.sc);
+}
+
+static void
+delayedCallback(UA_Server *serverPtr, void *data) {
+    delayedExecuted = true;
+}
+
+/* A strand that is never empty does not block the delayed callbacks */
+START_TEST(Server_strandDelayedCallback) {
+    busyStrand = UA_Strand_new();
+    ck_assert_ptr_ne(busyStrand, NULL);
+    busyRunning = true;
+    busyCallback.sc.callback = busyStrandCallback;
+    busyCallback.sc.data = &busyCallback;
+    UA_Server_strandCallback(server, busyStrand, &busyCallback.sc);
+
+    delayedExecuted = false;
+    UA_Server_delayedCallback(server, delayedCallback, NULL);
+    for(size_t i = 0; i < 1000 && !delayedExecuted; i++) {
+        UA_Server_run_iterate(server, false);
+        UA_realSleep(1);
+    }
+    ck_assert_uint_eq(delayedExecuted, true);
+
+    busyRunning = false;
+    for(size_t i = 0; i < 1000 && !UA_Strand_isIdle(busyStrand); i++)
+        UA_realSleep(1);
+    ck_assert(UA_Strand_isIdle(busyStrand));
+    UA_Strand_delete(busyStrand);
+}
+END_TEST
+
+#endif /* UA_ENABLE_MULTITHREADING */
+
 static Suite* testSuite_Client(void) {
     Suite *s = suite_create("Server Callbacks");
     TCase *tc_server = tcase_create("Server Repeated Callbacks");
     tcase_add_checked_fixture(tc_server, setup, teardown);
     tcase_add_test(tc_server, Server_addRemoveRepeatedCallback);
     tcase_add_test(tc_server, Server_repeatedCallbackRemoveItself);
+    tcase_add_test(tc_server, Server_dispatchDelayedCallback);
+#ifdef UA_ENABLE_MULTITHREADING
+    tcase_add_test(tc_server, Server_strandFifo);
+    tcase_add_test(tc_server, Server_strandDelayedCallback);
+#endif
     suite_add_tcase(s, tc_server);
     return s;
 }
@@ -0,0 +1,324 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* This example is just to see how fast MonitoredItems are sampled. The server
+   does not open a TCP port. */
+
+#include <time.h>
+#include <stdio.h>
+#include <check.h>
+
+#include "ua_server.h"
+#include "ua_config_default.h"
+#include "server/ua_server_internal.h"
+#include "server/ua_subscription.h"
+#include "testing_clock.h"
+
+#define MONITOREDITEMS 1000
+#define SAMPLES 100
+
+static UA_ServerConfig *config;
+static UA_Server *server;
+static size_t notifications;
+
+static const UA_NodeId scalarNodeId = {1, UA_NODEIDTYPE_NUMERIC, {50000}};
+static const UA_NodeId arrayNodeId = {1, UA_NODEIDTYPE_NUMERIC, {50001}};
+
+static void
+dataChangeCallback(UA_Server *s, UA_UInt32 monitoredItemId,
+                   void *monitoredItemContext, const UA_NodeId *nodeId,
+                   void *nodeContext, UA_UInt32 attributeId,
+                   const UA_DataValue *value) {
+    notifications++;
+}
+
+static void
+addVariable(const UA_NodeId nodeId, UA_Variant *value) {
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    attr.value = *value;
+    attr.displayName = UA_LOCALIZEDTEXT("en-US", "sampled");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "sampled"), UA_NODEID_NULL,
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+static void
+addMonitoredItems(const UA_NodeId nodeId) {
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = nodeId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    item.requestedParameters.samplingInterval = 100000.0; /* Sample manually */
+    for(size_t i = 0; i < MONITOREDITEMS; ++i) {
+        UA_MonitoredItemCreateResult result =
+            UA_Server_createDataChangeMonitoredItem(server, UA_TIMESTAMPSTORETURN_BOTH,
+                                                    item, NULL, dataChangeCallback);
+        ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+    }
+}
+
+static void setup(void) {
+    config = UA_ServerConfig_new_default();
+    server = UA_Server_new(config);
+    notifications = 0;
+
+    UA_Double scalar = 42.0;
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &scalar, &UA_TYPES[UA_TYPES_DOUBLE]);
+    addVariable(scalarNodeId, &v);
+
+    UA_String array[16];
+    for(size_t i = 0; i < 16; ++i)
+        array[i] = UA_STRING("some string in the array");
+    UA_Variant_setArray(&v, array, 16, &UA_TYPES[UA_TYPES_STRING]);
+    addVariable(arrayNodeId, &v);
+}
+
+static void teardown(void) {
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+
+static void
+sampleAll(void) {
+    UA_MonitoredItem *mon;
+    LIST_FOREACH(mon, &server->localMonitoredItems, listEntry)
+        UA_MonitoredItem_sampleCallback(server, mon);
+}
+
+static void
+resetAll(void) {
+    UA_MonitoredItem *mon;
+    LIST_FOREACH(mon, &server->localMonitoredItems, listEntry)
+        UA_MonitoredItem_resetLastSample(mon);
+}
+
+static double
+sampleSpeed(void) {
+    clock_t begin = clock();
+    for(size_t i = 0; i < SAMPLES; ++i)
+        sampleAll();
+    clock_t finish = clock();
+    return (double)(finish - begin) / CLOCKS_PER_SEC;
+}
+
+static void
+printSpeed(const char *name, double time_spent) {
+    printf("%s: %f s, %f us per sampled item\n", name, time_spent,
+           time_spent * 1000000.0 / (MONITOREDITEMS * SAMPLES));
+}
+
+static void
+runSampleSpeed(const UA_NodeId nodeId, const UA_Variant *newValue) {
+    addMonitoredItems(nodeId);
+
+    /* The first sample is always reported */
+    sampleAll();
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+
+    /* The value is unchanged. The sampling is skipped. */
+    double time_spent = sampleSpeed();
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+    printSpeed("unchanged node", time_spent);
+
+    /* The value is sampled and compared with the last sample */
+    clock_t begin = clock();
+    for(size_t i = 0; i < SAMPLES; ++i) {
+        UA_MonitoredItem *mon;
+        LIST_FOREACH(mon, &server->localMonitoredItems, listEntry) {
+            mon->lastSampledVersion = 0;
+            UA_MonitoredItem_sampleCallback(server, mon);
+        }
+    }
+    time_spent = (double)(clock() - begin) / CLOCKS_PER_SEC;
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+    printSpeed("unchanged value", time_spent);
+
+    /* Writing the same value again is not reported */
+    UA_Variant value;
+    UA_StatusCode retval = UA_Server_readValue(server, nodeId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_writeValue(server, nodeId, value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Variant_deleteMembers(&value);
+    sampleAll();
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+
+    /* The new value is reported */
+    retval = UA_Server_writeValue(server, nodeId, *newValue);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    sampleAll();
+    ck_assert_uint_eq(notifications, 2 * MONITOREDITEMS);
+
+    /* Every sample is reported */
+    begin = clock();
+    for(size_t i = 0; i < SAMPLES; ++i) {
+        resetAll();
+        sampleAll();
+    }
+    time_spent = (double)(clock() - begin) / CLOCKS_PER_SEC;
+    ck_assert_uint_eq(notifications, (2 + SAMPLES) * MONITOREDITEMS);
+    printSpeed("changed value", time_spent);
+}
+
+START_TEST(sampleSpeedScalar) {
+    UA_Double scalar = 43.0;
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &scalar, &UA_TYPES[UA_TYPES_DOUBLE]);
+    runSampleSpeed(scalarNodeId, &v);
+}
+END_TEST
+
+START_TEST(sampleSpeedArray) {
+    UA_String array[16];
+    for(size_t i = 0; i < 16; ++i)
+        array[i] = UA_STRING("some string in the array");
+    array[15] = UA_STRING("another string in the array");
+    UA_Variant v;
+    UA_Variant_setArray(&v, array, 16, &UA_TYPES[UA_TYPES_STRING]);
+    runSampleSpeed(arrayNodeId, &v);
+}
+END_TEST
+
+/* With multithreading, the sample callbacks registered on write are executed
+ * asynchronously in the workers */
+#ifndef UA_ENABLE_MULTITHREADING
+
+static void setupSampleOnWrite(void) {
+    setup();
+    server->config.sampleOnWrite = true;
+    UA_Server_run_startup(server);
+}
+
+static void teardownSampleOnWrite(void) {
+    UA_Server_run_shutdown(server);
+    teardown();
+}
+
+static void
+writeScalar(UA_Double d) {
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_StatusCode retval = UA_Server_writeValue(server, scalarNodeId, v);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+static size_t
+countRegistered(void) {
+    size_t count = 0;
+    UA_MonitoredItem *mon;
+    LIST_FOREACH(mon, &server->localMonitoredItems, listEntry) {
+        ck_assert_ptr_ne(mon->monitoredNode, NULL);
+        if(mon->sampleCallbackIsRegistered)
+            count++;
+    }
+    return count;
+}
+
+START_TEST(sampleOnWrite) {
+    addMonitoredItems(scalarNodeId);
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+
+    /* Without writes, the MonitoredItems don't sample */
+    ck_assert_uint_eq(countRegistered(), 0);
+    UA_fakeSleep(200000);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+
+    /* A write is sampled right away */
+    writeScalar(43.0);
+    ck_assert_uint_eq(notifications, 2 * MONITOREDITEMS);
+    ck_assert_uint_eq(countRegistered(), MONITOREDITEMS);
+
+    /* More writes within the sampling interval are sampled with the interval */
+    writeScalar(44.0);
+    writeScalar(45.0);
+    ck_assert_uint_eq(notifications, 2 * MONITOREDITEMS);
+    UA_fakeSleep(100001);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(notifications, 3 * MONITOREDITEMS);
+    ck_assert_uint_eq(countRegistered(), MONITOREDITEMS);
+
+    /* No more writes. Stop sampling. */
+    UA_fakeSleep(100001);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(notifications, 3 * MONITOREDITEMS);
+    ck_assert_uint_eq(countRegistered(), 0);
+
+    /* Idle MonitoredItems have no cost */
+    clock_t begin = clock();
+    for(size_t i = 0; i < SAMPLES; ++i) {
+        UA_fakeSleep(100001);
+        UA_Server_run_iterate(server, false);
+    }
+    printSpeed("idle sample on write", (double)(clock() - begin) / CLOCKS_PER_SEC);
+    ck_assert_uint_eq(notifications, 3 * MONITOREDITEMS);
+}
+END_TEST
+
+static void
+onRead(UA_Server *s, const UA_NodeId *sessionId, void *sessionContext,
+       const UA_NodeId *nodeId, void *nodeContext, const UA_NumericRange *range,
+       const UA_DataValue *value) {
+}
+
+START_TEST(sampleOnWriteDataSource) {
+    addMonitoredItems(scalarNodeId);
+    ck_assert_uint_eq(notifications, MONITOREDITEMS);
+
+    /* Values with an onRead callback change without a write. Fall back to
+     * sampling in the interval. */
+    UA_ValueCallback callback;
+    callback.onRead = onRead;
+    callback.onWrite = NULL;
+    UA_StatusCode retval =
+        UA_Server_setVariableNode_valueCallback(server, scalarNodeId, callback);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(countRegistered(), MONITOREDITEMS);
+
+    /* Deleting the node is sampled */
+    size_t before = notifications;
+    retval = UA_Server_deleteNode(server, scalarNodeId, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_fakeSleep(100001);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(notifications, before + MONITOREDITEMS);
+}
+END_TEST
+
+#endif /* UA_ENABLE_MULTITHREADING */
+
+static Suite * sample_speed_suite (void) {
+    Suite *s = suite_create ("Sample Speed");
+
+    TCase* tc_sample = tcase_create ("Sample");
+    tcase_add_checked_fixture(tc_sample, setup, teardown);
+    tcase_add_test (tc_sample, sampleSpeedScalar);
+    tcase_add_test (tc_sample, sampleSpeedArray);
+    suite_add_tcase (s, tc_sample);
+
+#ifndef UA_ENABLE_MULTITHREADING
+    TCase* tc_onwrite = tcase_create ("SampleOnWrite");
+    tcase_add_checked_fixture(tc_onwrite, setupSampleOnWrite, teardownSampleOnWrite);
+    tcase_add_test (tc_onwrite, sampleOnWrite);
+    tcase_add_test (tc_onwrite, sampleOnWriteDataSource);
+    suite_add_tcase (s, tc_onwrite);
+#endif
+
+    return s;
+}
+
+int main (void) {
+    int number_failed = 0;
+    Suite *s = sample_speed_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr,CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed (sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
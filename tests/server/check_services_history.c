@@ -0,0 +1,307 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ua_server.h"
+#include "server/ua_services.h"
+#include "server/ua_server_internal.h"
+#include "ua_config_default.h"
+#include "ua_history_default.h"
+#include "check.h"
+
+#define HISTORY_SIZE 100
+
+static UA_Server *server = NULL;
+static UA_ServerConfig *config = NULL;
+static UA_NodeId historyNodeId;
+
+static void setup(void) {
+    config = UA_ServerConfig_new_default();
+    config->historyDatabase.deleteMembers(&config->historyDatabase);
+    config->historyDatabase = UA_HistoryDatabase_default(HISTORY_SIZE);
+    server = UA_Server_new(config);
+
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Int32 myInteger = 0;
+    UA_Variant_setScalar(&attr.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    attr.accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE |
+        UA_ACCESSLEVELMASK_HISTORYREAD;
+    attr.historizing = true;
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, 5000),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "the answer"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, &historyNodeId);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+static void teardown(void) {
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+
+/* Write the values 1..count with the source timestamps 1..count (in seconds) */
+static void
+writeValues(UA_Int32 count) {
+    for(UA_Int32 i = 1; i <= count; ++i) {
+        UA_WriteValue wValue;
+        UA_WriteValue_init(&wValue);
+        wValue.nodeId = historyNodeId;
+        wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_Variant_setScalar(&wValue.value.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        wValue.value.hasValue = true;
+        wValue.value.sourceTimestamp = i * UA_DATETIME_SEC;
+        wValue.value.hasSourceTimestamp = true;
+        UA_StatusCode retval = UA_Server_write(server, &wValue);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+}
+
+static void
+historyRead(UA_ReadRawModifiedDetails *details, const UA_ByteString *cp,
+            UA_HistoryReadResponse *response) {
+    UA_HistoryReadValueId id;
+    UA_HistoryReadValueId_init(&id);
+    id.nodeId = historyNodeId;
+    if(cp)
+        id.continuationPoint = *cp;
+
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    request.historyReadDetails.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    request.historyReadDetails.content.decoded.type = &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS];
+    request.historyReadDetails.content.decoded.data = details;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &id;
+
+    UA_HistoryReadResponse_init(response);
+    Service_HistoryRead(server, &adminSession, &request, response);
+    ck_assert_int_eq(response->responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response->resultsSize, 1);
+}
+
+static UA_HistoryData *
+getHistoryData(UA_HistoryReadResponse *response) {
+    UA_ExtensionObject *eo = &response->results[0].historyData;
+    ck_assert_int_eq(eo->encoding, UA_EXTENSIONOBJECT_DECODED);
+    ck_assert_ptr_eq(eo->content.decoded.type, &UA_TYPES[UA_TYPES_HISTORYDATA]);
+    return (UA_HistoryData*)eo->content.decoded.data;
+}
+
+static void
+checkValue(const UA_DataValue *dv, UA_Int32 expected) {
+    ck_assert(dv->hasValue);
+    ck_assert_int_eq(*(UA_Int32*)dv->value.data, expected);
+    ck_assert(dv->hasSourceTimestamp);
+    ck_assert_int_eq(dv->sourceTimestamp, expected * UA_DATETIME_SEC);
+    ck_assert(!dv->hasServerTimestamp);
+}
+
+START_TEST(ReadRawRange) {
+    writeValues(50);
+
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 10 * UA_DATETIME_SEC;
+    details.endTime = 20 * UA_DATETIME_SEC;
+
+    UA_HistoryReadResponse response;
+    historyRead(&details, NULL, &response);
+    ck_assert_int_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.results[0].continuationPoint.length, 0);
+    UA_HistoryData *data = getHistoryData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 10);
+    for(size_t i = 0; i < data->dataValuesSize; ++i)
+        checkValue(&data->dataValues[i], (UA_Int32)(10 + i));
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* With the bounding values */
+    details.returnBounds = true;
+    historyRead(&details, NULL, &response);
+    data = getHistoryData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 12);
+    checkValue(&data->dataValues[0], 9);
+    checkValue(&data->dataValues[11], 20);
+    UA_HistoryReadResponse_deleteMembers(&response);
+} END_TEST
+
+START_TEST(ReadRawReverse) {
+    writeValues(50);
+
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 20 * UA_DATETIME_SEC;
+    details.endTime = 10 * UA_DATETIME_SEC;
+
+    UA_HistoryReadResponse response;
+    historyRead(&details, NULL, &response);
+    ck_assert_int_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    UA_HistoryData *data = getHistoryData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 10);
+    for(size_t i = 0; i < data->dataValuesSize; ++i)
+        checkValue(&data->dataValues[i], (UA_Int32)(20 - i));
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Only the end time. Returns the last values first. */
+    details.startTime = 0;
+    details.endTime = 30 * UA_DATETIME_SEC;
+    details.numValuesPerNode = 5;
+    historyRead(&details, NULL, &response);
+    data = getHistoryData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 5);
+    checkValue(&data->dataValues[0], 30);
+    checkValue(&data->dataValues[4], 26);
+    UA_HistoryReadResponse_deleteMembers(&response);
+} END_TEST
+
+static void
+readWithContinuationPoints(UA_ReadRawModifiedDetails *details,
+                           UA_Int32 first, UA_Int32 step, size_t expected) {
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    UA_Int32 next = first;
+    size_t total = 0;
+    do {
+        UA_HistoryReadResponse response;
+        historyRead(details, &cp, &response);
+        UA_ByteString_deleteMembers(&cp);
+        ck_assert_int_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+        UA_HistoryData *data = getHistoryData(&response);
+        ck_assert(data->dataValuesSize <= details->numValuesPerNode);
+        for(size_t i = 0; i < data->dataValuesSize; ++i) {
+            checkValue(&data->dataValues[i], next);
+            next += step;
+        }
+        total += data->dataValuesSize;
+        cp = response.results[0].continuationPoint;
+        response.results[0].continuationPoint = UA_BYTESTRING_NULL;
+        UA_HistoryReadResponse_deleteMembers(&response);
+    } while(cp.length > 0);
+    ck_assert_uint_eq(total, expected);
+}
+
+START_TEST(ReadRawContinuationPoint) {
+    writeValues(50);
+
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 1 * UA_DATETIME_SEC;
+    details.endTime = 46 * UA_DATETIME_SEC;
+    details.numValuesPerNode = 7;
+    readWithContinuationPoints(&details, 1, 1, 45);
+
+    details.startTime = 46 * UA_DATETIME_SEC;
+    details.endTime = 1 * UA_DATETIME_SEC;
+    readWithContinuationPoints(&details, 46, -1, 45);
+} END_TEST
+
+START_TEST(ReadRawEvictsOldest) {
+    writeValues(HISTORY_SIZE + 20);
+
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 1;
+    details.endTime = (HISTORY_SIZE + 21) * UA_DATETIME_SEC;
+
+    UA_HistoryReadResponse response;
+    historyRead(&details, NULL, &response);
+    UA_HistoryData *data = getHistoryData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, HISTORY_SIZE);
+    checkValue(&data->dataValues[0], 21);
+    checkValue(&data->dataValues[HISTORY_SIZE - 1], HISTORY_SIZE + 20);
+    UA_HistoryReadResponse_deleteMembers(&response);
+} END_TEST
+
+/* Values with the same timestamp are all kept. The continuation points
+ * resume between them. */
+START_TEST(ReadRawEqualTimestamps) {
+    for(UA_Int32 i = 1; i <= 20; ++i) {
+        UA_WriteValue wValue;
+        UA_WriteValue_init(&wValue);
+        wValue.nodeId = historyNodeId;
+        wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_Variant_setScalar(&wValue.value.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        wValue.value.hasValue = true;
+        wValue.value.sourceTimestamp = ((i + 1) / 2) * UA_DATETIME_SEC;
+        wValue.value.hasSourceTimestamp = true;
+        UA_StatusCode retval = UA_Server_write(server, &wValue);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 1 * UA_DATETIME_SEC;
+    details.endTime = 11 * UA_DATETIME_SEC;
+    details.numValuesPerNode = 3;
+
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    UA_Int32 next = 1;
+    do {
+        UA_HistoryReadResponse response;
+        historyRead(&details, &cp, &response);
+        UA_ByteString_deleteMembers(&cp);
+        ck_assert_int_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+        UA_HistoryData *data = getHistoryData(&response);
+        for(size_t i = 0; i < data->dataValuesSize; ++i) {
+            ck_assert_int_eq(*(UA_Int32*)data->dataValues[i].value.data, next);
+            next++;
+        }
+        cp = response.results[0].continuationPoint;
+        response.results[0].continuationPoint = UA_BYTESTRING_NULL;
+        UA_HistoryReadResponse_deleteMembers(&response);
+    } while(cp.length > 0);
+    ck_assert_int_eq(next, 21);
+} END_TEST
+
+START_TEST(ReadRawNoData) {
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = 1 * UA_DATETIME_SEC;
+    details.endTime = 10 * UA_DATETIME_SEC;
+
+    UA_HistoryReadResponse response;
+    historyRead(&details, NULL, &response);
+    ck_assert_int_eq(response.results[0].statusCode, UA_STATUSCODE_GOODNODATA);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Neither start nor end time */
+    writeValues(5);
+    details.startTime = 0;
+    details.endTime = 0;
+    historyRead(&details, NULL, &response);
+    ck_assert_int_eq(response.results[0].statusCode,
+                     UA_STATUSCODE_BADINVALIDTIMESTAMPARGUMENT);
+    UA_HistoryReadResponse_deleteMembers(&response);
+} END_TEST
+
+static Suite * testSuite_services_history(void) {
+    Suite *s = suite_create("services_history");
+
+    TCase *tc_readraw = tcase_create("readraw");
+    tcase_add_checked_fixture(tc_readraw, setup, teardown);
+    tcase_add_test(tc_readraw, ReadRawRange);
+    tcase_add_test(tc_readraw, ReadRawReverse);
+    tcase_add_test(tc_readraw, ReadRawContinuationPoint);
+    tcase_add_test(tc_readraw, ReadRawEvictsOldest);
+    tcase_add_test(tc_readraw, ReadRawEqualTimestamps);
+    tcase_add_test(tc_readraw, ReadRawNoData);
+    suite_add_tcase(s, tc_readraw);
+
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_services_history();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr,CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
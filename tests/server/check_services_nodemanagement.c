@@ -311,6 +311,83 @@ START_TEST(DeleteObjectAndReferences) {
     UA_BrowseResult_deleteMembers(&br);
 } END_TEST
 
+/* Browse the Organizes references of the folder. Count the targets with an odd
+ * and an even identifier. */
+static void
+browseChildren(UA_NodeId folderId, size_t *odd, size_t *even) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = folderId;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    *odd = 0;
+    *even = 0;
+    for(size_t i = 0; i < br.referencesSize; ++i) {
+        if(br.references[i].nodeId.nodeId.identifier.numeric % 2 == 1)
+            (*odd)++;
+        else
+            (*even)++;
+    }
+    UA_BrowseResult_deleteMembers(&br);
+}
+
+/* Enough children to use the indexed reference targets */
+#define MANYCHILDREN 300
+
+START_TEST(DeleteReferencesWithManyTargets) {
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    UA_NodeId folderId = UA_NODEID_NUMERIC(1, 1000);
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, folderId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                attr, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+    for(UA_UInt32 i = 1; i <= MANYCHILDREN; ++i) {
+        res = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 2000 + i), folderId,
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                      UA_QUALIFIEDNAME(1, "Child"),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                      attr, NULL, NULL);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    /* Duplicate references are detected */
+    res = UA_Server_addReference(server, folderId, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                 UA_EXPANDEDNODEID_NUMERIC(1, 2000 + 123), true);
+    ck_assert_int_eq(res, UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED);
+
+    /* Delete the references to the children with an even identifier */
+    for(UA_UInt32 i = 2; i <= MANYCHILDREN; i += 2) {
+        res = UA_Server_deleteReference(server, folderId,
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), true,
+                                        UA_EXPANDEDNODEID_NUMERIC(1, 2000 + i), true);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    size_t odd, even;
+    browseChildren(folderId, &odd, &even);
+    ck_assert_uint_eq(odd, MANYCHILDREN / 2);
+    ck_assert_uint_eq(even, 0);
+
+    /* The deleted references can be added again */
+    for(UA_UInt32 i = 2; i <= MANYCHILDREN; i += 2) {
+        res = UA_Server_addReference(server, folderId,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_EXPANDEDNODEID_NUMERIC(1, 2000 + i), true);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    browseChildren(folderId, &odd, &even);
+    ck_assert_uint_eq(odd, MANYCHILDREN / 2);
+    ck_assert_uint_eq(even, MANYCHILDREN / 2);
+} END_TEST
+
 
 /* Example taken from tutorial_server_object.c */
 START_TEST(InstantiateObjectType) {
@@ -420,6 +497,7 @@ int main(void) {
     tcase_add_checked_fixture(tc_deletenodes, setup, teardown);
     tcase_add_test(tc_deletenodes, DeleteObjectWithDestructor);
     tcase_add_test(tc_deletenodes, DeleteObjectAndReferences);
+    tcase_add_test(tc_deletenodes, DeleteReferencesWithManyTargets);
     suite_add_tcase(s, tc_deletenodes);
 
     SRunner *sr = srunner_create(s);
@@ -125,6 +125,51 @@ START_TEST(Service_Browse_WithBrowseName) {
 }
 END_TEST
 
+START_TEST(Service_Browse_SubtypeCacheInvalidation) {
+    UA_ServerConfig *config = UA_ServerConfig_new_default();
+    UA_Server *server = UA_Server_new(config);
+
+    const UA_NodeId hierarchical = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    const UA_NodeId hasComponent = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    const UA_NodeId refType = UA_NODEID_NUMERIC(1, 5000);
+    const UA_NodeId subRefType = UA_NODEID_NUMERIC(1, 5001);
+
+    ck_assert(isSubtypeOf(server, &organizes, &hierarchical));
+    ck_assert(!isSubtypeOf(server, &hasComponent, &organizes));
+
+    UA_StatusCode retval =
+        UA_Server_addReferenceTypeNode(server, refType, organizes, hasSubtype,
+                                       UA_QUALIFIEDNAME(1, "MyOrganizes"),
+                                       UA_ReferenceTypeAttributes_default, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addReferenceTypeNode(server, subRefType, refType, hasSubtype,
+                                            UA_QUALIFIEDNAME(1, "MySubOrganizes"),
+                                            UA_ReferenceTypeAttributes_default, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(isSubtypeOf(server, &subRefType, &organizes));
+    ck_assert(isSubtypeOf(server, &subRefType, &hierarchical));
+    ck_assert(!isSubtypeOf(server, &subRefType, &hasComponent));
+    ck_assert(!isSubtypeOf(server, &organizes, &subRefType));
+
+    /* Move the reference type below HasComponent */
+    UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NUMERIC(1, 5000);
+    retval = UA_Server_deleteReference(server, organizes, hasSubtype, true, target, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!isSubtypeOf(server, &subRefType, &organizes));
+    ck_assert(isSubtypeOf(server, &subRefType, &refType));
+
+    retval = UA_Server_addReference(server, hasComponent, hasSubtype, target, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(isSubtypeOf(server, &subRefType, &hasComponent));
+    ck_assert(isSubtypeOf(server, &subRefType, &hierarchical));
+
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+END_TEST
+
 START_TEST(Service_TranslateBrowsePathsToNodeIds) {
     UA_Client *client = UA_Client_new(UA_ClientConfig_default);
 
@@ -191,6 +236,7 @@ static Suite *testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
     TCase *tc_browse = tcase_create("Browse Service");
     tcase_add_test(tc_browse, Service_Browse_WithBrowseName);
     tcase_add_test(tc_browse, Service_Browse_WithMaxResults);
+    tcase_add_test(tc_browse, Service_Browse_SubtypeCacheInvalidation);
     suite_add_tcase(s, tc_browse);
 
     TCase *tc_translate = tcase_create("TranslateBrowsePathsToNodeIds");
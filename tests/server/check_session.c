@@ -6,7 +6,9 @@
 #include <stdlib.h>
 
 #include "ua_types.h"
+#include "ua_config_default.h"
 #include "server/ua_services.h"
+#include "server/ua_server_internal.h"
 #include "check.h"
 
 START_TEST(Session_init_ShallWork) {
@@ -46,6 +48,109 @@ START_TEST(Session_updateLifetime_ShallWork) {
 }
 END_TEST
 
+#define MANY_SESSIONS 500
+
+static UA_Server *server;
+static UA_ServerConfig *config;
+
+static void setup(void) {
+    config = UA_ServerConfig_new_default();
+    config->maxSessions = MANY_SESSIONS;
+    server = UA_Server_new(config);
+}
+
+static void teardown(void) {
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+
+static UA_Session *
+createSession(UA_Double timeout) {
+    UA_CreateSessionRequest request;
+    UA_CreateSessionRequest_init(&request);
+    request.requestedSessionTimeout = timeout;
+    UA_Session *session = NULL;
+    UA_StatusCode retval =
+        UA_SessionManager_createSession(&server->sessionManager, NULL,
+                                        &request, &session);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    return session;
+}
+
+START_TEST(SessionManager_lookupShallFindAllSessions) {
+    UA_Session *sessions[MANY_SESSIONS];
+    for(size_t i = 0; i < MANY_SESSIONS; ++i)
+        sessions[i] = createSession(10000.0);
+
+    UA_CreateSessionRequest request;
+    UA_CreateSessionRequest_init(&request);
+    UA_Session *tooMany = NULL;
+    UA_StatusCode retval =
+        UA_SessionManager_createSession(&server->sessionManager, NULL,
+                                        &request, &tooMany);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTOOMANYSESSIONS);
+
+    for(size_t i = 0; i < MANY_SESSIONS; ++i) {
+        UA_Session *found = UA_SessionManager_getSessionByToken(&server->sessionManager,
+                                                                &sessions[i]->header.authenticationToken);
+        ck_assert_ptr_eq(found, sessions[i]);
+        found = UA_SessionManager_getSessionById(&server->sessionManager,
+                                                 &sessions[i]->sessionId);
+        ck_assert_ptr_eq(found, sessions[i]);
+    }
+
+    /* The token is not the session id */
+    UA_Session *found = UA_SessionManager_getSessionByToken(&server->sessionManager,
+                                                            &sessions[0]->sessionId);
+    ck_assert_ptr_eq(found, NULL);
+
+    /* Removed sessions are no longer found */
+    UA_NodeId token = sessions[0]->header.authenticationToken;
+    retval = UA_SessionManager_removeSession(&server->sessionManager, &token);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    found = UA_SessionManager_getSessionByToken(&server->sessionManager, &token);
+    ck_assert_ptr_eq(found, NULL);
+    retval = UA_SessionManager_removeSession(&server->sessionManager, &token);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADSESSIONIDINVALID);
+    ck_assert_uint_eq(server->sessionManager.currentSessionCount, MANY_SESSIONS - 1);
+}
+END_TEST
+
+START_TEST(SessionManager_cleanupShallRemoveTimedOutSessions) {
+    UA_Session *shortSession = createSession(1000.0);
+    UA_Session *longSession = createSession(5000.0);
+    UA_Session *usedSession = createSession(1000.0);
+    ck_assert_uint_eq(server->sessionManager.currentSessionCount, 3);
+
+    /* The session is used. The lifetime is extended without touching the
+     * session manager. */
+    usedSession->validTill += 3000 * UA_DATETIME_MSEC;
+
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_SessionManager_cleanupTimedOut(&server->sessionManager,
+                                      now + 500 * UA_DATETIME_MSEC);
+    ck_assert_uint_eq(server->sessionManager.currentSessionCount, 3);
+
+    UA_SessionManager_cleanupTimedOut(&server->sessionManager,
+                                      now + 2000 * UA_DATETIME_MSEC);
+    ck_assert_uint_eq(server->sessionManager.currentSessionCount, 2);
+    ck_assert_ptr_eq(UA_SessionManager_getSessionById(&server->sessionManager,
+                                                      &shortSession->sessionId), NULL);
+    ck_assert_ptr_eq(UA_SessionManager_getSessionById(&server->sessionManager,
+                                                      &usedSession->sessionId), usedSession);
+
+    UA_SessionManager_cleanupTimedOut(&server->sessionManager,
+                                      now + 4500 * UA_DATETIME_MSEC);
+    ck_assert_uint_eq(server->sessionManager.currentSessionCount, 1);
+    ck_assert_ptr_eq(UA_SessionManager_getSessionById(&server->sessionManager,
+                                                      &longSession->sessionId), longSession);
+
+    UA_SessionManager_cleanupTimedOut(&server->sessionManager,
+                                      now + 6000 * UA_DATETIME_MSEC);
+    ck_assert_uint_eq(server->sessionManager.currentSessionCount, 0);
+}
+END_TEST
+
 static Suite* testSuite_Session(void) {
     Suite *s = suite_create("Session");
     TCase *tc_core = tcase_create("Core");
@@ -53,6 +158,12 @@ static Suite* testSuite_Session(void) {
     tcase_add_test(tc_core, Session_updateLifetime_ShallWork);
 
     suite_add_tcase(s,tc_core);
+
+    TCase *tc_manager = tcase_create("SessionManager");
+    tcase_add_checked_fixture(tc_manager, setup, teardown);
+    tcase_add_test(tc_manager, SessionManager_lookupShallFindAllSessions);
+    tcase_add_test(tc_manager, SessionManager_cleanupShallRemoveTimedOutSessions);
+    suite_add_tcase(s, tc_manager);
     return s;
 }
 
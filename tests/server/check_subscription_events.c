@@ -361,6 +361,138 @@ START_TEST(uppropagation) {
 }
 END_TEST
 
+static UA_StatusCode
+emitEvent(const UA_NodeId origin, UA_ByteString *outEventId) {
+    UA_QualifiedName severityName = UA_QUALIFIEDNAME(0, "Severity");
+    UA_QualifiedName messageName = UA_QUALIFIEDNAME(0, "Message");
+    UA_UInt16 eventSeverity = 1000;
+    UA_LocalizedText message = UA_LOCALIZEDTEXT("en-US", "Generated Event");
+
+    UA_EventField fields[2];
+    fields[0].browsePathSize = 1;
+    fields[0].browsePath = &severityName;
+    UA_Variant_setScalar(&fields[0].value, &eventSeverity, &UA_TYPES[UA_TYPES_UINT16]);
+    fields[1].browsePathSize = 1;
+    fields[1].browsePath = &messageName;
+    UA_Variant_setScalar(&fields[1].value, &message, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    return UA_Server_emitEvent(server, eventType, origin, 2, fields, outEventId);
+}
+
+static void
+deleteMonitoredItem(void) {
+    UA_DeleteMonitoredItemsRequest deleteRequest;
+    UA_DeleteMonitoredItemsRequest_init(&deleteRequest);
+    deleteRequest.subscriptionId = subscriptionId;
+    deleteRequest.monitoredItemIds = &monitoredItemId;
+    deleteRequest.monitoredItemIdsSize = 1;
+
+    UA_DeleteMonitoredItemsResponse deleteResponse =
+        UA_Client_MonitoredItems_delete(client, deleteRequest);
+    ck_assert_uint_eq(deleteResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(deleteResponse.resultsSize, 1);
+    UA_DeleteMonitoredItemsResponse_deleteMembers(&deleteResponse);
+}
+
+// the server publishes from its own thread. give it some time to respond.
+static void
+fetchNotifications(void) {
+    notificationReceived = false;
+    UA_fakeSleep((UA_UInt32) publishingInterval + 100);
+    for(size_t i = 0; i < 5 && !notificationReceived; i++) {
+        UA_realSleep(20);
+        UA_StatusCode retval = UA_Client_run_iterate(client, 0);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+}
+
+// events without a node representation are received with the same values
+START_TEST(emitEvents) {
+    UA_MonitoredItemCreateResult createResult = addMonitoredItem(handler_events_simple);
+    ck_assert_uint_eq(createResult.statusCode, UA_STATUSCODE_GOOD);
+
+    UA_ByteString eventId = UA_BYTESTRING_NULL;
+    UA_StatusCode retval = emitEvent(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), &eventId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(eventId.length, 16);
+    UA_ByteString_deleteMembers(&eventId);
+
+    fetchNotifications();
+    ck_assert_uint_eq(notificationReceived, true);
+
+    // the event type must be a subtype of BaseEventType
+    retval = UA_Server_emitEvent(server, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), 0, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADINVALIDARGUMENT);
+
+    deleteMonitoredItem();
+}
+END_TEST
+
+START_TEST(emitUppropagation) {
+    UA_MonitoredItemCreateResult createResult = addMonitoredItem(handler_events_propagate);
+    ck_assert_uint_eq(createResult.statusCode, UA_STATUSCODE_GOOD);
+
+    UA_StatusCode retval = emitEvent(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_NAMESPACES), NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    fetchNotifications();
+    ck_assert_uint_eq(notificationReceived, true);
+    deleteMonitoredItem();
+}
+END_TEST
+
+static void
+handler_events_any(UA_Client *lclient, UA_UInt32 subId, void *subContext,
+                   UA_UInt32 monId, void *monContext,
+                   size_t nEventFields, UA_Variant *eventFields) {
+    ck_assert_uint_eq(nEventFields, nSelectClauses);
+    notificationReceived = true;
+}
+
+// the cached parents of an origin follow changes of the hierarchy
+START_TEST(emitAfterReferenceChange) {
+    UA_NodeId objectId = UA_NODEID_NUMERIC(1, 5001);
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, objectId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "EventSource"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_MonitoredItemCreateResult createResult = addMonitoredItem(handler_events_any);
+    ck_assert_uint_eq(createResult.statusCode, UA_STATUSCODE_GOOD);
+
+    // the object is not below the server object
+    retval = emitEvent(objectId, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    fetchNotifications();
+    ck_assert_uint_eq(notificationReceived, false);
+
+    UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NUMERIC(1, 5001);
+    retval = UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), target, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = emitEvent(objectId, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    fetchNotifications();
+    ck_assert_uint_eq(notificationReceived, true);
+
+    retval = UA_Server_deleteReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), true,
+                                       target, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = emitEvent(objectId, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    fetchNotifications();
+    ck_assert_uint_eq(notificationReceived, false);
+
+    deleteMonitoredItem();
+}
+END_TEST
+
 /*
 static void
 handler_events_overflow(UA_Client *lclient, UA_UInt32 subId, void *subContext,
@@ -429,6 +561,9 @@ static Suite *testSuite_Client(void) {
     tcase_add_checked_fixture(tc_server, setup, teardown);
     tcase_add_test(tc_server, generateEvents);
     tcase_add_test(tc_server, uppropagation);
+    tcase_add_test(tc_server, emitEvents);
+    tcase_add_test(tc_server, emitUppropagation);
+    tcase_add_test(tc_server, emitAfterReferenceChange);
 //    tcase_add_test(tc_server, eventOverflow);
 #endif // UA_ENABLE_SUBSCRIPTIONS_EVENTS
     suite_add_tcase(s, tc_server);
@@ -63,3 +63,18 @@ UA_comboSleep(UA_UInt32 duration) {
     UA_fakeSleep(duration);
     UA_realSleep(duration);
 }
+
+UA_DateTime
+UA_realNowMonotonic(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, ticks;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&ticks);
+    UA_Double ticks2dt = UA_DATETIME_SEC / (UA_Double)freq.QuadPart;
+    return (UA_DateTime)(ticks.QuadPart * ticks2dt);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * UA_DATETIME_SEC) + (ts.tv_nsec / 100);
+#endif
+}
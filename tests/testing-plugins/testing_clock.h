@@ -24,6 +24,10 @@ void UA_fakeSleep(UA_UInt32 duration);
 /* Sleep for the duration in milliseconds. Used to wait for workers to complete. */
 void UA_realSleep(UA_UInt32 duration);
 
+/* The monotonic wall-clock time of the system. Not affected by the testing
+ * clock. Used to measure the duration of benchmarks. */
+UA_DateTime UA_realNowMonotonic(void);
+
 /* Sleep for the duration in milliseconds and update the current time.
  * combines fakeSleep and realSleep.
  * */
@@ -399,6 +399,14 @@ parser.add_argument('-s', '--selected-types',
                     default=[],
                     help='file with list of types (among those parsed) to be generated. If not given, all types are generated')
 
+parser.add_argument('--specialized-types',
+                    metavar="<specializedTypes>",
+                    type=argparse.FileType('r'),
+                    dest="specialized_types",
+                    action='append',
+                    default=[],
+                    help='file with list of structures for which specialized binary en-/decoding functions are generated')
+
 parser.add_argument('--no-builtin',
                     action='store_true',
                     dest="no_builtin",
@@ -505,6 +513,40 @@ printh('''/**
 printh("#define " + outname.upper() + "_COUNT %s" % (str(len(filtered_types))))
 printh("extern UA_EXPORT const UA_DataType " + outname.upper() + "[" + outname.upper() + "_COUNT];")
 
+# Perfect hash tables from the numeric typeId / binaryEncodingId to the index
+# in the type array. The table size is the smallest modulus for which no two
+# keys collide. Unused slots contain the type count.
+def perfect_hash(keys):
+    size = max(len(keys), 1)
+    while len(set(map(lambda k: k % size, keys))) != len(keys):
+        size += 1
+    table = [len(filtered_types)] * size
+    for key, index in keys.items():
+        table[key % size] = index
+    return table
+
+hashtables = []
+if outname == "ua_types":
+    typeIds = {}
+    binaryEncodingIds = {}
+    for i, t in enumerate(filtered_types):
+        if not t.name in typedescriptions:
+            continue
+        description = typedescriptions[t.name]
+        typeIds[int(description.nodeid)] = i
+        if int(description.binaryEncodingId) != 0:
+            binaryEncodingIds[int(description.binaryEncodingId)] = i
+    hashtables = [("TYPEID", perfect_hash(typeIds)),
+                  ("BINARYENCODINGID", perfect_hash(binaryEncodingIds))]
+    printh('''
+/* Perfect hash of the numeric typeId and binaryEncodingId to the index in
+ * %s. Look up with the identifier modulo the table size. Unused slots
+ * contain %s_COUNT. */''' % (outname.upper(), outname.upper()))
+    for (name, table) in hashtables:
+        printh("#define %s_%s_HASHSIZE %s" % (outname.upper(), name, len(table)))
+        printh("extern const UA_UInt16 %s_%s_HASH[%s_%s_HASHSIZE];" %
+               (outname.upper(), name, outname.upper(), name))
+
 i = 0
 for t in filtered_types:
     printh("\n/**\n * " +  t.name)
@@ -584,6 +626,13 @@ for t in filtered_types:
     printc(t.datatype_c() + ",")
 printc("};\n")
 
+for (name, table) in hashtables:
+    printc("const UA_UInt16 %s_%s_HASH[%s_%s_HASHSIZE] = {" %
+           (outname.upper(), name, outname.upper(), name))
+    for i in range(0, len(table), 12):
+        printc("    " + ", ".join(map(str, table[i:i+12])) + ",")
+    printc("};\n")
+
 ##################
 # Print Encoding #
 ##################
@@ -603,3 +652,113 @@ fh.close()
 ff.close()
 fc.close()
 fe.close()
+
+##############################
+# Print Specialized Encoding #
+##############################
+
+# Builtin types that share the binary encoding of another builtin type
+builtin_codec = {"SByte": "Byte", "Int16": "UInt16", "Int32": "UInt32",
+                 "StatusCode": "UInt32", "Int64": "UInt64", "DateTime": "UInt64",
+                 "ByteString": "String", "XmlElement": "String"}
+
+builtin_fixed_size = {"Boolean": 1, "SByte": 1, "Byte": 1, "Int16": 2, "UInt16": 2,
+                      "Int32": 4, "UInt32": 4, "Float": 4, "StatusCode": 4,
+                      "Int64": 8, "UInt64": 8, "Double": 8, "DateTime": 8, "Guid": 16}
+
+# Resolve opaque types and enums to the builtin type of their encoding
+def codec_type(t):
+    if isinstance(t, OpaqueType):
+        return codec_type(t.members[0].memberType)
+    if isinstance(t, EnumerationType):
+        return types["Int32"]
+    return t
+
+def specialized_members(t):
+    for m in t.members:
+        member_type = "UA_" + m.memberType.name
+        ptr = m.memberType.datatype_ptr()
+        ct = codec_type(m.memberType)
+        yield m, member_type, ptr, ct
+
+def specialized_encoding(t):
+    enc = "static status\n%s_encodeBinarySpecialized(const UA_%s *src, const UA_DataType *type, Ctx *ctx) {\n" % (t.name, t.name)
+    dec = "static status\n%s_decodeBinarySpecialized(UA_%s *dst, const UA_DataType *type, Ctx *ctx) {\n" % (t.name, t.name)
+    size = "static size_t\n%s_calcSizeBinarySpecialized(const UA_%s *src, const UA_DataType *type) {\n" % (t.name, t.name)
+    if len(t.members) > 0:
+        enc += "    status ret;\n"
+        dec += "    status ret;\n"
+    fixed = 0
+    variable = []
+    for m, member_type, ptr, ct in specialized_members(t):
+        if m.isArray:
+            enc += "    ENCODE_ARRAY(src->%s, src->%sSize, %s);\n" % (m.name, m.name, ptr)
+            dec += "    DECODE_ARRAY(&dst->%s, &dst->%sSize, %s);\n" % (m.name, m.name, ptr)
+            variable.append("Array_calcSizeBinary(src->%s, src->%sSize, %s)" % (m.name, m.name, ptr))
+        elif isinstance(ct, BuiltinType):
+            codec = builtin_codec.get(ct.name, ct.name)
+            # Floating point numbers may be encoded as integers (see
+            # UA_BINARY_OVERLAYABLE_FLOAT)
+            suffix = "Specialized" if codec in ["Float", "Double"] else "Binary"
+            enc += "    ENCODE_MEMBER((const UA_%s*)&src->%s, %s_encode%s, %s);\n" % (codec, m.name, codec, suffix, ptr)
+            dec += "    DECODE_MEMBER((UA_%s*)&dst->%s, %s_decode%s, %s);\n" % (codec, m.name, codec, suffix, ptr)
+            if ct.name in builtin_fixed_size:
+                fixed += builtin_fixed_size[ct.name]
+            else:
+                variable.append("%s_calcSizeBinary((const UA_%s*)&src->%s, NULL)" % (codec, codec, m.name))
+        else:
+            enc += "    ENCODE_MEMBER(&src->%s, encodeBinaryInternal, %s);\n" % (m.name, ptr)
+            dec += "    DECODE_MEMBER(&dst->%s, decodeBinaryInternal, %s);\n" % (m.name, ptr)
+            variable.append("UA_calcSizeBinary(&src->%s, %s)" % (m.name, ptr))
+    enc += "    return UA_STATUSCODE_GOOD;\n}"
+    dec += "    return UA_STATUSCODE_GOOD;\n}"
+    size += "    size_t s = %d;\n" % fixed
+    for v in variable:
+        size += "    s += %s;\n" % v
+    size += "    return s;\n}"
+    return enc + "\n\n" + dec + "\n\n" + size
+
+if len(args.specialized_types) > 0:
+    specialized_names = []
+    for f in args.specialized_types:
+        specialized_names += list(filter(len, [line.strip() for line in f]))
+    # Only structures whose members are all part of the generated types
+    filtered_names = [t.name for t in filtered_types]
+    specialized = [t for t in filtered_types if t.name in specialized_names and
+                   isinstance(t, StructType) and
+                   all(m.memberType.name in filtered_names for m in t.members)]
+    if len(specialized) > 255:
+        raise Exception("Too many specialized types for the index table")
+
+    fs = open(args.outfile + "_generated_encoding_specialized.h",'w')
+    def prints(string):
+        print(string, end='\n', file=fs)
+
+    prints('''/* Generated from ''' + inname + ''' with script ''' + sys.argv[0] + '''
+ * on host ''' + platform.uname()[1] + ''' by user ''' + getpass.getuser() + \
+           ''' at ''' + time.strftime("%Y-%m-%d %I:%M:%S") + ''' */
+
+/* Included at the end of ua_types_encoding_binary.c. The functions en-/decode
+ * the members in sequence without interpreting the type description. */''')
+
+    for t in specialized:
+        prints("\n/* " + t.name + " */")
+        prints(specialized_encoding(t))
+
+    index = [0] * len(filtered_types)
+    for i, t in enumerate(specialized):
+        index[filtered_types.index(t)] = i + 1
+    prints("\nconst UA_Byte UA_specializedBinaryIndex[%s_COUNT] = {" % outname.upper())
+    for i in range(0, len(index), 12):
+        prints("    " + ", ".join(map(str, index[i:i+12])) + ",")
+    prints("};")
+
+    for kind in ["encode", "decode", "calcSize"]:
+        sig = "UA_%sBinarySpecializedSignature" % kind
+        prints("\nconst %s UA_%sBinarySpecializedJumpTable[%s] = {" % (sig, kind, max(len(specialized), 1)))
+        if len(specialized) == 0:
+            prints("    NULL")
+        for t in specialized:
+            prints("    (%s)%s_%sBinarySpecialized," % (sig, t.name, kind))
+        prints("};")
+    fs.close()
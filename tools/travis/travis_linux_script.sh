@@ -247,6 +247,16 @@ else
     cd .. && rm build -rf
     echo -en 'travis_fold:end:script.build.unit_test_ns0_full\\r'
 
+    echo -e "\r\n== Unit tests (specialized encoding) ==" && echo -en 'travis_fold:start:script.build.unit_test_specialized\\r'
+    mkdir -p build && cd build
+    cmake -DPYTHON_EXECUTABLE:FILEPATH=/usr/bin/$PYTHON \
+    -DCMAKE_BUILD_TYPE=Debug -DUA_BUILD_UNIT_TESTS=ON -DUA_ENABLE_COVERAGE=OFF \
+    -DUA_ENABLE_UNIT_TESTS_MEMCHECK=ON -DUA_ENABLE_SPECIALIZED_ENCODING=ON ..
+    make -j && make test ARGS="-V"
+    if [ $? -ne 0 ] ; then exit 1 ; fi
+    cd .. && rm build -rf
+    echo -en 'travis_fold:end:script.build.unit_test_specialized\\r'
+
     if [ "$CC" != "tcc" ]; then
         echo -e "\r\n== Unit tests (minimal NS0) ==" && echo -en 'travis_fold:start:script.build.unit_test_ns0_minimal\\r'
         mkdir -p build && cd build